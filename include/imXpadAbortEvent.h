@@ -0,0 +1,74 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADABORTEVENT_H_
+#define IMXPADABORTEVENT_H_
+
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class AbortEvent
+ * \brief eventfd waking every socket read waiting on it
+ *
+ * Once triggered, the event stays set until clear(), so that all the
+ * readers sharing it leave their wait, not only the first one.
+ *******************************************************************/
+class AbortEvent
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "AbortEvent", "imXpad");
+
+public:
+	AbortEvent();
+	~AbortEvent();
+
+	void trigger();
+	void clear();
+	bool isTriggered() const;
+
+	//! File descriptor to add to the poll set, readable while triggered
+	int getFd() const;
+
+	//! Called by a reader leaving its wait on the event
+	void unblocked();
+
+	//! Time from the last trigger to the first read it unblocked, in seconds (-1 if none)
+	double getUnblockLatency() const;
+
+private:
+	static double _now();
+
+	int				m_fd;
+	mutable Mutex	m_lock;
+	bool			m_triggered;
+	double			m_trigger_time;
+	double			m_latency;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADABORTEVENT_H_ */
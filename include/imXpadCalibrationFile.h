@@ -0,0 +1,117 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADCALIBRATIONFILE_H_
+#define IMXPADCALIBRATIONFILE_H_
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "lima/Debug.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class CalibrationFile
+ * \brief global and local configurations of a detector in one binary file
+ *
+ * Layout, little endian:
+ *   uint32 magic ("XCAL"), uint32 version, uint32 nb_sections,
+ *   then per section: uint32 type, uint32 module, uint32 rows,
+ *   uint32 columns, uint32 crc32, uint16 values[rows * columns].
+ * The CRC covers the first four fields of the section and its values.
+ *
+ * A Global section holds the registers of one module, as in the .cfg
+ * text: one row per register, its id then one value per chip, module
+ * being the module mask bit. A Local section holds the 120 lines of
+ * one module of the .cfl text, module being its rank in the file.
+ *******************************************************************/
+class CalibrationFile
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "CalibrationFile", "imXpad");
+
+public:
+	enum SectionType
+	{
+		Global = 1,
+		Local = 2
+	} ;
+
+	struct Section
+	{
+		uint32_t				type;
+		uint32_t				module;
+		uint32_t				rows;
+		uint32_t				columns;
+		std::vector<uint16_t>	values;
+	} ;
+
+	static const uint32_t MAGIC = 0x4c414358;	// "XCAL"
+	static const uint32_t VERSION = 1;
+	static const int MODULE_LINES = 120;
+	static const int CHIP_COLUMNS = 80;
+
+	CalibrationFile();
+
+	void clear();
+	const std::vector<Section>& getSections() const;
+	bool hasSections(SectionType type) const;
+
+	//! Replace the sections of the type by the ones of a server text (.cfg or .cfl)
+	void parseText(SectionType type, const char *text, size_t len);
+
+	//! Replace the Local sections by a map of the whole detector, MODULE_LINES rows per module
+	void setLocal(const uint16_t *values, uint32_t rows, uint32_t columns);
+
+	//! Server text of the sections of the type
+	void formatText(SectionType type, std::string& text) const;
+
+	//! Server text of the Local sections selected by rank, others left out
+	void formatLocalText(const std::vector<bool>& modules, std::string& text) const;
+
+	//! Per Local section, one bit per chip differing from the same section of reference, all bits if it has none
+	void getChangedChips(const CalibrationFile& reference, std::vector<uint32_t>& chip_masks) const;
+
+	//! Same from and to text files
+	void loadText(SectionType type, const char *path);
+	void saveText(SectionType type, const char *path) const;
+
+	//! Binary container, checked against its version and checksums
+	void load(const char *path);
+	void save(const char *path) const;
+
+	static uint32_t crc32(uint32_t crc, const void *buf, size_t len);
+
+private:
+	void _parseGlobal(const char *text, size_t len);
+	void _parseLocal(const char *text, size_t len);
+	static uint32_t _sectionCrc(const unsigned char *fields, const unsigned char *values, size_t nb_values);
+
+	std::vector<Section>	m_sections;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADCALIBRATIONFILE_H_ */
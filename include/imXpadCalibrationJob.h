@@ -0,0 +1,118 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADCALIBRATIONJOB_H_
+#define IMXPADCALIBRATIONJOB_H_
+
+#include <string>
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+#include "imXpadClient.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class CalibrationJob
+ * \brief server calibration run by its own thread and connection
+ *
+ * One job at a time. Its progress comes from the time bars the server
+ * sends while the calibration runs, its remaining time is extrapolated
+ * from the progress so far. A job is cancelled by aborting the current
+ * process of the server from another connection, cancel() only tells
+ * the job that its end is an abort.
+ *******************************************************************/
+class CalibrationJob : public ProgressCallback
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "CalibrationJob", "imXpad");
+
+public:
+	enum State
+	{
+		Idle,
+		Running,
+		Succeeded,
+		Aborted,
+		Failed
+	} ;
+
+	CalibrationJob();
+	~CalibrationJob();
+
+	//! Open the job connection, session_cmds bring it to the state of the camera one
+	void connect(const std::string& hostname, int port, const std::vector<std::string>& session_cmds);
+	void disconnect();
+	bool isConnected() const;
+
+	//! Run a calibration command, its return value is 0 on success and 1 on abort
+	void start(const std::string& cmd);
+	void cancel();
+
+	//! Wait for the end of the job, timeout in seconds (-1 forever), true if ended
+	bool wait(double timeout = -1) const;
+
+	State getState() const;
+	bool isRunning() const;
+	std::string getCommand() const;
+
+	//! Fraction of the calibration done, -1 before the first time bar
+	double getProgress() const;
+
+	//! Seconds left at the current pace, -1 while unknown
+	double getRemainingTime() const;
+
+	//! Seconds since the start, up to the end once ended
+	double getElapsedTime() const;
+
+	//! Text of the last time bar, or the error of a failed job
+	std::string getMessage() const;
+
+	virtual void progress(int done, int outoff, const std::string& message);
+
+private:
+	class JobThread;
+	friend class JobThread;
+
+	static double _now();
+
+	mutable Cond	m_cond;
+	XpadClient		*m_client;
+	JobThread		*m_thread;
+	std::string		m_cmd;
+	bool			m_pending;		// command to run, not taken by the thread yet
+	bool			m_quit;
+	bool			m_running;		// thread alive
+	bool			m_cancelled;
+	State			m_state;
+	double			m_start_time;
+	double			m_end_time;
+	double			m_progress;
+	double			m_progress_time;	// when m_progress was received
+	std::string		m_message;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADCALIBRATIONJOB_H_ */
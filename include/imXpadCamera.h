@@ -37,8 +37,27 @@
 #include "imXpadInterface.h"
 #include "lima/Debug.h"
 #include "imXpadClient.h"
+#include "imXpadWorkerPool.h"
+#include "imXpadCorrection.h"
+#include "imXpadGeometry.h"
+#include "imXpadSparse.h"
+#include "imXpadCodec.h"
+#include "imXpadModuleReadout.h"
+#include "imXpadCpuAffinity.h"
+#include "imXpadCommandQueue.h"
+#include "imXpadAbortEvent.h"
+#include "imXpadCommandBuilder.h"
+#include "imXpadTranscript.h"
+#include "imXpadFrameAccounting.h"
+#include "imXpadThroughput.h"
+#include "imXpadThresholdScan.h"
+#include "imXpadCalibrationFile.h"
+#include "imXpadCalibrationJob.h"
+#include "imXpadPixelStatistics.h"
+#include "imXpadModuleRoi.h"
 #include <unistd.h>
 #include <sys/time.h>
+#include <fstream>
 
 namespace lima
 {
@@ -299,7 +318,7 @@ public:
     //!< Get the number of images per stack;
     unsigned int getStackImages();
 
-    //! Perform a Calibration over the noise
+    //! Perform a Calibration over the noise, in the background: see getCalibrationProgress
     int calibrationOTN(unsigned short calibrationConfiguration);
 
     //! Perform a Calibration over the noise with PULSE
@@ -308,12 +327,92 @@ public:
     //! Perform a Calibration over the noise
     int calibrationBEAM(unsigned int time, unsigned int ITHLmax, unsigned short calibrationConfiguration);
 
-    //! Load a Calibration file from disk
+    //! Load a Calibration file from disk, a .xcal binary calibration or the .cfg and .cfl texts
     int loadCalibrationFromFile(char *fpath);
 
-    //! Save calibration to a file
+    //! Save calibration to a file, a .xcal binary calibration or the .cfg and .cfl texts
     int saveCalibrationToFile(char *fpath);
 
+    //! Write the .cfg and .cfl texts of a calibration into one binary calibration
+    void convertCalibration(std::string config_g_path, std::string config_l_path, std::string path);
+
+    //! Write a binary calibration back as .cfg and .cfl texts
+    void exportCalibration(std::string path, std::string config_g_path, std::string config_l_path);
+
+    //! Upload only the modules whose local configuration changed since the last upload
+    void setDeltaConfigLFlag(unsigned short flag);
+    unsigned short getDeltaConfigLFlag();
+
+    //! Get the chips changed by the last local configuration upload, the modules sent and the ones left untouched
+    void getConfigLUploadStatistics(int& changed_chips, int& sent_modules, int& skipped_modules);
+
+    //! Get the state of the last calibration (a CalibrationJob::State), its fraction done, seconds left (-1 if unknown) and spent, and the server message
+    void getCalibrationProgress(int& state, double& progress, double& remaining_time, double& elapsed_time, std::string& message);
+
+    //! Wait for the end of the calibration in progress, throw if it failed
+    void waitCalibrationEnd();
+
+    //! Abort the calibration in progress on the server
+    void cancelCalibration();
+
+    //! Keep per-pixel mean, variance, extrema and zero counts over the frames of each acquisition
+    void setPixelStatisticsFlag(unsigned short flag);
+    unsigned short getPixelStatisticsFlag();
+
+    //! Set what makes a pixel dead (zero in a fraction of the frames, mean under a fraction of the median) or noisy (mean over a multiple of the median, variance over mean)
+    void setPixelMaskThresholds(double dead_zero_fraction, double dead_mean_ratio, double noisy_mean_ratio, double noisy_dispersion);
+    void getPixelMaskThresholds(double& dead_zero_fraction, double& dead_mean_ratio, double& noisy_mean_ratio, double& noisy_dispersion);
+
+    //! Derive the dead and noisy pixel masks from the last acquisition statistics and hand them to the client-side correction
+    void applyPixelStatisticsMasks(int& nb_dead, int& nb_noisy);
+
+    //! Write the same masks, one byte per pixel, as loadLocalDeadPixelMask and loadLocalNoisyPixelMask read them
+    void savePixelStatisticsMasks(std::string dead_path, std::string noisy_path);
+
+    //---------------------------------------------------------------
+    //- Direct access, without copy, for the Python views
+    enum ThresholdScanMap
+    {
+        ThresholdMap,
+        NoiseMap
+    } ;
+
+    enum PixelStatisticsMap
+    {
+        MeanMap,            ///< double
+        VarianceMap,        ///< double, only as a copy from getPixelStatisticsVariance
+        MinMap,             ///< uint32
+        MaxMap,             ///< uint32
+        ZeroCountMap        ///< uint32
+    } ;
+
+    //! Get a frame still in the buffer ring, valid until it is overwritten or the buffers reallocated
+    void getFrameBufferView(int frame_nb, void*& ptr, int& width, int& height, int& depth);
+
+    //! Get a map of the last threshold scan, one float per pixel, valid until the next scan
+    const float* getThresholdScanMap(int map, int& width, int& height);
+
+    //! Get a map of the pixel statistics, valid until the next acquisition
+    const void* getPixelStatisticsMap(int map, int& width, int& height);
+
+    //! Copy the variance map of the pixel statistics, computed from the running sums
+    void getPixelStatisticsVariance(std::vector<double>& variance, int& width, int& height);
+
+    //! Upload a local configuration of the whole detector, one trim value per pixel, 120 lines per module
+    int loadConfigLFromArray(const unsigned short* values, int width, int height);
+
+    //---------------------------------------------------------------
+    //- Readout of the modules holding a region only
+    //! Enable the fewest modules holding the region x, y, width x height of the whole detector frame, shrinking the
+    //! frame to them; a zero width or height reads the whole detector out again
+    void setModuleRoi(int x, int y, int width, int height);
+
+    //! Get the region asked for, all zero if none
+    void getModuleRoi(int& x, int& y, int& width, int& height);
+
+    //! Get the modules read out, the first line of the whole detector frame they start at and their number of lines
+    void getModuleRoiReadout(unsigned int& module_mask, int& first_line, int& nb_lines);
+
     //! Cancel current operation
     void abortCurrentProcess();
 
@@ -359,8 +458,206 @@ public:
     //!< Create the dead noisy pixel mask
     int createDeadNoisyMask();
 
+    //---------------------------------------------------------------
+    //- Client-side processing
+    //! Set the number of threads helping the acquisition thread to process frames
+    void setProcessingThreads(unsigned int nb_threads);
+
+    //! Get the number of processing threads
+    unsigned int getProcessingThreads();
+
+    //! Set flag for client-side flat field & dead/noisy pixel corrections (server ones restored on 0)
+    void setLocalCorrectionFlag(unsigned short flag);
+
+    //! Get flag for client-side corrections
+    unsigned short getLocalCorrectionFlag();
+
+    //! Load a raw 32 bits white image for the client-side flat field correction
+    int loadLocalFlatField(char *fpath);
+
+    //! Load a dead pixel mask (one byte per pixel) for the client-side correction
+    int loadLocalDeadPixelMask(char *fpath);
+
+    //! Load a noisy pixel mask (one byte per pixel) for the client-side correction
+    int loadLocalNoisyPixelMask(char *fpath);
+
+    //! Drop every client-side correction map
+    void clearLocalCorrections();
+
+    //! Set how masked pixels are corrected: 0 -> zero, 1 -> interpolate
+    void setLocalBadPixelMode(unsigned short mode);
+
+    //! Get how masked pixels are corrected
+    unsigned short getLocalBadPixelMode();
+
+    //! Set flag for client-side geometrical corrections (replaces the server one, restored on 0)
+    void setLocalGeometricalCorrectionFlag(unsigned short flag);
+
+    //! Get flag for client-side geometrical corrections
+    unsigned short getLocalGeometricalCorrectionFlag();
+
+    //! Set the gap columns inserted between chips and gap lines between modules
+    void setLocalGeometryGaps(unsigned int chip_gap, unsigned int module_gap);
+
+    //! Set the number of lines remapped by one processing work item
+    void setLocalGeometryBlockLines(unsigned int block_lines);
+
+    //! Get the duration of the last frame remap in seconds
+    double getLocalGeometryRemapTime();
+
+    //! Set flag for sparse encoding of the received frames
+    void setSparseFlag(unsigned short flag);
+
+    //! Get flag for sparse encoding
+    unsigned short getSparseFlag();
+
+    //! Set the fraction of non-zero pixels above which frames stay dense
+    void setSparseOccupancyThreshold(double occupancy);
+
+    //! Get the sparse occupancy threshold
+    double getSparseOccupancyThreshold();
+
+    //! Set the file receiving the sparse frames of each acquisition (empty to disable)
+    void setSparseFile(char *fpath);
+
+    //! Register a consumer of the sparse frames
+    void registerSparseFrameCallback(SparseFrameCallback& cb);
+
+    //! Unregister a consumer of the sparse frames
+    void unregisterSparseFrameCallback(SparseFrameCallback& cb);
+
+    //! Get the number of frames sent sparse and dense during the last acquisition
+    void getSparseStatistics(int& nb_sparse, int& nb_dense);
+
+    //! Negotiate the frame transfer compression with the server (0 raw, 1 bit-packed)
+    void setTransferCompression(unsigned short codec);
+
+    //! Get the negotiated frame transfer compression
+    unsigned short getTransferCompression();
+
+    //! Set flag for the readout of every module on its own connection and thread,
+    //! refused while the server geometrical correction is on
+    void setModuleReadoutFlag(unsigned short flag);
+
+    //! Get flag for the per-module readout
+    unsigned short getModuleReadoutFlag();
+
+    //! Get the time between the first and the last module band of the last frame, in seconds
+    double getModuleReadoutSkew();
+
+    //! Set the hugepage backing of the frame buffers (0 none, 1 transparent, 2 MAP_HUGETLB)
+    void setBufferHugePageMode(unsigned short mode);
+
+    //! Get the hugepage backing of the frame buffers
+    unsigned short getBufferHugePageMode();
+
+    //! Get the time spent touching new frame buffer pages in the last prepareAcq, in seconds
+    double getBufferPrefaultTime();
+
+    //! Pin the acquisition and processing threads to a CPU list ("0-3,8", empty to unpin)
+    void setCpuAffinity(std::string cpu_list);
+
+    //! Get the CPU list of the acquisition and processing threads
+    void getCpuAffinity(std::string& cpu_list);
+
+    //! Set the SCHED_FIFO priority of the acquisition and processing threads (0 for default scheduling)
+    void setRealtimePriority(int priority);
+
+    //! Get the SCHED_FIFO priority of the acquisition and processing threads
+    int getRealtimePriority();
+
+    //! Get the CPU changes seen by the acquisition thread and the processing threads during the last acquisition
+    void getThreadMigrations(int& acq_thread, int& workers);
+
+    //! Queue a server command on the command connection, return_type is a CommandQueue::ReturnType
+    CommandFuture sendCommandAsync(std::string cmd, int return_type, CommandCallback* cb = NULL);
+
+    //! Queued versions of the blocking calls, the result is read from the future
+    CommandFuture getBurstNumberAsync(CommandCallback* cb = NULL);
+    CommandFuture createWhiteImageAsync(std::string fileName, CommandCallback* cb = NULL);
+    CommandFuture deleteWhiteImageAsync(std::string fileName, CommandCallback* cb = NULL);
+    CommandFuture setWhiteImageAsync(std::string fileName, CommandCallback* cb = NULL);
+    CommandFuture getWhiteImagesInDirAsync(CommandCallback* cb = NULL);
+
+    //! Get the number of queued commands not yet completed
+    int getNbPendingCommands();
+
+    //! Get the time the last stop took to wake up the frame reception, in seconds (-1 if none)
+    double getAbortLatency();
+
+    //! Reconnect a dropped server connection and restore its settings, giving up after nb_attempts (0 to disable)
+    void setAutoReconnect(unsigned short nb_attempts);
+
+    //! Get the number of reconnection attempts before giving up
+    unsigned short getAutoReconnect();
+
+    //! Get the reconnections of the command connection and the duration of the last one, restore included, in seconds
+    void getReconnectStatistics(int& nb_reconnects, double& last_reconnect_time);
+
+    //! Record every byte of the command connection, frames included, with its time, to a transcript file
+    void startProtocolCapture(std::string path);
+    void stopProtocolCapture();
+
+    //! Get the number of connection bytes recorded by the current or last capture
+    long long getProtocolCaptureSize();
+
+    //! Get the frames of the current or last acquisition: expected (0 if until stopped), received, received with a
+    //! payload shorter than their header announces, headers with no payload or an unexpected size, frames coming more
+    //! than half an exposure-plus-latency period late (internal trigger only) and the longest gap between two frames
+    void getFrameAccounting(int& expected, int& received, int& short_reads, int& header_anomalies,
+                            int& late_frames, double& max_gap);
+
+    //! Get the time a frame header came and the modelled start of its exposure, in seconds from the acquisition start
+    void getFrameTiming(int frame_nb, double& receive_time, double& exposure_start);
+
+    //! Get the delay from the modelled exposure start to the frame reception: mean, standard deviation and max, in seconds
+    void getFrameTimingStatistics(double& mean_delay, double& jitter, double& max_delay);
+
+    //! Get the frame rate the link and the client sustain with the current modules, pixel depth, transfer and timing
+    double getMaxFrameRate();
+
+    //! Set the bandwidth of the server link, in bytes per second, used until one is measured
+    void setLinkBandwidth(double bandwidth);
+
+    //! Get the link and client bandwidths, in bytes per second, and the compression ratio of the throughput model
+    void getThroughputModel(double& link_bandwidth, double& client_bandwidth, double& compression_ratio);
+
+    //! Reject, instead of warning about, a frame rate the link or the client cannot sustain at prepareAcq
+    void setStrictFrameRateFlag(unsigned short flag);
+    unsigned short getStrictFrameRateFlag();
+
+    //! Step ITHL from first_ithl to last_ithl, one frame per step, then fit the per-pixel threshold and noise,
+    //! refused while the per-module readout is on
+    void startThresholdScan(unsigned short first_ithl, unsigned short last_ithl);
+
+    //! Get the steps acquired by the last threshold scan and the time of its acquisition and fit, in seconds,
+    //! once it ended; throws the error of a failed scan
+    void getThresholdScanTimes(int& nb_steps, double& acquisition_time, double& fit_time);
+
+    //! Write the threshold and noise maps of the last scan, in ITHL units, one float per pixel
+    void saveThresholdScanMaps(std::string threshold_path, std::string noise_path);
+
 private:
 
+    int receiveFrame(void *bptr, int frame_nb);
+    int readFrameExpose(void *bptr, int frame_nb, size_t capacity);
+    void processFrame(void *rptr, void *bptr, int frame_nb);
+    void accountFrame(int ret);
+    Timestamp frameTimestamp(int frame_nb);
+    double minFramePeriod();
+    void runThresholdScan();
+    int readConfigGText(std::ostream& file);
+    void loadBinaryCalibration(const std::string& path);
+    void saveBinaryCalibration(const std::string& path);
+    int uploadConfigL(const CalibrationFile& config);
+    void startCalibrationJob(const std::string& cmd);
+    void exposureParametersCommand(CommandBuilder& cmd);
+    void exposureParametersCommand(CommandBuilder& cmd, int nb_frames, unsigned int trigger_mode,
+                                   unsigned short transfer_flag);
+    void getSessionCommands(XpadClient *client, std::vector<std::string>& cmds);
+    int applyModuleMask(unsigned int moduleMask);
+    void updateImageSize();
+
 
 /*     GLOBAL REGISTERS     */
 #define AMPTP                       31
@@ -434,8 +731,68 @@ private:
     unsigned int            m_stack_images;
 
     // Buffer control object
-    SoftBufferCtrlObj       m_buffer_ctrl_obj;
+    BufferCtrlObj           m_buffer_ctrl_obj;
     XpadStatus              m_state;
+
+    //---------------------------------
+    //- Client-side processing
+    WorkerPool              m_pool;
+    Correction              m_correction;
+    unsigned short          m_local_correction_flag;
+    unsigned short          m_server_noisy_pixel_flag;	// server flags saved while the plugin corrects
+    unsigned short          m_server_dead_pixel_flag;
+    Geometry                m_geometry;
+    unsigned short          m_local_geometry_flag;
+    unsigned short          m_server_geometry_flag;	// server flag saved while the plugin remaps
+    std::vector<uint32_t>   m_raw_frame;
+    SparseEncoder           m_sparse_encoder;
+    SparseFrame             m_sparse_frame;
+    unsigned short          m_sparse_flag;
+    std::string             m_sparse_file_path;
+    std::ofstream           m_sparse_file;
+    Mutex                   m_sparse_lock;
+    std::vector<SparseFrameCallback*> m_sparse_cbs;
+    int                     m_sparse_nb_frames;
+    int                     m_dense_nb_frames;
+    FrameCodec              m_codec;
+    unsigned short          m_transfer_compression;
+    ModuleReadout           m_module_readout;
+    unsigned short          m_module_readout_flag;
+    CpuAffinity             m_cpu_affinity;
+    int                     m_cpu_affinity_generation;
+    MigrationCounter        m_acq_migrations;	// guarded by m_cond
+    CommandQueue            m_command_queue;
+    Mutex                   m_command_lock;
+    AbortEvent              m_abort_event;
+    bool                    m_frame_streaming;
+    bool                    m_acq_aborted;
+    class                   SessionRestore;
+    SessionRestore          *m_session_restore;
+    std::string             m_white_image;
+    unsigned short          m_auto_reconnect;
+    TranscriptWriter        m_transcript;
+    FrameAccounting         m_frame_accounting;
+    double                  m_start_raw_time;
+    ThroughputModel         m_throughput;
+    unsigned short          m_strict_frame_rate_flag;
+    ThresholdScan           m_threshold_scan;
+    unsigned short          m_scan_first_ithl;
+    unsigned short          m_scan_last_ithl;
+    int                     m_scan_nb_steps;
+    double                  m_scan_acq_time;
+    double                  m_scan_fit_time;
+    std::string             m_scan_error;		// failure of the last scan, empty if it succeeded
+    CalibrationFile         m_config_l_uploaded;    // what the detector holds, empty if unknown
+    unsigned short          m_delta_config_l_flag;
+    int                     m_config_l_changed_chips;
+    int                     m_config_l_sent_modules;
+    int                     m_config_l_skipped_modules;
+    CalibrationJob          m_calibration_job;
+    PixelStatistics         m_pixel_statistics;
+    unsigned short          m_pixel_statistics_flag;
+    PixelStatistics::Thresholds m_mask_thresholds;
+    unsigned int            m_detector_module_mask; // modules of the whole detector
+    ModuleRoi               m_module_roi;
 } ;
 
 } // namespace imXpad
@@ -39,6 +39,46 @@ namespace imXpad {
 
 const int RD_BUFF = 1000;	// Read buffer for more efficient recv
 
+class FrameCodec;
+class AbortEvent;
+class CommandBuilder;
+class ServerLine;
+class TranscriptWriter;
+class XpadClient;
+
+// called once a dropped connection is open again, to restore the server session
+class ConnectionCallback {
+public:
+    virtual ~ConnectionCallback() {}
+    virtual void connectionRestored(XpadClient& client) = 0;
+};
+
+// time bar of the command in progress, called from the thread waiting for its return
+class ProgressCallback {
+public:
+    virtual ~ProgressCallback() {}
+    virtual void progress(int done, int outoff, const std::string& message) = 0;
+};
+
+// header of the last frame read from the data stream
+struct FrameHeader {
+    enum Kind {
+        Frame,          // header and payload read
+        EndOfStream,    // '*' header closing the stream
+        Empty,          // header announcing no payload
+        Oversized,      // header announcing more than the buffer holds, payload dropped
+        Aborted         // read left on abort
+    };
+    Kind kind;
+    uint32_t data_size;
+    uint32_t lines;
+    uint32_t columns;
+    bool compressed;    // payload decoded by the frame codec
+    double receive_time;    // CLOCK_MONOTONIC_RAW seconds at the header arrival
+    double payload_time;    // CLOCK_MONOTONIC_RAW seconds once the payload is read
+    int nb_reads;           // reads the payload took, 1 if it was already buffered
+};
+
 class XpadClient {
 DEB_CLASS_NAMESPC(DebModCamera, "XpadClient", "Xpad");
 
@@ -46,21 +86,43 @@ public:
     XpadClient();
     ~XpadClient();
 
-    void sendNoWait(std::string cmd);
-	void sendWait(std::string cmd);
-	void sendWait(std::string cmd, int& value);
-	void sendWait(std::string cmd, double& value);
-	void sendWait(std::string cmd, std::string& value);
+    void sendNoWait(const std::string& cmd);
+	void sendWait(const std::string& cmd);
+	void sendWait(const std::string& cmd, int& value);
+	void sendWait(const std::string& cmd, double& value);
+	void sendWait(const std::string& cmd, std::string& value);
+    void sendNoWait(const CommandBuilder& cmd);
+	void sendWait(const CommandBuilder& cmd);
+	void sendWait(const CommandBuilder& cmd, int& value);
+	void sendWait(const CommandBuilder& cmd, double& value);
+	void sendWait(const CommandBuilder& cmd, std::string& value);
+	void sendBatch(const std::vector<std::string>& cmds, std::vector<int>& values);
 
 	int connectToServer (const std::string hostname, int port);
 	void disconnectFromServer();
+	static XpadClient* open(const std::string& hostname, int port);	// connected client, throws on failure
+	void shutdown();		// wakes up a thread blocked on the socket, closed by disconnectFromServer()
+	void release(bool busy);	// Exit if idle, then shutdown() to cut a command in progress
+    void setAutoReconnect(int max_attempts);		// 0: a dropped connection is an error
+    void setConnectionCallback(ConnectionCallback* cb);
+    void setProgressCallback(ProgressCallback* cb);	// NULL: time bars are dropped
+    void reconnect();
+    int getNbReconnects() const;
+    double getLastReconnectTime() const;			// seconds, restore included
 	int initServerDataPort();
     //void getData(void* bptr, unsigned short xpad_format);
     int sendParametersFile(char* filePath);
     int receiveParametersFile(char* filePath);
+    int sendParametersData(const char* data, uint32_t size);	// same as a file, from memory
+    int receiveParametersData(std::string& data);
     void sendExposeCommand();
-    int getDataExpose(void* bptr, unsigned short xpadFormat);
+    int getDataExpose(void* bptr, unsigned short xpadFormat, size_t capacity);	// capacity of bptr, in bytes
+    const FrameHeader& getLastFrameHeader() const;	// what the last getDataExpose read
+    void setFrameCodec(FrameCodec* codec);	// NULL: raw frames only
+    void setAbortEvent(AbortEvent* abort);	// NULL: reads only wait for the server
+    void setTranscript(TranscriptWriter* transcript);	// NULL: no capture
     void getExposeCommandReturn(int &value);
+    bool isResyncPending() const;			// stream left inconsistent by an abort
 	std::string getErrorMessage() const;
 	std::vector<std::string> getDebugMessages() const;
     int getChar();
@@ -76,27 +138,57 @@ private:
 	int m_data_listen_skt;				// data socket we listen on
 	int m_prompts;						// counts # of prompts received
 	int m_num_read, m_cur_pos;
-	char m_rd_buff[RD_BUFF];
+	std::vector<char> m_rd_buff;		// unread server output starts at m_cur_pos
 	int m_just_read;
 	std::string m_errorMessage;
 	std::vector<std::string> m_debugMessages;
-
-	enum ServerResponse {
-		CLN_NEXT_PROMPT,		// '> ': at prompt
-		CLN_NEXT_ERRMSG, 		// '! ': read error message
-		CLN_NEXT_DEBUGMSG,		// '# ': read debugging message
-		CLN_NEXT_TIMEBAR,		// '@ ': time-bar message
-		CLN_NEXT_UNKNOWN,		// unknown line
-		CLN_NEXT_INTRET,		// '* ': read integer ret value
-		CLN_NEXT_DBLRET,		// '* ': read double ret value
-		CLN_NEXT_STRRET			// '* ': read string ret value
+	FrameCodec* m_codec;				// decoder of compressed frames
+	std::vector<unsigned char> m_payload;	// frame payload, reused between frames
+	static const uint32_t DRAIN_CHUNK = 65536;	// read size when dropping a payload
+	AbortEvent* m_abort;				// wakes a read blocked on the server
+	int m_epoll_fd;						// waits on the socket and the abort event
+	int m_epoll_skt;					// socket registered in m_epoll_fd
+	bool m_read_aborted;				// last read left on abort
+	int m_resync;						// what is left to discard after an abort
+	bool m_draining;					// discarding, the abort event is ignored
+	unsigned char m_resync_chain[12];	// frame header read before the abort
+	uint32_t m_resync_header;			// bytes of m_resync_chain already read
+	uint32_t m_resync_payload;			// payload bytes of the aborted frame still due
+	std::string m_hostname;				// server of the last connection
+	int m_port;
+	int m_max_reconnects;				// attempts before giving up, 0 to never reconnect
+	bool m_reconnecting;
+	ConnectionCallback* m_connection_cb;
+	int m_nb_reconnects;
+	double m_reconnect_time;
+	TranscriptWriter* m_transcript;		// records the connection bytes
+	ProgressCallback* m_progress_cb;
+	FrameHeader m_last_header;
+
+	enum ResyncState {
+		RESYNC_NONE,			// stream in sync
+		RESYNC_FRAMES,			// frames left, up to the end of stream header
+		RESYNC_REPLY			// return value left, up to the next line or prompt
 	};
-	void sendCmd(const std::string cmd);
+	void sendCmd(const char *cmd, size_t len);
+	void doSendWait(const char *cmd, size_t len);
+	void doSendWait(const char *cmd, size_t len, int& value);
+	void doSendWait(const char *cmd, size_t len, double& value);
+	void doSendWait(const char *cmd, size_t len, std::string& value);
+	int waitForReturn(ServerLine& line);
 	int waitForResponse(std::string& value);
 	int waitForResponse(double& value);
 	int waitForResponse(int& value);
 	int waitForPrompt();
-	int nextLine(std::string *errmsg, int *ivalue, double *dvalue, std::string *svalue, int *done, int *outoff);
+	int waitReadable();
+	void readyForCommand();
+	bool canReconnect() const;
+	void readResync(unsigned char *buf, uint32_t len);
+	void resyncStream();
+	void nextLine(ServerLine& line);
+	int fillReadBuffer();
+	ssize_t readServer(void *buf, size_t len);
+	ssize_t writeServer(const void *buf, size_t len);
 
 
 	void errmsg_handler(const std::string errmsg);
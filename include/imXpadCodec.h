@@ -0,0 +1,86 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADCODEC_H_
+#define IMXPADCODEC_H_
+
+#include <vector>
+#include <stdint.h>
+#include "lima/Debug.h"
+#include "imXpadWorkerPool.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class FrameCodec
+ * \brief lossless block bit-packing of 32 bits frames
+ *
+ * Compressed payload, sent under the usual 12 bytes frame header:
+ *   uint32 magic ("XPZ1"), uint32 nb_pixels, uint32 block_pixels,
+ *   uint32 nb_blocks, uint32 offsets[nb_blocks + 1], blocks...
+ * Each block is one byte holding the bit width b of its largest value
+ * followed by the values packed on b bits, LSB first. Offsets are
+ * relative to the first block so that blocks decode independently.
+ *******************************************************************/
+class FrameCodec
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "FrameCodec", "imXpad");
+
+public:
+	enum
+	{
+		Raw = 0,
+		BitPack = 1
+	} ;
+
+	static const uint32_t MAGIC = 0x315a5058;	// "XPZ1"
+	static const int HEADER_SIZE = 4 * sizeof(uint32_t);
+
+	FrameCodec(WorkerPool& pool, int block_pixels = 64);
+	~FrameCodec();
+
+	//! True if payload starts with a compressed frame header
+	static bool isCompressed(const unsigned char *payload, uint32_t size);
+
+	//! Number of pixels announced by a compressed payload
+	static uint32_t getNbPixels(const unsigned char *payload);
+
+	//! Encode nb_pixels values into out (server side / tests)
+	void encode(const uint32_t *pixels, uint32_t nb_pixels, std::vector<unsigned char>& out);
+
+	//! Decode payload into frame, depth is 2 or 4 bytes per pixel
+	void decode(const unsigned char *payload, uint32_t size, void *frame,
+				uint32_t nb_pixels, int depth);
+
+private:
+	class DecodeTask;
+
+	WorkerPool&	m_pool;
+	int			m_block_pixels;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADCODEC_H_ */
@@ -0,0 +1,81 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADCOMMANDBUILDER_H_
+#define IMXPADCOMMANDBUILDER_H_
+
+#include <string>
+#include <ostream>
+#include "lima/Debug.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+const int CMD_BUFF = 1024;	// longest command line, file paths included
+
+/*******************************************************************
+ * \class CommandBuilder
+ * \brief server command formatted in place, without heap allocation
+ *
+ * Used like the std::stringstream it replaces: numbers are written as
+ * the stream would write them in the C locale, whatever the process
+ * locale is. A command not fitting the buffer throws.
+ *******************************************************************/
+class CommandBuilder
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "CommandBuilder", "imXpad");
+
+public:
+	CommandBuilder();
+	explicit CommandBuilder(const char *cmd);
+
+	void clear();
+
+	CommandBuilder& operator<<(const char *s);
+	CommandBuilder& operator<<(const std::string& s);
+	CommandBuilder& operator<<(char c);
+	CommandBuilder& operator<<(int value);
+	CommandBuilder& operator<<(unsigned int value);
+	CommandBuilder& operator<<(long value);
+	CommandBuilder& operator<<(unsigned long value);
+	CommandBuilder& operator<<(double value);
+
+	//! Command line, not terminated
+	const char *data() const { return m_buf; }
+	size_t size() const { return m_len; }
+	std::string str() const;
+
+private:
+	void _append(const char *s, size_t len);
+	void _appendDecimal(unsigned long value, bool negative);
+
+	char	m_buf[CMD_BUFF];
+	size_t	m_len;
+} ;
+
+std::ostream& operator<<(std::ostream& os, const CommandBuilder& cmd);
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADCOMMANDBUILDER_H_ */
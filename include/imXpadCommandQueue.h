@@ -0,0 +1,139 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADCOMMANDQUEUE_H_
+#define IMXPADCOMMANDQUEUE_H_
+
+#include <deque>
+#include <string>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+class XpadClient;
+class CommandFuture;
+
+/*******************************************************************
+ * \class CommandCallback
+ * \brief called from the I/O thread when a queued command completed
+ *******************************************************************/
+class CommandCallback
+{
+public:
+	virtual ~CommandCallback() {}
+	virtual void commandDone(const CommandFuture& result) = 0;
+} ;
+
+/*******************************************************************
+ * \class CommandFuture
+ * \brief handle on the result of a queued command
+ *
+ * Copies share the same result. The getters block until the command
+ * completed and throw if it failed.
+ *******************************************************************/
+class CommandFuture
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "CommandFuture", "imXpad");
+
+public:
+	CommandFuture();
+	CommandFuture(const CommandFuture& o);
+	CommandFuture& operator=(const CommandFuture& o);
+	~CommandFuture();
+
+	bool isValid() const;
+	bool isReady() const;
+
+	//! Wait for completion, timeout in seconds (-1 forever), true if completed
+	bool wait(double timeout = -1) const;
+
+	bool hasError() const;
+	std::string getErrorMessage() const;
+	std::string getCommand() const;
+
+	int getInt() const;
+	double getDouble() const;
+	std::string getString() const;
+
+private:
+	friend class CommandQueue;
+	struct State;
+
+	explicit CommandFuture(State *state);
+	void _release();
+	State& _waitState() const;
+
+	State *m_state;
+} ;
+
+/*******************************************************************
+ * \class CommandQueue
+ * \brief server commands executed in order by one I/O thread
+ *
+ * The thread owns its own connection to the server, so that queued
+ * commands neither block their callers nor the acquisition socket.
+ *******************************************************************/
+class CommandQueue
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "CommandQueue", "imXpad");
+
+public:
+	enum ReturnType
+	{
+		NoReturn,
+		IntReturn,
+		DoubleReturn,
+		StringReturn
+	} ;
+
+	CommandQueue();
+	~CommandQueue();
+
+	void connect(const std::string& hostname, int port);
+	void disconnect();
+	bool isConnected() const;
+
+	CommandFuture submit(const std::string& cmd, ReturnType type, CommandCallback *cb = NULL);
+
+	//! Commands queued or in progress
+	int getNbPending() const;
+
+private:
+	class IOThread;
+	friend class IOThread;
+
+	mutable Cond						m_cond;
+	std::deque<CommandFuture::State*>	m_queue;
+	XpadClient							*m_client;
+	IOThread							*m_thread;
+	bool								m_busy;
+	bool								m_quit;
+	bool								m_running;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADCOMMANDQUEUE_H_ */
@@ -0,0 +1,108 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADCORRECTION_H_
+#define IMXPADCORRECTION_H_
+
+#include <vector>
+#include <stdint.h>
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+#include "imXpadWorkerPool.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class Correction
+ * \brief client-side flat field and dead/noisy pixel correction
+ *
+ * Frames are corrected in place on the receive path: a float flat
+ * field multiply over all pixels, then masked pixels are either set
+ * to zero or replaced by the mean of their valid 4-neighbours.
+ *******************************************************************/
+class Correction
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "Correction", "imXpad");
+
+public:
+
+	enum BadPixelMode
+	{
+		Zero,
+		Interpolate
+	} ;
+
+	Correction(WorkerPool& pool);
+	~Correction();
+
+	//! Load a raw uint32 white image and derive the flat field coefficients
+	void loadFlatField(const char *fpath, const Size& size);
+	//! Set the flat field coefficients directly (one float per pixel)
+	void setFlatField(const float *coeffs, const Size& size);
+	void clearFlatField();
+
+	//! Load a dead/noisy pixel mask (one byte per pixel, non-zero = masked)
+	void loadDeadPixelMask(const char *fpath, const Size& size);
+	void loadNoisyPixelMask(const char *fpath, const Size& size);
+	void setDeadPixelMask(const unsigned char *mask, const Size& size);
+	void setNoisyPixelMask(const unsigned char *mask, const Size& size);
+	void clearPixelMasks();
+
+	void setBadPixelMode(BadPixelMode mode);
+	BadPixelMode getBadPixelMode() const;
+
+	//! True when at least one correction map is loaded
+	bool isActive() const;
+
+	//! Check the loaded maps against the acquisition frame size
+	void prepare(const Size& size);
+
+	//! Correct a frame in place, depth is 2 or 4 bytes per pixel
+	void apply(void *frame, int depth);
+
+private:
+	class FlatFieldTask;
+	class BadPixelTask;
+
+	void _checkSize(const Size& size);
+	void _setMask(std::vector<unsigned char>& dst, const unsigned char *mask,
+				  const Size& size);
+	void _loadMask(std::vector<unsigned char>& dst, const char *fpath,
+				   const Size& size);
+	void _updateBadPixels();
+
+	WorkerPool&					m_pool;
+	Size						m_size;
+	std::vector<float>			m_flat_field;
+	std::vector<unsigned char>	m_dead_mask;
+	std::vector<unsigned char>	m_noisy_mask;
+	std::vector<unsigned char>	m_bad_mask;
+	std::vector<int>			m_bad_pixels;
+	BadPixelMode				m_bad_pixel_mode;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADCORRECTION_H_ */
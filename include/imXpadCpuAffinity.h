@@ -0,0 +1,89 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADCPUAFFINITY_H_
+#define IMXPADCPUAFFINITY_H_
+
+#include <string>
+#include <vector>
+#include "lima/Debug.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class CpuAffinity
+ * \brief CPU set and scheduling applied to the acquisition threads
+ *
+ * The CPU set uses the kernel list syntax ("0-3,8"); an empty list
+ * leaves the threads free to run anywhere.
+ *******************************************************************/
+class CpuAffinity
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "CpuAffinity", "imXpad");
+
+public:
+	CpuAffinity();
+
+	void setCpus(const std::string& cpu_list);
+	std::string getCpus() const;
+	bool isPinned() const;
+
+	//! 0 for the default scheduling, otherwise the SCHED_FIFO priority
+	void setRealtimePriority(int priority);
+	int getRealtimePriority() const;
+
+	//! NUMA node of the first CPU of the set, -1 if unknown or not pinned
+	int getNumaNode() const;
+
+	//! Apply CPU set and scheduling to the calling thread, warns on failure
+	void applyToCurrentThread() const;
+
+private:
+	std::vector<int>	m_cpus;
+	int					m_rt_priority;
+} ;
+
+/*******************************************************************
+ * \class MigrationCounter
+ * \brief counts the CPU changes seen by the sampling thread
+ *******************************************************************/
+class MigrationCounter
+{
+public:
+	MigrationCounter();
+
+	void reset();
+	void sample();
+	int getNbMigrations() const;
+	int getLastCpu() const;
+
+private:
+	int m_last_cpu;
+	int m_nb_migrations;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADCPUAFFINITY_H_ */
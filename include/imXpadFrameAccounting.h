@@ -0,0 +1,99 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADFRAMEACCOUNTING_H_
+#define IMXPADFRAMEACCOUNTING_H_
+
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class FrameAccounting
+ * \brief what the acquisition thread received during an acquisition
+ *
+ * Updated by the acquisition thread, read by any other one. A frame
+ * is late when it comes more than half a period after the previous
+ * one, the first frame of an acquisition is never late.
+ *
+ * Times are read on the raw monotonic clock, not slewed by NTP. The
+ * exposure of frame n is modelled to start n periods after the start
+ * time, its delay is the time from there to the frame reception.
+ *******************************************************************/
+class FrameAccounting
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "FrameAccounting", "imXpad");
+
+public:
+	FrameAccounting();
+
+	//! Raw monotonic clock, in seconds
+	static double now();
+
+	//! Start counting nb_expected frames (0 until stopped), one every period seconds from start_time,
+	//! late frames are only counted when paced by the detector
+	void start(int nb_expected, double period, bool paced, double start_time);
+
+	void frameReceived(double receive_time);
+	void shortRead();
+	void headerAnomaly();
+
+	int getNbExpected() const;
+	int getNbReceived() const;
+	int getNbShortReads() const;
+	int getNbHeaderAnomalies() const;
+	int getNbLateFrames() const;
+
+	//! Longest time between two frames, in seconds
+	double getMaxGap() const;
+
+	//! Receive time of a frame and modelled start of its exposure, false if not received
+	bool getFrameTiming(int frame_nb, double& receive_time, double& exposure_start) const;
+
+	//! Delay from the modelled exposure start to the reception: mean, standard deviation and max, in seconds
+	void getDelayStatistics(double& mean, double& jitter, double& max) const;
+
+private:
+	mutable Mutex	m_lock;
+	int				m_nb_expected;
+	double			m_period;
+	bool			m_paced;
+	double			m_start_time;
+	std::vector<double>	m_receive_times;
+	int				m_nb_received;
+	int				m_nb_short_reads;
+	int				m_nb_header_anomalies;
+	int				m_nb_late;
+	double			m_max_gap;
+	double			m_delay_mean;
+	double			m_delay_m2;			// sum of the squared deviations from the mean
+	double			m_delay_max;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADFRAMEACCOUNTING_H_ */
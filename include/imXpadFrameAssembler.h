@@ -0,0 +1,123 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADFRAMEASSEMBLER_H_
+#define IMXPADFRAMEASSEMBLER_H_
+
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+#include "lima/Timestamp.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class FrameAssembler
+ * \brief stitches the frames of several detectors into one frame
+ *
+ * Each detector is a tile placed at its offset in the assembled frame.
+ * Tiles of the same frame number are copied in place by the thread of
+ * the detector that received them, so that the copies run in parallel;
+ * the thread bringing the last tile hands the frames now complete over
+ * to the sink, in frame order. A detector more than nb_slots frames
+ * ahead of the oldest incomplete frame waits for it.
+ *******************************************************************/
+class FrameAssembler
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "FrameAssembler", "imXpad");
+
+public:
+	struct Tile
+	{
+		int		x;
+		int		y;
+		int		width;
+		int		height;
+	} ;
+
+	class Sink
+	{
+	public:
+		virtual ~Sink() {}
+		//! Memory of the assembled frame, the same for frame_nb and frame_nb + nb_slots
+		virtual void *getFrameBuffer(int frame_nb) = 0;
+		//! Every tile of frame_nb is in place, false stops the assembly
+		virtual bool frameAssembled(int frame_nb, const Timestamp& timestamp) = 0;
+	} ;
+
+	FrameAssembler();
+
+	//! Place a tile of width x height pixels at x, y, returns its index; tiles may not overlap
+	int addTile(int x, int y, int width, int height);
+	void clearTiles();
+	int getNbTiles() const;
+	const Tile& getTile(int tile) const;
+
+	//! Smallest frame holding every tile, pixels outside the tiles stay zero
+	Size getFrameSize() const;
+
+	//! Start an assembly of depth bytes per pixel, frame_nb of each tile counting from 0
+	void prepare(Sink *sink, int depth, int nb_slots);
+
+	//! Copy the tile of frame_nb from data (tile width x height pixels), false once stopped
+	bool placeTile(int tile, int frame_nb, const void *data, const Timestamp& timestamp);
+
+	//! Release the waiting tiles, every later one is dropped
+	void stop();
+
+	int getNbAssembledFrames() const;
+
+	//! Longest time between the first and the last tile of a frame of the current assembly, in seconds
+	double getMaxTileSkew() const;
+
+	//! Times a tile waited for an older frame to complete
+	int getNbTileWaits() const;
+
+private:
+	struct Slot
+	{
+		int			frame_nb;
+		int			nb_tiles;
+		Timestamp	timestamp;
+		double		first_tile;
+	} ;
+
+	void _clearGaps();
+
+	mutable Cond		m_cond;
+	std::vector<Tile>	m_tiles;
+	std::vector<Slot>	m_slots;
+	Sink				*m_sink;
+	int					m_depth;
+	int					m_next_frame;			///< oldest frame not handed over
+	bool				m_stopped;
+	double				m_max_skew;
+	int					m_nb_waits;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADFRAMEASSEMBLER_H_ */
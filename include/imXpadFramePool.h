@@ -0,0 +1,102 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADFRAMEPOOL_H_
+#define IMXPADFRAMEPOOL_H_
+
+#include <cstddef>
+#include "lima/Debug.h"
+#include "lima/HwBufferMgr.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class FramePool
+ * \brief persistent frame memory shared by all the acquisitions
+ *
+ * Buffers are page aligned slices of one mapping which is only grown,
+ * never given back between acquisitions. Pages are touched once by
+ * prefault(), so that no page fault is taken while receiving frames.
+ *******************************************************************/
+class FramePool : public BufferAllocMgr
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "FramePool", "imXpad");
+
+public:
+	enum HugePageMode
+	{
+		NoHugePage = 0,
+		TransparentHugePage = 1,	///< madvise(MADV_HUGEPAGE) on the mapping
+		HugeTLB = 2					///< MAP_HUGETLB, needs reserved hugepages
+	} ;
+
+	FramePool();
+	virtual ~FramePool();
+
+	virtual int getMaxNbBuffers(const FrameDim& frame_dim);
+	virtual void allocBuffers(int nb_buffers, const FrameDim& frame_dim);
+	virtual const FrameDim& getFrameDim();
+	virtual void getNbBuffers(int& nb_buffers);
+	virtual void releaseBuffers();
+	virtual void *getBufferPtr(int buffer_nb);
+
+	//! Applies to the next mapping, call freeMemory() to remap now
+	void setHugePageMode(HugePageMode mode);
+	HugePageMode getHugePageMode() const;
+
+	//! Touch every page of the allocated buffers not touched yet
+	void prefault();
+
+	//! Give the mapping back to the system
+	void freeMemory();
+
+	//! Place the pages on a NUMA node (-1 for the default policy), moves mapped pages
+	void setNumaNode(int node);
+	int getNumaNode() const;
+
+	size_t getMappedSize() const;
+	double getPrefaultTime() const;
+
+private:
+	void _map(size_t size);
+	void _unmap();
+	void _bind();
+
+	FrameDim		m_frame_dim;
+	int				m_nb_buffers;
+	size_t			m_stride;
+	HugePageMode	m_huge_page_mode;
+	char			*m_map_base;		///< as returned by mmap
+	size_t			m_map_size;
+	char			*m_base;			///< first buffer, hugepage aligned
+	size_t			m_size;
+	size_t			m_prefaulted;		///< bytes from m_base already touched
+	double			m_prefault_time;
+	int				m_numa_node;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADFRAMEPOOL_H_ */
@@ -0,0 +1,99 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADGEOMETRY_H_
+#define IMXPADGEOMETRY_H_
+
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+#include "imXpadWorkerPool.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class Geometry
+ * \brief client-side geometrical correction through a remap table
+ *
+ * The raw frame is made of nb_modules x nb_chips chips of
+ * chip_lines x chip_columns pixels. The corrected frame inserts
+ * chip_gap columns between chips and module_gap lines between modules;
+ * the wide pixels on both sides of a chip border share their counts
+ * with the gap columns next to them.
+ *
+ * The table (one source index and one weight per corrected pixel) is
+ * only rebuilt when the layout changes and is applied by blocks of
+ * lines spread over the worker pool.
+ *******************************************************************/
+class Geometry
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "Geometry", "imXpad");
+
+public:
+	Geometry(WorkerPool& pool, int chip_lines, int chip_columns);
+	~Geometry();
+
+	void setGaps(int chip_gap, int module_gap);
+	void getGaps(int& chip_gap, int& module_gap) const;
+
+	//! Number of corrected lines handled by one work item
+	void setBlockLines(int block_lines);
+	int getBlockLines() const;
+
+	//! Build the table for the given layout (no-op if already built)
+	void build(int nb_modules, int nb_chips);
+
+	const Size& getRawSize() const;
+	const Size& getCorrectedSize() const;
+
+	//! Remap a raw frame into frame, depth is 2 or 4 bytes per pixel
+	void apply(const void *raw, void *frame, int depth);
+
+	//! Duration of the last remap in seconds
+	double getRemapTime() const;
+
+private:
+	class RemapTask;
+
+	void _spread(int dst_line, int dst_col, int src, int nb, int step);
+
+	WorkerPool&			m_pool;
+	int					m_chip_lines;
+	int					m_chip_columns;
+	int					m_chip_gap;
+	int					m_module_gap;
+	int					m_block_lines;
+	int					m_nb_modules;
+	int					m_nb_chips;
+	Size				m_raw_size;
+	Size				m_corrected_size;
+	std::vector<int>	m_src;
+	std::vector<float>	m_weight;
+	double				m_remap_time;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADGEOMETRY_H_ */
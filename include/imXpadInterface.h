@@ -28,6 +28,7 @@
 #define XPADINTERFACE_H_
 
 #include "lima/HwInterface.h"
+#include "imXpadFramePool.h"
 #include <sys/time.h>
 
 namespace lima {
@@ -76,7 +77,7 @@ class BufferCtrlObj : public HwBufferCtrlObj
     DEB_CLASS_NAMESPC(DebModCamera, "BufferCtrlObj", "Xpad");
 
  public:
-    BufferCtrlObj(Camera& simu);
+    BufferCtrlObj();
     virtual ~BufferCtrlObj();
 
     virtual void setFrameDim(const FrameDim& frame_dim);
@@ -99,8 +100,13 @@ class BufferCtrlObj : public HwBufferCtrlObj
     virtual void registerFrameCallback(HwFrameCallback& frame_cb);
     virtual void unregisterFrameCallback(HwFrameCallback& frame_cb);
 
+    StdBufferCbMgr& getBuffer();
+    FramePool& getFramePool();
+
  private:
-    BufferCtrlMgr& m_buffer_mgr;
+    FramePool m_frame_pool;
+    StdBufferCbMgr m_buffer_cb_mgr;
+    BufferCtrlMgr m_buffer_mgr;
 };
 
 /*******************************************************************
@@ -0,0 +1,114 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADMODULEREADOUT_H_
+#define IMXPADMODULEREADOUT_H_
+
+#include <string>
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "imXpadCpuAffinity.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+class XpadClient;
+class FrameCodec;
+class AbortEvent;
+
+/*******************************************************************
+ * \class ModuleReadout
+ * \brief one data connection and one receiving thread per module
+ *
+ * Each enabled bit of the module mask opens its own connection to the
+ * server and streams the lines of that module only. The k-th enabled
+ * module fills the k-th row band of the frame; readFrame() returns
+ * when every band of the frame has arrived. Frames are raw ones, made
+ * of whole modules without gap lines.
+ *******************************************************************/
+class ModuleReadout
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "ModuleReadout", "imXpad");
+
+public:
+	ModuleReadout();
+	~ModuleReadout();
+
+	//! Open one data stream per enabled module of module_mask
+	void connect(const std::string& hostname, int port, unsigned int module_mask);
+	void disconnect();
+	bool isConnected() const;
+	int getNbModules() const;
+
+	//! Decoder for compressed bands, NULL for raw transfer
+	void setFrameCodec(FrameCodec* codec);
+
+	//! Event interrupting the module reads, NULL to only wait for the server
+	void setAbortEvent(AbortEvent* abort);
+
+	//! Set the full frame size and bytes per pixel before an acquisition,
+	//! reopens the streams left inconsistent by an abort
+	void prepare(const Size& frame_size, int depth);
+
+	//! Receive every band of frame_nb into bptr, 0 if complete, -1 if aborted
+	int readFrame(void *bptr, int frame_nb);
+
+	//! Time between the first and the last band of the last frame, in seconds
+	double getLastFrameSkew() const;
+
+	//! CPU set and scheduling of the module threads, applied before their next frame
+	void setCpuAffinity(const CpuAffinity& affinity);
+
+private:
+	class ModuleThread;
+	friend class ModuleThread;
+
+	mutable Cond				m_cond;
+	std::vector<ModuleThread*>	m_modules;
+	char						*m_frame;
+	int							m_frame_nb;
+	int							m_band_bytes;
+	int							m_depth;
+	int							m_generation;
+	int							m_pending;
+	int							m_running;
+	int							m_failed;
+	double						m_first_band;
+	double						m_last_band;
+	bool						m_quit;
+	CpuAffinity					m_affinity;
+	int							m_affinity_generation;
+	std::string					m_hostname;
+	int							m_port;
+	unsigned int				m_module_mask;
+	FrameCodec					*m_codec;
+	AbortEvent					*m_abort;
+	bool						m_reconnect;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADMODULEREADOUT_H_ */
@@ -0,0 +1,76 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADMODULEROI_H_
+#define IMXPADMODULEROI_H_
+
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class ModuleRoi
+ * \brief smallest set of modules holding a region of the detector
+ *
+ * The region is given in the frame of the whole detector, where the
+ * k-th enabled module of the detector mask covers the k-th of as many
+ * bands of equal height; with the geometrical corrections, the gap
+ * lines are shared between the bands next to them. Modules span the
+ * full frame width, so only the lines of the region select modules.
+ *******************************************************************/
+class ModuleRoi
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "ModuleRoi", "imXpad");
+
+public:
+	ModuleRoi();
+
+	//! Region of the whole detector frame, a zero width or height for the whole detector
+	void setRegion(int x, int y, int width, int height);
+	void getRegion(int& x, int& y, int& width, int& height) const;
+	bool isEmpty() const;
+
+	//! Modules of detector_mask holding the region of a whole detector frame of full_size
+	unsigned int map(unsigned int detector_mask, const Size& full_size);
+
+	//! Modules of the last map, the first line of the whole frame they cover and their number of lines
+	void getReadout(unsigned int& module_mask, int& first_line, int& nb_lines) const;
+
+	static int getNbModules(unsigned int module_mask);
+
+private:
+	int				m_x;
+	int				m_y;
+	int				m_width;
+	int				m_height;
+	unsigned int	m_module_mask;
+	int				m_first_line;
+	int				m_nb_lines;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADMODULEROI_H_ */
@@ -0,0 +1,122 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADMULTICAMERA_H_
+#define IMXPADMULTICAMERA_H_
+
+#include <string>
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/HwMaxImageSizeCallback.h"
+#include "imXpadCamera.h"
+#include "imXpadFrameAssembler.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class MultiCamera
+ * \brief several detectors triggered together, seen as one
+ *
+ * Each detector keeps its own Camera, server connection and receiving
+ * thread, filling a small buffer ring of its own. The frames they
+ * receive are matched by frame number and placed at the offset the
+ * layout gives their detector in the assembled frame, the one Lima sees.
+ * Exposure, trigger and frame count settings go to every detector.
+ *******************************************************************/
+class MultiCamera : public HwMaxImageSizeCallbackGen, private FrameAssembler::Sink
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "MultiCamera", "imXpad");
+
+public:
+	MultiCamera();
+	~MultiCamera();
+
+	//! Place a detector at x, y of the assembled frame, in pixels; cam must outlive the multi camera
+	void addCamera(Camera& cam, int x, int y);
+	int getNbCameras() const;
+	Camera& getCamera(int index);
+
+	//! Get the offset and size of a detector in the assembled frame
+	void getCameraLayout(int index, int& x, int& y, int& width, int& height);
+
+	int prepareAcq();
+	void startAcq();
+	void abortCurrentProcess();
+	void waitAcqEnd();
+
+	// -- detector info object
+	void getImageSize(Size& size);
+	void getImageType(ImageType& type);
+	void setImageType(ImageType type);
+	void getPixelSize(double& size_x, double& size_y);
+	void getDetectorType(std::string& type);
+	void getDetectorModel(std::string& model);
+
+	// -- Buffer control object
+	HwBufferCtrlObj* getBufferCtrlObj();
+	int getNbHwAcquiredFrames();
+
+	//! Set the frames each detector buffers until its tile is placed
+	void setNbCameraBuffers(int nb_buffers);
+	int getNbCameraBuffers();
+
+	//-- Synch control object
+	void setTrigMode(TrigMode mode);
+	void getTrigMode(TrigMode& mode);
+	void setExpTime(double exp_time);
+	void getExpTime(double& exp_time);
+	void setLatTime(double lat_time);
+	void getLatTime(double& lat_time);
+	void setNbFrames(int nb_frames);
+	void getNbFrames(int& nb_frames);
+
+	//-- Status, the one of the first detector not idle
+	void getStatus(Camera::XpadStatus& status);
+
+	//! Get the longest time between the first and the last detector of a frame, in seconds, and the times a detector waited for the others
+	void getAssemblyStatistics(double& max_skew, int& nb_waits);
+
+private:
+	class CameraLink;
+	friend class CameraLink;
+
+	virtual void *getFrameBuffer(int frame_nb);
+	virtual bool frameAssembled(int frame_nb, const Timestamp& timestamp);
+
+	void _cameraSizeChanged(int index, const Size& size);
+	void _buildLayout();
+
+	std::vector<Camera*>		m_cameras;
+	std::vector<CameraLink*>	m_links;
+	std::vector<Point>			m_offsets;
+	std::vector<Size>			m_sizes;
+	FrameAssembler				m_assembler;
+	BufferCtrlObj				m_buffer_ctrl_obj;
+	int							m_nb_camera_buffers;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADMULTICAMERA_H_ */
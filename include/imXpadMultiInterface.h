@@ -0,0 +1,125 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADMULTIINTERFACE_H_
+#define IMXPADMULTIINTERFACE_H_
+
+#include "lima/HwInterface.h"
+
+namespace lima {
+namespace imXpad {
+
+class MultiCamera;
+
+/*******************************************************************
+ * \class MultiDetInfoCtrlObj
+ * \brief Detector info of the frame assembled from several detectors
+ *******************************************************************/
+
+class MultiDetInfoCtrlObj: public HwDetInfoCtrlObj {
+
+DEB_CLASS_NAMESPC(DebModCamera, "MultiDetInfoCtrlObj", "Xpad");
+
+public:
+    MultiDetInfoCtrlObj(MultiCamera& cam);
+    virtual ~MultiDetInfoCtrlObj();
+
+    virtual void getMaxImageSize(Size& max_image_size);
+    virtual void getDetectorImageSize(Size& det_image_size);
+
+    virtual void getDefImageType(ImageType& def_image_type);
+    virtual void getCurrImageType(ImageType& curr_image_type);
+    virtual void setCurrImageType(ImageType curr_image_type);
+
+    virtual void getPixelSize(double& x_size, double &y_size);
+    virtual void getDetectorType(std::string& det_type);
+    virtual void getDetectorModel(std::string& det_model);
+
+    virtual void registerMaxImageSizeCallback(HwMaxImageSizeCallback& cb);
+    virtual void unregisterMaxImageSizeCallback(HwMaxImageSizeCallback& cb);
+
+private:
+    MultiCamera& m_cam;
+};
+
+/*******************************************************************
+ * \class MultiSyncCtrlObj
+ * \brief Synchronization of every detector of a multi camera
+ *******************************************************************/
+
+class MultiSyncCtrlObj: public HwSyncCtrlObj {
+DEB_CLASS_NAMESPC(DebModCamera, "MultiSyncCtrlObj", "Xpad");
+
+public:
+    MultiSyncCtrlObj(MultiCamera& cam);
+    virtual ~MultiSyncCtrlObj();
+
+    virtual bool checkTrigMode(TrigMode trig_mode);
+    virtual void setTrigMode(TrigMode trig_mode);
+    virtual void getTrigMode(TrigMode& trig_mode);
+
+    virtual void setExpTime(double exp_time);
+    virtual void getExpTime(double& exp_time);
+
+    virtual void setLatTime(double lat_time);
+    virtual void getLatTime(double& lat_time);
+
+    virtual void setNbHwFrames(int nb_frames);
+    virtual void getNbHwFrames(int& nb_frames);
+
+    virtual void getValidRanges(ValidRangesType& valid_ranges);
+
+private:
+    MultiCamera& m_cam;
+};
+
+/*******************************************************************
+ * \class MultiInterface
+ * \brief Hardware interface of several Xpad detectors seen as one
+ *******************************************************************/
+
+class MultiInterface: public HwInterface {
+DEB_CLASS_NAMESPC(DebModCamera, "MultiInterface", "Xpad");
+
+public:
+    MultiInterface(MultiCamera& cam);
+    virtual ~MultiInterface();
+
+    virtual void getCapList(CapList&) const;
+    virtual void reset(ResetLevel reset_level);
+    virtual void prepareAcq();
+    virtual void startAcq();
+    virtual void stopAcq();
+    virtual void getStatus(StatusType& status);
+    virtual int getNbHwAcquiredFrames();
+    //! get the multi camera object to access it directly from client
+    MultiCamera& getMultiCamera() { return m_cam; }
+private:
+    MultiCamera& m_cam;
+    CapList m_cap_list;
+    MultiDetInfoCtrlObj m_det_info;
+    MultiSyncCtrlObj m_sync;
+};
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADMULTIINTERFACE_H_ */
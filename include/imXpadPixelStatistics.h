@@ -0,0 +1,97 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADPIXELSTATISTICS_H_
+#define IMXPADPIXELSTATISTICS_H_
+
+#include <vector>
+#include <stdint.h>
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+#include "imXpadWorkerPool.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class PixelStatistics
+ * \brief running per-pixel mean, variance, extrema and zero counts
+ *
+ * Frames are folded in as they arrive with a Welford update, the same
+ * for every pixel since they all see the same number of frames, so the
+ * loop over a row vectorizes. Dead and noisy pixel masks are derived
+ * from the result, without keeping the frames.
+ *******************************************************************/
+class PixelStatistics
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "PixelStatistics", "imXpad");
+
+public:
+	struct Thresholds
+	{
+		double dead_zero_fraction;	//!< dead if zero in at least this fraction of the frames
+		double dead_mean_ratio;		//!< dead if the mean is below this fraction of the median mean
+		double noisy_mean_ratio;	//!< noisy if the mean is above this multiple of the median mean
+		double noisy_dispersion;	//!< noisy if variance / mean is above this, 1 for a poissonian pixel
+
+		Thresholds();
+	} ;
+
+	PixelStatistics(WorkerPool& pool);
+
+	//! Reset the accumulators for frames of size
+	void prepare(const Size& size);
+
+	//! Fold a frame in, depth is 2 or 4 bytes per pixel
+	void accumulate(const void *frame, int depth);
+
+	int getNbFrames() const;
+	const Size& getSize() const;
+
+	const std::vector<double>& getMean() const;
+	void getVariance(std::vector<double>& variance) const;
+	const std::vector<uint32_t>& getMin() const;
+	const std::vector<uint32_t>& getMax() const;
+	const std::vector<uint32_t>& getZeroCount() const;
+
+	//! One byte per pixel, non zero when masked, as Correction takes them
+	void createMasks(const Thresholds& thresholds, std::vector<unsigned char>& dead,
+					 std::vector<unsigned char>& noisy) const;
+
+private:
+	class AccumulateTask;
+
+	WorkerPool&				m_pool;
+	Size					m_size;
+	int						m_nb_frames;
+	std::vector<double>		m_mean;
+	std::vector<double>		m_m2;
+	std::vector<uint32_t>	m_min;
+	std::vector<uint32_t>	m_max;
+	std::vector<uint32_t>	m_zero_count;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADPIXELSTATISTICS_H_ */
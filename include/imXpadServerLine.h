@@ -0,0 +1,99 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADSERVERLINE_H_
+#define IMXPADSERVERLINE_H_
+
+#include <string>
+#include <cstddef>
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class ServerLine
+ * \brief one line of the server command protocol, parsed in place
+ *
+ * The text of the line is a view into the parsed buffer: nothing is
+ * copied, and it is only valid until the buffer changes.
+ *******************************************************************/
+class ServerLine
+{
+public:
+	enum Type
+	{
+		Prompt,				// '> '
+		ErrorMessage,		// '! text'
+		DebugMessage,		// '# text'
+		TimeBar,			// '@ done outoff "text"'
+		Return,				// '* number'
+		StringReturn,		// '* "text"' or '* (null)'
+		Unknown				// anything else, up to the end of the line
+	} ;
+
+	ServerLine();
+
+	//! Parses the line starting at buf, returns its length or 0 if buf ends before it does
+	size_t parse(const char *buf, size_t len);
+
+	Type getType() const { return m_type; }
+	const char *data() const { return m_text; }
+	size_t size() const { return m_len; }
+	std::string str() const { return std::string(m_text, m_len); }
+
+	//! Return value as atoi and atof would read it
+	int toInt() const;
+	double toDouble() const;
+
+	//! Progress of a time-bar line
+	int getDone() const { return m_done; }
+	int getOutOff() const { return m_outoff; }
+
+private:
+	typedef const char *(ServerLine::*Scan)(const char *p, const char *end);
+	struct Rule
+	{
+		char	lead;
+		Type	type;
+		Scan	scan;
+	} ;
+	static const Rule s_rules[];
+
+	// each returns the end of the line, or NULL if it is not complete
+	const char *_scanPrompt(const char *p, const char *end);
+	const char *_scanMessage(const char *p, const char *end);
+	const char *_scanTimeBar(const char *p, const char *end);
+	const char *_scanReturn(const char *p, const char *end);
+	const char *_scanUnknown(const char *p, const char *end);
+
+	Type		m_type;
+	const char	*m_text;
+	size_t		m_len;
+	int			m_done;
+	int			m_outoff;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADSERVERLINE_H_ */
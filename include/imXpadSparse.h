@@ -0,0 +1,107 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADSPARSE_H_
+#define IMXPADSPARSE_H_
+
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+#include "imXpadWorkerPool.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \struct SparseFrame
+ * \brief index/value representation of a mostly empty frame
+ *
+ * When the occupancy is above the encoder threshold the frame is
+ * flagged dense and the consumer must use the Lima frame buffer.
+ *******************************************************************/
+struct SparseFrame
+{
+	int						acq_frame_nb;
+	Size					size;
+	bool					dense;
+	const void				*frame;			///< Lima frame buffer (dense frames)
+	int						depth;			///< bytes per pixel of the Lima frame
+	std::vector<uint32_t>	indices;
+	std::vector<uint32_t>	values;
+
+	SparseFrame();
+	double getOccupancy() const;
+
+	//! Write one binary record (header, then index/value pairs or dense pixels)
+	void write(std::ostream& os) const;
+} ;
+
+/*******************************************************************
+ * \class SparseFrameCallback
+ * \brief downstream consumer of sparse frames
+ *******************************************************************/
+class SparseFrameCallback
+{
+public:
+	virtual ~SparseFrameCallback() {}
+	virtual void sparseFrameReady(const SparseFrame& frame) = 0;
+} ;
+
+/*******************************************************************
+ * \class SparseEncoder
+ * \brief parallel zero-scan producing SparseFrame
+ *
+ * A first pass counts the non-zero pixels of each slice; if the frame
+ * is below the occupancy threshold a second pass writes every slice
+ * at its prefix-sum offset.
+ *******************************************************************/
+class SparseEncoder
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "SparseEncoder", "imXpad");
+
+public:
+	SparseEncoder(WorkerPool& pool);
+	~SparseEncoder();
+
+	//! Fraction of non-zero pixels above which frames stay dense
+	void setThreshold(double occupancy);
+	double getThreshold() const;
+
+	//! Encode frame into sparse, returns false if it was left dense
+	bool encode(const void *frame, int depth, const Size& size, SparseFrame& sparse);
+
+private:
+	class CountTask;
+	class FillTask;
+
+	WorkerPool&			m_pool;
+	double				m_threshold;
+	std::vector<int>	m_slice_count;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADSPARSE_H_ */
@@ -0,0 +1,92 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADTHRESHOLDSCAN_H_
+#define IMXPADTHRESHOLDSCAN_H_
+
+#include <vector>
+#include <stdint.h>
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+#include "imXpadWorkerPool.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class ThresholdScan
+ * \brief frame cube of an ITHL scan and its per-pixel S-curve fit
+ *
+ * One raw uint32 frame is kept per ITHL step. The counts of a pixel
+ * go from one plateau to the other along the scan as an erfc, whose
+ * middle is the pixel threshold and whose sigma is the pixel noise,
+ * both in ITHL units. The fit interpolates where the counts cross
+ * 16%, 50% and 84% of the way between the plateaus, read on the first
+ * and last two steps: it needs no iteration and runs over contiguous
+ * pixels, sliced across the worker pool. Pixels which never changed
+ * count, or never crossed a level, get -1 in both maps.
+ *******************************************************************/
+class ThresholdScan
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "ThresholdScan", "imXpad");
+
+public:
+	ThresholdScan(WorkerPool& pool);
+	~ThresholdScan();
+
+	//! Allocate the cube for the scan from first_ithl to last_ithl of frames of size
+	void prepare(int first_ithl, int last_ithl, const Size& size);
+
+	int getNbSteps() const;
+	int getStepIthl(int step) const;
+	Size getSize() const;
+
+	//! Frame of a step, filled by the acquisition
+	uint32_t *getStepFrame(int step);
+
+	//! Fit the nb_steps first steps of the cube
+	void fit(int nb_steps);
+
+	const std::vector<float>& getThresholdMap() const;
+	const std::vector<float>& getNoiseMap() const;
+
+	//! Write the threshold and noise maps, one float per pixel
+	void saveMaps(const char *threshold_path, const char *noise_path) const;
+
+private:
+	class FitTask;
+
+	WorkerPool&				m_pool;
+	int						m_first_ithl;
+	int						m_direction;	// +1 or -1 ITHL per step
+	int						m_nb_steps;
+	Size					m_size;
+	std::vector<uint32_t>	m_cube;			// frames of the steps, one after the other
+	std::vector<float>		m_threshold;
+	std::vector<float>		m_noise;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADTHRESHOLDSCAN_H_ */
@@ -0,0 +1,84 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADTHROUGHPUT_H_
+#define IMXPADTHROUGHPUT_H_
+
+#include <stdint.h>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class ThroughputModel
+ * \brief frame rate the server link and the client can sustain
+ *
+ * A frame costs its payload on the link and its conversion into the
+ * frame buffer on the client, which overlap. Both bandwidths start
+ * from defaults and are measured on the frames read: a payload only
+ * measures the link when it had to be waited for, one already
+ * buffered by the kernel would only measure a memory copy.
+ *******************************************************************/
+class ThroughputModel
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "ThroughputModel", "imXpad");
+
+public:
+	static const double DEFAULT_LINK_BANDWIDTH;		// 1 GbE, in bytes per second
+	static const double DEFAULT_CLIENT_BANDWIDTH;
+
+	ThroughputModel();
+
+	//! Set the link bandwidth, in bytes per second, and forget the measured one
+	void setLinkBandwidth(double bandwidth);
+	double getLinkBandwidth() const;
+	double getClientBandwidth() const;
+
+	//! Wire size of a compressed frame over its raw size, 1 until measured
+	double getCompressionRatio() const;
+
+	//! A frame of nb_pixels 32 bits pixels read in wire_bytes and converted to depth bytes per pixel,
+	//! transfer_time is 0 when the payload was already buffered
+	void frameMeasured(uint32_t nb_pixels, uint32_t wire_bytes, bool compressed, double transfer_time,
+					   int depth, double processing_time);
+
+	//! Shortest period for frames of nb_pixels converted to depth bytes per pixel, in seconds
+	double getMinFramePeriod(uint32_t nb_pixels, int depth, bool compressed) const;
+
+private:
+	mutable Mutex	m_lock;
+	double			m_default_link_bandwidth;
+	double			m_link_bytes;			// measured on the link
+	double			m_link_time;
+	double			m_client_bytes;			// converted on the client
+	double			m_client_time;
+	double			m_raw_bytes;			// of compressed frames
+	double			m_compressed_bytes;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADTHROUGHPUT_H_ */
@@ -0,0 +1,163 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADTRANSCRIPT_H_
+#define IMXPADTRANSCRIPT_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*
+ * Transcript file: the magic "XPADTRC1", then one record per read or write
+ * on the server connection, all fields little-endian:
+ *   uint64 time in ns since the capture started
+ *   uint32 number of bytes
+ *   uint8  direction (0: to the server, 1: from the server), 3 bytes padding
+ *   the bytes exactly as they went through the socket
+ */
+const char TRANSCRIPT_MAGIC[] = "XPADTRC1";
+
+enum TranscriptDirection
+{
+	ToServer = 0,
+	FromServer = 1
+} ;
+
+struct TranscriptRecord
+{
+	TranscriptDirection	direction;
+	uint64_t			time_ns;
+	std::vector<char>	data;
+} ;
+
+/*******************************************************************
+ * \class TranscriptWriter
+ * \brief records the bytes of a server connection with their time
+ *******************************************************************/
+class TranscriptWriter
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "TranscriptWriter", "imXpad");
+
+public:
+	TranscriptWriter();
+	~TranscriptWriter();
+
+	void open(const std::string& path);
+	void close();
+	bool isOpen() const;
+
+	void record(TranscriptDirection direction, const void *buf, size_t len);
+	void record(TranscriptDirection direction, const struct iovec *iov, int iovcnt);
+
+	//! Bytes of connection data recorded since open
+	long long getNbBytes() const;
+
+private:
+	static uint64_t _now();
+
+	mutable Mutex	m_lock;
+	FILE			*m_file;
+	uint64_t		m_start;
+	long long		m_nb_bytes;
+} ;
+
+/*******************************************************************
+ * \class TranscriptReader
+ *******************************************************************/
+class TranscriptReader
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "TranscriptReader", "imXpad");
+
+public:
+	TranscriptReader();
+	~TranscriptReader();
+
+	void open(const std::string& path);
+	void close();
+
+	//! Next record, false at the end of the transcript
+	bool next(TranscriptRecord& record);
+
+private:
+	FILE		*m_file;
+	std::string	m_path;
+} ;
+
+/*******************************************************************
+ * \class TranscriptReplayer
+ * \brief plays the server side of a transcript to one local client
+ *
+ * The client is expected to send what the transcript recorded; what it
+ * sends differently is counted, not fatal. Server data is sent either
+ * as fast as possible, or with its recorded delay after the last client
+ * data, which keeps the pace of the original server.
+ *******************************************************************/
+class TranscriptReplayer: public Thread
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "TranscriptReplayer", "imXpad");
+
+public:
+	//! Listens on the loopback interface, port 0 picks a free one
+	TranscriptReplayer(const std::string& path, bool keep_pace, int port = 0);
+	virtual ~TranscriptReplayer();
+
+	int getPort() const;
+	void abort();
+
+	bool isDone() const;
+	std::string getErrorMessage() const;
+	int getNbMismatches() const;			// client records differing from the transcript
+	long long getNbBytesReplayed() const;	// server bytes sent
+	double getReplayTime() const;			// seconds from the client connection to the end
+
+protected:
+	virtual void threadFunction();
+
+private:
+	void _replay(int skt);
+
+	std::string		m_path;
+	bool			m_keep_pace;
+	int				m_listener;
+	int				m_port;
+	int				m_skt;
+	mutable Cond	m_cond;
+	bool			m_done;
+	std::string		m_error;
+	int				m_nb_mismatches;
+	long long		m_nb_bytes;
+	double			m_replay_time;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADTRANSCRIPT_H_ */
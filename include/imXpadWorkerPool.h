@@ -0,0 +1,99 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef IMXPADWORKERPOOL_H_
+#define IMXPADWORKERPOOL_H_
+
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+#include "imXpadCpuAffinity.h"
+
+namespace lima
+{
+namespace imXpad
+{
+
+/*******************************************************************
+ * \class WorkerPool
+ * \brief fixed set of threads sharing the per-frame processing
+ *
+ * run() splits [0, nb_items) in contiguous slices, one per worker plus
+ * one for the calling thread, and returns when every slice is done.
+ * Tasks run one at a time, concurrent callers wait for their turn.
+ *******************************************************************/
+class WorkerPool
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "WorkerPool", "imXpad");
+
+public:
+
+	class Task
+	{
+	public:
+		virtual ~Task() {}
+		//! Process items in [begin, end)
+		virtual void process(int begin, int end) = 0;
+	};
+
+	WorkerPool(int nb_workers = 0);
+	~WorkerPool();
+
+	//! Set the number of helper threads (the caller always works too)
+	void setNbWorkers(int nb_workers);
+	int getNbWorkers() const;
+
+	//! Run task over nb_items, blocking until it is complete
+	void run(Task& task, int nb_items);
+
+	//! CPU set and scheduling of the workers, applied before their next task
+	void setCpuAffinity(const CpuAffinity& affinity);
+
+	//! CPU changes seen by the workers since the last reset
+	int getNbMigrations() const;
+	void resetMigrations();
+
+private:
+	class WorkerThread;
+	friend class WorkerThread;
+
+	void _startWorkers(int nb_workers);
+	void _stopWorkers();
+	void _slice(int index, int& begin, int& end) const;
+	void _waitTask();	// called with m_cond held
+
+	mutable Cond				m_cond;
+	Mutex						m_run_lock;
+	std::vector<WorkerThread*>	m_workers;
+	Task*						m_task;
+	int							m_nb_items;
+	int							m_generation;
+	int							m_pending;
+	int							m_running;
+	bool						m_quit;
+	CpuAffinity					m_affinity;
+	int							m_affinity_generation;
+} ;
+
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADWORKERPOOL_H_ */
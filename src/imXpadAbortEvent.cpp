@@ -0,0 +1,106 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <sys/eventfd.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <time.h>
+#include "imXpadAbortEvent.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+AbortEvent::AbortEvent() :
+m_triggered(false), m_trigger_time(0), m_latency(-1)
+{
+	DEB_CONSTRUCTOR();
+
+	m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_fd < 0)
+		THROW_HW_ERROR(Error) << "Cannot create abort eventfd: " << strerror(errno);
+}
+
+AbortEvent::~AbortEvent()
+{
+	DEB_DESTRUCTOR();
+	close(m_fd);
+}
+
+double AbortEvent::_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+void AbortEvent::trigger()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_lock);
+	if (m_triggered)
+		return;
+	m_triggered = true;
+	m_trigger_time = _now();
+	m_latency = -1;
+
+	uint64_t one = 1;
+	if (write(m_fd, &one, sizeof(one)) != sizeof(one))
+		DEB_WARNING() << "Cannot signal abort eventfd: " << strerror(errno);
+}
+
+void AbortEvent::clear()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_lock);
+	uint64_t count;
+	while (read(m_fd, &count, sizeof(count)) > 0)
+		;
+	m_triggered = false;
+}
+
+bool AbortEvent::isTriggered() const
+{
+	AutoMutex aLock(m_lock);
+	return m_triggered;
+}
+
+int AbortEvent::getFd() const
+{
+	return m_fd;
+}
+
+void AbortEvent::unblocked()
+{
+	AutoMutex aLock(m_lock);
+	if (m_triggered && m_latency < 0)
+		m_latency = _now() - m_trigger_time;
+}
+
+double AbortEvent::getUnblockLatency() const
+{
+	AutoMutex aLock(m_lock);
+	return m_latency;
+}
@@ -0,0 +1,108 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "imXpadInterface.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+BufferCtrlObj::BufferCtrlObj() :
+    m_buffer_cb_mgr(m_frame_pool), m_buffer_mgr(m_buffer_cb_mgr) {
+    DEB_CONSTRUCTOR();
+}
+
+BufferCtrlObj::~BufferCtrlObj() {
+    DEB_DESTRUCTOR();
+}
+
+void BufferCtrlObj::setFrameDim(const FrameDim& frame_dim) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.setFrameDim(frame_dim);
+}
+
+void BufferCtrlObj::getFrameDim(FrameDim& frame_dim) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.getFrameDim(frame_dim);
+}
+
+void BufferCtrlObj::setNbBuffers(int nb_buffers) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.setNbBuffers(nb_buffers);
+}
+
+void BufferCtrlObj::getNbBuffers(int& nb_buffers) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.getNbBuffers(nb_buffers);
+}
+
+void BufferCtrlObj::setNbConcatFrames(int nb_concat_frames) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.setNbConcatFrames(nb_concat_frames);
+}
+
+void BufferCtrlObj::getNbConcatFrames(int& nb_concat_frames) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.getNbConcatFrames(nb_concat_frames);
+}
+
+void BufferCtrlObj::getMaxNbBuffers(int& max_nb_buffers) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.getMaxNbBuffers(max_nb_buffers);
+}
+
+void *BufferCtrlObj::getBufferPtr(int buffer_nb, int concat_frame_nb) {
+    DEB_MEMBER_FUNCT();
+    return m_buffer_mgr.getBufferPtr(buffer_nb, concat_frame_nb);
+}
+
+void *BufferCtrlObj::getFramePtr(int acq_frame_nb) {
+    DEB_MEMBER_FUNCT();
+    return m_buffer_mgr.getFramePtr(acq_frame_nb);
+}
+
+void BufferCtrlObj::getStartTimestamp(Timestamp& start_ts) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.getStartTimestamp(start_ts);
+}
+
+void BufferCtrlObj::getFrameInfo(int acq_frame_nb, HwFrameInfoType& info) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.getFrameInfo(acq_frame_nb, info);
+}
+
+void BufferCtrlObj::registerFrameCallback(HwFrameCallback& frame_cb) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.registerFrameCallback(frame_cb);
+}
+
+void BufferCtrlObj::unregisterFrameCallback(HwFrameCallback& frame_cb) {
+    DEB_MEMBER_FUNCT();
+    m_buffer_mgr.unregisterFrameCallback(frame_cb);
+}
+
+StdBufferCbMgr& BufferCtrlObj::getBuffer() {
+    return m_buffer_cb_mgr;
+}
+
+FramePool& BufferCtrlObj::getFramePool() {
+    return m_frame_pool;
+}
@@ -0,0 +1,503 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include "imXpadCalibrationFile.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- helpers
+//---------------------------
+
+static uint32_t crc_table[256];
+
+static bool buildCrcTable()
+{
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		uint32_t c = i;
+		for (int k = 0; k < 8; ++k)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		crc_table[i] = c;
+	}
+	return true;
+}
+
+static const bool crc_table_built = buildCrcTable();
+
+// values of one text line, -1 on a character which is not part of a number list
+static int parseLine(const char *& p, const char *end, std::vector<unsigned long>& values)
+{
+	values.clear();
+	while (p < end && *p != '\n')
+	{
+		char c = *p;
+		if (c == ' ' || c == '\t' || c == '\r')
+		{
+			++p;
+			continue;
+		}
+		if (c < '0' || c > '9')
+			return -1;
+		unsigned long value = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			value = value * 10 + (*p++ - '0');
+		values.push_back(value);
+	}
+	if (p < end)
+		++p;
+	return values.size();
+}
+
+static void appendValue(std::string& text, unsigned long value)
+{
+	char digits[16];
+	int n = 0;
+	do
+	{
+		digits[n++] = char('0' + value % 10);
+		value /= 10;
+	} while (value);
+	while (n)
+		text += digits[--n];
+	text += ' ';
+}
+
+static void readFile(std::ifstream& file, std::vector<char>& data)
+{
+	file.seekg(0, std::ios::end);
+	data.resize(file.tellg());
+	file.seekg(0, std::ios::beg);
+	if (!data.empty())
+		file.read(&data[0], data.size());
+}
+
+static void put32(std::vector<char>& buf, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		buf.push_back(char(value >> (8 * i)));
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+//---------------------------
+//- CalibrationFile
+//---------------------------
+
+CalibrationFile::CalibrationFile()
+{
+	DEB_CONSTRUCTOR();
+}
+
+uint32_t CalibrationFile::crc32(uint32_t crc, const void *buf, size_t len)
+{
+	const unsigned char *p = (const unsigned char *) buf;
+	crc = ~crc;
+	while (len--)
+		crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+// the section as stored, its checksum field left out
+uint32_t CalibrationFile::_sectionCrc(const unsigned char *fields, const unsigned char *values, size_t nb_values)
+{
+	return crc32(crc32(0, fields, 4 * sizeof(uint32_t)), values, nb_values * sizeof(uint16_t));
+}
+
+void CalibrationFile::clear()
+{
+	m_sections.clear();
+}
+
+const std::vector<CalibrationFile::Section>& CalibrationFile::getSections() const
+{
+	return m_sections;
+}
+
+bool CalibrationFile::hasSections(SectionType type) const
+{
+	for (size_t i = 0; i < m_sections.size(); ++i)
+		if (m_sections[i].type == uint32_t(type))
+			return true;
+	return false;
+}
+
+void CalibrationFile::parseText(SectionType type, const char *text, size_t len)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(type, len);
+
+	std::vector<Section> sections;
+	for (size_t i = 0; i < m_sections.size(); ++i)
+		if (m_sections[i].type != uint32_t(type))
+			sections.push_back(m_sections[i]);
+	m_sections.swap(sections);
+
+	if (type == Global)
+		_parseGlobal(text, len);
+	else
+		_parseLocal(text, len);
+}
+
+void CalibrationFile::setLocal(const uint16_t *values, uint32_t rows, uint32_t columns)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(rows, columns);
+
+	if (!rows || !columns || rows % MODULE_LINES)
+		THROW_HW_ERROR(InvalidValue) << "Local configuration of " << columns << "x" << rows
+									 << " is not made of modules of " << MODULE_LINES << " lines";
+
+	std::vector<Section> sections;
+	for (size_t i = 0; i < m_sections.size(); ++i)
+		if (m_sections[i].type != Local)
+			sections.push_back(m_sections[i]);
+	m_sections.swap(sections);
+
+	size_t module_size = size_t(MODULE_LINES) * columns;
+	for (uint32_t module = 0; module < rows / MODULE_LINES; ++module)
+	{
+		Section section;
+		section.type = Local;
+		section.module = module;
+		section.rows = MODULE_LINES;
+		section.columns = columns;
+		section.values.assign(values + module * module_size, values + (module + 1) * module_size);
+		m_sections.push_back(section);
+	}
+}
+
+void CalibrationFile::_parseGlobal(const char *text, size_t len)
+{
+	DEB_MEMBER_FUNCT();
+
+	size_t first = m_sections.size();
+	std::vector<unsigned long> values;
+	const char *p = text, *end = text + len;
+	for (int line = 1; p < end; ++line)
+	{
+		int nb = parseLine(p, end, values);
+		if (nb < 0)
+			THROW_HW_ERROR(Error) << "Global configuration line " << line << ": invalid character";
+		if (nb == 0)
+			continue;
+		if (nb < 3)
+			THROW_HW_ERROR(Error) << "Global configuration line " << line << ": module, register and values expected";
+
+		size_t s;
+		for (s = first; s < m_sections.size() && m_sections[s].module != values[0]; ++s)
+			;
+		if (s == m_sections.size())
+		{
+			Section section;
+			section.type = Global;
+			section.module = values[0];
+			section.rows = 0;
+			section.columns = nb - 1;
+			m_sections.push_back(section);
+		}
+		Section& section = m_sections[s];
+		if (section.columns != uint32_t(nb - 1))
+			THROW_HW_ERROR(Error) << "Global configuration line " << line << ": " << nb - 2
+								  << " values, " << section.columns - 1 << " expected";
+		for (int i = 1; i < nb; ++i)
+		{
+			if (values[i] > 0xffff)
+				THROW_HW_ERROR(Error) << "Global configuration line " << line << ": value " << values[i] << " too large";
+			section.values.push_back(uint16_t(values[i]));
+		}
+		section.rows++;
+	}
+}
+
+void CalibrationFile::_parseLocal(const char *text, size_t len)
+{
+	DEB_MEMBER_FUNCT();
+
+	std::vector<unsigned long> values;
+	const char *p = text, *end = text + len;
+	int nb_lines = 0;
+	for (int line = 1; p < end; ++line)
+	{
+		int nb = parseLine(p, end, values);
+		if (nb < 0)
+			THROW_HW_ERROR(Error) << "Local configuration line " << line << ": invalid character";
+		if (nb == 0)
+			continue;
+
+		if (nb_lines % MODULE_LINES == 0)
+		{
+			Section section;
+			section.type = Local;
+			section.module = nb_lines / MODULE_LINES;
+			section.rows = 0;
+			section.columns = nb;
+			section.values.reserve(MODULE_LINES * nb);
+			m_sections.push_back(section);
+		}
+		Section& section = m_sections.back();
+		if (section.columns != uint32_t(nb))
+			THROW_HW_ERROR(Error) << "Local configuration line " << line << ": " << nb
+								  << " values, " << section.columns << " expected";
+		for (int i = 0; i < nb; ++i)
+		{
+			if (values[i] > 0xffff)
+				THROW_HW_ERROR(Error) << "Local configuration line " << line << ": value " << values[i] << " too large";
+			section.values.push_back(uint16_t(values[i]));
+		}
+		section.rows++;
+		nb_lines++;
+	}
+}
+
+void CalibrationFile::formatText(SectionType type, std::string& text) const
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(type);
+
+	text.clear();
+	if (type == Local)
+	{
+		std::vector<bool> modules(m_sections.size(), true);
+		formatLocalText(modules, text);
+		return;
+	}
+
+	// register after register, each for all the modules, as the detector saves them
+	uint32_t nb_rows = 0;
+	for (size_t s = 0; s < m_sections.size(); ++s)
+		if (m_sections[s].type == Global && m_sections[s].rows > nb_rows)
+			nb_rows = m_sections[s].rows;
+	for (uint32_t r = 0; r < nb_rows; ++r)
+	{
+		for (size_t s = 0; s < m_sections.size(); ++s)
+		{
+			const Section& section = m_sections[s];
+			if (section.type != Global || r >= section.rows)
+				continue;
+			appendValue(text, section.module);
+			for (uint32_t c = 0; c < section.columns; ++c)
+				appendValue(text, section.values[r * section.columns + c]);
+			text += '\n';
+		}
+	}
+}
+
+void CalibrationFile::formatLocalText(const std::vector<bool>& modules, std::string& text) const
+{
+	DEB_MEMBER_FUNCT();
+
+	text.clear();
+	size_t nb_values = 0;
+	for (size_t s = 0; s < m_sections.size(); ++s)
+		if (m_sections[s].type == Local)
+			nb_values += m_sections[s].values.size();
+	text.reserve(nb_values * 4);
+
+	size_t rank = 0;
+	for (size_t s = 0; s < m_sections.size(); ++s)
+	{
+		const Section& section = m_sections[s];
+		if (section.type != Local)
+			continue;
+		if (rank >= modules.size() || !modules[rank++])
+			continue;
+		const uint16_t *v = section.values.empty() ? NULL : &section.values[0];
+		for (uint32_t r = 0; r < section.rows; ++r)
+		{
+			for (uint32_t c = 0; c < section.columns; ++c)
+				appendValue(text, *v++);
+			text += '\n';
+		}
+	}
+}
+
+void CalibrationFile::getChangedChips(const CalibrationFile& reference, std::vector<uint32_t>& chip_masks) const
+{
+	DEB_MEMBER_FUNCT();
+
+	std::vector<const Section *> previous;
+	for (size_t s = 0; s < reference.m_sections.size(); ++s)
+		if (reference.m_sections[s].type == Local)
+			previous.push_back(&reference.m_sections[s]);
+
+	chip_masks.clear();
+	for (size_t s = 0; s < m_sections.size(); ++s)
+	{
+		const Section& section = m_sections[s];
+		if (section.type != Local)
+			continue;
+		uint32_t nb_chips = (section.columns + CHIP_COLUMNS - 1) / CHIP_COLUMNS;
+		uint32_t all = nb_chips >= 32 ? 0xffffffff : (1u << nb_chips) - 1;
+
+		size_t rank = chip_masks.size();
+		const Section *other = rank < previous.size() ? previous[rank] : NULL;
+		if (!other || other->rows != section.rows || other->columns != section.columns)
+		{
+			chip_masks.push_back(all);
+			continue;
+		}
+
+		uint32_t mask = 0;
+		for (uint32_t r = 0; r < section.rows && mask != all; ++r)
+		{
+			const uint16_t *a = &section.values[r * section.columns];
+			const uint16_t *b = &other->values[r * section.columns];
+			for (uint32_t chip = 0; chip < nb_chips; ++chip)
+			{
+				if (mask & (1u << chip))
+					continue;
+				uint32_t first = chip * CHIP_COLUMNS;
+				uint32_t len = std::min<uint32_t>(CHIP_COLUMNS, section.columns - first);
+				if (memcmp(a + first, b + first, len * sizeof(uint16_t)) != 0)
+					mask |= 1u << chip;
+			}
+		}
+		chip_masks.push_back(mask);
+	}
+}
+
+void CalibrationFile::loadText(SectionType type, const char *path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(type, path);
+
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		THROW_HW_ERROR(Error) << "Cannot open " << path;
+	std::vector<char> text;
+	readFile(file, text);
+	parseText(type, text.empty() ? NULL : &text[0], text.size());
+}
+
+void CalibrationFile::saveText(SectionType type, const char *path) const
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(type, path);
+
+	std::string text;
+	formatText(type, text);
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		THROW_HW_ERROR(Error) << "Cannot open " << path;
+	file.write(text.data(), text.size());
+	if (!file)
+		THROW_HW_ERROR(Error) << "Cannot write " << path;
+}
+
+void CalibrationFile::load(const char *path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(path);
+
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		THROW_HW_ERROR(Error) << "Cannot open calibration " << path;
+	std::vector<char> data;
+	readFile(file, data);
+	const unsigned char *p = (const unsigned char *) (data.empty() ? NULL : &data[0]);
+	const unsigned char *end = p + data.size();
+
+	if (data.size() < 3 * sizeof(uint32_t) || get32(p) != MAGIC)
+		THROW_HW_ERROR(Error) << path << " is not a calibration file";
+	uint32_t version = get32(p + 4);
+	if (version > VERSION)
+		THROW_HW_ERROR(Error) << "Calibration " << path << " has version " << version
+							  << ", only up to " << VERSION << " is supported";
+	uint32_t nb_sections = get32(p + 8);
+	p += 3 * sizeof(uint32_t);
+
+	std::vector<Section> sections;
+	for (uint32_t s = 0; s < nb_sections; ++s)
+	{
+		if (end - p < 5 * 4)
+			THROW_HW_ERROR(Error) << "Calibration " << path << " truncated in section " << s;
+		Section section;
+		section.type = get32(p);
+		section.module = get32(p + 4);
+		section.rows = get32(p + 8);
+		section.columns = get32(p + 12);
+		uint32_t crc = get32(p + 16);
+		const unsigned char *fields = p;
+		p += 5 * 4;
+
+		uint64_t nb_values = uint64_t(section.rows) * section.columns;
+		if (uint64_t(end - p) < nb_values * 2)
+			THROW_HW_ERROR(Error) << "Calibration " << path << " truncated in section " << s;
+		if (_sectionCrc(fields, p, nb_values) != crc)
+			THROW_HW_ERROR(Error) << "Calibration " << path << ": checksum error in section " << s
+								  << " (module " << section.module << ")";
+		if (section.type != Global && section.type != Local)
+			THROW_HW_ERROR(Error) << "Calibration " << path << ": unknown section type " << section.type;
+
+		section.values.resize(nb_values);
+		for (uint64_t i = 0; i < nb_values; ++i, p += 2)
+			section.values[i] = uint16_t(p[0] | (p[1] << 8));
+		sections.push_back(section);
+	}
+	m_sections.swap(sections);
+}
+
+void CalibrationFile::save(const char *path) const
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(path);
+
+	std::vector<char> data;
+	put32(data, MAGIC);
+	put32(data, VERSION);
+	put32(data, m_sections.size());
+	for (size_t s = 0; s < m_sections.size(); ++s)
+	{
+		const Section& section = m_sections[s];
+		size_t fields = data.size();
+		put32(data, section.type);
+		put32(data, section.module);
+		put32(data, section.rows);
+		put32(data, section.columns);
+		put32(data, 0);
+		for (size_t i = 0; i < section.values.size(); ++i)
+		{
+			data.push_back(char(section.values[i]));
+			data.push_back(char(section.values[i] >> 8));
+		}
+
+		const unsigned char *p = (const unsigned char *) &data[fields];
+		uint32_t crc = _sectionCrc(p, p + 5 * 4, section.values.size());
+		for (int i = 0; i < 4; ++i)
+			data[fields + 4 * 4 + i] = char(crc >> (8 * i));
+	}
+
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		THROW_HW_ERROR(Error) << "Cannot open calibration " << path;
+	file.write(&data[0], data.size());
+	if (!file)
+		THROW_HW_ERROR(Error) << "Cannot write calibration " << path;
+}
@@ -0,0 +1,305 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <time.h>
+#include "imXpadCalibrationJob.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- job thread
+//---------------------------
+
+class CalibrationJob::JobThread: public Thread
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "CalibrationJob", "JobThread");
+public:
+	JobThread(CalibrationJob& job) : m_job(job) {}
+	virtual ~JobThread() {}
+
+protected:
+	virtual void threadFunction();
+
+private:
+	CalibrationJob& m_job;
+} ;
+
+void CalibrationJob::JobThread::threadFunction()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_job.m_cond.mutex());
+
+	while (1)
+	{
+		while (!m_job.m_quit && !m_job.m_pending)
+			m_job.m_cond.wait();
+		if (m_job.m_quit)
+			break;
+
+		m_job.m_pending = false;
+		std::string cmd = m_job.m_cmd;
+		aLock.unlock();
+
+		DEB_TRACE() << "execute " << cmd;
+		int ret = -1;
+		std::string errmsg;
+		try
+		{
+			m_job.m_client->sendWait(cmd, ret);
+			if (ret != 0 && ret != 1)
+				errmsg = m_job.m_client->getErrorMessage();
+		}
+		catch (Exception& e)
+		{
+			errmsg = e.getErrMsg();
+		}
+
+		aLock.lock();
+		m_job.m_end_time = _now();
+		if (ret == 0)
+			m_job.m_state = Succeeded;
+		else if (ret == 1 || m_job.m_cancelled)
+			m_job.m_state = Aborted;
+		else
+		{
+			m_job.m_state = Failed;
+			m_job.m_message = errmsg;
+			DEB_ERROR() << cmd << " FAILED: " << errmsg;
+		}
+		DEB_TRACE() << cmd << " ended in " << m_job.m_end_time - m_job.m_start_time << " s";
+		m_job.m_cond.broadcast();
+	}
+
+	// a job not taken yet never ran
+	if (m_job.m_pending)
+	{
+		m_job.m_pending = false;
+		m_job.m_state = Aborted;
+		m_job.m_end_time = _now();
+	}
+	m_job.m_running = false;
+	m_job.m_cond.broadcast();
+}
+
+//---------------------------
+//- CalibrationJob
+//---------------------------
+
+CalibrationJob::CalibrationJob() :
+m_client(NULL), m_thread(NULL), m_pending(false), m_quit(false), m_running(false), m_cancelled(false),
+m_state(Idle), m_start_time(0), m_end_time(0), m_progress(-1), m_progress_time(0)
+{
+	DEB_CONSTRUCTOR();
+}
+
+CalibrationJob::~CalibrationJob()
+{
+	DEB_DESTRUCTOR();
+	disconnect();
+}
+
+double CalibrationJob::_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+void CalibrationJob::connect(const std::string& hostname, int port, const std::vector<std::string>& session_cmds)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(hostname, port);
+
+	disconnect();
+
+	XpadClient *client = XpadClient::open(hostname, port);
+	try
+	{
+		std::vector<int> rets;
+		client->sendBatch(session_cmds, rets);
+		for (size_t i = 0; i < session_cmds.size(); ++i)
+			if (rets[i] != 0)
+				DEB_WARNING() << "Calibration connection: " << session_cmds[i] << " returned " << rets[i];
+	}
+	catch (Exception& e)
+	{
+		client->disconnectFromServer();
+		delete client;
+		throw;
+	}
+	client->setProgressCallback(this);
+
+	AutoMutex aLock(m_cond.mutex());
+	m_client = client;
+	m_quit = false;
+	m_running = true;
+	aLock.unlock();
+
+	m_thread = new JobThread(*this);
+	m_thread->start();
+}
+
+void CalibrationJob::disconnect()
+{
+	DEB_MEMBER_FUNCT();
+
+	if (!m_thread)
+		return;
+
+	AutoMutex aLock(m_cond.mutex());
+	m_quit = true;
+	m_cond.broadcast();
+	// a calibration in progress holds the connection, it is cut under it
+	m_client->release(m_state == Running);
+	while (m_running)
+		m_cond.wait();
+	aLock.unlock();
+
+	delete m_thread;
+	m_thread = NULL;
+	m_client->disconnectFromServer();
+	delete m_client;
+	m_client = NULL;
+}
+
+bool CalibrationJob::isConnected() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_running;
+}
+
+void CalibrationJob::start(const std::string& cmd)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(cmd);
+
+	AutoMutex aLock(m_cond.mutex());
+	if (!m_running)
+		THROW_HW_ERROR(Error) << "Calibration connection not open";
+	if (m_state == Running)
+		THROW_HW_ERROR(Error) << "Calibration already running: " << m_cmd;
+
+	m_cmd = cmd;
+	m_pending = true;
+	m_cancelled = false;
+	m_state = Running;
+	m_start_time = _now();
+	m_end_time = 0;
+	m_progress = -1;
+	m_progress_time = 0;
+	m_message.clear();
+	m_cond.broadcast();
+}
+
+void CalibrationJob::cancel()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	if (m_state == Running)
+		m_cancelled = true;
+}
+
+bool CalibrationJob::wait(double timeout) const
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	while (m_state == Running)
+	{
+		if (!m_cond.wait(timeout) && timeout >= 0)
+			break;
+	}
+	return m_state != Running;
+}
+
+CalibrationJob::State CalibrationJob::getState() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_state;
+}
+
+bool CalibrationJob::isRunning() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_state == Running;
+}
+
+std::string CalibrationJob::getCommand() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_cmd;
+}
+
+double CalibrationJob::getProgress() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	if (m_state == Succeeded)
+		return 1;
+	return m_progress;
+}
+
+double CalibrationJob::getRemainingTime() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	if (m_state != Running)
+		return (m_state == Idle) ? -1 : 0;
+	if (m_progress <= 0)
+		return -1;
+
+	// pace up to the last time bar, less what passed since
+	double total = (m_progress_time - m_start_time) / m_progress;
+	double left = total - (_now() - m_start_time);
+	return left > 0 ? left : 0;
+}
+
+double CalibrationJob::getElapsedTime() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	if (m_state == Idle)
+		return 0;
+	return ((m_state == Running) ? _now() : m_end_time) - m_start_time;
+}
+
+std::string CalibrationJob::getMessage() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_message;
+}
+
+void CalibrationJob::progress(int done, int outoff, const std::string& message)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR3(done, outoff, message);
+
+	AutoMutex aLock(m_cond.mutex());
+	if (outoff > 0)
+	{
+		double fraction = double(done) / outoff;
+		m_progress = (fraction < 0) ? 0 : (fraction > 1) ? 1 : fraction;
+		m_progress_time = _now();
+	}
+	m_message = message;
+	m_cond.broadcast();
+}
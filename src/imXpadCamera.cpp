@@ -37,11 +37,19 @@
 #include <sys/stat.h>
 #include <ostream>
 #include <fstream>
+#include <algorithm>
 
 
 using namespace lima;
 using namespace lima::imXpad;
 
+// calibrations given as .xcal go through the binary container, others as .cfg/.cfl texts
+static bool isBinaryCalibration(const std::string& path)
+{
+	size_t len = path.length();
+	return len >= 5 && path.compare(len - 5, 5, ".xcal") == 0;
+}
+
 #define CHECK_DETECTOR_ACCESS \
 { \
 	if (m_thread_running == false || (m_thread_running && m_process_id >0) || (m_acq_frame_nb == m_nb_frames)) \
@@ -67,15 +75,58 @@ public:
 protected:
 	virtual void threadFunction();
 
+private:
+	Camera& m_cam;
+	int m_affinity_generation;
+} ;
+
+//---------------------------
+//- session restore
+//---------------------------
+
+class Camera::SessionRestore: public ConnectionCallback
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "Camera", "SessionRestore");
+public:
+	SessionRestore(Camera &aCam) : m_cam(aCam) {}
+
+	virtual void connectionRestored(XpadClient& client);
+
 private:
 	Camera& m_cam;
 } ;
 
+void Camera::SessionRestore::connectionRestored(XpadClient& client)
+{
+	DEB_MEMBER_FUNCT();
+
+	std::vector<std::string> cmds;
+	std::vector<int> rets;
+	m_cam.getSessionCommands(&client, cmds);
+	client.sendBatch(cmds, rets);
+
+	for (size_t i = 0; i < cmds.size(); ++i)
+		if (rets[i] != 0)
+			DEB_WARNING() << "Restoring " << cmds[i] << " returned " << rets[i];
+	DEB_TRACE() << "Session restored with " << cmds.size() << " commands";
+}
+
 //---------------------------
 // @brief  Ctor
 //---------------------------m_npixels
 
-Camera::Camera(std::string hostname, int port, unsigned int moduleMask) : m_host_name(hostname), m_port(port)
+Camera::Camera(std::string hostname, int port, unsigned int moduleMask) : m_host_name(hostname), m_port(port),
+	m_correction(m_pool), m_local_correction_flag(0),
+	m_server_noisy_pixel_flag(0), m_server_dead_pixel_flag(0),
+	m_geometry(m_pool, IMG_LINE, IMG_COLUMN), m_local_geometry_flag(0), m_server_geometry_flag(0),
+	m_sparse_encoder(m_pool), m_sparse_flag(0), m_sparse_nb_frames(0), m_dense_nb_frames(0),
+	m_codec(m_pool), m_transfer_compression(FrameCodec::Raw), m_module_readout_flag(0),
+	m_cpu_affinity_generation(0), m_frame_streaming(false), m_acq_aborted(false),
+	m_auto_reconnect(0), m_start_raw_time(0), m_strict_frame_rate_flag(0),
+	m_threshold_scan(m_pool), m_scan_first_ithl(0), m_scan_last_ithl(0), m_scan_nb_steps(0),
+	m_scan_acq_time(0), m_scan_fit_time(0),
+	m_delta_config_l_flag(1), m_config_l_changed_chips(0), m_config_l_sent_modules(0), m_config_l_skipped_modules(0),
+	m_pixel_statistics(m_pool), m_pixel_statistics_flag(0), m_detector_module_mask(0)
 {
 	DEB_CONSTRUCTOR();
 
@@ -89,6 +140,9 @@ Camera::Camera(std::string hostname, int port, unsigned int moduleMask) : m_host
 
 	m_xpad = new XpadClient();
 	m_xpad_alt = new XpadClient();
+	m_session_restore = new SessionRestore(*this);
+	m_xpad->setConnectionCallback(m_session_restore);
+	m_xpad_alt->setConnectionCallback(m_session_restore);
 
 	if (m_xpad->connectToServer(m_host_name, m_port) < 0)
 	{
@@ -98,6 +152,10 @@ Camera::Camera(std::string hostname, int port, unsigned int moduleMask) : m_host
 	{
 		THROW_HW_ERROR(Error) << "[ " << m_xpad_alt->getErrorMessage() << " ]";
 	}
+	// frame reads can be interrupted, m_xpad_alt stays free to send the abort
+	m_xpad->setAbortEvent(&m_abort_event);
+	// only records while a capture file is open
+	m_xpad->setTranscript(&m_transcript);
 	m_state.state = XpadStatus::Idle;
 	std::string xpad_type, xpad_model;
 
@@ -107,6 +165,7 @@ Camera::Camera(std::string hostname, int port, unsigned int moduleMask) : m_host
 	getDetectorModelFromHardware(xpad_model);
 	m_xpad_model = xpad_model;
 	getModuleMask();
+	m_detector_module_mask = m_module_mask;
 	getChipMask();
 	getModuleNumber();
 	getChipNumber();
@@ -125,6 +184,7 @@ Camera::Camera(std::string hostname, int port, unsigned int moduleMask) : m_host
 	setStackImages(1);
 	setWaitAcqEndTime(10000);
 	getBurstNumber();
+	setAutoReconnect(8);
 
 
 }
@@ -132,6 +192,9 @@ Camera::Camera(std::string hostname, int port, unsigned int moduleMask) : m_host
 Camera::~Camera()
 {
 	DEB_DESTRUCTOR();
+	// a server already gone must not hold the destruction
+	m_xpad->setAutoReconnect(0);
+	m_xpad_alt->setAutoReconnect(0);
 	quit();
 }
 
@@ -141,18 +204,19 @@ int Camera::init()
 	DEB_TRACE() << "********** Inside of Camera::init ***********";
 	m_acq_frame_nb = 0;
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "Init";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
+	m_config_l_uploaded.clear();
 
 	if (ret == 1 )
 		throw LIMA_HW_EXC(Error, "Detector BUSY!");
 	else if (ret == -1)
 		throw LIMA_HW_EXC(Error, "xpadInit FAILED!");
 
-	m_xpad_alt->sendWait(cmd.str(), ret);
+	m_xpad_alt->sendWait(cmd, ret);
 
 	if (ret == 1 )
 		throw LIMA_HW_EXC(Error, "Detector BUSY!");
@@ -163,8 +227,9 @@ int Camera::init()
 	
 	//use module mask to enable/disable some modules. 
 	//Do not apply if 0, in order to keep compatibility with others versions
+	//the modules of a region stay selected
 	if(m_module_mask!=0)
-		setModuleMask(m_module_mask);
+		applyModuleMask(m_module_mask);
 	return ret;
 }
 
@@ -173,12 +238,12 @@ void Camera::quit()
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::exit ***********";
 
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "Exit";
-	m_xpad->sendNoWait(cmd.str());
-	m_xpad_alt->sendNoWait(cmd.str());
+	m_xpad->sendNoWait(cmd);
+	m_xpad_alt->sendNoWait(cmd);
 
 	DEB_TRACE() << "********** Outside of Camera::exit ***********";
 }
@@ -188,9 +253,9 @@ void Camera::reset()
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::reset ***********";
 
-	std::stringstream cmd1;
+	CommandBuilder cmd1;
 	cmd1 << "ResetDetector";
-	m_xpad->sendNoWait(cmd1.str());
+	m_xpad->sendNoWait(cmd1);
 	DEB_TRACE() << "Reset of detector  -> OK";
 
 	DEB_TRACE() << "********** Outside of Camera::reset ***********";
@@ -203,27 +268,62 @@ int Camera::prepareAcq()
 
 	//waitAcqEnd();
 
+	if (m_calibration_job.isRunning())
+		THROW_HW_ERROR(Error) << "Calibration in progress: " << m_calibration_job.getCommand();
+
 	int value;
-	std::stringstream cmd1;
 
 	m_image_file_format = 1;
 
-	cmd1	<< "SetExposureParameters "
-	 << m_nb_frames << " "
-	 << m_exp_time_usec << " "
-	 << m_lat_time_usec << " "
-	 << m_overflow_time << " "
-	 << m_xpad_trigger_mode << " "
-	 << m_xpad_output_signal_mode << " "
-	 << m_geometrical_correction_flag << " "
-	 << m_flat_field_correction_flag << " "
-	 << m_image_transfer_flag << " "
-	 << m_image_file_format << " "
-	 << m_acquisition_mode << " "
-	 << m_stack_images << " "
-	 << "/opt/imXPAD/tmp_corrected/";
+	// the remap table follows the layout, it is rebuilt with the image size
+	if (m_local_geometry_flag)
+	{
+		const Size& raw_size = m_geometry.getRawSize();
+		m_raw_frame.resize(raw_size.getWidth() * raw_size.getHeight());
+	}
 
-	m_xpad->sendWait(cmd1.str(), value);
+	// the first frame must not pay for page faults
+	m_buffer_ctrl_obj.getFramePool().prefault();
+
+	if (m_module_readout_flag)
+	{
+		Size raw_size = m_local_geometry_flag ? m_geometry.getRawSize() : m_image_size;
+		m_module_readout.prepare(raw_size, (m_pixel_depth == Camera::B2) ? 2 : 4);
+	}
+
+	if (m_local_correction_flag)
+		m_correction.prepare(m_image_size);
+
+	if (m_pixel_statistics_flag)
+		m_pixel_statistics.prepare(m_image_size);
+
+	AutoMutex sparseLock(m_sparse_lock);
+	m_sparse_nb_frames = 0;
+	m_dense_nb_frames = 0;
+	if (m_sparse_flag && !m_sparse_file_path.empty())
+	{
+		if (m_sparse_file.is_open())
+			m_sparse_file.close();
+		m_sparse_file.open(m_sparse_file_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!m_sparse_file.is_open())
+			THROW_HW_ERROR(Error) << "Cannot open sparse frame file " << m_sparse_file_path;
+	}
+	sparseLock.unlock();
+
+	double period = (m_exp_time_usec + m_lat_time_usec) * 1e-6;
+	double min_period = minFramePeriod();
+	if (period < min_period)
+	{
+		if (m_strict_frame_rate_flag)
+			THROW_HW_ERROR(InvalidValue) << "Frame period of " << period << " s too short, the link and the client "
+										 << "sustain " << min_period << " s (" << 1 / min_period << " Hz)";
+		DEB_WARNING() << "Frame period of " << period << " s too short, frames will back up: the link and the client "
+					  << "sustain " << min_period << " s (" << 1 / min_period << " Hz)";
+	}
+
+	CommandBuilder cmd;
+	exposureParametersCommand(cmd);
+	m_xpad->sendWait(cmd, value);
 
 	if (!value)
 	{
@@ -259,9 +359,11 @@ void Camera::startAcq()
 		m_acq_frame_nb = 0;
 		StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
 		buffer_mgr.setStartTimestamp(Timestamp::now());
+		m_start_raw_time = FrameAccounting::now();
 
 		m_wait_flag = false;
 		m_quit = false;
+		m_acq_aborted = false;
 		m_process_id = 0;
 		m_cond.broadcast();
 
@@ -285,7 +387,9 @@ void Camera::waitAcqEnd()
 	while (m_thread_running)
 		m_cond.wait();
 
-	usleep(m_dead_time);
+	// an aborted stream is drained by the next command, not waited for here
+	if (!m_acq_aborted)
+		usleep(m_dead_time);
 
 	DEB_TRACE() << "********** Outside of Camera::waitAcqEnd ***********";
 }
@@ -321,6 +425,15 @@ void Camera::sendExposeCommand()
 }
 
 int Camera::readFrameExpose(void *bptr, int frame_nb)
+{
+	DEB_MEMBER_FUNCT();
+
+	// the caller provides a frame of the current image size
+	size_t capacity = size_t(m_image_size.getWidth()) * m_image_size.getHeight() * ((m_pixel_depth == Camera::B2) ? 2 : 4);
+	return readFrameExpose(bptr, frame_nb, capacity);
+}
+
+int Camera::readFrameExpose(void *bptr, int frame_nb, size_t capacity)
 {
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::readFrameExpose ***********";
@@ -329,7 +442,10 @@ int Camera::readFrameExpose(void *bptr, int frame_nb)
 
 	int ret;
 
-	ret = m_xpad->getDataExpose(bptr, (m_pixel_depth == Camera::B2) ? 0 : 1);
+	if (m_module_readout_flag)
+		ret = m_module_readout.readFrame(bptr, frame_nb);
+	else
+		ret = m_xpad->getDataExpose(bptr, (m_pixel_depth == Camera::B2) ? 0 : 1, capacity);
 
 	DEB_TRACE() << "********** Outside of Camera::readFrameExpose ***********";
 
@@ -354,7 +470,7 @@ void Camera::getStatus(XpadStatus& status)
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::getStatus ***********";
 	CHECK_DETECTOR_ACCESS
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	std::string str;
 	unsigned short pos;
 	cmd << "GetDetectorStatus";
@@ -399,6 +515,130 @@ int Camera::getNbHwAcquiredFrames()
 	return m_acq_frame_nb;
 }
 
+int Camera::receiveFrame(void *bptr, int frame_nb)
+{
+	DEB_MEMBER_FUNCT();
+
+	// with the local geometry the server ships raw frames, staged before the remap
+	void *rptr = m_local_geometry_flag ? (void *) &m_raw_frame[0] : bptr;
+	size_t capacity = m_local_geometry_flag ? m_raw_frame.size() * sizeof(uint32_t)
+		: size_t(m_image_size.getWidth()) * m_image_size.getHeight() * ((m_pixel_depth == Camera::B2) ? 2 : 4);
+
+	int ret = readFrameExpose(rptr, frame_nb, capacity);
+	if (ret == 0)
+		processFrame(rptr, bptr, frame_nb);
+
+	return ret;
+}
+
+void Camera::accountFrame(int ret)
+{
+	DEB_MEMBER_FUNCT();
+
+	// the module streams have no frame header to check
+	if (m_module_readout_flag)
+	{
+		if (ret == 0)
+			m_frame_accounting.frameReceived(FrameAccounting::now());
+		return;
+	}
+
+	const FrameHeader& header = m_xpad->getLastFrameHeader();
+	if (header.kind == FrameHeader::Empty)
+	{
+		DEB_WARNING() << "Frame " << m_acq_frame_nb << ": header with no payload";
+		m_frame_accounting.headerAnomaly();
+	}
+	if (header.kind == FrameHeader::Oversized)
+	{
+		DEB_ERROR() << "Frame " << m_acq_frame_nb << ": header announces " << header.lines << "x" << header.columns
+					<< ", more than the frame buffer holds";
+		m_frame_accounting.headerAnomaly();
+	}
+	if (header.kind != FrameHeader::Frame)
+		return;
+
+	Size raw_size = m_local_geometry_flag ? m_geometry.getRawSize() : m_image_size;
+	if (header.lines != (uint32_t) raw_size.getHeight() || header.columns != (uint32_t) raw_size.getWidth())
+	{
+		DEB_WARNING() << "Frame " << m_acq_frame_nb << ": header announces " << header.lines << "x" << header.columns
+					  << ", expected " << raw_size.getHeight() << "x" << raw_size.getWidth();
+		m_frame_accounting.headerAnomaly();
+	}
+	if (!header.compressed && header.data_size < header.lines * header.columns * sizeof(uint32_t))
+	{
+		DEB_WARNING() << "Frame " << m_acq_frame_nb << ": short payload of " << header.data_size << " bytes";
+		m_frame_accounting.shortRead();
+	}
+	m_frame_accounting.frameReceived(header.receive_time);
+
+	double transfer_time = (header.nb_reads > 1) ? header.payload_time - header.receive_time : 0;
+	m_throughput.frameMeasured(header.lines * header.columns, header.data_size, header.compressed, transfer_time,
+							   (m_pixel_depth == Camera::B2) ? 2 : 4, FrameAccounting::now() - header.payload_time);
+}
+
+double Camera::minFramePeriod()
+{
+	DEB_MEMBER_FUNCT();
+
+	Size raw_size = m_local_geometry_flag ? m_geometry.getRawSize() : m_image_size;
+	uint32_t nb_pixels = raw_size.getWidth() * raw_size.getHeight();
+	if (nb_pixels == 0)
+	{
+		int nb_modules = 0;
+		for (unsigned int mask = m_module_mask; mask; mask >>= 1)
+			nb_modules += mask & 1;
+		nb_pixels = nb_modules * m_chip_number * IMG_LINE * IMG_COLUMN;
+	}
+
+	return m_throughput.getMinFramePeriod(nb_pixels, (m_pixel_depth == Camera::B2) ? 2 : 4,
+										  m_transfer_compression != FrameCodec::Raw);
+}
+
+Timestamp Camera::frameTimestamp(int frame_nb)
+{
+	DEB_MEMBER_FUNCT();
+
+	double receive_time, exposure_start;
+	if (!m_frame_accounting.getFrameTiming(frame_nb, receive_time, exposure_start))
+		return Timestamp();		// stamped by the buffer manager
+	return Timestamp(receive_time - m_start_raw_time);
+}
+
+void Camera::processFrame(void *rptr, void *bptr, int frame_nb)
+{
+	DEB_MEMBER_FUNCT();
+
+	int depth = (m_pixel_depth == Camera::B2) ? 2 : 4;
+
+	if (m_local_geometry_flag)
+		m_geometry.apply(rptr, bptr, depth);
+
+	// statistics see the frames as the detector counted them, before the masks they lead to
+	if (m_pixel_statistics_flag)
+		m_pixel_statistics.accumulate(bptr, depth);
+
+	if (m_local_correction_flag && m_correction.isActive())
+		m_correction.apply(bptr, depth);
+
+	if (m_sparse_flag)
+	{
+		m_sparse_frame.acq_frame_nb = frame_nb;
+		bool sparse = m_sparse_encoder.encode(bptr, depth, m_image_size, m_sparse_frame);
+
+		AutoMutex aLock(m_sparse_lock);
+		if (sparse)
+			++m_sparse_nb_frames;
+		else
+			++m_dense_nb_frames;
+		if (m_sparse_file.is_open())
+			m_sparse_frame.write(m_sparse_file);
+		std::vector<SparseFrameCallback*>::iterator cb;
+		for (cb = m_sparse_cbs.begin(); cb != m_sparse_cbs.end(); ++cb)
+			(*cb)->sparseFrameReady(m_sparse_frame);
+	}
+}
+
 void Camera::AcqThread::threadFunction()
 {
 	DEB_MEMBER_FUNCT();
@@ -422,14 +662,27 @@ void Camera::AcqThread::threadFunction()
 		DEB_TRACE() << "Acqisition thread running...";
 		m_cam.m_thread_running = true;
 		m_cam.m_cond.broadcast();
+		bool new_affinity = (m_affinity_generation != m_cam.m_cpu_affinity_generation);
+		CpuAffinity affinity = m_cam.m_cpu_affinity;
+		m_affinity_generation = m_cam.m_cpu_affinity_generation;
 		aLock.unlock();
 
+		if (new_affinity)
+			affinity.applyToCurrentThread();
+
 		switch (m_cam.m_process_id)
 		{
 			case 0:
 			{  //startAcq()
 
 				DEB_TRACE() << "Starting to acquire images...";
+				aLock.lock();
+				m_cam.m_acq_migrations.reset();
+				aLock.unlock();
+				m_cam.m_pool.resetMigrations();
+				// frames are only late when the detector paces them
+				m_cam.m_frame_accounting.start(m_cam.m_nb_frames, (m_cam.m_exp_time_usec + m_cam.m_lat_time_usec) * 1e-6,
+											   m_cam.m_xpad_trigger_mode == 0, FrameAccounting::now());
 
 				if (m_cam.m_quit == false)
 				{
@@ -440,18 +693,33 @@ void Camera::AcqThread::threadFunction()
 
 					if (m_cam.m_image_transfer_flag == 1)
 					{
+						// from now on a stop interrupts the frame reads
+						aLock.lock();
+						m_cam.m_frame_streaming = true;
+						if (m_cam.m_quit)
+						{
+							m_cam.m_acq_aborted = true;
+							m_cam.m_abort_event.trigger();
+						}
+						aLock.unlock();
+
 						while (continueFlag && (!m_cam.m_nb_frames || m_cam.m_acq_frame_nb < m_cam.m_nb_frames))
 						{
 
 							DEB_TRACE() << m_cam.m_acq_frame_nb;
 							void *bptr = buffer_mgr.getFrameBufferPtr(m_cam.m_acq_frame_nb);
 
-							ret = m_cam.readFrameExpose(bptr, m_cam.m_acq_frame_nb);
+							ret = m_cam.receiveFrame(bptr, m_cam.m_acq_frame_nb);
+							aLock.lock();
+							m_cam.m_acq_migrations.sample();
+							aLock.unlock();
+							m_cam.accountFrame(ret);
 
 							if ( ret == 0 )
 							{
 								HwFrameInfoType frame_info;
 								frame_info.acq_frame_nb = m_cam.m_acq_frame_nb;
+								frame_info.frame_timestamp = m_cam.frameTimestamp(m_cam.m_acq_frame_nb);
 								continueFlag = buffer_mgr.newFrameReady(frame_info);
 								DEB_TRACE() << "acqThread::threadFunction() newframe ready ";
 
@@ -463,6 +731,9 @@ void Camera::AcqThread::threadFunction()
 							{
 								continueFlag = false;
 								DEB_TRACE() << "ABORT detected";
+								if (!m_cam.m_acq_aborted && m_cam.m_acq_frame_nb < m_cam.m_nb_frames)
+									DEB_WARNING() << "Stream ended after " << m_cam.m_acq_frame_nb << " of "
+												  << m_cam.m_nb_frames << " frames";
 							}
 						}
 						m_cam.getDataExposeReturn();
@@ -473,20 +744,25 @@ void Camera::AcqThread::threadFunction()
 						DEB_TRACE() << m_cam.m_acq_frame_nb;
 						DEB_TRACE() << m_cam.m_image_size.getWidth() << " " << m_cam.m_image_size.getHeight();
 
-						uint numData = m_cam.m_image_size.getWidth() * m_cam.m_image_size.getHeight();
+						Size raw_size = m_cam.m_local_geometry_flag ? m_cam.m_geometry.getRawSize() : m_cam.m_image_size;
+						uint numData = raw_size.getWidth() * raw_size.getHeight();
 
 						uint16_t *buffer_short;
 						uint32_t *buffer_int;
 
+						// files hold 32 bits pixels, staged when the frame is 16 bits
+						bool staged = m_cam.m_local_geometry_flag || m_cam.m_pixel_depth == Camera::B2;
+						if (staged && m_cam.m_raw_frame.size() < numData)
+							m_cam.m_raw_frame.resize(numData);
+
 						while (continueFlag && (!m_cam.m_nb_frames || m_cam.m_acq_frame_nb < m_cam.m_nb_frames) && m_cam.m_quit == false)
 						{
 
 							void *bptr = buffer_mgr.getFrameBufferPtr(m_cam.m_acq_frame_nb);
+							void *rptr = m_cam.m_local_geometry_flag ? (void *) &m_cam.m_raw_frame[0] : bptr;
 
-							if (m_cam.m_pixel_depth == Camera::B2)
-								buffer_short = (uint16_t *) bptr;
-							else
-								buffer_int = (uint32_t *) bptr;
+							buffer_short = (uint16_t *) rptr;
+							buffer_int = staged ? &m_cam.m_raw_frame[0] : (uint32_t *) rptr;
 
 							std::stringstream fileName;
 
@@ -527,9 +803,15 @@ void Camera::AcqThread::threadFunction()
 								}
 
 								remove(fileName.str().c_str());
+								m_cam.processFrame(rptr, bptr, m_cam.m_acq_frame_nb);
+								aLock.lock();
+								m_cam.m_acq_migrations.sample();
+								aLock.unlock();
+								m_cam.m_frame_accounting.frameReceived(FrameAccounting::now());
 
 								HwFrameInfoType frame_info;
 								frame_info.acq_frame_nb = m_cam.m_acq_frame_nb;
+								frame_info.frame_timestamp = m_cam.frameTimestamp(m_cam.m_acq_frame_nb);
 								continueFlag = buffer_mgr.newFrameReady(frame_info);
 								//DEB_TRACE() << "acqThread::threadFunction() newframe ready ";
 								++m_cam.m_acq_frame_nb;
@@ -538,67 +820,24 @@ void Camera::AcqThread::threadFunction()
 							}
 						}
 					}
-				}
-
-				break;
-			}
-			case 1:
-			{ //CalibrationOTN
-				int ret;
-				std::stringstream cmd;
-
-				cmd <<  "CalibrationOTN " << m_cam.m_calibration_configuration;
-				m_cam.m_xpad->sendWait(cmd.str(), ret);
-
-				if (ret == 0)
-					DEB_TRACE() << "Calibration Over-The-Noise finished SUCCESFULLY";
-				else if (ret == 1)
-					DEB_TRACE() << "Calibration Over-The-Noise was ABORTED";
-				else
-					throw LIMA_HW_EXC(Error, "Calibration Over The Noise FAILED!");
-
-				break;
-			}
-			case 2:
-			{ //CalibrationOTNPulse
-				int ret;
-				std::stringstream cmd;
-
-				cmd <<  "CalibrationOTNPulse " << m_cam.m_calibration_configuration;
-				m_cam.m_xpad->sendWait(cmd.str(), ret);
-
-				if (ret == 0)
-					DEB_TRACE() << "Calibration Over-The-Noise with PULSE finished SUCCESFULLY";
-				else if (ret == 1)
-					DEB_TRACE() << "Calibration Over-The-Noise was ABORTED";
-				else
-					throw LIMA_HW_EXC(Error, "Calibration Over The Noise with PULSE FAILED!");
-
-				break;
-
-			}
-			case 3:
-			{ //CalibrationBEAM
-				int ret;
-				std::stringstream cmd;
-
-				cmd <<  "CalibrationBEAM " << m_cam.m_time << " " << m_cam.m_ITHL_max << " " << m_cam.m_calibration_configuration;
-				m_cam.m_xpad->sendWait(cmd.str(), ret);
 
-				if (ret == 0)
-					DEB_TRACE() << "Calibration BEAM finished SUCCESFULLY";
-				else if (ret == 1)
-					DEB_TRACE() << "Calibration BEAM was ABORTED";
-				else
-					throw LIMA_HW_EXC(Error, "Calibration BEAM FAILED!");
+					AutoMutex sparseLock(m_cam.m_sparse_lock);
+					if (m_cam.m_sparse_file.is_open())
+						m_cam.m_sparse_file.close();
+				}
 
 				break;
-
 			}
 			case 4:
 			{ //loadCalibrationFromFile
 				int ret1;
 
+				if (isBinaryCalibration(m_cam.m_file_path))
+				{
+					m_cam.loadBinaryCalibration(m_cam.m_file_path);
+					break;
+				}
+
 				size_t pos = m_cam.m_file_path.find(".cf");
 
 				if (pos == std::string::npos)
@@ -622,6 +861,12 @@ void Camera::AcqThread::threadFunction()
 			{ //saveCalibrationToFile
 				int ret1;
 
+				if (isBinaryCalibration(m_cam.m_file_path))
+				{
+					m_cam.saveBinaryCalibration(m_cam.m_file_path);
+					break;
+				}
+
 				size_t pos = m_cam.m_file_path.find(".cf");
 
 				if (pos == std::string::npos)
@@ -643,7 +888,7 @@ void Camera::AcqThread::threadFunction()
 			case 6:
 			{ //Load Default Config G values
 				std::string ret;
-				std::stringstream cmd;
+				CommandBuilder cmd;
 				int value, regid;
 
 				for (int i = 0; i < 7; i++)
@@ -694,9 +939,9 @@ void Camera::AcqThread::threadFunction()
 							break;
 					}
 
-					cmd.str(std::string());
+					cmd.clear();
 					cmd << "LoadConfigG " << register_name << " " << value ;
-					m_cam.m_xpad->sendWait(cmd.str(), ret);
+					m_cam.m_xpad->sendWait(cmd, ret);
 				}
 
 				if (ret.length() > 1)
@@ -709,11 +954,11 @@ void Camera::AcqThread::threadFunction()
 			case 7:
 			{ //ITHL Increase
 				int ret;
-				std::stringstream cmd;
+				CommandBuilder cmd;
 
-				cmd.str(std::string());
+				cmd.clear();
 				cmd << "ITHLIncrease";
-				m_cam.m_xpad->sendWait(cmd.str(), ret);
+				m_cam.m_xpad->sendWait(cmd, ret);
 
 				if (!ret)
 					DEB_TRACE() << "ITHL was increased SUCCESFULLY";
@@ -725,11 +970,11 @@ void Camera::AcqThread::threadFunction()
 			case 8:
 			{  //ITHL Decrease
 				int ret;
-				std::stringstream cmd;
+				CommandBuilder cmd;
 
-				cmd.str(std::string());
+				cmd.clear();
 				cmd << "ITHLDecrease";
-				m_cam.m_xpad->sendWait(cmd.str(), ret);
+				m_cam.m_xpad->sendWait(cmd, ret);
 
 				if (!ret)
 					DEB_TRACE() << "ITHL was decreased SUCCESFULLY";
@@ -741,11 +986,13 @@ void Camera::AcqThread::threadFunction()
 			case 9:
 			{  //LoadFloatConfigL
 				int ret;
-				std::stringstream cmd;
+				CommandBuilder cmd;
+
+				m_cam.m_config_l_uploaded.clear();	// the server writes its own
 
-				cmd.str(std::string());
+				cmd.clear();
 				cmd <<  "LoadFlatConfigL " << " " << m_cam.m_flat_value;
-				m_cam.m_xpad->sendWait(cmd.str(), ret);
+				m_cam.m_xpad->sendWait(cmd, ret);
 
 				if (!ret)
 					DEB_TRACE() << "Loading local configurations values, with flat value: " <<  m_cam.m_flat_value << " -> OK" ;
@@ -754,8 +1001,15 @@ void Camera::AcqThread::threadFunction()
 
 				break;
 			}
+			case 10:
+			{  //ThresholdScan
+				m_cam.runThresholdScan();
+				break;
+			}
 		}
 		aLock.lock();
+		m_cam.m_frame_streaming = false;
+		m_cam.m_abort_event.clear();
 		m_cam.m_quit = false;
 		m_cam.m_wait_flag = true;
 		m_cam.m_cond.broadcast();
@@ -766,7 +1020,7 @@ void Camera::AcqThread::threadFunction()
 }
 
 Camera::AcqThread::AcqThread(Camera& cam) :
-m_cam(cam)
+m_cam(cam), m_affinity_generation(0)
 {
 	AutoMutex aLock(m_cam.m_cond.mutex());
 	m_cam.m_wait_flag = true;
@@ -789,17 +1043,23 @@ void Camera::getImageSize(Size& size)
 	DEB_MEMBER_FUNCT();
 	CHECK_DETECTOR_ACCESS
 	std::string message, ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetImageSize";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 	int pos = ret.find("x");
 
 	int row = atoi(ret.substr(0, pos).c_str());
 	int columns = atoi(ret.substr(pos + 1, ret.length() - pos + 1).c_str());
 
 	size = Size(columns, row);
+
+	if (m_local_geometry_flag)
+	{
+		m_geometry.build(row / IMG_LINE, columns / IMG_COLUMN);
+		size = m_geometry.getCorrectedSize();
+	}
 }
 
 void Camera::getPixelSize(double& size_x, double& size_y)
@@ -854,11 +1114,11 @@ void Camera::getDetectorTypeFromHardware(std::string& type)
 	DEB_MEMBER_FUNCT();
 	CHECK_DETECTOR_ACCESS
 	std::string message;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetDetectorType";
-	m_xpad->sendWait(cmd.str(), type);
+	m_xpad->sendWait(cmd, type);
 
 	m_xpad_type = type;
 }
@@ -873,11 +1133,11 @@ void Camera::getDetectorModelFromHardware(std::string& model)
 	DEB_MEMBER_FUNCT();
 	CHECK_DETECTOR_ACCESS
 	std::string message;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetDetectorModel";
-	m_xpad->sendWait(cmd.str(), model);
+	m_xpad->sendWait(cmd, model);
 
 	m_xpad_model = model;
 }
@@ -1005,11 +1265,11 @@ std::string Camera::getUSBDeviceList(void)
 	DEB_TRACE() << "********** Inside of Camera::getUSBDeviceList ***********";
 
 	std::string message;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetUSBDeviceList";
-	m_xpad->sendWait(cmd.str(), message);
+	m_xpad->sendWait(cmd, message);
 
 	DEB_TRACE() << "List of USB devices connected: " << message;
 
@@ -1025,11 +1285,11 @@ int Camera::setUSBDevice(unsigned short device)
 	DEB_TRACE() << "********** Inside of Camera::setUSBDevice ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "SetUSBDevice " << device;
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	if (!ret)
 		DEB_TRACE() << "Setting active USB device to " << device;
@@ -1047,11 +1307,11 @@ DEB_MEMBER_FUNCT();
 DEB_TRACE() << "********** Inside of Camera::DefineDetectorModel ***********";
 
 int ret;
-std::stringstream cmd;
+CommandBuilder cmd;
 
-cmd.str(std::string());
+cmd.clear();
 cmd << "DefineDetectorModel " << model;
-m_xpad->sendWait(cmd.str(), ret);
+m_xpad->sendWait(cmd, ret);
 
 if(!ret)
 DEB_TRACE() << "Defining detector model to " << model;
@@ -1070,24 +1330,58 @@ int Camera::setModuleMask(unsigned int moduleMask)
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::setModuleMask ***********";
 
+	// the modules of the detector, a region is taken out of them
+	m_detector_module_mask = moduleMask;
+	m_module_roi.setRegion(0, 0, 0, 0);
+	m_config_l_uploaded.clear();
+
+	int ret = applyModuleMask(moduleMask);
+	updateImageSize();
+
+	DEB_TRACE() << "********** Outside of Camera::setModuleMask ***********";
+
+	return ret;
+
+}
+
+int Camera::applyModuleMask(unsigned int moduleMask)
+{
+	DEB_MEMBER_FUNCT();
+
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
 	m_module_mask = moduleMask;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "SetModuleMask " << moduleMask;
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	if (!ret)
 		DEB_TRACE() << "Setting module mask to " << moduleMask;
 	else
 		throw LIMA_HW_EXC(Error, "Setting module mask FAILED!");
 
-	DEB_TRACE() << "********** Outside of Camera::setModuleMask ***********";
+	// one stream per enabled module
+	if (m_module_readout_flag)
+		m_module_readout.connect(m_host_name, m_port, m_module_mask);
 
 	return ret;
+}
+
+void Camera::updateImageSize()
+{
+	DEB_MEMBER_FUNCT();
+
+	Size size;
+	getImageSize(size);
+	if (size.getWidth() == m_image_size.getWidth() && size.getHeight() == m_image_size.getHeight())
+		return;
 
+	m_image_size = size;
+	ImageType pixel_depth;
+	getImageType(pixel_depth);
+	maxImageSizeChanged(m_image_size, pixel_depth);
 }
 
 void Camera::getModuleMask()
@@ -1096,11 +1390,11 @@ void Camera::getModuleMask()
 	DEB_TRACE() << "********** Inside of Camera::getModuleMask ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetModuleMask";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	m_module_mask = ret;
 
@@ -1113,11 +1407,11 @@ void Camera::getModuleNumber()
 	DEB_TRACE() << "********** Inside of Camera::getModuleNumber ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetModuleNumber";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	m_module_number = ret;
 
@@ -1130,11 +1424,11 @@ void Camera::getChipMask()
 	DEB_TRACE() << "********** Inside of Camera::getChipMask ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetChipMask";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	m_chip_mask = ret;
 
@@ -1147,11 +1441,11 @@ void Camera::getChipNumber()
 	DEB_TRACE() << "********** Inside of Camera::getChipNumber ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetChipNumber";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	m_chip_number = ret;
 
@@ -1164,11 +1458,11 @@ int Camera::askReady()
 	DEB_TRACE() << "********** Inside of Camera::askReady ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "AskReady";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	if (!ret)
 	{
@@ -1188,7 +1482,7 @@ int Camera::digitalTest(unsigned short mode)
 	DEB_TRACE() << "********** Inside of Camera::digitalTest ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
 	std::string mode_name;
 
@@ -1203,19 +1497,19 @@ int Camera::digitalTest(unsigned short mode)
 		default: mode_name = "strip";
 	}
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "SetGeometricalCorrectionFlag " << "false";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "DigitalTest " << mode_name.c_str();
-	m_xpad->sendNoWait(cmd.str());
+	m_xpad->sendNoWait(cmd);
 
 	int rows = IMG_LINE * m_module_number;
 	int columns = IMG_COLUMN * m_chip_number;
 
 	uint32_t buff[rows * columns];
-	readFrameExpose(buff, 1);
+	readFrameExpose(buff, 1, sizeof(buff));
 
 	uint32_t val;
 	//Saving Digital Test image to disk
@@ -1253,12 +1547,12 @@ int Camera::loadConfigGFromFile(char *fpath)
 
 	DEB_TRACE() << "LoadConfigGFromFile : " << fpath;
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "LoadConfigGFromFile ";
 
-	m_xpad->sendNoWait(cmd.str());
+	m_xpad->sendNoWait(cmd);
 
 	ret = m_xpad->sendParametersFile(fpath);
 
@@ -1279,111 +1573,117 @@ int Camera::saveConfigGToFile(char *fpath)
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::saveConfigGToFile ***********";
 	DEB_TRACE() << "saveConfigGToFile : " << fpath;
-	int ret;
-	unsigned short  regid;
-
-	std::stringstream cmd;
+	int ret = -1;
 
 	//File is being open to be writen
 	std::ofstream file(fpath, std::ios::out);
 	if (file.is_open())
 	{
+		ret = readConfigGText(file);
+		file.close();
+	}
+
+	if (ret == 0)
+		DEB_TRACE() << "Global configuration saved to file SUCCESFULLY";
+	else if (ret == 1)
+		DEB_TRACE() << "Global configuration saved to file was ABORTED";
+	else
+		throw LIMA_HW_EXC(Error, "Saving global configuration to file FAILED!");
+
+
+	DEB_TRACE() << "********** Outside of Camera::saveConfigGToFile ***********";
+
+	return ret;
+}
+
+int Camera::readConfigGText(std::ostream& file)
+{
+	DEB_MEMBER_FUNCT();
+	int ret = -1;
+	unsigned short  regid;
 
-		std::string          retString;
+	CommandBuilder cmd;
+	std::string          retString;
 
-		//All registers are being read
-		for (unsigned short registro = 0; registro < 7; registro++)
+	//All registers are being read
+	for (unsigned short registro = 0; registro < 7; registro++)
+	{
+		switch (registro)
 		{
-			switch (registro)
-			{
-				case 0: regid = AMPTP;
-					break;
-				case 1: regid = IMFP;
-					break;
-				case 2: regid = IOTA;
-					break;
-				case 3: regid = IPRE;
-					break;
-				case 4: regid = ITHL;
-					break;
-				case 5: regid = ITUNE;
-					break;
-				case 6: regid = IBUFF;
-			}
+			case 0: regid = AMPTP;
+				break;
+			case 1: regid = IMFP;
+				break;
+			case 2: regid = IOTA;
+				break;
+			case 3: regid = IPRE;
+				break;
+			case 4: regid = ITHL;
+				break;
+			case 5: regid = ITUNE;
+				break;
+			case 6: regid = IBUFF;
+		}
 
-			std::string register_name;
-			switch (regid)
-			{
-				case 31: register_name = "AMPTP";
-					break;
-				case 59: register_name = "IMFP";
-					break;
-				case 60: register_name = "IOTA";
-					break;
-				case 61: register_name = "IPRE";
-					break;
-				case 62: register_name = "ITHL";
-					break;
-				case 63: register_name = "ITUNE";
-					break;
-				case 64: register_name = "IBUFF";
-					break;
-				default: register_name = "ITHL";
-			}
+		std::string register_name;
+		switch (regid)
+		{
+			case 31: register_name = "AMPTP";
+				break;
+			case 59: register_name = "IMFP";
+				break;
+			case 60: register_name = "IOTA";
+				break;
+			case 61: register_name = "IPRE";
+				break;
+			case 62: register_name = "ITHL";
+				break;
+			case 63: register_name = "ITUNE";
+				break;
+			case 64: register_name = "IBUFF";
+				break;
+			default: register_name = "ITHL";
+		}
 
-			//Each register value is read from the detector
-			cmd.str(std::string());
-			cmd << "ReadConfigG " << register_name;
-			m_xpad->sendWait(cmd.str(), retString);
+		//Each register value is read from the detector
+		cmd.clear();
+		cmd << "ReadConfigG " << register_name;
+		m_xpad->sendWait(cmd, retString);
 
-			std::stringstream stream(retString.c_str());
-			int length = retString.length();
+		std::stringstream stream(retString.c_str());
+		int length = retString.length();
 
-			unsigned mdMask = 1;
+		unsigned mdMask = 1;
 
-			while (mdMask <= m_module_mask)
+		while (mdMask <= m_module_mask)
+		{
+			if (length > 1)
 			{
-				if (length > 1)
+				//Register values are being stored in the file
+				file << mdMask << " ";
+				file << regid << " ";
+				for (int count = 0; count < 8; count++)
 				{
-					//Register values are being stored in the file
-					file << mdMask << " ";
-					file << regid << " ";
-					for (int count = 0; count < 8; count++)
-					{
-						stream >> retString;
-						if (count > 0)
-							file << retString << " ";
-					}
-					file << std::endl;
-					mdMask = mdMask << 1;
-					ret = 0;
-					if (mdMask <= m_module_mask)
-					{
-						stream >> retString;
-					}
-
+					stream >> retString;
+					if (count > 0)
+						file << retString << " ";
 				}
-				else
+				file << std::endl;
+				mdMask = mdMask << 1;
+				ret = 0;
+				if (mdMask <= m_module_mask)
 				{
-					ret = -1;
-					file.close();
-					exit();
+					stream >> retString;
 				}
+
+			}
+			else
+			{
+				exit();
+				return -1;
 			}
 		}
-		file.close();
 	}
-
-	if (ret == 0)
-		DEB_TRACE() << "Global configuration saved to file SUCCESFULLY";
-	else if (ret == 1)
-		DEB_TRACE() << "Global configuration saved to file was ABORTED";
-	else
-		throw LIMA_HW_EXC(Error, "Saving global configuration to file FAILED!");
-
-
-	DEB_TRACE() << "********** Outside of Camera::saveConfigGToFile ***********";
-
 	return ret;
 }
 
@@ -1393,14 +1693,14 @@ int Camera::loadConfigG(char *regID, unsigned short value)
 	DEB_TRACE() << "********** Inside of Camera::loadConfigG ***********";
 
 	std::string ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
 	std::string register_name;
 	register_name.append(regID);
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "LoadConfigG " << register_name.c_str() << " " << value ;
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	DEB_TRACE() << "********** Outside of Camera::loadConfigG ***********";
 
@@ -1422,7 +1722,7 @@ int Camera::readConfigG(char *regID)
 	DEB_TRACE() << "********** Inside of Camera::readConfigG ***********";
 
 	std::string message;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	int reg;
 
 	unsigned short *ret = new unsigned short[8];
@@ -1447,9 +1747,9 @@ int Camera::readConfigG(char *regID)
 	else
 		reg = 62;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "ReadConfigG " << register_name;
-	m_xpad->sendWait(cmd.str(), message);
+	m_xpad->sendWait(cmd, message);
 
 	if (message.length() > 1)
 	{
@@ -1573,14 +1873,33 @@ int Camera::loadConfigLFromFile(char *fpath)
 	DEB_TRACE() << "********** Inside of Camera::loadConfigLFromFile ***********";
 	DEB_TRACE() << "LoadConfigLFromFile : " << fpath;
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
+
+	CalibrationFile config;
+	bool parsed = true;
+	try
+	{
+		config.loadText(CalibrationFile::Local, fpath);
+	}
+	catch (Exception& e)
+	{
+		DEB_WARNING() << "Local configuration sent whole, it cannot be compared: " << e.getErrMsg();
+		parsed = false;
+	}
+
+	if (parsed)
+		ret = uploadConfigL(config);
+	else
+	{
+		m_config_l_uploaded.clear();
 
-	cmd.str(std::string());
-	cmd << "LoadConfigLFromFile ";
+		cmd.clear();
+		cmd << "LoadConfigLFromFile ";
 
-	m_xpad->sendNoWait(cmd.str());
+		m_xpad->sendNoWait(cmd);
 
-	ret = m_xpad->sendParametersFile(fpath);
+		ret = m_xpad->sendParametersFile(fpath);
+	}
 
 	if (ret == 0)
 		DEB_TRACE() << "Local configuration loaded from file SUCCESFULLY";
@@ -1601,12 +1920,12 @@ int Camera::saveConfigLToFile(char *fpath)
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::saveConfigLToFile ***********";
 
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	//std::string str;
 	int ret;
 
 	cmd << "ReadConfigL";
-	m_xpad->sendNoWait(cmd.str());
+	m_xpad->sendNoWait(cmd);
 
 	if (!m_xpad->receiveParametersFile(fpath))
 		ret = 0;
@@ -1655,11 +1974,15 @@ void Camera::setGeometricalCorrectionFlag(unsigned short flag)
 	DEB_TRACE() << "Camera::setGeometricalCorrectionFlag - " << DEB_VAR1(flag);
 	DEB_PARAM() << DEB_VAR1(flag);
 
+	if (flag && m_module_readout_flag)
+		THROW_HW_ERROR(Error) << "Geometrical correction adds lines between the module bands, "
+							  << "disable the per-module readout first";
+
 	m_geometrical_correction_flag = flag;
 
 	int ret;
 	std::string message, flag_state;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	Size size;
 
 	switch (flag)
@@ -1669,9 +1992,9 @@ void Camera::setGeometricalCorrectionFlag(unsigned short flag)
 		default: flag_state = "true";
 	}
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "SetGeometricalCorrectionFlag " << flag_state.c_str();
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	if ( ret == 0)
 		getImageSize(size);
@@ -1737,7 +2060,7 @@ void Camera::setNoisyPixelCorrectionFlag(unsigned short flag)
 
 	int ret;
 	std::string message, flag_state;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	Size size;
 
 	switch (flag)
@@ -1748,9 +2071,9 @@ void Camera::setNoisyPixelCorrectionFlag(unsigned short flag)
 			break;
 	}
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "SetNoisyPixelCorrectionFlag " << flag_state.c_str();
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 }
 
 unsigned short Camera::getNoisyPixelCorrectionFlag()
@@ -1759,11 +2082,11 @@ unsigned short Camera::getNoisyPixelCorrectionFlag()
 
 	std::string ret;
 	std::string message;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetNoisyPixelCorrectionFlag ";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	if (ret.compare("false"))
 		m_noisy_pixel_correction_flag = 1;
@@ -1783,7 +2106,7 @@ void Camera::setDeadPixelCorrectionFlag(unsigned short flag)
 
 	int ret;
 	std::string message, flag_state;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
 	switch (flag)
 	{
@@ -1793,9 +2116,9 @@ void Camera::setDeadPixelCorrectionFlag(unsigned short flag)
 			break;
 	}
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "SetDeadPixelCorrectionFlag " << flag_state.c_str();
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 }
 
 unsigned short Camera::getDeadPixelCorrectionFlag()
@@ -1804,11 +2127,11 @@ unsigned short Camera::getDeadPixelCorrectionFlag()
 
 	std::string ret;
 	std::string message;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetDeadPixelCorrectionFlag ";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	if (ret.compare("false"))
 		m_dead_pixel_correction_flag = 1;
@@ -1904,17 +2227,10 @@ int Camera::calibrationOTN(unsigned short calibrationConfiguration)
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::calibrationOTN ***********";
 
-	waitAcqEnd();
-
-	m_wait_flag = false;
-	m_quit = false;
+	CommandBuilder cmd;
 	m_calibration_configuration = calibrationConfiguration;
-	m_process_id = 1;
-	//m_process_param1 = calibrationConfiguration;
-	m_cond.broadcast();
-
-	while (!m_thread_running)
-		m_cond.wait();
+	cmd <<  "CalibrationOTN " << m_calibration_configuration;
+	startCalibrationJob(cmd.str());
 
 	DEB_TRACE() << "********** Outside of Camera::calibrationOTN ***********";
 
@@ -1927,17 +2243,10 @@ int Camera::calibrationOTNPulse(unsigned short calibrationConfiguration)
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::calibrationOTNPulse ***********";
 
-	waitAcqEnd();
-
-	m_wait_flag = false;
-	m_quit = false;
+	CommandBuilder cmd;
 	m_calibration_configuration = calibrationConfiguration;
-	m_process_id = 2;
-	//m_process_param1 = calibrationConfiguration;
-	m_cond.broadcast();
-
-	while (!m_thread_running)
-		m_cond.wait();
+	cmd <<  "CalibrationOTNPulse " << m_calibration_configuration;
+	startCalibrationJob(cmd.str());
 
 	DEB_TRACE() << "********** Outside of Camera::calibrationOTNPulse ***********";
 
@@ -1951,18 +2260,12 @@ int Camera::calibrationBEAM(unsigned int time, unsigned int ITHLmax, unsigned sh
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::calibrationBEAM ***********";
 
-	waitAcqEnd();
-
-	m_wait_flag = false;
-	m_quit = false;
+	CommandBuilder cmd;
 	m_time = time;
 	m_ITHL_max = ITHLmax;
 	m_calibration_configuration = calibrationConfiguration;
-	m_process_id = 3;
-	m_cond.broadcast();
-
-	while (!m_thread_running)
-		m_cond.wait();
+	cmd <<  "CalibrationBEAM " << m_time << " " << m_ITHL_max << " " << m_calibration_configuration;
+	startCalibrationJob(cmd.str());
 
 	DEB_TRACE() << "********** Outside of Camera::calibrationBEAM ***********";
 
@@ -2022,13 +2325,23 @@ void Camera::abortCurrentProcess()
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::abortCurrentProcess ***********";
 
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
+	m_calibration_job.cancel();
+
+	AutoMutex aLock(m_cond.mutex());
 	m_quit = true;
+	// wake up the acquisition thread blocked on a frame before telling the server
+	if (m_frame_streaming)
+	{
+		m_acq_aborted = true;
+		m_abort_event.trigger();
+	}
 	m_cond.broadcast();
+	aLock.unlock();
 
 	cmd <<  "AbortCurrentProcess";
-	m_xpad_alt->sendNoWait(cmd.str());
+	m_xpad_alt->sendNoWait(cmd);
 
 	DEB_TRACE() << "********** Outside of Camera::abortCurrentProcess ***********";
 }
@@ -2038,11 +2351,11 @@ int Camera::increaseBurstNumber()
 
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::decreaseBurstNumber ***********";
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	int ret;
 
 	cmd << "IncreaseBurstNumber";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	DEB_TRACE() << "********** Outside of Camera::decreaseBurstNumber ***********";
 
@@ -2054,11 +2367,11 @@ int Camera::decreaseBurstNumber()
 
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::decreaseBurstNumber ***********";
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	int ret;
 
 	cmd << "DecreaseBurstNumber";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	DEB_TRACE() << "********** Outside of Camera::decreaseBurstNumber ***********";
 
@@ -2070,11 +2383,11 @@ int Camera::getBurstNumber()
 
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::getBurstNumber ***********";
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	int ret;
 
 	cmd << "GetBurstNumber";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	m_burst_number = ret;
 
@@ -2088,11 +2401,11 @@ int Camera::resetBurstNumber()
 
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::resetBurstNumber ***********";
-	std::stringstream cmd;
+	CommandBuilder cmd;
 	int ret;
 
 	cmd << "ResetBurstNumber";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	DEB_TRACE() << "********** Outside of Camera::resetBurstNumber ***********";
 
@@ -2110,10 +2423,10 @@ void Camera::exit()
 
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "********** Inside of Camera::exit ***********";
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
 	cmd << "Exit";
-	m_xpad->sendNoWait(cmd.str());
+	m_xpad->sendNoWait(cmd);
 
 	DEB_TRACE() << "********** Outside of Camera::exit ***********";
 }
@@ -2130,11 +2443,11 @@ int Camera::createWhiteImage(char* fileName)
 	DEB_TRACE() << "********** Inside of Camera::createWhiteImage ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "CreateWhiteImage " << fileName;
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	DEB_TRACE() << "********** Outside of Camera::createWhiteImage ***********";
 
@@ -2147,11 +2460,14 @@ int Camera::deleteWhiteImage(char* fileName)
 	DEB_TRACE() << "********** Inside of Camera::deleteWhiteImage ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "DeleteWhiteImage " << fileName;
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
+
+	if (ret == 0 && m_white_image == fileName)
+		m_white_image.clear();
 
 	DEB_TRACE() << "********** Outside of Camera::deleteWhiteImage ***********";
 
@@ -2164,11 +2480,15 @@ int Camera::setWhiteImage(char* fileName)
 	DEB_TRACE() << "********** Inside of Camera::setWhiteImage ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "SetWhiteImage " << fileName;
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
+
+	// replayed if the connection has to be restored
+	if (ret == 0)
+		m_white_image = fileName;
 
 	DEB_TRACE() << "********** Outside of Camera::setWhiteImage ***********";
 
@@ -2181,11 +2501,11 @@ std::string Camera::getWhiteImagesInDir()
 	DEB_TRACE() << "********** Inside of Camera::getWhiteImagesInDir ***********";
 
 	std::string message;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "GetWhiteImagesInDir";
-	m_xpad->sendWait(cmd.str(), message);
+	m_xpad->sendWait(cmd, message);
 
 	DEB_TRACE() << "List of White Images In DIR: " << message;
 
@@ -2204,7 +2524,7 @@ int Camera::setDebugMode(unsigned short flag)
 
 	int ret;
 	std::string flag_state;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
 	switch (flag)
 	{
@@ -2214,9 +2534,9 @@ int Camera::setDebugMode(unsigned short flag)
 			break;
 	}
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "SetDebugMode " << flag_state.c_str();
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	DEB_TRACE() << "********** Outside of Camera::setDebugMode ***********";
 
@@ -2230,7 +2550,7 @@ int Camera::showTimers(unsigned short flag)
 
 	int ret;
 	std::string flag_state;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
 	switch (flag)
 	{
@@ -2240,9 +2560,9 @@ int Camera::showTimers(unsigned short flag)
 			break;
 	}
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "ShowTimers " << flag_state.c_str();
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	DEB_TRACE() << "********** Outside of Camera::showTimers ***********";
 
@@ -2255,13 +2575,1397 @@ int Camera::createDeadNoisyMask()
 	DEB_TRACE() << "********** Inside of Camera::showTimers ***********";
 
 	int ret;
-	std::stringstream cmd;
+	CommandBuilder cmd;
 
-	cmd.str(std::string());
+	cmd.clear();
 	cmd << "CreateDeadNoisyMask ";
-	m_xpad->sendWait(cmd.str(), ret);
+	m_xpad->sendWait(cmd, ret);
 
 	DEB_TRACE() << "********** Outside of Camera::showTimers ***********";
 
 	return ret;
 }
+
+void Camera::setProcessingThreads(unsigned int nb_threads)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(nb_threads);
+
+	m_pool.setNbWorkers(nb_threads);
+}
+
+unsigned int Camera::getProcessingThreads()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_pool.getNbWorkers();
+}
+
+void Camera::setLocalCorrectionFlag(unsigned short flag)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "Camera::setLocalCorrectionFlag - " << DEB_VAR1(flag);
+	DEB_PARAM() << DEB_VAR1(flag);
+
+	// the server only has to ship raw data when the plugin corrects frames,
+	// its own flags are given back when the plugin stops correcting
+	if (flag && !m_local_correction_flag)
+	{
+		m_server_noisy_pixel_flag = getNoisyPixelCorrectionFlag();
+		m_server_dead_pixel_flag = getDeadPixelCorrectionFlag();
+		setNoisyPixelCorrectionFlag(0);
+		setDeadPixelCorrectionFlag(0);
+	}
+	else if (!flag && m_local_correction_flag)
+	{
+		setNoisyPixelCorrectionFlag(m_server_noisy_pixel_flag);
+		setDeadPixelCorrectionFlag(m_server_dead_pixel_flag);
+	}
+
+	m_local_correction_flag = flag;
+}
+
+unsigned short Camera::getLocalCorrectionFlag()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_local_correction_flag;
+}
+
+int Camera::loadLocalFlatField(char *fpath)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::loadLocalFlatField ***********";
+
+	m_correction.loadFlatField(fpath, m_image_size);
+
+	DEB_TRACE() << "********** Outside of Camera::loadLocalFlatField ***********";
+
+	return 0;
+}
+
+int Camera::loadLocalDeadPixelMask(char *fpath)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::loadLocalDeadPixelMask ***********";
+
+	m_correction.loadDeadPixelMask(fpath, m_image_size);
+
+	DEB_TRACE() << "********** Outside of Camera::loadLocalDeadPixelMask ***********";
+
+	return 0;
+}
+
+int Camera::loadLocalNoisyPixelMask(char *fpath)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::loadLocalNoisyPixelMask ***********";
+
+	m_correction.loadNoisyPixelMask(fpath, m_image_size);
+
+	DEB_TRACE() << "********** Outside of Camera::loadLocalNoisyPixelMask ***********";
+
+	return 0;
+}
+
+void Camera::clearLocalCorrections()
+{
+	DEB_MEMBER_FUNCT();
+
+	m_correction.clearFlatField();
+	m_correction.clearPixelMasks();
+}
+
+void Camera::setLocalBadPixelMode(unsigned short mode)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(mode);
+
+	switch (mode)
+	{
+		case 0: m_correction.setBadPixelMode(Correction::Zero);
+			break;
+		case 1: m_correction.setBadPixelMode(Correction::Interpolate);
+			break;
+		default:
+			DEB_ERROR() << "Error: Bad pixel mode unsupported: only 0 (zero) and 1 (interpolate)";
+			throw LIMA_HW_EXC(Error, "Bad pixel mode unsupported: only 0 (zero) and 1 (interpolate)");
+	}
+}
+
+unsigned short Camera::getLocalBadPixelMode()
+{
+	DEB_MEMBER_FUNCT();
+
+	return (m_correction.getBadPixelMode() == Correction::Interpolate) ? 1 : 0;
+}
+
+void Camera::setLocalGeometricalCorrectionFlag(unsigned short flag)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "Camera::setLocalGeometricalCorrectionFlag - " << DEB_VAR1(flag);
+	DEB_PARAM() << DEB_VAR1(flag);
+
+	// the local remap replaces the server one, which is given back when the
+	// plugin stops remapping; the image size is updated there, from the
+	// local flag, so the flag is only kept once the server agreed
+	unsigned short local_flag = m_local_geometry_flag;
+	if (flag && !local_flag)
+	{
+		unsigned short server_flag = m_geometrical_correction_flag;
+		m_local_geometry_flag = flag;
+		try
+		{
+			setGeometricalCorrectionFlag(0);
+		}
+		catch (Exception& e)
+		{
+			m_local_geometry_flag = local_flag;
+			throw;
+		}
+		m_server_geometry_flag = server_flag;
+	}
+	else if (!flag && local_flag)
+	{
+		m_local_geometry_flag = 0;
+		try
+		{
+			setGeometricalCorrectionFlag(m_server_geometry_flag);
+		}
+		catch (Exception& e)
+		{
+			m_local_geometry_flag = local_flag;
+			throw;
+		}
+	}
+	else
+		m_local_geometry_flag = flag;
+}
+
+unsigned short Camera::getLocalGeometricalCorrectionFlag()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_local_geometry_flag;
+}
+
+void Camera::setLocalGeometryGaps(unsigned int chip_gap, unsigned int module_gap)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(chip_gap, module_gap);
+
+	m_geometry.setGaps(chip_gap, module_gap);
+
+	if (m_local_geometry_flag)
+		setGeometricalCorrectionFlag(0);
+}
+
+void Camera::setLocalGeometryBlockLines(unsigned int block_lines)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(block_lines);
+
+	m_geometry.setBlockLines(block_lines);
+}
+
+double Camera::getLocalGeometryRemapTime()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_geometry.getRemapTime();
+}
+
+void Camera::setSparseFlag(unsigned short flag)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "Camera::setSparseFlag - " << DEB_VAR1(flag);
+	DEB_PARAM() << DEB_VAR1(flag);
+
+	m_sparse_flag = flag;
+}
+
+unsigned short Camera::getSparseFlag()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_sparse_flag;
+}
+
+void Camera::setSparseOccupancyThreshold(double occupancy)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(occupancy);
+
+	m_sparse_encoder.setThreshold(occupancy);
+}
+
+double Camera::getSparseOccupancyThreshold()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_sparse_encoder.getThreshold();
+}
+
+void Camera::setSparseFile(char *fpath)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(fpath);
+
+	m_sparse_file_path = fpath ? fpath : "";
+}
+
+void Camera::registerSparseFrameCallback(SparseFrameCallback& cb)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_sparse_lock);
+	m_sparse_cbs.push_back(&cb);
+}
+
+void Camera::unregisterSparseFrameCallback(SparseFrameCallback& cb)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_sparse_lock);
+	std::vector<SparseFrameCallback*>::iterator i;
+	i = std::find(m_sparse_cbs.begin(), m_sparse_cbs.end(), &cb);
+	if (i != m_sparse_cbs.end())
+		m_sparse_cbs.erase(i);
+}
+
+void Camera::getSparseStatistics(int& nb_sparse, int& nb_dense)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_sparse_lock);
+	nb_sparse = m_sparse_nb_frames;
+	nb_dense = m_dense_nb_frames;
+}
+
+void Camera::setTransferCompression(unsigned short codec)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::setTransferCompression ***********";
+	DEB_PARAM() << DEB_VAR1(codec);
+
+	if (codec != FrameCodec::Raw && codec != FrameCodec::BitPack)
+		THROW_HW_ERROR(InvalidValue) << "Unknown transfer compression " << codec;
+
+	int ret;
+	CommandBuilder cmd;
+
+	cmd << "SetTransferCompression " << codec;
+	m_xpad->sendWait(cmd, ret);
+
+	// an older server answers with an error, keep the raw transfer then
+	if (ret == 0)
+	{
+		m_transfer_compression = codec;
+		DEB_TRACE() << "Transfer compression set to " << codec;
+	}
+	else
+	{
+		m_transfer_compression = FrameCodec::Raw;
+		DEB_WARNING() << "Server refused transfer compression " << codec << ", frames are sent raw";
+	}
+	m_xpad->setFrameCodec(m_transfer_compression ? &m_codec : NULL);
+	m_module_readout.setFrameCodec(m_transfer_compression ? &m_codec : NULL);
+}
+
+unsigned short Camera::getTransferCompression()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_transfer_compression;
+}
+
+void Camera::setModuleReadoutFlag(unsigned short flag)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::setModuleReadoutFlag ***********";
+	DEB_PARAM() << DEB_VAR1(flag);
+
+	if (flag == m_module_readout_flag)
+		return;
+	// bands are cut by module, the gap lines of the corrected image would shift them
+	if (flag && m_geometrical_correction_flag)
+		THROW_HW_ERROR(Error) << "Per-module readout needs raw frames, disable the server geometrical "
+							  << "correction or use the local one";
+
+	int ret;
+	CommandBuilder cmd;
+
+	if (flag)
+	{
+		// streams first, so that the server knows where to send the module data
+		m_module_readout.connect(m_host_name, m_port, m_module_mask);
+		m_module_readout.setFrameCodec(m_transfer_compression ? &m_codec : NULL);
+		m_module_readout.setAbortEvent(&m_abort_event);
+
+		cmd << "SetModuleReadoutFlag true";
+		m_xpad->sendWait(cmd, ret);
+		if (ret != 0)
+		{
+			m_module_readout.disconnect();
+			THROW_HW_ERROR(Error) << "Server refused the per-module readout";
+		}
+	}
+	else
+	{
+		cmd << "SetModuleReadoutFlag false";
+		m_xpad->sendWait(cmd, ret);
+		m_module_readout.disconnect();
+	}
+	m_module_readout_flag = flag;
+
+	DEB_TRACE() << "********** Outside of Camera::setModuleReadoutFlag ***********";
+}
+
+unsigned short Camera::getModuleReadoutFlag()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_module_readout_flag;
+}
+
+double Camera::getModuleReadoutSkew()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_module_readout.getLastFrameSkew();
+}
+
+void Camera::setBufferHugePageMode(unsigned short mode)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(mode);
+
+	if (mode > FramePool::HugeTLB)
+		THROW_HW_ERROR(InvalidValue) << "Unknown hugepage mode " << mode;
+
+	FramePool& pool = m_buffer_ctrl_obj.getFramePool();
+	pool.setHugePageMode(FramePool::HugePageMode(mode));
+
+	// remap at the next allocation if no buffer is in use
+	int nb_buffers;
+	pool.getNbBuffers(nb_buffers);
+	if (!nb_buffers)
+		pool.freeMemory();
+}
+
+unsigned short Camera::getBufferHugePageMode()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_buffer_ctrl_obj.getFramePool().getHugePageMode();
+}
+
+double Camera::getBufferPrefaultTime()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_buffer_ctrl_obj.getFramePool().getPrefaultTime();
+}
+
+void Camera::setCpuAffinity(std::string cpu_list)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::setCpuAffinity ***********";
+	DEB_PARAM() << DEB_VAR1(cpu_list);
+
+	AutoMutex aLock(m_cond.mutex());
+	m_cpu_affinity.setCpus(cpu_list);
+	++m_cpu_affinity_generation;
+	CpuAffinity affinity = m_cpu_affinity;
+	aLock.unlock();
+
+	// threads pick it up when they are woken up for the next job
+	m_pool.setCpuAffinity(affinity);
+	m_module_readout.setCpuAffinity(affinity);
+
+	// frame buffers follow the receiving threads
+	int node = affinity.getNumaNode();
+	DEB_TRACE() << "Frame buffers on NUMA node " << node;
+	m_buffer_ctrl_obj.getFramePool().setNumaNode(node);
+}
+
+void Camera::getCpuAffinity(std::string& cpu_list)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	cpu_list = m_cpu_affinity.getCpus();
+}
+
+void Camera::setRealtimePriority(int priority)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(priority);
+
+	AutoMutex aLock(m_cond.mutex());
+	m_cpu_affinity.setRealtimePriority(priority);
+	++m_cpu_affinity_generation;
+	CpuAffinity affinity = m_cpu_affinity;
+	aLock.unlock();
+
+	m_pool.setCpuAffinity(affinity);
+	m_module_readout.setCpuAffinity(affinity);
+}
+
+int Camera::getRealtimePriority()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	return m_cpu_affinity.getRealtimePriority();
+}
+
+void Camera::getThreadMigrations(int& acq_thread, int& workers)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	acq_thread = m_acq_migrations.getNbMigrations();
+	aLock.unlock();
+	workers = m_pool.getNbMigrations();
+}
+
+CommandFuture Camera::sendCommandAsync(std::string cmd, int return_type, CommandCallback* cb)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(cmd, return_type);
+
+	if (return_type < CommandQueue::NoReturn || return_type > CommandQueue::StringReturn)
+		THROW_HW_ERROR(InvalidValue) << "Invalid command return type " << return_type;
+
+	// the queue gets its own server connection on first use
+	AutoMutex aLock(m_command_lock);
+	if (!m_command_queue.isConnected())
+		m_command_queue.connect(m_host_name, m_port);
+	aLock.unlock();
+
+	return m_command_queue.submit(cmd, CommandQueue::ReturnType(return_type), cb);
+}
+
+CommandFuture Camera::getBurstNumberAsync(CommandCallback* cb)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::getBurstNumberAsync ***********";
+
+	return sendCommandAsync("GetBurstNumber", CommandQueue::IntReturn, cb);
+}
+
+CommandFuture Camera::createWhiteImageAsync(std::string fileName, CommandCallback* cb)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::createWhiteImageAsync ***********";
+
+	CommandBuilder cmd;
+	cmd << "CreateWhiteImage " << fileName;
+	return sendCommandAsync(cmd.str(), CommandQueue::IntReturn, cb);
+}
+
+CommandFuture Camera::deleteWhiteImageAsync(std::string fileName, CommandCallback* cb)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::deleteWhiteImageAsync ***********";
+
+	CommandBuilder cmd;
+	cmd << "DeleteWhiteImage " << fileName;
+	return sendCommandAsync(cmd.str(), CommandQueue::IntReturn, cb);
+}
+
+CommandFuture Camera::setWhiteImageAsync(std::string fileName, CommandCallback* cb)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::setWhiteImageAsync ***********";
+
+	CommandBuilder cmd;
+	cmd << "SetWhiteImage " << fileName;
+	return sendCommandAsync(cmd.str(), CommandQueue::IntReturn, cb);
+}
+
+CommandFuture Camera::getWhiteImagesInDirAsync(CommandCallback* cb)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::getWhiteImagesInDirAsync ***********";
+
+	return sendCommandAsync("GetWhiteImagesInDir", CommandQueue::StringReturn, cb);
+}
+
+int Camera::getNbPendingCommands()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_command_queue.getNbPending();
+}
+
+double Camera::getAbortLatency()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_abort_event.getUnblockLatency();
+}
+
+void Camera::exposureParametersCommand(CommandBuilder& cmd)
+{
+	exposureParametersCommand(cmd, m_nb_frames, m_xpad_trigger_mode, m_image_transfer_flag);
+}
+
+void Camera::exposureParametersCommand(CommandBuilder& cmd, int nb_frames, unsigned int trigger_mode,
+									   unsigned short transfer_flag)
+{
+	cmd.clear();
+	cmd	<< "SetExposureParameters "
+	 << nb_frames << " "
+	 << m_exp_time_usec << " "
+	 << m_lat_time_usec << " "
+	 << m_overflow_time << " "
+	 << trigger_mode << " "
+	 << m_xpad_output_signal_mode << " "
+	 << m_geometrical_correction_flag << " "
+	 << (m_local_correction_flag ? 0 : m_flat_field_correction_flag) << " "
+	 << transfer_flag << " "
+	 << m_image_file_format << " "
+	 << m_acquisition_mode << " "
+	 << m_stack_images << " "
+	 << "/opt/imXPAD/tmp_corrected/";
+}
+
+void Camera::getSessionCommands(XpadClient *client, std::vector<std::string>& cmds)
+{
+	DEB_MEMBER_FUNCT();
+
+	cmds.clear();
+	cmds.push_back("Init");
+	// the alternate connection only carries aborts
+	if (client == m_xpad_alt)
+		return;
+
+	CommandBuilder cmd;
+	if (m_module_mask != 0)
+	{
+		cmd << "SetModuleMask " << m_module_mask;
+		cmds.push_back(cmd.str());
+	}
+	cmds.push_back(m_geometrical_correction_flag ? "SetGeometricalCorrectionFlag true" : "SetGeometricalCorrectionFlag false");
+	if (!m_white_image.empty())
+		cmds.push_back("SetWhiteImage " + m_white_image);
+	if (m_transfer_compression != FrameCodec::Raw)
+	{
+		cmd.clear();
+		cmd << "SetTransferCompression " << m_transfer_compression;
+		cmds.push_back(cmd.str());
+	}
+	if (m_module_readout_flag)
+		cmds.push_back("SetModuleReadoutFlag true");
+	exposureParametersCommand(cmd);
+	cmds.push_back(cmd.str());
+}
+
+void Camera::setAutoReconnect(unsigned short nb_attempts)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::setAutoReconnect ***********";
+	DEB_PARAM() << DEB_VAR1(nb_attempts);
+
+	m_auto_reconnect = nb_attempts;
+	m_xpad->setAutoReconnect(nb_attempts);
+	m_xpad_alt->setAutoReconnect(nb_attempts);
+}
+
+unsigned short Camera::getAutoReconnect()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_auto_reconnect;
+}
+
+void Camera::getReconnectStatistics(int& nb_reconnects, double& last_reconnect_time)
+{
+	DEB_MEMBER_FUNCT();
+
+	nb_reconnects = m_xpad->getNbReconnects();
+	last_reconnect_time = m_xpad->getLastReconnectTime();
+}
+
+void Camera::startProtocolCapture(std::string path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::startProtocolCapture ***********";
+	DEB_PARAM() << DEB_VAR1(path);
+
+	m_transcript.open(path);
+}
+
+void Camera::stopProtocolCapture()
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::stopProtocolCapture ***********";
+
+	m_transcript.close();
+}
+
+long long Camera::getProtocolCaptureSize()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_transcript.getNbBytes();
+}
+
+void Camera::getFrameAccounting(int& expected, int& received, int& short_reads, int& header_anomalies,
+								int& late_frames, double& max_gap)
+{
+	DEB_MEMBER_FUNCT();
+
+	expected = m_frame_accounting.getNbExpected();
+	received = m_frame_accounting.getNbReceived();
+	short_reads = m_frame_accounting.getNbShortReads();
+	header_anomalies = m_frame_accounting.getNbHeaderAnomalies();
+	late_frames = m_frame_accounting.getNbLateFrames();
+	max_gap = m_frame_accounting.getMaxGap();
+}
+
+void Camera::getFrameTiming(int frame_nb, double& receive_time, double& exposure_start)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(frame_nb);
+
+	if (!m_frame_accounting.getFrameTiming(frame_nb, receive_time, exposure_start))
+		THROW_HW_ERROR(Error) << "Frame " << frame_nb << " not received";
+	receive_time -= m_start_raw_time;
+	exposure_start -= m_start_raw_time;
+}
+
+void Camera::getFrameTimingStatistics(double& mean_delay, double& jitter, double& max_delay)
+{
+	DEB_MEMBER_FUNCT();
+
+	m_frame_accounting.getDelayStatistics(mean_delay, jitter, max_delay);
+}
+
+double Camera::getMaxFrameRate()
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::getMaxFrameRate ***********";
+
+	double period = std::max((m_exp_time_usec + m_lat_time_usec) * 1e-6, minFramePeriod());
+	return (period > 0) ? 1 / period : 0;
+}
+
+void Camera::setLinkBandwidth(double bandwidth)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::setLinkBandwidth ***********";
+	DEB_PARAM() << DEB_VAR1(bandwidth);
+
+	m_throughput.setLinkBandwidth(bandwidth);
+}
+
+void Camera::getThroughputModel(double& link_bandwidth, double& client_bandwidth, double& compression_ratio)
+{
+	DEB_MEMBER_FUNCT();
+
+	link_bandwidth = m_throughput.getLinkBandwidth();
+	client_bandwidth = m_throughput.getClientBandwidth();
+	compression_ratio = m_throughput.getCompressionRatio();
+}
+
+void Camera::setStrictFrameRateFlag(unsigned short flag)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(flag);
+
+	m_strict_frame_rate_flag = flag;
+}
+
+unsigned short Camera::getStrictFrameRateFlag()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_strict_frame_rate_flag;
+}
+
+void Camera::startThresholdScan(unsigned short first_ithl, unsigned short last_ithl)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::startThresholdScan ***********";
+	DEB_PARAM() << DEB_VAR2(first_ithl, last_ithl);
+
+	waitAcqEnd();
+
+	if (first_ithl == last_ithl)
+		THROW_HW_ERROR(InvalidValue) << "A threshold scan needs 2 ITHL values at least";
+	// the steps are read on the command connection, the module streams would get them
+	if (m_module_readout_flag)
+		THROW_HW_ERROR(Error) << "Threshold scan not available with the per-module readout, disable it first";
+
+	// the cube is allocated here so that a lack of memory is reported to the caller
+	Size raw_size = m_local_geometry_flag ? m_geometry.getRawSize() : m_image_size;
+	m_threshold_scan.prepare(first_ithl, last_ithl, raw_size);
+	m_scan_first_ithl = first_ithl;
+	m_scan_last_ithl = last_ithl;
+	m_scan_nb_steps = 0;
+	m_scan_error.clear();
+
+	m_wait_flag = false;
+	m_quit = false;
+	m_acq_aborted = false;
+	m_process_id = 10;
+	m_cond.broadcast();
+
+	while (!m_thread_running)
+		m_cond.wait();
+
+	DEB_TRACE() << "********** Outside of Camera::startThresholdScan ***********";
+}
+
+void Camera::runThresholdScan()
+{
+	DEB_MEMBER_FUNCT();
+
+	double start = FrameAccounting::now();
+	int nb_steps = m_threshold_scan.getNbSteps();
+	Size size = m_threshold_scan.getSize();
+	int ret;
+	std::string str;
+	CommandBuilder cmd;
+
+	// one frame per exposure, streamed on the command connection, internally triggered
+	exposureParametersCommand(cmd, 1, 0, 1);
+
+	try
+	{
+		m_xpad->sendWait(cmd, ret);
+		if (ret)
+			THROW_HW_ERROR(Error) << "Setting the scan exposure parameters FAILED!";
+
+		cmd.clear();
+		cmd << "LoadConfigG ITHL " << m_scan_first_ithl;
+		m_xpad->sendWait(cmd, str);
+
+		int step;
+		for (step = 0; step < nb_steps && !m_quit; ++step)
+		{
+			if (step > 0)
+			{
+				cmd.clear();
+				cmd << ((m_scan_last_ithl > m_scan_first_ithl) ? "ITHLIncrease" : "ITHLDecrease");
+				m_xpad->sendWait(cmd, ret);
+				if (ret)
+					THROW_HW_ERROR(Error) << "ITHL step to " << m_threshold_scan.getStepIthl(step) << " FAILED!";
+			}
+
+			// a stop interrupts the frame read, as in a streamed acquisition
+			AutoMutex aLock(m_cond.mutex());
+			m_frame_streaming = true;
+			if (m_quit)
+			{
+				m_acq_aborted = true;
+				m_abort_event.trigger();
+			}
+			aLock.unlock();
+
+			m_xpad->sendExposeCommand();
+			ret = m_xpad->getDataExpose(m_threshold_scan.getStepFrame(step), 1,
+										size_t(size.getWidth()) * size.getHeight() * sizeof(uint32_t));
+			const FrameHeader& header = m_xpad->getLastFrameHeader();
+			m_xpad->getExposeCommandReturn(ret);
+
+			aLock.lock();
+			m_frame_streaming = false;
+			bool aborted = m_acq_aborted;
+			aLock.unlock();
+			if (aborted)
+				break;
+			if (header.kind != FrameHeader::Frame)
+				THROW_HW_ERROR(Error) << "No frame at ITHL " << m_threshold_scan.getStepIthl(step);
+			if (header.lines != (uint32_t) size.getHeight() || header.columns != (uint32_t) size.getWidth())
+				THROW_HW_ERROR(Error) << "Scan frame of " << header.lines << "x" << header.columns
+									  << ", expected " << size.getHeight() << "x" << size.getWidth();
+		}
+		m_scan_nb_steps = step;
+		m_scan_acq_time = FrameAccounting::now() - start;
+
+		start = FrameAccounting::now();
+		m_threshold_scan.fit(step);
+		m_scan_fit_time = FrameAccounting::now() - start;
+
+		DEB_TRACE() << "Threshold scan of " << step << " steps: acquired in " << m_scan_acq_time
+					<< " s, fitted in " << m_scan_fit_time << " s";
+	}
+	catch (Exception& e)
+	{
+		DEB_ERROR() << "Threshold scan FAILED: " << e.getErrMsg();
+		m_scan_error = e.getErrMsg();
+	}
+
+	// the next acquisition finds the server as it was set
+	try
+	{
+		exposureParametersCommand(cmd);
+		m_xpad->sendWait(cmd, ret);
+	}
+	catch (Exception& e)
+	{
+		DEB_ERROR() << "Restoring the exposure parameters FAILED: " << e.getErrMsg();
+		if (m_scan_error.empty())
+			m_scan_error = "Restoring the exposure parameters: " + e.getErrMsg();
+	}
+}
+
+void Camera::getThresholdScanTimes(int& nb_steps, double& acquisition_time, double& fit_time)
+{
+	DEB_MEMBER_FUNCT();
+
+	waitAcqEnd();
+
+	if (!m_scan_error.empty())
+		THROW_HW_ERROR(Error) << "Threshold scan FAILED: " << m_scan_error;
+
+	nb_steps = m_scan_nb_steps;
+	acquisition_time = m_scan_acq_time;
+	fit_time = m_scan_fit_time;
+}
+
+void Camera::saveThresholdScanMaps(std::string threshold_path, std::string noise_path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::saveThresholdScanMaps ***********";
+	DEB_PARAM() << DEB_VAR2(threshold_path, noise_path);
+
+	waitAcqEnd();
+
+	if (m_scan_nb_steps < 2)
+		THROW_HW_ERROR(Error) << "No threshold scan to save" << (m_scan_error.empty() ? "" : ": ") << m_scan_error;
+	m_threshold_scan.saveMaps(threshold_path.c_str(), noise_path.c_str());
+}
+
+void Camera::loadBinaryCalibration(const std::string& path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "LoadCalibration : " << path;
+
+	try
+	{
+		CalibrationFile calibration;
+		calibration.load(path.c_str());
+
+		CommandBuilder cmd;
+		std::string text;
+		int ret;
+		if (calibration.hasSections(CalibrationFile::Global))
+		{
+			calibration.formatText(CalibrationFile::Global, text);
+			cmd.clear();
+			cmd << "LoadConfigGFromFile ";
+			m_xpad->sendNoWait(cmd);
+			ret = m_xpad->sendParametersData(text.data(), text.size());
+			if (ret == 1)
+			{
+				DEB_TRACE() << "Global configuration loaded from calibration was ABORTED";
+				return;
+			}
+			if (ret != 0)
+				THROW_HW_ERROR(Error) << "Loading global configuration FAILED";
+		}
+		if (calibration.hasSections(CalibrationFile::Local))
+		{
+			ret = uploadConfigL(calibration);
+			if (ret == 1)
+			{
+				DEB_TRACE() << "Local configuration loaded from calibration was ABORTED";
+				return;
+			}
+			if (ret != 0)
+				THROW_HW_ERROR(Error) << "Loading local configuration FAILED";
+		}
+		DEB_TRACE() << "Calibration loaded SUCCESFULLY";
+	}
+	catch (Exception& e)
+	{
+		DEB_ERROR() << "Loading calibration " << path << " FAILED: " << e.getErrMsg();
+	}
+}
+
+void Camera::saveBinaryCalibration(const std::string& path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "SaveCalibration : " << path;
+
+	try
+	{
+		CalibrationFile calibration;
+
+		std::ostringstream global;
+		if (readConfigGText(global) != 0)
+			THROW_HW_ERROR(Error) << "Reading global configuration FAILED";
+		std::string text = global.str();
+		calibration.parseText(CalibrationFile::Global, text.data(), text.size());
+
+		CommandBuilder cmd;
+		cmd << "ReadConfigL";
+		m_xpad->sendNoWait(cmd);
+		if (m_xpad->receiveParametersData(text) != 0)
+			THROW_HW_ERROR(Error) << "Reading local configuration FAILED";
+		calibration.parseText(CalibrationFile::Local, text.data(), text.size());
+		m_config_l_uploaded = calibration;
+
+		calibration.save(path.c_str());
+		DEB_TRACE() << "Calibration saved SUCCESFULLY";
+	}
+	catch (Exception& e)
+	{
+		DEB_ERROR() << "Saving calibration " << path << " FAILED: " << e.getErrMsg();
+	}
+}
+
+void Camera::convertCalibration(std::string config_g_path, std::string config_l_path, std::string path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::convertCalibration ***********";
+	DEB_PARAM() << DEB_VAR3(config_g_path, config_l_path, path);
+
+	CalibrationFile calibration;
+	calibration.loadText(CalibrationFile::Global, config_g_path.c_str());
+	calibration.loadText(CalibrationFile::Local, config_l_path.c_str());
+	calibration.save(path.c_str());
+}
+
+void Camera::exportCalibration(std::string path, std::string config_g_path, std::string config_l_path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::exportCalibration ***********";
+	DEB_PARAM() << DEB_VAR3(path, config_g_path, config_l_path);
+
+	CalibrationFile calibration;
+	calibration.load(path.c_str());
+	calibration.saveText(CalibrationFile::Global, config_g_path.c_str());
+	calibration.saveText(CalibrationFile::Local, config_l_path.c_str());
+}
+
+int Camera::uploadConfigL(const CalibrationFile& config)
+{
+	DEB_MEMBER_FUNCT();
+
+	std::vector<uint32_t> chip_masks;
+	config.getChangedChips(m_config_l_uploaded, chip_masks);
+
+	// local sections follow the modules of the detector, whatever region is read out
+	unsigned detector_mask = m_detector_module_mask ? m_detector_module_mask : m_module_mask;
+	std::vector<unsigned> module_bits;
+	for (unsigned bit = 1; bit && bit <= detector_mask; bit <<= 1)
+		if (detector_mask & bit)
+			module_bits.push_back(bit);
+
+	int nb_modules = chip_masks.size();
+	bool delta = m_delta_config_l_flag && m_config_l_uploaded.hasSections(CalibrationFile::Local)
+				 && int(module_bits.size()) == nb_modules;
+
+	std::vector<bool> modules(nb_modules, true);
+	unsigned delta_mask = 0;
+	int nb_chips = 0, nb_sent = 0;
+	for (int i = 0; i < nb_modules; ++i)
+	{
+		for (uint32_t mask = chip_masks[i]; mask; mask >>= 1)
+			nb_chips += mask & 1;
+		if (delta)
+			modules[i] = chip_masks[i] != 0;
+		if (modules[i])
+		{
+			nb_sent++;
+			if (delta)
+				delta_mask |= module_bits[i];
+		}
+	}
+	m_config_l_changed_chips = nb_chips;
+	m_config_l_sent_modules = nb_sent;
+	m_config_l_skipped_modules = nb_modules - nb_sent;
+	DEB_TRACE() << DEB_VAR4(delta, nb_chips, nb_sent, nb_modules);
+
+	if (nb_sent == 0)
+	{
+		DEB_TRACE() << "Local configuration unchanged, nothing uploaded";
+		return 0;
+	}
+
+	std::string text;
+	config.formatLocalText(modules, text);
+
+	// the server loads the text into the enabled modules
+	unsigned load_mask = (nb_sent < nb_modules) ? delta_mask : detector_mask;
+	bool remask = load_mask != m_module_mask;
+	CommandBuilder cmd;
+	int ret;
+	if (remask)
+	{
+		cmd << "SetModuleMask " << load_mask;
+		m_xpad->sendWait(cmd, ret);
+		if (ret)
+			THROW_HW_ERROR(Error) << "Selecting the modules to load FAILED!";
+	}
+
+	try
+	{
+		cmd.clear();
+		cmd << "LoadConfigLFromFile ";
+		m_xpad->sendNoWait(cmd);
+		ret = m_xpad->sendParametersData(text.data(), text.size());
+	}
+	catch (Exception& e)
+	{
+		m_config_l_uploaded.clear();
+		if (remask)
+		{
+			int ret2;
+			cmd.clear();
+			cmd << "SetModuleMask " << m_module_mask;
+			m_xpad->sendWait(cmd, ret2);
+		}
+		throw;
+	}
+
+	if (remask)
+	{
+		int ret2;
+		cmd.clear();
+		cmd << "SetModuleMask " << m_module_mask;
+		m_xpad->sendWait(cmd, ret2);
+		if (ret2)
+			THROW_HW_ERROR(Error) << "Restoring module mask " << m_module_mask << " FAILED!";
+	}
+
+	// after a failure or an abort, what the detector holds is unknown
+	if (ret == 0)
+		m_config_l_uploaded = config;
+	else
+		m_config_l_uploaded.clear();
+	return ret;
+}
+
+void Camera::setDeltaConfigLFlag(unsigned short flag)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(flag);
+
+	m_delta_config_l_flag = flag;
+}
+
+unsigned short Camera::getDeltaConfigLFlag()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_delta_config_l_flag;
+}
+
+void Camera::getConfigLUploadStatistics(int& changed_chips, int& sent_modules, int& skipped_modules)
+{
+	DEB_MEMBER_FUNCT();
+
+	changed_chips = m_config_l_changed_chips;
+	sent_modules = m_config_l_sent_modules;
+	skipped_modules = m_config_l_skipped_modules;
+}
+
+void Camera::startCalibrationJob(const std::string& cmd)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(cmd);
+
+	waitAcqEnd();
+
+	// the job gets its own server connection on first use
+	AutoMutex aLock(m_command_lock);
+	if (!m_calibration_job.isConnected())
+	{
+		std::vector<std::string> cmds;
+		getSessionCommands(NULL, cmds);
+		m_calibration_job.connect(m_host_name, m_port, cmds);
+	}
+	aLock.unlock();
+
+	m_config_l_uploaded.clear();	// the server writes its own
+	m_calibration_job.start(cmd);
+}
+
+void Camera::getCalibrationProgress(int& state, double& progress, double& remaining_time, double& elapsed_time,
+									std::string& message)
+{
+	DEB_MEMBER_FUNCT();
+
+	state = m_calibration_job.getState();
+	progress = m_calibration_job.getProgress();
+	remaining_time = m_calibration_job.getRemainingTime();
+	elapsed_time = m_calibration_job.getElapsedTime();
+	message = m_calibration_job.getMessage();
+	DEB_RETURN() << DEB_VAR4(state, progress, remaining_time, message);
+}
+
+void Camera::waitCalibrationEnd()
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::waitCalibrationEnd ***********";
+
+	m_calibration_job.wait();
+	if (m_calibration_job.getState() == CalibrationJob::Failed)
+		THROW_HW_ERROR(Error) << m_calibration_job.getCommand() << " FAILED: " << m_calibration_job.getMessage();
+}
+
+void Camera::cancelCalibration()
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::cancelCalibration ***********";
+
+	if (!m_calibration_job.isRunning())
+		return;
+	m_calibration_job.cancel();
+
+	CommandBuilder cmd;
+	cmd <<  "AbortCurrentProcess";
+	m_xpad_alt->sendNoWait(cmd);
+}
+
+void Camera::setPixelStatisticsFlag(unsigned short flag)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(flag);
+
+	m_pixel_statistics_flag = flag;
+}
+
+unsigned short Camera::getPixelStatisticsFlag()
+{
+	DEB_MEMBER_FUNCT();
+
+	return m_pixel_statistics_flag;
+}
+
+void Camera::setPixelMaskThresholds(double dead_zero_fraction, double dead_mean_ratio, double noisy_mean_ratio,
+									double noisy_dispersion)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR4(dead_zero_fraction, dead_mean_ratio, noisy_mean_ratio, noisy_dispersion);
+
+	if (dead_zero_fraction <= 0 || dead_zero_fraction > 1 || dead_mean_ratio < 0 || noisy_mean_ratio <= 0
+		|| noisy_dispersion <= 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid pixel mask thresholds";
+
+	m_mask_thresholds.dead_zero_fraction = dead_zero_fraction;
+	m_mask_thresholds.dead_mean_ratio = dead_mean_ratio;
+	m_mask_thresholds.noisy_mean_ratio = noisy_mean_ratio;
+	m_mask_thresholds.noisy_dispersion = noisy_dispersion;
+}
+
+void Camera::getPixelMaskThresholds(double& dead_zero_fraction, double& dead_mean_ratio, double& noisy_mean_ratio,
+									double& noisy_dispersion)
+{
+	DEB_MEMBER_FUNCT();
+
+	dead_zero_fraction = m_mask_thresholds.dead_zero_fraction;
+	dead_mean_ratio = m_mask_thresholds.dead_mean_ratio;
+	noisy_mean_ratio = m_mask_thresholds.noisy_mean_ratio;
+	noisy_dispersion = m_mask_thresholds.noisy_dispersion;
+}
+
+void Camera::applyPixelStatisticsMasks(int& nb_dead, int& nb_noisy)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::applyPixelStatisticsMasks ***********";
+
+	waitAcqEnd();
+
+	std::vector<unsigned char> dead, noisy;
+	m_pixel_statistics.createMasks(m_mask_thresholds, dead, noisy);
+	m_correction.setDeadPixelMask(&dead[0], m_pixel_statistics.getSize());
+	m_correction.setNoisyPixelMask(&noisy[0], m_pixel_statistics.getSize());
+
+	nb_dead = std::count(dead.begin(), dead.end(), 1);
+	nb_noisy = std::count(noisy.begin(), noisy.end(), 1);
+	DEB_RETURN() << DEB_VAR2(nb_dead, nb_noisy);
+}
+
+void Camera::savePixelStatisticsMasks(std::string dead_path, std::string noisy_path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(dead_path, noisy_path);
+
+	waitAcqEnd();
+
+	std::vector<unsigned char> masks[2];
+	m_pixel_statistics.createMasks(m_mask_thresholds, masks[0], masks[1]);
+
+	const std::string *paths[2] = {&dead_path, &noisy_path};
+	for (int i = 0; i < 2; ++i)
+	{
+		std::ofstream file(paths[i]->c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			THROW_HW_ERROR(Error) << "Cannot open pixel mask " << *paths[i];
+		file.write((const char *) &masks[i][0], masks[i].size());
+		if (!file)
+			THROW_HW_ERROR(Error) << "Cannot write pixel mask " << *paths[i];
+	}
+}
+
+void Camera::getFrameBufferView(int frame_nb, void*& ptr, int& width, int& height, int& depth)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(frame_nb);
+
+	StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
+	int nb_buffers;
+	buffer_mgr.getNbBuffers(nb_buffers);
+	int acq_frame_nb = m_acq_frame_nb;
+
+	if (frame_nb < 0 || frame_nb >= acq_frame_nb)
+		THROW_HW_ERROR(InvalidValue) << "Frame " << frame_nb << " not acquired, "
+									 << acq_frame_nb << " frames so far";
+	// the ring holds the last nb_buffers frames, an older one was overwritten
+	if (frame_nb < acq_frame_nb - nb_buffers)
+		THROW_HW_ERROR(InvalidValue) << "Frame " << frame_nb << " overwritten, the "
+									 << nb_buffers << " buffers hold frames " << acq_frame_nb - nb_buffers
+									 << " to " << acq_frame_nb - 1;
+
+	ptr = buffer_mgr.getFrameBufferPtr(frame_nb);
+	width = m_image_size.getWidth();
+	height = m_image_size.getHeight();
+	depth = (m_pixel_depth == Camera::B2) ? 2 : 4;
+}
+
+const float* Camera::getThresholdScanMap(int map, int& width, int& height)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(map);
+
+	waitAcqEnd();
+
+	if (m_scan_nb_steps < 2)
+		THROW_HW_ERROR(Error) << "No threshold scan";
+	if (map != ThresholdMap && map != NoiseMap)
+		THROW_HW_ERROR(InvalidValue) << "Invalid threshold scan map " << map;
+
+	Size size = m_threshold_scan.getSize();
+	width = size.getWidth();
+	height = size.getHeight();
+	return (map == ThresholdMap) ? &m_threshold_scan.getThresholdMap()[0] : &m_threshold_scan.getNoiseMap()[0];
+}
+
+const void* Camera::getPixelStatisticsMap(int map, int& width, int& height)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(map);
+
+	waitAcqEnd();
+
+	if (m_pixel_statistics.getNbFrames() == 0)
+		THROW_HW_ERROR(Error) << "No pixel statistics";
+
+	const Size& size = m_pixel_statistics.getSize();
+	width = size.getWidth();
+	height = size.getHeight();
+	switch (map)
+	{
+		case MeanMap: return &m_pixel_statistics.getMean()[0];
+		case VarianceMap:
+			THROW_HW_ERROR(InvalidValue) << "Variance map computed on demand, get a copy with getPixelStatisticsVariance";
+		case MinMap: return &m_pixel_statistics.getMin()[0];
+		case MaxMap: return &m_pixel_statistics.getMax()[0];
+		case ZeroCountMap: return &m_pixel_statistics.getZeroCount()[0];
+	}
+	THROW_HW_ERROR(InvalidValue) << "Invalid pixel statistics map " << map;
+}
+
+void Camera::getPixelStatisticsVariance(std::vector<double>& variance, int& width, int& height)
+{
+	DEB_MEMBER_FUNCT();
+
+	waitAcqEnd();
+
+	if (m_pixel_statistics.getNbFrames() == 0)
+		THROW_HW_ERROR(Error) << "No pixel statistics";
+
+	const Size& size = m_pixel_statistics.getSize();
+	width = size.getWidth();
+	height = size.getHeight();
+	m_pixel_statistics.getVariance(variance);
+}
+
+int Camera::loadConfigLFromArray(const unsigned short* values, int width, int height)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "********** Inside of Camera::loadConfigLFromArray ***********";
+	DEB_PARAM() << DEB_VAR2(width, height);
+
+	waitAcqEnd();
+
+	CalibrationFile config;
+	config.setLocal(values, height, width);
+	int ret = uploadConfigL(config);
+
+	if (ret == 0)
+		DEB_TRACE() << "Local configuration loaded from array SUCCESFULLY";
+	else if (ret == 1)
+		DEB_TRACE() << "Local configuration loaded from array was ABORTED";
+	else
+		throw LIMA_HW_EXC(Error, "Loading local configuration from array FAILED!");
+
+	return ret;
+}
+
+void Camera::setModuleRoi(int x, int y, int width, int height)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR4(x, y, width, height);
+
+	if (isAcqRunning())
+		THROW_HW_ERROR(Error) << "Cannot change the readout region during an acquisition";
+
+	// the bands of the modules are those of the whole detector frame
+	if (m_module_mask != m_detector_module_mask)
+		applyModuleMask(m_detector_module_mask);
+	Size full_size;
+	getImageSize(full_size);
+
+	unsigned int mask;
+	try
+	{
+		m_module_roi.setRegion(x, y, width, height);
+		mask = m_module_roi.map(m_detector_module_mask, full_size);
+	}
+	catch (Exception& e)
+	{
+		// the whole detector is left read out
+		m_module_roi.setRegion(0, 0, 0, 0);
+		updateImageSize();
+		throw;
+	}
+
+	if (mask != m_module_mask)
+		applyModuleMask(mask);
+	updateImageSize();
+
+	unsigned int module_mask;
+	int first_line, nb_lines;
+	m_module_roi.getReadout(module_mask, first_line, nb_lines);
+	DEB_TRACE() << "Reading out modules " << module_mask << ", lines " << first_line << " to "
+				<< first_line + nb_lines - 1 << " of the detector";
+}
+
+void Camera::getModuleRoi(int& x, int& y, int& width, int& height)
+{
+	DEB_MEMBER_FUNCT();
+	m_module_roi.getRegion(x, y, width, height);
+}
+
+void Camera::getModuleRoiReadout(unsigned int& module_mask, int& first_line, int& nb_lines)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (m_module_roi.isEmpty())
+	{
+		module_mask = m_module_mask;
+		first_line = 0;
+		nb_lines = m_image_size.getHeight();
+		return;
+	}
+	m_module_roi.getReadout(module_mask, first_line, nb_lines);
+}
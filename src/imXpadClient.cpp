@@ -35,6 +35,7 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
@@ -43,10 +44,17 @@
 #include <fcntl.h>
 #include <sys/time.h>
 #include <sys/select.h>
+#include <sys/epoll.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdlib.h>
 
 #include "imXpadClient.h"
+#include "imXpadCommandBuilder.h"
+#include "imXpadServerLine.h"
+#include "imXpadTranscript.h"
+#include "imXpadCodec.h"
+#include "imXpadAbortEvent.h"
 #include "lima/ThreadUtils.h"
 #include "lima/Exceptions.h"
 #include "lima/Debug.h"
@@ -54,17 +62,25 @@
 
 //static char errorMessage[1024];
 
-const int MAX_ERRMSG = 1024;
 const int CR = '\15';				// carriage return
 const int LF = '\12';				// line feed
 const char QUIT[] = "Exit\n";		// sent using 'send'
+const int RESYNC_TIMEOUT = 30000;	// ms the server has to end an aborted stream
+const int RECONNECT_FIRST_DELAY = 10;	// ms before the second attempt, doubled after each failure
+const int RECONNECT_MAX_DELAY = 1000;
 
 using namespace std;
 using namespace lima;
 using namespace lima::imXpad;
 
-XpadClient::XpadClient() : m_debugMessages() {
+XpadClient::XpadClient() : m_num_read(0), m_cur_pos(0), m_rd_buff(2 * RD_BUFF),
+    m_debugMessages(), m_codec(NULL), m_abort(NULL),
+    m_epoll_fd(-1), m_epoll_skt(-1), m_read_aborted(false),
+    m_resync(RESYNC_NONE), m_draining(false), m_resync_header(0), m_resync_payload(0),
+    m_port(0), m_max_reconnects(0), m_reconnecting(false), m_connection_cb(NULL),
+    m_nb_reconnects(0), m_reconnect_time(0), m_transcript(NULL), m_progress_cb(NULL) {
     DEB_CONSTRUCTOR();
+    memset(&m_last_header, 0, sizeof(m_last_header));
     // Ignore the sigpipe we get we try to send quit to
     // dead server in disconnect, just use error codes
     struct sigaction pipe_act;
@@ -77,18 +93,64 @@ XpadClient::XpadClient() : m_debugMessages() {
 
 XpadClient::~XpadClient() {
     DEB_DESTRUCTOR();
+    if (m_epoll_fd >= 0)
+        close(m_epoll_fd);
 }
 
-void XpadClient::sendWait(string cmd) {
+void XpadClient::sendWait(const string& cmd) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendWait(" << cmd << ")";
+    doSendWait(cmd.data(), cmd.size());
+}
+
+void XpadClient::sendWait(const string& cmd, int& value) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendWait(" << cmd << ")";
+    doSendWait(cmd.data(), cmd.size(), value);
+}
+
+void XpadClient::sendWait(const string& cmd, double& value) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendWait(" << cmd << ")";
+    doSendWait(cmd.data(), cmd.size(), value);
+}
+
+void XpadClient::sendWait(const string& cmd, string& value) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendWait(" << cmd << ")";
+    doSendWait(cmd.data(), cmd.size(), value);
+}
+
+void XpadClient::sendWait(const CommandBuilder& cmd) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendWait(" << cmd << ")";
+    doSendWait(cmd.data(), cmd.size());
+}
+
+void XpadClient::sendWait(const CommandBuilder& cmd, int& value) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendWait(" << cmd << ")";
+    doSendWait(cmd.data(), cmd.size(), value);
+}
+
+void XpadClient::sendWait(const CommandBuilder& cmd, double& value) {
     DEB_MEMBER_FUNCT();
-    int rc;
     DEB_TRACE() << "sendWait(" << cmd << ")";
+    doSendWait(cmd.data(), cmd.size(), value);
+}
+
+void XpadClient::sendWait(const CommandBuilder& cmd, string& value) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendWait(" << cmd << ")";
+    doSendWait(cmd.data(), cmd.size(), value);
+}
+
+void XpadClient::doSendWait(const char *cmd, size_t len) {
+    DEB_MEMBER_FUNCT();
+    int rc;
     AutoMutex aLock(m_cond.mutex());
-    if (waitForPrompt() != 0) {
-        disconnectFromServer();
-        THROW_HW_ERROR(Error) << "Time-out before client sent a prompt. Disconnecting.\n";
-    }
-    sendCmd(cmd);
+    readyForCommand();
+    sendCmd(cmd, len);
     if (waitForResponse(rc) < 0) {
         THROW_HW_ERROR(Error) << "Waiting for response from server";
     }
@@ -97,64 +159,81 @@ void XpadClient::sendWait(string cmd) {
     }
 }
 
-void XpadClient::sendWait(string cmd, int& value) {
+void XpadClient::doSendWait(const char *cmd, size_t len, int& value) {
     DEB_MEMBER_FUNCT();
-    DEB_TRACE() << "sendWait(" << cmd << ")";
     AutoMutex aLock(m_cond.mutex());
-    if (waitForPrompt() != 0) {
-        disconnectFromServer();
-        THROW_HW_ERROR(Error) << "Time out before client sent a prompt. Disconnecting.\n";
-    }
-    sendCmd(cmd);
+    readyForCommand();
+    sendCmd(cmd, len);
     if (waitForResponse(value) < 0) {
         THROW_HW_ERROR(Error) << "Waiting response from server";
     }
 }
 
-void XpadClient::sendWait(string cmd, double& value) {
+void XpadClient::doSendWait(const char *cmd, size_t len, double& value) {
     DEB_MEMBER_FUNCT();
-    DEB_TRACE() << "sendWait(" << cmd << ")";
     AutoMutex aLock(m_cond.mutex());
-    if (waitForPrompt() != 0) {
-        disconnectFromServer();
-        THROW_HW_ERROR(Error) << "Time-out before client sent a prompt. Disconnecting.\n";
-    }
-    sendCmd(cmd);
+    readyForCommand();
+    sendCmd(cmd, len);
     if (waitForResponse(value) < 0) {
         THROW_HW_ERROR(Error) << "Waiting for response from server";
     }
 }
 
-void XpadClient::sendWait(string cmd, string& value) {
+void XpadClient::doSendWait(const char *cmd, size_t len, string& value) {
     DEB_MEMBER_FUNCT();
-    DEB_TRACE() << "sendWait(" << cmd << ")";
     AutoMutex aLock(m_cond.mutex());
-    if (waitForPrompt() != 0) {
-        disconnectFromServer();
-        THROW_HW_ERROR(Error) << "Time-out before client sent a prompt. Disconnecting.\n";
-    }
-    sendCmd(cmd);
+    readyForCommand();
+    sendCmd(cmd, len);
     if (waitForResponse(value) < 0) {
         THROW_HW_ERROR(Error) << "Waiting for response from server";
     }
 }
 
+/*
+ * Send the commands in one write and read their integer returns in order:
+ * the server parses them one after the other from its input
+ */
+void XpadClient::sendBatch(const vector<string>& cmds, vector<int>& values) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendBatch(" << cmds.size() << " commands)";
+    values.resize(cmds.size());
+    if (cmds.empty())
+        return;
+
+    AutoMutex aLock(m_cond.mutex());
+    readyForCommand();
+    string batch = cmds[0];
+    for (size_t i = 1; i < cmds.size(); i++)
+        batch += "\n" + cmds[i];
+    sendCmd(batch.data(), batch.size());
+    for (size_t i = 0; i < cmds.size(); i++) {
+        if (i > 0 && waitForPrompt() != 0) {
+            THROW_HW_ERROR(Error) << "Connection lost after " << cmds[i - 1];
+        }
+        if (waitForResponse(values[i]) < 0) {
+            THROW_HW_ERROR(Error) << "Waiting for response to " << cmds[i];
+        }
+    }
+}
+
 void XpadClient::sendWaitCustom(const string& cmd, string& value)
 {
     DEB_MEMBER_FUNCT();
     DEB_TRACE() << "sendCustomWait(" << cmd << ")";
 
-    if( send(m_skt , cmd.c_str() , strlen(cmd.c_str()) , 0) < 0)
+    if( writeServer(cmd.c_str(), cmd.size()) < 0)
     {
         THROW_HW_ERROR(Error) << "Send command to server failed.";
     }
 
-    if( recv(m_skt , m_rd_buff , RD_BUFF , 0) < 0)
+    char reply[RD_BUFF];
+    ssize_t len = readServer(reply, RD_BUFF);
+    if( len < 0)
     {
        THROW_HW_ERROR(Error) << "Receive from server failed.";
     }
 
-    value = m_rd_buff;
+    value.assign(reply, len);
     std::string special_chars("\"*> ");
     for(int i = 0; i < special_chars.length(); ++i)
     {
@@ -162,15 +241,20 @@ void XpadClient::sendWaitCustom(const string& cmd, string& value)
     }
 }
 
-void XpadClient::sendNoWait(string cmd) {
+void XpadClient::sendNoWait(const string& cmd) {
     DEB_MEMBER_FUNCT();
     DEB_TRACE() << "sendNoWait(" << cmd << ")";
     AutoMutex aLock(m_cond.mutex());
-    if (waitForPrompt() != 0) {
-        disconnectFromServer();
-        THROW_HW_ERROR(Error) << "Time-out before client sent a prompt. Disconnecting.\n";
-    }
-    sendCmd(cmd);
+    readyForCommand();
+    sendCmd(cmd.data(), cmd.size());
+}
+
+void XpadClient::sendNoWait(const CommandBuilder& cmd) {
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendNoWait(" << cmd << ")";
+    AutoMutex aLock(m_cond.mutex());
+    readyForCommand();
+    sendCmd(cmd.data(), cmd.size());
 }
 
 int XpadClient::sendParametersFile(char* filePath){
@@ -200,8 +284,8 @@ int XpadClient::sendParametersFile(char* filePath){
         
         DEB_TRACE() << "Data size = " << data_size;
 
-        write(m_skt, data_size_buffer, sizeof(uint32_t));
-        write(m_skt, data.str().c_str(), data_size);
+        writeServer(data_size_buffer, sizeof(uint32_t));
+        writeServer(data.str().c_str(), data_size);
         this->getChar();
 
         file.close();
@@ -228,7 +312,7 @@ int XpadClient::receiveParametersFile(char* filePath){
 
     unsigned char data_chain[sizeof(uint32_t)];
 
-    while (read(m_skt, data_chain, sizeof(uint32_t)) < 0);
+    while (readServer(data_chain, sizeof(uint32_t)) < 0);
     
     for(int i=0; i<sizeof(uint32_t); i++)
         this->getChar();
@@ -245,7 +329,7 @@ int XpadClient::receiveParametersFile(char* filePath){
             stringstream message;
             message << "File received\n";
             string tmp = message.str();
-            write(m_skt,(char *)tmp.c_str(),tmp.length());
+            writeServer((char *)tmp.c_str(),tmp.length());
 
             return 0;
         }
@@ -253,7 +337,7 @@ int XpadClient::receiveParametersFile(char* filePath){
             stringstream message;
             message << "File not saved into file\n";
             string tmp = message.str();
-            write(m_skt,(char *)tmp.c_str(),tmp.length());
+            writeServer((char *)tmp.c_str(),tmp.length());
 
             return -1;
         }
@@ -262,8 +346,59 @@ int XpadClient::receiveParametersFile(char* filePath){
         stringstream message;
         message << "File not received\n";
         string tmp = message.str();
-        write(m_skt,(char *)tmp.c_str(),tmp.length());
+        writeServer((char *)tmp.c_str(),tmp.length());
+
+        return -1;
+    }
+}
+
+int XpadClient::sendParametersData(const char* data, uint32_t size){
+    DEB_MEMBER_FUNCT();
+    DEB_TRACE() << "sendParametersData(" << size << " bytes)";
+
+    char data_size_buffer[sizeof(uint32_t)];
+    memcpy(&data_size_buffer, &size, sizeof(uint32_t));
+
+    writeServer(data_size_buffer, sizeof(uint32_t));
+    writeServer(data, size);
+    this->getChar();
+
+    int ret;
+    string message;
+
+    this->waitForResponse(ret);
+    if (ret == -1){
+        this->waitForResponse(message);
+        DEB_TRACE() << message;
+    }
+    return ret;
+}
+
+int XpadClient::receiveParametersData(string& data){
+    DEB_MEMBER_FUNCT();
+
+    unsigned char data_chain[sizeof(uint32_t)];
+
+    while (readServer(data_chain, sizeof(uint32_t)) < 0);
+
+    for(int i=0; i<sizeof(uint32_t); i++)
+        this->getChar();
+
+    uint32_t data_size = data_chain[3]<<24|data_chain[2]<<16|data_chain[1]<<8|data_chain[0];
+
+    data.clear();
+    if (data_size > 0){
+        data.reserve(data_size);
+        for(uint32_t i=0; i<data_size; i++)
+            data += (char) this->getChar();
 
+        string tmp = "File received\n";
+        writeServer((char *)tmp.c_str(),tmp.length());
+        return 0;
+    }
+    else{
+        string tmp = "File not received\n";
+        writeServer((char *)tmp.c_str(),tmp.length());
         return -1;
     }
 }
@@ -277,12 +412,11 @@ void XpadClient::sendExposeCommand(){
     sendNoWait(cmd.str());
 }
 
-int XpadClient::getDataExpose(void *bptr, unsigned short xpadFormat) {
+int XpadClient::getDataExpose(void *bptr, unsigned short xpadFormat, size_t capacity) {
     DEB_MEMBER_FUNCT();
 
     uint16_t *buffer_short;
     uint32_t *buffer_int;
-    uint32_t *data_buff;
 
     if (xpadFormat==0)
         buffer_short = (uint16_t *)bptr;
@@ -294,15 +428,34 @@ int XpadClient::getDataExpose(void *bptr, unsigned short xpadFormat) {
     uint32_t column_final_image = 0;
     uint32_t bytes_received = 0;
 	ssize_t bytes = 0;
+	resyncStream();
+	memset(&m_last_header, 0, sizeof(m_last_header));
+	m_last_header.kind = FrameHeader::Aborted;
 	DEB_TRACE() << "read header from server [BEGIN]";
     unsigned char data_chain[3*sizeof(uint32_t)];
 	while(bytes_received < 3*sizeof(uint32_t)){
-		bytes = read(m_skt, data_chain + bytes_received, 3*sizeof(uint32_t) - bytes_received);
+		if (waitReadable() < 0) {
+			DEB_TRACE() << "read header aborted";
+			memcpy(m_resync_chain, data_chain, bytes_received);
+			m_resync_header = bytes_received;
+			m_resync_payload = 0;
+			m_resync = RESYNC_FRAMES;
+			return -1;
+		}
+		bytes = readServer(data_chain + bytes_received, 3*sizeof(uint32_t) - bytes_received);
 		DEB_TRACE() << "bytes = " << bytes;
 		if(bytes < 0){
 			DEB_TRACE() << "Read from server error : " << strerror(errno);
 			THROW_HW_ERROR(Error) << "Read from server error : " << strerror(errno);
 		}
+		if(bytes == 0)
+			THROW_HW_ERROR(Error) << "Connection closed by server while reading header";
+		if(bytes_received == 0){
+			// the frame time, before the payload and the conversion add their jitter
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+			m_last_header.receive_time = ts.tv_sec + 1e-9 * ts.tv_nsec;
+		}
 		bytes_received += bytes;
 	}
 	DEB_TRACE() << "bytes_received = " << bytes_received;	
@@ -318,56 +471,135 @@ int XpadClient::getDataExpose(void *bptr, unsigned short xpadFormat) {
     DEB_TRACE() << "column_final_image = " << column_final_image;
     DEB_TRACE() << "data_chain[0] = " << data_chain[0];
 
+    m_last_header.data_size = data_size;
+    m_last_header.lines = line_final_image;
+    m_last_header.columns = column_final_image;
+
     if(data_size > 0 && data_chain[0] != '*'){
 
-        unsigned char *data = new unsigned char[data_size];
-        data_buff = new uint32_t[line_final_image*column_final_image ];
+        // a header announcing more than the buffer holds is not trusted, its
+        // payload is read and dropped to keep the stream in step
+        uint64_t nb_pixels = uint64_t(line_final_image) * column_final_image;
+        size_t pixel_bytes = (xpadFormat==0) ? sizeof(uint16_t) : sizeof(uint32_t);
+        bool oversized = nb_pixels * pixel_bytes > capacity;
+        if (oversized) {
+            DEB_WARNING() << "Header announces " << line_final_image << "x" << column_final_image
+                          << " pixels, buffer holds " << capacity << " bytes: payload dropped";
+            m_payload.resize(std::min(data_size, uint32_t(DRAIN_CHUNK)));
+        } else
+            m_payload.resize(data_size);
+        unsigned char *data = &m_payload[0];
 		DEB_TRACE() << "read data from server [BEGIN]";
 		bytes_received = 0;	
 		bytes = 0;
 		while(bytes_received < data_size){
-			bytes = read(m_skt, data + bytes_received, data_size - bytes_received);
+			if (waitReadable() < 0) {
+				DEB_TRACE() << "read data aborted after " << bytes_received << " bytes";
+				m_resync_header = 0;
+				m_resync_payload = data_size - bytes_received;
+				m_resync = RESYNC_FRAMES;
+				return -1;
+			}
+			if (oversized)
+				bytes = readServer(data, std::min(data_size - bytes_received, uint32_t(m_payload.size())));
+			else
+				bytes = readServer(data + bytes_received, data_size - bytes_received);
 			if(bytes < 0){
 				DEB_TRACE() << "Read data from server error : " << strerror(errno);
 				THROW_HW_ERROR(Error) << "Read data from server error : " << strerror(errno);
 			}
+			if(bytes == 0)
+				THROW_HW_ERROR(Error) << "Connection closed by server while reading data";
 			bytes_received += bytes;
+			m_last_header.nb_reads++;
 		}
 		DEB_TRACE() << "bytes_received = " << bytes_received;		
 		DEB_TRACE() << "read data from server [END]";		
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+		m_last_header.payload_time = ts.tv_sec + 1e-9 * ts.tv_nsec;
 
-        write(m_skt,"\n",sizeof(char));
-
-        uint32_t count = 0;
-        int i=0;
-        while (count < data_size){
-
-            if (xpadFormat==0){
-                memcpy (&data_buff[i], &data[count], sizeof(uint32_t) );
-                buffer_short[i] = (uint16_t)(data_buff[i]);
-            }
-            else{
-                memcpy (&data_buff[i], &data[count], sizeof(uint32_t) );
-                buffer_int[i] = (uint32_t)(data_buff[i]);
-            }
-            count += sizeof(uint32_t);
-            i++;
+        writeServer("\n",sizeof(char));
+        if (oversized) {
+            m_last_header.kind = FrameHeader::Oversized;
+            return -1;
+        }
+        m_last_header.kind = FrameHeader::Frame;
+
+        // a compressed payload is recognised by its own header, raw frames
+        // are still accepted so that an old server keeps working
+        if (m_codec && FrameCodec::isCompressed(data, data_size)) {
+            DEB_TRACE() << "decode compressed frame of " << data_size << " bytes";
+            m_last_header.compressed = true;
+            m_codec->decode(data, data_size, bptr, line_final_image*column_final_image,
+                            xpadFormat==0 ? sizeof(uint16_t) : sizeof(uint32_t));
+            return 0;
         }
 
-        delete[] data_buff;
-	delete[] data;
+        // a payload longer than the header announces is cut to the frame
+        uint32_t nb_values = std::min(uint64_t(data_size / sizeof(uint32_t)), nb_pixels);
+        uint32_t value;
+        for (uint32_t i = 0; i < nb_values; i++){
+            memcpy (&value, &data[i * sizeof(uint32_t)], sizeof(uint32_t) );
+            if (xpadFormat==0)
+                buffer_short[i] = (uint16_t)value;
+            else
+                buffer_int[i] = value;
+        }
         return 0;
 
     }
     else{
-        write(m_skt,"\n",sizeof(char));
+        writeServer("\n",sizeof(char));
+        m_last_header.kind = (data_chain[0] == '*') ? FrameHeader::EndOfStream : FrameHeader::Empty;
         return -1;
     }
 }
 
+const FrameHeader& XpadClient::getLastFrameHeader() const {
+    return m_last_header;
+}
+
+void XpadClient::setFrameCodec(FrameCodec* codec) {
+    DEB_MEMBER_FUNCT();
+    m_codec = codec;
+}
+
+void XpadClient::setTranscript(TranscriptWriter* transcript) {
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_cond.mutex());
+    m_transcript = transcript;
+}
+
+void XpadClient::setAbortEvent(AbortEvent* abort) {
+    DEB_MEMBER_FUNCT();
+    m_abort = abort;
+    // the poll set is rebuilt around the new event on the next read
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    m_epoll_skt = -1;
+}
+
 void XpadClient::getExposeCommandReturn(int &value){
     DEB_MEMBER_FUNCT();
-    waitForResponse(value);
+    // after an abort the return value is read by the resynchronization
+    if (m_resync != RESYNC_NONE) {
+        value = -1;
+        return;
+    }
+    try {
+        waitForResponse(value);
+    } catch (Exception& e) {
+        if (m_resync == RESYNC_NONE)
+            throw;
+        value = -1;
+    }
+}
+
+bool XpadClient::isResyncPending() const {
+    return m_resync != RESYNC_NONE;
 }
 
 /*
@@ -416,7 +648,11 @@ int XpadClient::connectToServer(const string hostName, int port) {
         }
     }
     endprotoent();
+    m_hostname = hostName;
+    m_port = port;
     m_valid = 1;
+    m_epoll_skt = -1;
+    m_resync = RESYNC_NONE;
     m_data_port = -1;
     m_data_listen_skt = -1;
     m_prompts = 0;
@@ -428,10 +664,126 @@ int XpadClient::connectToServer(const string hostName, int port) {
 void XpadClient::disconnectFromServer() {
     DEB_MEMBER_FUNCT();
     if (m_valid) {
-        shutdown(m_skt, 2);
+        ::shutdown(m_skt, 2);
         close(m_skt);
         m_valid = 0;
+        m_epoll_skt = -1;
+    }
+}
+
+XpadClient* XpadClient::open(const string& hostname, int port) {
+    DEB_STATIC_FUNCT();
+    XpadClient *client = new XpadClient();
+    if (client->connectToServer(hostname, port) < 0) {
+        string msg = client->getErrorMessage();
+        delete client;
+        THROW_HW_ERROR(Error) << "[ " << msg << " ]";
     }
+    return client;
+}
+
+/*
+ * Only stops the traffic, the descriptor stays valid for the thread still
+ * reading it until disconnectFromServer()
+ */
+void XpadClient::shutdown() {
+    DEB_MEMBER_FUNCT();
+    if (m_valid)
+        ::shutdown(m_skt, SHUT_RDWR);
+}
+
+/*
+ * Let the server end its connection thread if the socket is idle, a
+ * command stuck on a dead server must not hold the caller forever
+ */
+void XpadClient::release(bool busy) {
+    DEB_MEMBER_FUNCT();
+    if (!busy) {
+        try {
+            sendNoWait("Exit");
+        } catch (Exception& e) {
+            DEB_WARNING() << "Exit not sent: " << e.getErrMsg();
+        }
+    }
+    shutdown();
+}
+
+void XpadClient::setAutoReconnect(int max_attempts) {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(max_attempts);
+    AutoMutex aLock(m_cond.mutex());
+    m_max_reconnects = max_attempts;
+}
+
+void XpadClient::setConnectionCallback(ConnectionCallback* cb) {
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_cond.mutex());
+    m_connection_cb = cb;
+}
+
+void XpadClient::setProgressCallback(ProgressCallback* cb) {
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_cond.mutex());
+    m_progress_cb = cb;
+}
+
+bool XpadClient::canReconnect() const {
+    return m_max_reconnects > 0 && !m_reconnecting && !m_hostname.empty();
+}
+
+/*
+ * Open the connection again, waiting longer after each failed attempt, and
+ * let the callback restore the server session
+ */
+void XpadClient::reconnect() {
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_cond.mutex());
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    double start = ts.tv_sec + 1e-9 * ts.tv_nsec;
+    int delay = RECONNECT_FIRST_DELAY;
+    int max_attempts = std::max(m_max_reconnects, 1);
+
+    m_reconnecting = true;
+    disconnectFromServer();
+    for (int attempt = 1; ; attempt++) {
+        DEB_TRACE() << "reconnecting to " << m_hostname << ":" << m_port << ", attempt " << attempt;
+        connectToServer(m_hostname, m_port);
+        if (m_valid) {
+            try {
+                if (m_connection_cb)
+                    m_connection_cb->connectionRestored(*this);
+                break;
+            } catch (Exception& e) {
+                m_errorMessage = e.getErrMsg();
+                disconnectFromServer();
+            }
+        }
+        if (attempt >= max_attempts) {
+            m_reconnecting = false;
+            THROW_HW_ERROR(Error) << "Cannot reconnect to server after " << attempt
+                                  << " attempts: [ " << m_errorMessage << " ]";
+        }
+        usleep(delay * 1000);
+        delay = std::min(2 * delay, RECONNECT_MAX_DELAY);
+    }
+    m_reconnecting = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    m_reconnect_time = ts.tv_sec + 1e-9 * ts.tv_nsec - start;
+    m_nb_reconnects++;
+    DEB_TRACE() << "reconnected in " << m_reconnect_time << " s";
+}
+
+int XpadClient::getNbReconnects() const {
+    AutoMutex aLock(m_cond.mutex());
+    return m_nb_reconnects;
+}
+
+double XpadClient::getLastReconnectTime() const {
+    AutoMutex aLock(m_cond.mutex());
+    return m_reconnect_time;
 }
 
 int XpadClient::initServerDataPort() {
@@ -474,9 +826,9 @@ int XpadClient::initServerDataPort() {
         m_data_port = ntohs (data_addr.sin_port);
         if (waitForPrompt() == -1)
             return -1;
-        stringstream ss;
-        ss << "Port " << m_data_port;
-        sendCmd(ss.str());
+        CommandBuilder cmd("Port ");
+        cmd << m_data_port;
+        sendCmd(cmd.data(), cmd.size());
         int null = 0;
         if (waitForResponse(null) == -1)
             return -1;
@@ -493,26 +845,53 @@ vector<string> XpadClient::getDebugMessages() const {
     return m_debugMessages;
 }
 
-void XpadClient::sendCmd(const string cmd) {
-    //cout << "Inside sendCmd" << endl;
+/*
+ * Send the command and its line feed with a single system call, nothing
+ * is copied
+ */
+void XpadClient::sendCmd(const char *cmd, size_t len) {
     DEB_MEMBER_FUNCT();
-    DEB_TRACE() << "cmd: " << cmd ;
-    int r, len;
-    char *p;
-    string command = cmd + "\n";
+    static char lf = LF;
+    struct iovec iov[2];
+    struct msghdr msg;
+    ssize_t r = 0;
+
     if (!m_valid) {
         THROW_HW_ERROR(Error) << "Not connected to server ";
     }
-    len = command.length();
-    p = (char*) command.c_str();
-    while (len > 0 && (r = send(m_skt, p, len, 0)) > 0)
-        p += r, len -= r;
-
-    if (r <= 0) {
-        THROW_HW_ERROR(Error) << "Sending command " << cmd << " to server failed";
+    iov[0].iov_base = (void *) cmd;
+    iov[0].iov_len = len;
+    iov[1].iov_base = &lf;
+    iov[1].iov_len = 1;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    while (msg.msg_iovlen > 0) {
+        while ((r = sendmsg(m_skt, &msg, 0)) < 0 && errno == EINTR);
+        if (r <= 0)
+            break;
+        // partial write: skip what went out
+        while (msg.msg_iovlen > 0 && size_t(r) >= msg.msg_iov->iov_len) {
+            r -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base + r;
+            msg.msg_iov->iov_len -= r;
+        }
     }
 
-    //cout << "Getting out of sendCmd" << endl;
+    if (msg.msg_iovlen > 0) {
+        THROW_HW_ERROR(Error) << "Sending command " << string(cmd, len) << " to server failed";
+    }
+    if (m_transcript) {
+        iov[0].iov_base = (void *) cmd;
+        iov[0].iov_len = len;
+        iov[1].iov_base = &lf;
+        iov[1].iov_len = 1;
+        m_transcript->record(ToServer, iov, 2);
+    }
 }
 
 int XpadClient::waitForPrompt() {
@@ -531,9 +910,10 @@ int XpadClient::waitForPrompt() {
         return -1;
     }
     if (m_prompts == 0) {
+        ServerLine line;
         do {
-            r = nextLine(0, 0, 0, 0, 0, 0);
-        } while (r != CLN_NEXT_PROMPT);
+            nextLine(line);
+        } while (line.getType() != ServerLine::Prompt);
     } else {
         m_prompts--;
     }
@@ -542,109 +922,241 @@ int XpadClient::waitForPrompt() {
 }
 
 /*
- *  Wait for an integer response
+ * Get the connection ready for a command: drain what an abort left, wait
+ * for the prompt, and open the connection again if the server dropped it
  */
-int XpadClient::waitForResponse(int& value) {
-    //cout << "Inside waitForResponse" << endl;
+void XpadClient::readyForCommand() {
     DEB_MEMBER_FUNCT();
-    int r, code, done, outoff;
-    string errmsg;
-    m_debugMessages.clear();
 
-    if (!m_valid) {
-        THROW_HW_ERROR(Error) << "Not connected to server ";
+    if (!m_valid && canReconnect())
+        reconnect();
+    try {
+        resyncStream();
+    } catch (Exception& e) {
+        if (!canReconnect())
+            throw;
+        reconnect();
+    }
+    if (waitForPrompt() == 0)
+        return;
+
+    disconnectFromServer();
+    if (canReconnect()) {
+        reconnect();
+        if (waitForPrompt() == 0)
+            return;
+        disconnectFromServer();
+    }
+    THROW_HW_ERROR(Error) << "Time-out before client sent a prompt. Disconnecting.\n";
+}
+
+/*
+ * Wait until the socket has data, or the abort event is set (returns -1)
+ */
+int XpadClient::waitReadable() {
+    DEB_MEMBER_FUNCT();
+    struct epoll_event ev;
+
+    m_read_aborted = false;
+    if (m_draining) {
+        struct pollfd pfd;
+        pfd.fd = m_skt;
+        pfd.events = POLLIN;
+        int r;
+        while ((r = poll(&pfd, 1, RESYNC_TIMEOUT)) < 0 && errno == EINTR);
+        if (r <= 0) {
+            THROW_HW_ERROR(Error) << "Time-out waiting for the end of the aborted stream";
+        }
+        return 0;
+    }
+    if (!m_abort)
+        return 0;
+
+    if (m_epoll_skt != m_skt) {
+        if (m_epoll_fd < 0) {
+            if ((m_epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+                THROW_HW_ERROR(Error) << "Cannot create epoll set: " << strerror(errno);
+            }
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.fd = m_abort->getFd();
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+        } else if (m_epoll_skt >= 0) {
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_epoll_skt, &ev);
+        }
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = m_skt;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_skt, &ev) < 0 &&
+            (errno != EEXIST || epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, m_skt, &ev) < 0)) {
+            THROW_HW_ERROR(Error) << "Cannot poll server socket: " << strerror(errno);
+        }
+        m_epoll_skt = m_skt;
     }
+
     for (;;) {
-        r = nextLine(&errmsg, &code, 0, 0, &done, &outoff);
-        switch (r) {
-        case CLN_NEXT_PROMPT:
-            error_handler("(warning) No return code from the server.");
-            m_prompts++;
-            return -1;
-        case CLN_NEXT_ERRMSG:
-            errmsg_handler(errmsg);
-            cout << "\t---> message: " << errmsg << endl;
-            break;
-        case CLN_NEXT_DEBUGMSG:
-            debugmsg_handler(errmsg);
-            cout << "\t---> message: " << errmsg << endl;
-            break;
-        case CLN_NEXT_UNKNOWN:
-            error_handler("Unknown string from server: "+ errmsg);
-            break;
-        case CLN_NEXT_TIMEBAR:
-            timebar_handler(done, outoff, errmsg);
-            break;
-        case CLN_NEXT_INTRET:
-            value = code;
-            DEB_TRACE() << "\t---> value: " << value ;
-            if (value == -1){
-                string error_message;
-                waitForResponse(error_message);
+        struct epoll_event events[2];
+        int n = epoll_wait(m_epoll_fd, events, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            THROW_HW_ERROR(Error) << "Waiting for server data: " << strerror(errno);
+        }
+        // an abort wins over pending data: the caller wants out now
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == m_abort->getFd()) {
+                m_abort->unblocked();
+                m_read_aborted = true;
+                return -1;
             }
+        }
+        if (n > 0)
             return 0;
-        case CLN_NEXT_DBLRET:
-            error_handler("Unexpected double return code.");
-            return -1;
-        case CLN_NEXT_STRRET:
-            error_handler("Server responded with a string.");
-            return -1;
-        default:
-            THROW_HW_ERROR(Error) << "Programming error. Please report";
+    }
+}
+
+/*
+ * Blocking read of len bytes while draining an aborted stream
+ */
+void XpadClient::readResync(unsigned char *buf, uint32_t len) {
+    DEB_MEMBER_FUNCT();
+    while (len > 0) {
+        waitReadable();
+        ssize_t bytes = readServer(buf, len);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0) {
+            THROW_HW_ERROR(Error) << "Connection lost while draining the aborted stream";
         }
+        buf += bytes;
+        len -= bytes;
     }
-    //cout << "Getting out of waitForResponse" << endl;
-    return 0;
 }
 
 /*
- *  Wait for an double response
+ * Discard what an abort left on the connection: the rest of the frame in
+ * flight, the following frames up to the end of stream header, and the
+ * return value of the exposure (or of the command) that was interrupted.
+ * The connection is closed if the server does not end the stream.
  */
-int XpadClient::waitForResponse(double& value) {
+void XpadClient::resyncStream() {
+    DEB_MEMBER_FUNCT();
+
+    if (m_resync == RESYNC_NONE)
+        return;
+
+    DEB_TRACE() << "resynchronizing the server stream after an abort";
+    m_draining = true;
+    try {
+        while (m_resync == RESYNC_FRAMES) {
+            if (m_resync_payload > 0) {
+                unsigned char discard[4096];
+                while (m_resync_payload > 0) {
+                    uint32_t len = std::min<uint32_t>(m_resync_payload, sizeof(discard));
+                    readResync(discard, len);
+                    m_resync_payload -= len;
+                }
+                writeServer("\n", sizeof(char));
+            }
+            readResync(m_resync_chain + m_resync_header, sizeof(m_resync_chain) - m_resync_header);
+            m_resync_header = 0;
+            uint32_t data_size = m_resync_chain[3]<<24|m_resync_chain[2]<<16|m_resync_chain[1]<<8|m_resync_chain[0];
+            if (data_size > 0 && m_resync_chain[0] != '*') {
+                m_resync_payload = data_size;
+            } else {
+                writeServer("\n", sizeof(char));
+                m_resync = RESYNC_REPLY;
+            }
+        }
+        int value;
+        waitForResponse(value);
+    } catch (Exception& e) {
+        m_draining = false;
+        m_resync = RESYNC_NONE;
+        disconnectFromServer();
+        THROW_HW_ERROR(Error) << "Cannot resynchronize with server after abort: " << e.getErrMsg();
+    }
+    m_draining = false;
+    m_resync = RESYNC_NONE;
+    DEB_TRACE() << "server stream resynchronized";
+}
+
+/*
+ * Read lines up to the return value of the command, handling the messages
+ * in between. Returns -1 if the server prompts without returning a value.
+ */
+int XpadClient::waitForReturn(ServerLine& line) {
     DEB_MEMBER_FUNCT();
-    int r, done, outoff;
-    double code;
-    string errmsg;
     m_debugMessages.clear();
 
     if (!m_valid) {
         THROW_HW_ERROR(Error) << "Not connected to server ";
     }
     for (;;) {
-        r = nextLine(&errmsg, 0, &code, 0, &done, &outoff);
-        switch (r) {
-        case CLN_NEXT_PROMPT:
+        nextLine(line);
+        switch (line.getType()) {
+        case ServerLine::Prompt:
             error_handler("(warning) No return code from the server.");
             m_prompts++;
             return -1;
-        case CLN_NEXT_ERRMSG:
-            errmsg_handler(errmsg);
-            cout << "\t---> message: " << errmsg << endl;
+        case ServerLine::ErrorMessage:
+            errmsg_handler(line.str());
+            cout << "\t---> message: " << line.str() << endl;
             break;
-        case CLN_NEXT_DEBUGMSG:
-            debugmsg_handler(errmsg);
-            cout << "\t---> message: " << errmsg << endl;
+        case ServerLine::DebugMessage:
+            debugmsg_handler(line.str());
+            cout << "\t---> message: " << line.str() << endl;
             break;
-        case CLN_NEXT_UNKNOWN:
-            error_handler("Unknown string from server: "+ errmsg);
+        case ServerLine::Unknown:
+            error_handler("Unknown string from server: " + line.str());
             break;
-        case CLN_NEXT_TIMEBAR:
-            timebar_handler(done, outoff, errmsg);
+        case ServerLine::TimeBar:
+            timebar_handler(line.getDone(), line.getOutOff(), line.str());
             break;
-        case CLN_NEXT_INTRET:
-            error_handler("Unexpected integer return code.");
-            return -1;
-        case CLN_NEXT_DBLRET:
-            value = code;
-            DEB_TRACE() << "\t---> value: " << value ;
+        case ServerLine::Return:
+        case ServerLine::StringReturn:
             return 0;
-        case CLN_NEXT_STRRET:
-            error_handler("Server responded with a string.");
-            return -1;
-        default:
-            THROW_HW_ERROR(Error) << "Programming error. Please report";
         }
     }
+}
+
+/*
+ *  Wait for an integer response
+ */
+int XpadClient::waitForResponse(int& value) {
+    DEB_MEMBER_FUNCT();
+    ServerLine line;
+
+    if (waitForReturn(line) < 0)
+        return -1;
+    if (line.getType() == ServerLine::StringReturn) {
+        error_handler("Server responded with a string.");
+        return -1;
+    }
+    value = line.toInt();
+    DEB_TRACE() << "\t---> value: " << value ;
+    if (value == -1) {
+        string error_message;
+        waitForResponse(error_message);
+    }
+    return 0;
+}
+
+/*
+ *  Wait for an double response
+ */
+int XpadClient::waitForResponse(double& value) {
+    DEB_MEMBER_FUNCT();
+    ServerLine line;
+
+    if (waitForReturn(line) < 0)
+        return -1;
+    if (line.getType() == ServerLine::StringReturn) {
+        error_handler("Server responded with a string.");
+        return -1;
+    }
+    value = line.toDouble();
+    DEB_TRACE() << "\t---> value: " << value ;
     return 0;
 }
 
@@ -653,201 +1165,101 @@ int XpadClient::waitForResponse(double& value) {
  */
 int XpadClient::waitForResponse(string& value) {
     DEB_MEMBER_FUNCT();
-    int r, done, outoff;
-    string errmsg;
-    m_debugMessages.clear();
+    ServerLine line;
 
-    if (!m_valid) {
-        THROW_HW_ERROR(Error) << "Not connected to server ";
-    }
-    for (;;) {
-        r = nextLine(&errmsg, 0, 0, &value, &done, &outoff);
-        switch (r) {
-        case CLN_NEXT_PROMPT:
-            error_handler("(warning) No return code from the server.");
-            m_prompts++;
-            return -1;
-        case CLN_NEXT_ERRMSG:
-            errmsg_handler(errmsg);
-            cout << "\t---> message: " << errmsg << endl;
-            break;
-        case CLN_NEXT_DEBUGMSG:
-            debugmsg_handler(errmsg);
-            cout << "\t---> message: " << errmsg << endl;
-            break;
-        case CLN_NEXT_UNKNOWN:
-            error_handler("Unknown string from server.");
-            break;
-        case CLN_NEXT_TIMEBAR:
-            timebar_handler(done, outoff, errmsg);
-            break;
-        case CLN_NEXT_INTRET:
-            error_handler("Server responded with an integer");
-            return -1;
-        case CLN_NEXT_DBLRET:
-            error_handler("Server responded with a double");
-            return -1;
-        case CLN_NEXT_STRRET:
-            DEB_TRACE() << "\t---> message: " << value ;
-            return (value.length() == 0) ? -1 : 0;
-        default:
-            THROW_HW_ERROR(Error) << "Programming error. Please report";
-        }
+    if (waitForReturn(line) < 0)
+        return -1;
+    if (line.getType() == ServerLine::Return) {
+        error_handler("Server responded with a number");
+        return -1;
     }
-    return 0;
+    value.assign(line.data(), line.size());
+    DEB_TRACE() << "\t---> message: " << value ;
+    return (value.length() == 0) ? -1 : 0;
 }
 
 /*
- * Get the next line from the server
+ * Parse the next line in place in the read buffer, reading from the server
+ * until the line is complete. The line is valid until the next read.
  */
-int XpadClient::nextLine(string *errmsg, int *ivalue, double *dvalue, string *svalue, int *done, int *outoff) {
-    //cout << "Inside nextline " << endl;
+void XpadClient::nextLine(ServerLine& line) {
     DEB_MEMBER_FUNCT();
-    int r;
-    char timestr[80], *tp;
-    char buff[MAX_ERRMSG + 2];
-    char *bptr = buff;
-    char *bptr2 = buff;
-    int n, len;
-    // Assume we are either at the beginning of a line now, or we are right
-    // at the end of the previous line.
-    do {
-        r = getChar();
-    } while (r == CR || r == LF);
-
-
-    switch (r) {
-    case -1:						// read error (disconnected?)
-        THROW_HW_ERROR(Error) << "server read error (disconnected?)";
-
-    case '>':						// at prompt
-        getChar();					// discard ' '
-        return CLN_NEXT_PROMPT;
-
-    case '!':						// error message
-        getChar();					// discard ' '
-        while ((r = getChar()) != -1 && r != CR && r != LF) {
-            *bptr++ = r;
-        }
-        *bptr = '\0';
-        if(errmsg != 0)
-            *errmsg = buff;
-        return CLN_NEXT_ERRMSG;
-
-    case '#':						// comment
-        getChar();					// discard ' '
-        while ((r = getChar()) != -1 && r != CR && r != LF) {
-            *bptr++ = r;
-        }
-        *bptr = '\0';
-        if(errmsg != 0)
-            *errmsg = buff;
-        return CLN_NEXT_DEBUGMSG;
-
-    case '@':						// timebar message ("a/b")
-        getChar();					// discard ' '
-        tp = timestr;				// read time message
-        for (;;) {
-            r = getChar();
-            if (r == '\'' || r == '"' || r == CR || r == LF || r == -1)
-                break;
-            *tp++ = r;
-        }
-        *tp = '\0';
-        if (done != 0 && outoff != 0)
-            sscanf(timestr, "%d %d", done, outoff);
-        if (r == '\'' || r == '"') {
-            while ((r = getChar()) != -1 && r != CR && r != LF) {
-                *bptr++ = r;
-            }
-        } else {
-            *bptr = '\0';
-        }
-        *bptr = '\0';
-        len = strlen(buff);
-        if (len > 0 && (bptr2[len - 1] == '\'' || bptr2[len - 1] == '"')) {
-            bptr2[len - 1] = 0;
-        }
-        return CLN_NEXT_TIMEBAR;
-
-    case '*': 						// return value
-        getChar(); 					// discard ' '
-        r = getChar();				// distinguish strings/nums
-        if (r == '(')				// (null)
-        {
-
-            while ((r = getChar()) != -1 && r != ')' && r != CR && r != LF)
-                ;
-            if (svalue != 0)
-                *svalue = "";
-            return CLN_NEXT_STRRET;
-        } else if (r == '"') /*		string */
-        {
-            while ((r = getChar()) != -1 && r != '"') {
-                *bptr++ = r;
-            }
-            *bptr = '\0';
-            if (svalue != 0)
-                *svalue = buff;
-            return CLN_NEXT_STRRET;
-        } else {  // integer or double
-            char buffer[80], *p;
-
-            buffer[0] = r;
-            p = &buffer[1];
-
-            while ((r = getChar()) != -1 && r != CR && r != LF)
-                *p++ = r;
-            *p = '\0';
-
-            if (dvalue) {
-                if (strcmp(buffer, "nan") == 0) {
-                    *dvalue = NAN;
-                } else {
-                    *dvalue = atof(buffer);
-                }
-                return CLN_NEXT_DBLRET;
-            }
-            if (ivalue) {
-                *ivalue = atoi(buffer);
-            }
-            return CLN_NEXT_INTRET;
-        }
 
-    default: // don't know: abort to end of line
-        n = 0;
-        while ((r = getChar()) != -1 && r != CR && r != LF) {
-            if (++n == MAX_ERRMSG)
-                break;
-            *bptr++ = r;
+    for (;;) {
+        size_t len = line.parse(&m_rd_buff[m_cur_pos], m_num_read - m_cur_pos);
+        if (len > 0) {
+            m_cur_pos += len;
+            return;
+        }
+        if (fillReadBuffer() < 0) {
+            if (m_read_aborted)
+                THROW_HW_ERROR(Error) << "server read aborted";
+            THROW_HW_ERROR(Error) << "server read error (disconnected?)";
         }
-        bptr += '\0';
-        if (errmsg != 0)
-            *errmsg = buff;
-        return CLN_NEXT_UNKNOWN;
     }
 }
 
-int XpadClient::getChar() {
+/*
+ * Append what the server sent to the unread part of the buffer, moved to
+ * its start. The buffer only grows for lines longer than it.
+ */
+int XpadClient::fillReadBuffer() {
     DEB_MEMBER_FUNCT();
     int r;
 
     if (!m_valid) {
         THROW_HW_ERROR(Error) << "Not connected to xpad server ";
     }
+    if (m_cur_pos > 0) {
+        memmove(&m_rd_buff[0], &m_rd_buff[m_cur_pos], m_num_read - m_cur_pos);
+        m_num_read -= m_cur_pos;
+        m_cur_pos = 0;
+    }
+    if (m_rd_buff.size() - m_num_read < size_t(RD_BUFF))
+        m_rd_buff.resize(m_num_read + RD_BUFF);
+
+    if (waitReadable() < 0) {
+        if (m_resync == RESYNC_NONE)
+            m_resync = RESYNC_REPLY;
+        return -1;
+    }
+    while ((r = readServer(&m_rd_buff[m_num_read], RD_BUFF)) < 0 && errno == EINTR);
+    if (r <= 0) {
+        return -1;
+    }
+    m_num_read += r;
+    return 0;
+}
+
+/*
+ * Reads and writes of the command connection, recorded in the transcript
+ * while a capture runs
+ */
+ssize_t XpadClient::readServer(void *buf, size_t len) {
+    ssize_t r = read(m_skt, buf, len);
+    if (r > 0 && m_transcript)
+        m_transcript->record(FromServer, buf, r);
+    return r;
+}
+
+ssize_t XpadClient::writeServer(const void *buf, size_t len) {
+    ssize_t r = write(m_skt, buf, len);
+    if (r > 0 && m_transcript)
+        m_transcript->record(ToServer, buf, r);
+    return r;
+}
+
+int XpadClient::getChar() {
+    DEB_MEMBER_FUNCT();
+
     if (m_num_read == m_cur_pos) {
-        while ((r = recv(m_skt, m_rd_buff, RD_BUFF, 0)) < 0 && errno == EINTR);
-        if (r <= 0) {
+        if (fillReadBuffer() < 0)
             return -1;
-        }
-        m_cur_pos = 0;
-        m_num_read = r;
         m_just_read = 1;
     } else {
         m_just_read = 0;
     }
     return m_rd_buff[m_cur_pos++];
-
 }
 
 void XpadClient::errmsg_handler(const string errmsg) {
@@ -864,7 +1276,9 @@ void XpadClient::debugmsg_handler(const string msg) {
 
 void XpadClient::timebar_handler(int done, int outoff, const string errmsg) {
     DEB_MEMBER_FUNCT();
-    /* do nothing */
+    DEB_TRACE() << "time bar " << done << "/" << outoff << " " << errmsg;
+    if (m_progress_cb)
+        m_progress_cb->progress(done, outoff, errmsg);
 }
 
 void XpadClient::error_handler(const string errmsg) {
@@ -0,0 +1,236 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cstring>
+#include <algorithm>
+#include "imXpadCodec.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+// the wire format is little-endian, as the raw frames
+static inline uint32_t readWord(const unsigned char *p)
+{
+	return p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+static inline void writeWord(std::vector<unsigned char>& out, size_t pos, uint32_t value)
+{
+	out[pos] = value & 0xff;
+	out[pos + 1] = (value >> 8) & 0xff;
+	out[pos + 2] = (value >> 16) & 0xff;
+	out[pos + 3] = (value >> 24) & 0xff;
+}
+
+static inline int bitWidth(uint32_t value)
+{
+	return value ? 32 - __builtin_clz(value) : 0;
+}
+
+template <class T>
+static void unpackKernel(const unsigned char *block, int nb, T *out)
+{
+	int bits = block[0];		// at most 32, checked with the block size
+	const unsigned char *p = block + 1;
+
+	if (bits == 0)
+	{
+		for (int i = 0; i < nb; ++i)
+			out[i] = 0;
+		return;
+	}
+
+	uint64_t acc = 0;
+	int acc_bits = 0;
+	uint64_t mask = (uint64_t(1) << bits) - 1;
+	for (int i = 0; i < nb; ++i)
+	{
+		while (acc_bits < bits)
+		{
+			acc |= uint64_t(*p++) << acc_bits;
+			acc_bits += 8;
+		}
+		out[i] = T(acc & mask);
+		acc >>= bits;
+		acc_bits -= bits;
+	}
+}
+
+class FrameCodec::DecodeTask: public WorkerPool::Task
+{
+public:
+	DecodeTask(const unsigned char *payload, uint32_t size, void *frame,
+			   uint32_t nb_pixels, int depth) :
+	m_payload(payload), m_size(size), m_frame(frame), m_nb_pixels(nb_pixels), m_depth(depth)
+	{
+		m_block_pixels = readWord(payload + 2 * sizeof(uint32_t));
+		m_nb_blocks = readWord(payload + 3 * sizeof(uint32_t));
+		m_offsets = payload + HEADER_SIZE;
+		m_blocks = m_offsets + (uint64_t(m_nb_blocks) + 1) * sizeof(uint32_t);
+	}
+
+	uint32_t getNbBlocks() const { return m_nb_blocks; }
+
+	// every block decoded must lie in the payload, before the next one
+	bool isValid() const
+	{
+		if (!m_block_pixels)
+			return false;
+		uint64_t table_end = HEADER_SIZE + (uint64_t(m_nb_blocks) + 1) * sizeof(uint32_t);
+		if (table_end > m_size)
+			return false;
+		uint64_t blocks_size = readWord(m_offsets + uint64_t(m_nb_blocks) * sizeof(uint32_t));
+		if (table_end + blocks_size > m_size || uint64_t(m_nb_blocks) * m_block_pixels < m_nb_pixels)
+			return false;
+
+		uint32_t offset = readWord(m_offsets);
+		for (uint32_t block = 0; block < m_nb_blocks; ++block)
+		{
+			uint32_t next = readWord(m_offsets + (uint64_t(block) + 1) * sizeof(uint32_t));
+			if (next < offset || next > blocks_size)
+				return false;
+
+			uint64_t first = uint64_t(block) * m_block_pixels;
+			if (first < m_nb_pixels)
+			{
+				uint64_t nb = std::min<uint64_t>(m_nb_pixels - first, m_block_pixels);
+				if (next == offset)
+					return false;
+				uint32_t bits = m_blocks[offset];
+				if (bits > 32 || 1 + (nb * bits + 7) / 8 > uint64_t(next - offset))
+					return false;
+			}
+			offset = next;
+		}
+		return true;
+	}
+
+	virtual void process(int begin, int end)
+	{
+		for (int block = begin; block < end; ++block)
+		{
+			uint64_t first = uint64_t(block) * m_block_pixels;
+			if (first >= m_nb_pixels)
+				break;
+			int nb = (m_nb_pixels - first < m_block_pixels) ? m_nb_pixels - first : m_block_pixels;
+			const unsigned char *data = m_blocks + readWord(m_offsets + block * sizeof(uint32_t));
+			if (m_depth == 2)
+				unpackKernel(data, nb, (uint16_t *) m_frame + first);
+			else
+				unpackKernel(data, nb, (uint32_t *) m_frame + first);
+		}
+	}
+
+private:
+	const unsigned char	*m_payload;
+	uint32_t			m_size;
+	void				*m_frame;
+	uint32_t			m_nb_pixels;
+	int					m_depth;
+	uint32_t			m_block_pixels;
+	uint32_t			m_nb_blocks;
+	const unsigned char	*m_offsets;
+	const unsigned char	*m_blocks;
+} ;
+
+FrameCodec::FrameCodec(WorkerPool& pool, int block_pixels) :
+m_pool(pool), m_block_pixels(block_pixels)
+{
+	DEB_CONSTRUCTOR();
+}
+
+FrameCodec::~FrameCodec()
+{
+	DEB_DESTRUCTOR();
+}
+
+bool FrameCodec::isCompressed(const unsigned char *payload, uint32_t size)
+{
+	return size >= uint32_t(HEADER_SIZE) && readWord(payload) == MAGIC;
+}
+
+uint32_t FrameCodec::getNbPixels(const unsigned char *payload)
+{
+	return readWord(payload + sizeof(uint32_t));
+}
+
+void FrameCodec::encode(const uint32_t *pixels, uint32_t nb_pixels, std::vector<unsigned char>& out)
+{
+	DEB_MEMBER_FUNCT();
+
+	uint32_t nb_blocks = (nb_pixels + m_block_pixels - 1) / m_block_pixels;
+	size_t table = HEADER_SIZE + (nb_blocks + 1) * sizeof(uint32_t);
+
+	out.resize(table);
+	writeWord(out, 0, MAGIC);
+	writeWord(out, 4, nb_pixels);
+	writeWord(out, 8, m_block_pixels);
+	writeWord(out, 12, nb_blocks);
+
+	for (uint32_t block = 0; block < nb_blocks; ++block)
+	{
+		writeWord(out, HEADER_SIZE + block * sizeof(uint32_t), out.size() - table);
+
+		uint32_t first = block * m_block_pixels;
+		uint32_t nb = (nb_pixels - first < uint32_t(m_block_pixels)) ? nb_pixels - first : m_block_pixels;
+
+		uint32_t max_value = 0;
+		for (uint32_t i = 0; i < nb; ++i)
+			max_value |= pixels[first + i];
+		int bits = bitWidth(max_value);
+		out.push_back(bits);
+
+		uint64_t acc = 0;
+		int acc_bits = 0;
+		for (uint32_t i = 0; bits && i < nb; ++i)
+		{
+			acc |= uint64_t(pixels[first + i]) << acc_bits;
+			acc_bits += bits;
+			while (acc_bits >= 8)
+			{
+				out.push_back(acc & 0xff);
+				acc >>= 8;
+				acc_bits -= 8;
+			}
+		}
+		if (acc_bits > 0)
+			out.push_back(acc & 0xff);
+	}
+	writeWord(out, HEADER_SIZE + nb_blocks * sizeof(uint32_t), out.size() - table);
+}
+
+void FrameCodec::decode(const unsigned char *payload, uint32_t size, void *frame,
+						uint32_t nb_pixels, int depth)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (!isCompressed(payload, size))
+		THROW_HW_ERROR(Error) << "Not a compressed frame";
+	if (getNbPixels(payload) != nb_pixels)
+		THROW_HW_ERROR(Error) << "Compressed frame has " << getNbPixels(payload)
+							  << " pixels, expected " << nb_pixels;
+
+	DecodeTask task(payload, size, frame, nb_pixels, depth);
+	if (!task.isValid())
+		THROW_HW_ERROR(Error) << "Corrupted compressed frame";
+	m_pool.run(task, task.getNbBlocks());
+}
@@ -0,0 +1,140 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cstdio>
+#include <cstring>
+#include <locale.h>
+#include "imXpadCommandBuilder.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+CommandBuilder::CommandBuilder() :
+m_len(0)
+{
+}
+
+CommandBuilder::CommandBuilder(const char *cmd) :
+m_len(0)
+{
+	*this << cmd;
+}
+
+void CommandBuilder::clear()
+{
+	m_len = 0;
+}
+
+void CommandBuilder::_append(const char *s, size_t len)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (len > sizeof(m_buf) - m_len)
+		THROW_HW_ERROR(Error) << "Command longer than " << sizeof(m_buf) << " characters: "
+							  << std::string(m_buf, m_len) << "...";
+	memcpy(m_buf + m_len, s, len);
+	m_len += len;
+}
+
+void CommandBuilder::_appendDecimal(unsigned long value, bool negative)
+{
+	// digits come out backwards
+	char digits[24];
+	char *p = digits + sizeof(digits);
+	do
+	{
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	if (negative)
+		*--p = '-';
+	_append(p, digits + sizeof(digits) - p);
+}
+
+CommandBuilder& CommandBuilder::operator<<(const char *s)
+{
+	_append(s, strlen(s));
+	return *this;
+}
+
+CommandBuilder& CommandBuilder::operator<<(const std::string& s)
+{
+	_append(s.data(), s.size());
+	return *this;
+}
+
+CommandBuilder& CommandBuilder::operator<<(char c)
+{
+	_append(&c, 1);
+	return *this;
+}
+
+CommandBuilder& CommandBuilder::operator<<(int value)
+{
+	return *this << long(value);
+}
+
+CommandBuilder& CommandBuilder::operator<<(unsigned int value)
+{
+	return *this << (unsigned long) value;
+}
+
+CommandBuilder& CommandBuilder::operator<<(long value)
+{
+	// negate in unsigned arithmetic, LONG_MIN has no positive counterpart
+	if (value < 0)
+		_appendDecimal(0UL - (unsigned long) value, true);
+	else
+		_appendDecimal(value, false);
+	return *this;
+}
+
+CommandBuilder& CommandBuilder::operator<<(unsigned long value)
+{
+	_appendDecimal(value, false);
+	return *this;
+}
+
+CommandBuilder& CommandBuilder::operator<<(double value)
+{
+	// the default format of a stream, with the '.' the server parses
+	// whatever LC_NUMERIC the application set
+	static locale_t c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+
+	char num[32];
+	locale_t old_locale = c_locale ? uselocale(c_locale) : (locale_t) 0;
+	int len = snprintf(num, sizeof(num), "%g", value);
+	if (old_locale)
+		uselocale(old_locale);
+	_append(num, len);
+	return *this;
+}
+
+std::string CommandBuilder::str() const
+{
+	return std::string(m_buf, m_len);
+}
+
+std::ostream& lima::imXpad::operator<<(std::ostream& os, const CommandBuilder& cmd)
+{
+	return os.write(cmd.data(), cmd.size());
+}
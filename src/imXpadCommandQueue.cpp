@@ -0,0 +1,397 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "imXpadCommandQueue.h"
+#include "imXpadClient.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- shared result
+//---------------------------
+
+struct CommandFuture::State
+{
+	Cond						cond;
+	int							refs;
+	std::string					cmd;
+	CommandQueue::ReturnType	type;
+	CommandCallback				*cb;
+	bool						ready;
+	bool						error;
+	std::string					errmsg;
+	int							ivalue;
+	double						dvalue;
+	std::string					svalue;
+
+	State(const std::string& c, CommandQueue::ReturnType t, CommandCallback *callback) :
+	refs(1), cmd(c), type(t), cb(callback), ready(false), error(false), ivalue(0), dvalue(0) {}
+} ;
+
+CommandFuture::CommandFuture() :
+m_state(NULL)
+{
+}
+
+CommandFuture::CommandFuture(State *state) :
+m_state(state)
+{
+	AutoMutex aLock(m_state->cond.mutex());
+	++m_state->refs;
+}
+
+CommandFuture::CommandFuture(const CommandFuture& o) :
+m_state(o.m_state)
+{
+	if (m_state)
+	{
+		AutoMutex aLock(m_state->cond.mutex());
+		++m_state->refs;
+	}
+}
+
+CommandFuture& CommandFuture::operator=(const CommandFuture& o)
+{
+	if (o.m_state != m_state)
+	{
+		_release();
+		m_state = o.m_state;
+		if (m_state)
+		{
+			AutoMutex aLock(m_state->cond.mutex());
+			++m_state->refs;
+		}
+	}
+	return *this;
+}
+
+CommandFuture::~CommandFuture()
+{
+	_release();
+}
+
+void CommandFuture::_release()
+{
+	if (!m_state)
+		return;
+
+	AutoMutex aLock(m_state->cond.mutex());
+	bool last = (--m_state->refs == 0);
+	aLock.unlock();
+	if (last)
+		delete m_state;
+	m_state = NULL;
+}
+
+bool CommandFuture::isValid() const
+{
+	return m_state != NULL;
+}
+
+bool CommandFuture::isReady() const
+{
+	if (!m_state)
+		return false;
+	AutoMutex aLock(m_state->cond.mutex());
+	return m_state->ready;
+}
+
+bool CommandFuture::wait(double timeout) const
+{
+	DEB_MEMBER_FUNCT();
+
+	if (!m_state)
+		THROW_HW_ERROR(Error) << "No command attached to this result";
+
+	AutoMutex aLock(m_state->cond.mutex());
+	while (!m_state->ready)
+	{
+		if (!m_state->cond.wait(timeout) && timeout >= 0)
+			break;
+	}
+	return m_state->ready;
+}
+
+CommandFuture::State& CommandFuture::_waitState() const
+{
+	DEB_MEMBER_FUNCT();
+
+	wait();
+	if (m_state->error)
+		THROW_HW_ERROR(Error) << m_state->cmd << ": [ " << m_state->errmsg << " ]";
+	return *m_state;
+}
+
+bool CommandFuture::hasError() const
+{
+	wait();
+	return m_state->error;
+}
+
+std::string CommandFuture::getErrorMessage() const
+{
+	wait();
+	return m_state->errmsg;
+}
+
+std::string CommandFuture::getCommand() const
+{
+	return m_state ? m_state->cmd : std::string();
+}
+
+int CommandFuture::getInt() const
+{
+	return _waitState().ivalue;
+}
+
+double CommandFuture::getDouble() const
+{
+	return _waitState().dvalue;
+}
+
+std::string CommandFuture::getString() const
+{
+	return _waitState().svalue;
+}
+
+//---------------------------
+//- I/O thread
+//---------------------------
+
+class CommandQueue::IOThread: public Thread
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "CommandQueue", "IOThread");
+public:
+	IOThread(CommandQueue& queue) : m_queue(queue) {}
+	virtual ~IOThread() {}
+
+protected:
+	virtual void threadFunction();
+
+private:
+	void _execute(CommandFuture::State& state);
+	void _done(CommandFuture::State *state);
+
+	CommandQueue& m_queue;
+} ;
+
+void CommandQueue::IOThread::threadFunction()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_queue.m_cond.mutex());
+
+	while (1)
+	{
+		while (!m_queue.m_quit && m_queue.m_queue.empty())
+			m_queue.m_cond.wait();
+		if (m_queue.m_quit)
+			break;
+
+		CommandFuture::State *state = m_queue.m_queue.front();
+		m_queue.m_queue.pop_front();
+		m_queue.m_busy = true;
+		aLock.unlock();
+
+		_execute(*state);
+		_done(state);
+
+		aLock.lock();
+		m_queue.m_busy = false;
+		m_queue.m_cond.broadcast();
+	}
+
+	// fail what is left, nobody will execute it; submit() refuses new
+	// commands from now on, the callbacks included
+	std::deque<CommandFuture::State*> left;
+	left.swap(m_queue.m_queue);
+	aLock.unlock();
+	while (!left.empty())
+	{
+		CommandFuture::State *state = left.front();
+		left.pop_front();
+		AutoMutex stateLock(state->cond.mutex());
+		state->error = true;
+		state->errmsg = "Command queue stopped";
+		state->ready = true;
+		state->cond.broadcast();
+		stateLock.unlock();
+		_done(state);
+	}
+	aLock.lock();
+
+	m_queue.m_running = false;
+	m_queue.m_cond.broadcast();
+}
+
+// the queue reference goes with the callback
+void CommandQueue::IOThread::_done(CommandFuture::State *state)
+{
+	DEB_MEMBER_FUNCT();
+
+	CommandFuture result(state);
+	AutoMutex stateLock(state->cond.mutex());
+	--state->refs;
+	stateLock.unlock();
+	if (state->cb)
+	{
+		try
+		{
+			state->cb->commandDone(result);
+		}
+		catch (...)
+		{
+			DEB_ERROR() << "Callback of " << state->cmd << " failed";
+		}
+	}
+}
+
+void CommandQueue::IOThread::_execute(CommandFuture::State& state)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_TRACE() << "execute " << state.cmd;
+
+	int ivalue = 0;
+	double dvalue = 0;
+	std::string svalue;
+	std::string errmsg;
+	bool error = false;
+
+	try
+	{
+		switch (state.type)
+		{
+			case NoReturn:
+				m_queue.m_client->sendWait(state.cmd);
+				break;
+			case IntReturn:
+				m_queue.m_client->sendWait(state.cmd, ivalue);
+				break;
+			case DoubleReturn:
+				m_queue.m_client->sendWait(state.cmd, dvalue);
+				break;
+			case StringReturn:
+				m_queue.m_client->sendWait(state.cmd, svalue);
+				break;
+		}
+	}
+	catch (Exception& e)
+	{
+		error = true;
+		errmsg = e.getErrMsg();
+	}
+
+	AutoMutex aLock(state.cond.mutex());
+	state.ivalue = ivalue;
+	state.dvalue = dvalue;
+	state.svalue = svalue;
+	state.error = error;
+	state.errmsg = errmsg;
+	state.ready = true;
+	state.cond.broadcast();
+}
+
+//---------------------------
+//- CommandQueue
+//---------------------------
+
+CommandQueue::CommandQueue() :
+m_client(NULL), m_thread(NULL), m_busy(false), m_quit(false), m_running(false)
+{
+	DEB_CONSTRUCTOR();
+}
+
+CommandQueue::~CommandQueue()
+{
+	DEB_DESTRUCTOR();
+	disconnect();
+}
+
+void CommandQueue::connect(const std::string& hostname, int port)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(hostname, port);
+
+	disconnect();
+
+	XpadClient *client = XpadClient::open(hostname, port);
+
+	AutoMutex aLock(m_cond.mutex());
+	m_client = client;
+	m_quit = false;
+	m_running = true;
+	aLock.unlock();
+
+	m_thread = new IOThread(*this);
+	m_thread->start();
+}
+
+void CommandQueue::disconnect()
+{
+	DEB_MEMBER_FUNCT();
+
+	if (!m_thread)
+		return;
+
+	AutoMutex aLock(m_cond.mutex());
+	m_quit = true;
+	m_cond.broadcast();
+	m_client->release(m_busy);
+	while (m_running)
+		m_cond.wait();
+	aLock.unlock();
+
+	delete m_thread;
+	m_thread = NULL;
+	m_client->disconnectFromServer();
+	delete m_client;
+	m_client = NULL;
+}
+
+bool CommandQueue::isConnected() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_running;
+}
+
+CommandFuture CommandQueue::submit(const std::string& cmd, ReturnType type, CommandCallback *cb)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(cmd, type);
+
+	AutoMutex aLock(m_cond.mutex());
+	if (!m_running || m_quit)
+		THROW_HW_ERROR(Error) << "Command queue not connected";
+
+	// the queue holds the first reference
+	CommandFuture::State *state = new CommandFuture::State(cmd, type, cb);
+	m_queue.push_back(state);
+	m_cond.broadcast();
+	return CommandFuture(state);
+}
+
+int CommandQueue::getNbPending() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_queue.size() + (m_busy ? 1 : 0);
+}
@@ -0,0 +1,336 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <fstream>
+#include "imXpadCorrection.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- kernels
+//---------------------------
+
+template <class T>
+static void flatFieldKernel(T *__restrict frame, const float *__restrict coeffs,
+							int begin, int end, float max_value)
+{
+	// plain loop over contiguous rows so that the compiler vectorizes it
+	for (int i = begin; i < end; ++i)
+	{
+		float value = float(frame[i]) * coeffs[i] + 0.5f;
+		frame[i] = T(value < max_value ? value : max_value);
+	}
+}
+
+template <class T>
+static void badPixelKernel(T *frame, const int *bad_pixels,
+						   const unsigned char *bad_mask, int width, int height,
+						   int begin, int end, bool interpolate)
+{
+	for (int k = begin; k < end; ++k)
+	{
+		int i = bad_pixels[k];
+		if (!interpolate)
+		{
+			frame[i] = 0;
+			continue;
+		}
+
+		int x = i % width;
+		int y = i / width;
+		unsigned int sum = 0;
+		int nb = 0;
+		if (x > 0 && !bad_mask[i - 1])
+			sum += frame[i - 1], ++nb;
+		if (x < width - 1 && !bad_mask[i + 1])
+			sum += frame[i + 1], ++nb;
+		if (y > 0 && !bad_mask[i - width])
+			sum += frame[i - width], ++nb;
+		if (y < height - 1 && !bad_mask[i + width])
+			sum += frame[i + width], ++nb;
+		frame[i] = nb ? T((sum + nb / 2) / nb) : 0;
+	}
+}
+
+//---------------------------
+//- tasks
+//---------------------------
+
+class Correction::FlatFieldTask: public WorkerPool::Task
+{
+public:
+	FlatFieldTask(void *frame, int depth, const float *coeffs, int width) :
+	m_frame(frame), m_depth(depth), m_coeffs(coeffs), m_width(width) {}
+
+	virtual void process(int begin, int end)
+	{
+		begin *= m_width;
+		end *= m_width;
+		if (m_depth == 2)
+			flatFieldKernel((uint16_t *) m_frame, m_coeffs, begin, end, 65535.f);
+		else
+			flatFieldKernel((uint32_t *) m_frame, m_coeffs, begin, end, 4294967040.f);
+	}
+
+private:
+	void		*m_frame;
+	int			m_depth;
+	const float	*m_coeffs;
+	int			m_width;
+} ;
+
+class Correction::BadPixelTask: public WorkerPool::Task
+{
+public:
+	BadPixelTask(void *frame, int depth, const Correction& corr) :
+	m_frame(frame), m_depth(depth), m_corr(corr) {}
+
+	virtual void process(int begin, int end)
+	{
+		bool interpolate = (m_corr.m_bad_pixel_mode == Interpolate);
+		int width = m_corr.m_size.getWidth();
+		int height = m_corr.m_size.getHeight();
+		if (m_depth == 2)
+			badPixelKernel((uint16_t *) m_frame, &m_corr.m_bad_pixels[0],
+						   &m_corr.m_bad_mask[0], width, height, begin, end, interpolate);
+		else
+			badPixelKernel((uint32_t *) m_frame, &m_corr.m_bad_pixels[0],
+						   &m_corr.m_bad_mask[0], width, height, begin, end, interpolate);
+	}
+
+private:
+	void				*m_frame;
+	int					m_depth;
+	const Correction&	m_corr;
+} ;
+
+//---------------------------
+//- Correction
+//---------------------------
+
+Correction::Correction(WorkerPool& pool) :
+m_pool(pool), m_bad_pixel_mode(Zero)
+{
+	DEB_CONSTRUCTOR();
+}
+
+Correction::~Correction()
+{
+	DEB_DESTRUCTOR();
+}
+
+void Correction::loadFlatField(const char *fpath, const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(fpath);
+
+	int nb_pixels = size.getWidth() * size.getHeight();
+	std::vector<uint32_t> white(nb_pixels);
+
+	std::ifstream file(fpath, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		THROW_HW_ERROR(Error) << "Cannot open white image " << fpath;
+	file.read((char *) &white[0], nb_pixels * sizeof(uint32_t));
+	if (file.gcount() != std::streamsize(nb_pixels * sizeof(uint32_t)))
+		THROW_HW_ERROR(Error) << "White image " << fpath << " is smaller than "
+							  << size.getWidth() << "x" << size.getHeight();
+
+	// coefficient is mean / white, pixels which never counted are left at 0
+	double sum = 0;
+	int nb_valid = 0;
+	for (int i = 0; i < nb_pixels; ++i)
+		if (white[i] > 0)
+			sum += white[i], ++nb_valid;
+	if (!nb_valid)
+		THROW_HW_ERROR(Error) << "White image " << fpath << " is empty";
+
+	double mean = sum / nb_valid;
+	std::vector<float> coeffs(nb_pixels);
+	for (int i = 0; i < nb_pixels; ++i)
+		coeffs[i] = white[i] ? float(mean / white[i]) : 0.f;
+
+	setFlatField(&coeffs[0], size);
+}
+
+void Correction::setFlatField(const float *coeffs, const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	_checkSize(size);
+	m_flat_field.assign(coeffs, coeffs + size.getWidth() * size.getHeight());
+}
+
+void Correction::clearFlatField()
+{
+	DEB_MEMBER_FUNCT();
+	m_flat_field.clear();
+	if (m_bad_pixels.empty())
+		m_size = Size();
+}
+
+void Correction::loadDeadPixelMask(const char *fpath, const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	_loadMask(m_dead_mask, fpath, size);
+	_updateBadPixels();
+}
+
+void Correction::loadNoisyPixelMask(const char *fpath, const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	_loadMask(m_noisy_mask, fpath, size);
+	_updateBadPixels();
+}
+
+void Correction::setDeadPixelMask(const unsigned char *mask, const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	_setMask(m_dead_mask, mask, size);
+	_updateBadPixels();
+}
+
+void Correction::setNoisyPixelMask(const unsigned char *mask, const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	_setMask(m_noisy_mask, mask, size);
+	_updateBadPixels();
+}
+
+void Correction::clearPixelMasks()
+{
+	DEB_MEMBER_FUNCT();
+	m_dead_mask.clear();
+	m_noisy_mask.clear();
+	_updateBadPixels();
+	if (m_flat_field.empty())
+		m_size = Size();
+}
+
+void Correction::setBadPixelMode(BadPixelMode mode)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(mode);
+	m_bad_pixel_mode = mode;
+}
+
+Correction::BadPixelMode Correction::getBadPixelMode() const
+{
+	return m_bad_pixel_mode;
+}
+
+bool Correction::isActive() const
+{
+	return !m_flat_field.empty() || !m_bad_pixels.empty();
+}
+
+void Correction::prepare(const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (!isActive())
+		return;
+	if (size.getWidth() != m_size.getWidth() || size.getHeight() != m_size.getHeight())
+		THROW_HW_ERROR(Error) << "Correction maps are " << m_size.getWidth() << "x"
+							  << m_size.getHeight() << " but frames are "
+							  << size.getWidth() << "x" << size.getHeight();
+}
+
+void Correction::apply(void *frame, int depth)
+{
+	DEB_MEMBER_FUNCT();
+
+	// flat field first: interpolated pixels read already corrected neighbours
+	if (!m_flat_field.empty())
+	{
+		FlatFieldTask task(frame, depth, &m_flat_field[0], m_size.getWidth());
+		m_pool.run(task, m_size.getHeight());
+	}
+	if (!m_bad_pixels.empty())
+	{
+		BadPixelTask task(frame, depth, *this);
+		m_pool.run(task, m_bad_pixels.size());
+	}
+}
+
+void Correction::_checkSize(const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (size.isEmpty())
+		THROW_HW_ERROR(InvalidValue) << "Invalid correction map size";
+	if (isActive() && (size.getWidth() != m_size.getWidth() ||
+					   size.getHeight() != m_size.getHeight()))
+		THROW_HW_ERROR(InvalidValue) << "Correction map size does not match the maps already loaded";
+	m_size = size;
+}
+
+void Correction::_setMask(std::vector<unsigned char>& dst, const unsigned char *mask,
+						  const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	_checkSize(size);
+	dst.assign(mask, mask + size.getWidth() * size.getHeight());
+}
+
+void Correction::_loadMask(std::vector<unsigned char>& dst, const char *fpath,
+						   const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(fpath);
+
+	int nb_pixels = size.getWidth() * size.getHeight();
+	std::vector<unsigned char> mask(nb_pixels);
+
+	std::ifstream file(fpath, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		THROW_HW_ERROR(Error) << "Cannot open pixel mask " << fpath;
+	file.read((char *) &mask[0], nb_pixels);
+	if (file.gcount() != nb_pixels)
+		THROW_HW_ERROR(Error) << "Pixel mask " << fpath << " is smaller than "
+							  << size.getWidth() << "x" << size.getHeight();
+
+	_setMask(dst, &mask[0], size);
+}
+
+void Correction::_updateBadPixels()
+{
+	DEB_MEMBER_FUNCT();
+
+	m_bad_pixels.clear();
+	m_bad_mask.clear();
+	if (m_dead_mask.empty() && m_noisy_mask.empty())
+		return;
+
+	int nb_pixels = m_size.getWidth() * m_size.getHeight();
+	m_bad_mask.assign(nb_pixels, 0);
+	for (int i = 0; i < nb_pixels; ++i)
+	{
+		bool bad = (!m_dead_mask.empty() && m_dead_mask[i]) ||
+				   (!m_noisy_mask.empty() && m_noisy_mask[i]);
+		if (bad)
+		{
+			m_bad_mask[i] = 1;
+			m_bad_pixels.push_back(i);
+		}
+	}
+	DEB_TRACE() << m_bad_pixels.size() << " masked pixels";
+}
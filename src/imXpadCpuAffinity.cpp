@@ -0,0 +1,208 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <errno.h>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "imXpadCpuAffinity.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- CpuAffinity
+//---------------------------
+
+CpuAffinity::CpuAffinity() :
+m_rt_priority(0)
+{
+}
+
+void CpuAffinity::setCpus(const std::string& cpu_list)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(cpu_list);
+
+	std::vector<int> cpus;
+	std::stringstream ss(cpu_list);
+	std::string item;
+
+	while (std::getline(ss, item, ','))
+	{
+		if (item.find_first_not_of(" ") == std::string::npos)
+			continue;
+
+		// each bound must have its digits, "4-" is not "4-0"
+		const char *begin = item.c_str();
+		char *end;
+		long first = strtol(begin, &end, 10);
+		bool valid = (end != begin);
+		long last = first;
+		if (*end == '-')
+		{
+			begin = end + 1;
+			last = strtol(begin, &end, 10);
+			valid = valid && (end != begin);
+		}
+		while (*end == ' ')
+			++end;
+		if (!valid || *end || first < 0 || last < first || last >= CPU_SETSIZE)
+			THROW_HW_ERROR(InvalidValue) << "Invalid CPU list " << cpu_list;
+
+		for (long cpu = first; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+	}
+	m_cpus = cpus;
+}
+
+std::string CpuAffinity::getCpus() const
+{
+	std::stringstream ss;
+	for (size_t i = 0; i < m_cpus.size(); ++i)
+	{
+		size_t j = i;
+		while (j + 1 < m_cpus.size() && m_cpus[j + 1] == m_cpus[j] + 1)
+			++j;
+		if (i)
+			ss << ",";
+		ss << m_cpus[i];
+		if (j > i)
+			ss << "-" << m_cpus[j];
+		i = j;
+	}
+	return ss.str();
+}
+
+bool CpuAffinity::isPinned() const
+{
+	return !m_cpus.empty();
+}
+
+void CpuAffinity::setRealtimePriority(int priority)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(priority);
+
+	if (priority < 0 || priority > sched_get_priority_max(SCHED_FIFO))
+		THROW_HW_ERROR(InvalidValue) << "Invalid SCHED_FIFO priority " << priority;
+	m_rt_priority = priority;
+}
+
+int CpuAffinity::getRealtimePriority() const
+{
+	return m_rt_priority;
+}
+
+int CpuAffinity::getNumaNode() const
+{
+	if (m_cpus.empty())
+		return -1;
+
+	// the cpu directory holds a "nodeN" link to its node
+	std::stringstream path;
+	path << "/sys/devices/system/cpu/cpu" << m_cpus[0];
+	DIR *dir = opendir(path.str().c_str());
+	if (!dir)
+		return -1;
+
+	int node = -1;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+		{
+			node = atoi(entry->d_name + 4);
+			break;
+		}
+	}
+	closedir(dir);
+	return node;
+}
+
+void CpuAffinity::applyToCurrentThread() const
+{
+	DEB_MEMBER_FUNCT();
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (m_cpus.empty())
+	{
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			CPU_SET(cpu, &set);
+	}
+	else
+	{
+		for (size_t i = 0; i < m_cpus.size(); ++i)
+			CPU_SET(m_cpus[i], &set);
+	}
+	int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (ret)
+		DEB_WARNING() << "Cannot set CPU affinity " << getCpus() << ": " << strerror(ret);
+
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = m_rt_priority;
+	int policy = m_rt_priority ? SCHED_FIFO : SCHED_OTHER;
+	ret = pthread_setschedparam(pthread_self(), policy, &param);
+	if (ret)
+		DEB_WARNING() << "Cannot set SCHED_FIFO priority " << m_rt_priority << ": " << strerror(ret);
+}
+
+//---------------------------
+//- MigrationCounter
+//---------------------------
+
+MigrationCounter::MigrationCounter() :
+m_last_cpu(-1), m_nb_migrations(0)
+{
+}
+
+void MigrationCounter::reset()
+{
+	m_last_cpu = -1;
+	m_nb_migrations = 0;
+}
+
+void MigrationCounter::sample()
+{
+	int cpu = sched_getcpu();
+	if (m_last_cpu >= 0 && cpu != m_last_cpu)
+		++m_nb_migrations;
+	m_last_cpu = cpu;
+}
+
+int MigrationCounter::getNbMigrations() const
+{
+	return m_nb_migrations;
+}
+
+int MigrationCounter::getLastCpu() const
+{
+	return m_last_cpu;
+}
@@ -0,0 +1,153 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <time.h>
+#include <cmath>
+#include "imXpadFrameAccounting.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+FrameAccounting::FrameAccounting() :
+m_nb_expected(0), m_period(0), m_paced(false), m_start_time(0), m_nb_received(0),
+m_nb_short_reads(0), m_nb_header_anomalies(0), m_nb_late(0), m_max_gap(0),
+m_delay_mean(0), m_delay_m2(0), m_delay_max(0)
+{
+	DEB_CONSTRUCTOR();
+}
+
+double FrameAccounting::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+void FrameAccounting::start(int nb_expected, double period, bool paced, double start_time)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR3(nb_expected, period, paced);
+
+	AutoMutex aLock(m_lock);
+	m_nb_expected = nb_expected;
+	m_period = period;
+	m_paced = paced;
+	m_start_time = start_time;
+	m_receive_times.clear();
+	m_receive_times.reserve(nb_expected);
+	m_nb_received = 0;
+	m_nb_short_reads = 0;
+	m_nb_header_anomalies = 0;
+	m_nb_late = 0;
+	m_max_gap = 0;
+	m_delay_mean = 0;
+	m_delay_m2 = 0;
+	m_delay_max = 0;
+}
+
+void FrameAccounting::frameReceived(double receive_time)
+{
+	AutoMutex aLock(m_lock);
+	if (m_nb_received > 0)
+	{
+		double gap = receive_time - m_receive_times.back();
+		if (gap > m_max_gap)
+			m_max_gap = gap;
+		if (m_paced && gap > 1.5 * m_period)
+			++m_nb_late;
+	}
+
+	double delay = receive_time - (m_start_time + m_nb_received * m_period);
+	if (m_nb_received == 0 || delay > m_delay_max)
+		m_delay_max = delay;
+	double deviation = delay - m_delay_mean;
+	m_delay_mean += deviation / (m_nb_received + 1);
+	m_delay_m2 += deviation * (delay - m_delay_mean);
+
+	m_receive_times.push_back(receive_time);
+	++m_nb_received;
+}
+
+void FrameAccounting::shortRead()
+{
+	AutoMutex aLock(m_lock);
+	++m_nb_short_reads;
+}
+
+void FrameAccounting::headerAnomaly()
+{
+	AutoMutex aLock(m_lock);
+	++m_nb_header_anomalies;
+}
+
+int FrameAccounting::getNbExpected() const
+{
+	AutoMutex aLock(m_lock);
+	return m_nb_expected;
+}
+
+int FrameAccounting::getNbReceived() const
+{
+	AutoMutex aLock(m_lock);
+	return m_nb_received;
+}
+
+int FrameAccounting::getNbShortReads() const
+{
+	AutoMutex aLock(m_lock);
+	return m_nb_short_reads;
+}
+
+int FrameAccounting::getNbHeaderAnomalies() const
+{
+	AutoMutex aLock(m_lock);
+	return m_nb_header_anomalies;
+}
+
+int FrameAccounting::getNbLateFrames() const
+{
+	AutoMutex aLock(m_lock);
+	return m_nb_late;
+}
+
+double FrameAccounting::getMaxGap() const
+{
+	AutoMutex aLock(m_lock);
+	return m_max_gap;
+}
+
+bool FrameAccounting::getFrameTiming(int frame_nb, double& receive_time, double& exposure_start) const
+{
+	AutoMutex aLock(m_lock);
+	if (frame_nb < 0 || frame_nb >= m_nb_received)
+		return false;
+	receive_time = m_receive_times[frame_nb];
+	exposure_start = m_start_time + frame_nb * m_period;
+	return true;
+}
+
+void FrameAccounting::getDelayStatistics(double& mean, double& jitter, double& max) const
+{
+	AutoMutex aLock(m_lock);
+	mean = m_delay_mean;
+	jitter = (m_nb_received > 1) ? std::sqrt(m_delay_m2 / (m_nb_received - 1)) : 0;
+	max = m_delay_max;
+}
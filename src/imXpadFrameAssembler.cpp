@@ -0,0 +1,212 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cstring>
+#include <algorithm>
+#include <time.h>
+#include "imXpadFrameAssembler.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+FrameAssembler::FrameAssembler() :
+m_sink(NULL), m_depth(0), m_next_frame(0), m_stopped(true), m_max_skew(0), m_nb_waits(0)
+{
+}
+
+int FrameAssembler::addTile(int x, int y, int width, int height)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR4(x, y, width, height);
+
+	if (x < 0 || y < 0 || width <= 0 || height <= 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid tile " << width << "x" << height << " at " << x << "," << y;
+
+	std::vector<Tile>::const_iterator t;
+	for (t = m_tiles.begin(); t != m_tiles.end(); ++t)
+		if (x < t->x + t->width && t->x < x + width && y < t->y + t->height && t->y < y + height)
+			THROW_HW_ERROR(InvalidValue) << "Tile at " << x << "," << y << " overlaps the one at "
+										 << t->x << "," << t->y;
+
+	Tile tile = {x, y, width, height};
+	m_tiles.push_back(tile);
+	return m_tiles.size() - 1;
+}
+
+void FrameAssembler::clearTiles()
+{
+	m_tiles.clear();
+}
+
+int FrameAssembler::getNbTiles() const
+{
+	return m_tiles.size();
+}
+
+const FrameAssembler::Tile& FrameAssembler::getTile(int tile) const
+{
+	return m_tiles[tile];
+}
+
+Size FrameAssembler::getFrameSize() const
+{
+	int width = 0, height = 0;
+	std::vector<Tile>::const_iterator t;
+	for (t = m_tiles.begin(); t != m_tiles.end(); ++t)
+	{
+		width = std::max(width, t->x + t->width);
+		height = std::max(height, t->y + t->height);
+	}
+	return Size(width, height);
+}
+
+void FrameAssembler::prepare(Sink *sink, int depth, int nb_slots)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(depth, nb_slots);
+
+	if (m_tiles.empty())
+		THROW_HW_ERROR(Error) << "No tile to assemble";
+	if (nb_slots < 1)
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_slots);
+
+	AutoMutex aLock(m_cond.mutex());
+	m_sink = sink;
+	m_depth = depth;
+	Slot empty = {-1, 0, Timestamp(), 0};
+	m_slots.assign(nb_slots, empty);
+	m_next_frame = 0;
+	m_stopped = false;
+	m_max_skew = 0;
+	m_nb_waits = 0;
+	_clearGaps();
+}
+
+// the buffers are reused between acquisitions, only tiles overwrite them
+void FrameAssembler::_clearGaps()
+{
+	Size size = getFrameSize();
+	long long frame_pixels = (long long) size.getWidth() * size.getHeight();
+	long long tile_pixels = 0;
+	std::vector<Tile>::const_iterator t;
+	for (t = m_tiles.begin(); t != m_tiles.end(); ++t)
+		tile_pixels += (long long) t->width * t->height;
+	if (tile_pixels == frame_pixels)
+		return;
+
+	for (unsigned int s = 0; s < m_slots.size(); ++s)
+		memset(m_sink->getFrameBuffer(s), 0, frame_pixels * m_depth);
+}
+
+bool FrameAssembler::placeTile(int tile, int frame_nb, const void *data, const Timestamp& timestamp)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	int nb_slots = m_slots.size();
+	if (!m_stopped && frame_nb >= m_next_frame + nb_slots)
+	{
+		++m_nb_waits;
+		while (!m_stopped && frame_nb >= m_next_frame + nb_slots)
+			m_cond.wait();
+	}
+	if (m_stopped)
+		return false;
+
+	Slot& slot = m_slots[frame_nb % nb_slots];
+	if (slot.frame_nb != frame_nb)
+	{
+		slot.frame_nb = frame_nb;
+		slot.nb_tiles = 0;
+		slot.timestamp = timestamp;
+		slot.first_tile = now();
+	}
+	char *frame = (char *) m_sink->getFrameBuffer(frame_nb);
+	const Tile& t = m_tiles[tile];
+	int frame_line = getFrameSize().getWidth() * m_depth;
+	aLock.unlock();
+
+	int tile_line = t.width * m_depth;
+	char *dst = frame + t.y * frame_line + t.x * m_depth;
+	const char *src = (const char *) data;
+	for (int y = 0; y < t.height; ++y, dst += frame_line, src += tile_line)
+		memcpy(dst, src, tile_line);
+
+	aLock.lock();
+	if (m_stopped)
+		return false;
+	if (++slot.nb_tiles < int(m_tiles.size()))
+		return true;
+
+	double skew = now() - slot.first_tile;
+	if (skew > m_max_skew)
+		m_max_skew = skew;
+
+	// hand over this frame and the ones completed before it, in order
+	bool ok = true;
+	while (ok && !m_stopped)
+	{
+		Slot& next = m_slots[m_next_frame % nb_slots];
+		if (next.frame_nb != m_next_frame || next.nb_tiles < int(m_tiles.size()))
+			break;
+		ok = m_sink->frameAssembled(m_next_frame, next.timestamp);
+		++m_next_frame;
+	}
+	if (!ok)
+		m_stopped = true;
+	m_cond.broadcast();
+	return ok;
+}
+
+void FrameAssembler::stop()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	m_stopped = true;
+	m_cond.broadcast();
+}
+
+int FrameAssembler::getNbAssembledFrames() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_next_frame;
+}
+
+double FrameAssembler::getMaxTileSkew() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_max_skew;
+}
+
+int FrameAssembler::getNbTileWaits() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_nb_waits;
+}
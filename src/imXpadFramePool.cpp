@@ -0,0 +1,266 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cstring>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "imXpadFramePool.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t roundUp(size_t size, size_t align)
+{
+	return (size + align - 1) / align * align;
+}
+
+FramePool::FramePool() :
+m_nb_buffers(0), m_stride(0), m_huge_page_mode(NoHugePage),
+m_map_base(NULL), m_map_size(0), m_base(NULL), m_size(0), m_prefaulted(0),
+m_prefault_time(0), m_numa_node(-1)
+{
+	DEB_CONSTRUCTOR();
+}
+
+FramePool::~FramePool()
+{
+	DEB_DESTRUCTOR();
+	_unmap();
+}
+
+int FramePool::getMaxNbBuffers(const FrameDim& frame_dim)
+{
+	DEB_MEMBER_FUNCT();
+
+	size_t stride = roundUp(frame_dim.getMemSize(), sysconf(_SC_PAGESIZE));
+	if (!stride)
+		return 0;
+
+	// same share of the system memory as the default Lima allocator
+	int mem_unit;
+	int tot_mem = SoftBufferAllocMgr::getSystemMem(mem_unit);
+	long long max_mem = (long long) tot_mem * mem_unit * 7 / 10;
+	int max_nb_buffers = max_mem / stride;
+	DEB_RETURN() << DEB_VAR1(max_nb_buffers);
+	return max_nb_buffers;
+}
+
+void FramePool::allocBuffers(int nb_buffers, const FrameDim& frame_dim)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(nb_buffers, frame_dim);
+
+	if (nb_buffers <= 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid number of buffers " << nb_buffers;
+
+	size_t stride = roundUp(frame_dim.getMemSize(), sysconf(_SC_PAGESIZE));
+	size_t size = stride * nb_buffers;
+
+	// reuse the mapping of the previous acquisitions when it is large enough
+	if (size > m_size)
+		_map(size);
+
+	m_frame_dim = frame_dim;
+	m_nb_buffers = nb_buffers;
+	m_stride = stride;
+
+	DEB_TRACE() << "Allocated " << nb_buffers << " buffers of " << stride
+				<< " bytes in a mapping of " << m_size << " bytes";
+}
+
+const FrameDim& FramePool::getFrameDim()
+{
+	return m_frame_dim;
+}
+
+void FramePool::getNbBuffers(int& nb_buffers)
+{
+	nb_buffers = m_nb_buffers;
+}
+
+void FramePool::releaseBuffers()
+{
+	DEB_MEMBER_FUNCT();
+
+	// the mapping is kept for the next acquisition
+	m_nb_buffers = 0;
+}
+
+void *FramePool::getBufferPtr(int buffer_nb)
+{
+	if (buffer_nb < 0 || buffer_nb >= m_nb_buffers)
+		return NULL;
+	return m_base + buffer_nb * m_stride;
+}
+
+void FramePool::setHugePageMode(HugePageMode mode)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(mode);
+
+	m_huge_page_mode = mode;
+}
+
+FramePool::HugePageMode FramePool::getHugePageMode() const
+{
+	return m_huge_page_mode;
+}
+
+void FramePool::prefault()
+{
+	DEB_MEMBER_FUNCT();
+
+	size_t needed = m_stride * m_nb_buffers;
+	if (m_prefaulted >= needed)
+	{
+		m_prefault_time = 0;
+		return;
+	}
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	// one write per page, the buffers content is left to the acquisition
+	size_t page = sysconf(_SC_PAGESIZE);
+	volatile char *p = m_base + m_prefaulted;
+	volatile char *last = m_base + needed;
+	for (; p < last; p += page)
+		*p = 0;
+	m_prefaulted = needed;
+
+	gettimeofday(&end, NULL);
+	m_prefault_time = (end.tv_sec - start.tv_sec) + 1e-6 * (end.tv_usec - start.tv_usec);
+	DEB_TRACE() << "Prefaulted " << needed << " bytes in " << m_prefault_time << " s";
+}
+
+void FramePool::freeMemory()
+{
+	DEB_MEMBER_FUNCT();
+
+	if (m_nb_buffers)
+		THROW_HW_ERROR(Error) << "Frame buffers still in use";
+	_unmap();
+}
+
+void FramePool::setNumaNode(int node)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(node);
+
+	if (node >= int(sizeof(unsigned long) * 8))
+		THROW_HW_ERROR(InvalidValue) << "Invalid NUMA node " << node;
+	if (node == m_numa_node)
+		return;
+
+	m_numa_node = node;
+	if (m_map_base)
+		_bind();
+}
+
+int FramePool::getNumaNode() const
+{
+	return m_numa_node;
+}
+
+size_t FramePool::getMappedSize() const
+{
+	return m_size;
+}
+
+double FramePool::getPrefaultTime() const
+{
+	return m_prefault_time;
+}
+
+void FramePool::_map(size_t size)
+{
+	DEB_MEMBER_FUNCT();
+
+	_unmap();
+
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	if (m_huge_page_mode == HugeTLB)
+	{
+		size = roundUp(size, HUGE_PAGE_SIZE);
+		void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED)
+		{
+			m_map_base = m_base = (char *) ptr;
+			m_map_size = m_size = size;
+			if (m_numa_node >= 0)
+				_bind();
+			return;
+		}
+		DEB_WARNING() << "MAP_HUGETLB failed (" << strerror(errno)
+					  << "), falling back on transparent hugepages";
+	}
+
+	// over-allocate so that the buffers start on a hugepage boundary
+	size_t map_size = size + ((m_huge_page_mode != NoHugePage) ? HUGE_PAGE_SIZE : 0);
+	void *ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (ptr == MAP_FAILED)
+		THROW_HW_ERROR(Error) << "Cannot map " << map_size << " bytes of frame memory: "
+							  << strerror(errno);
+
+	m_map_base = (char *) ptr;
+	m_map_size = map_size;
+	m_base = m_map_base;
+	m_size = size;
+
+	if (m_huge_page_mode != NoHugePage)
+	{
+		m_base = (char *) roundUp((size_t) m_map_base, HUGE_PAGE_SIZE);
+		if (madvise(m_base, m_size, MADV_HUGEPAGE) < 0)
+			DEB_WARNING() << "madvise(MADV_HUGEPAGE) failed: " << strerror(errno);
+	}
+	if (m_numa_node >= 0)
+		_bind();
+}
+
+void FramePool::_bind()
+{
+	DEB_MEMBER_FUNCT();
+
+	// raw syscall, the plugin does not link against libnuma
+	unsigned long mask = (m_numa_node >= 0) ? 1UL << m_numa_node : 0;
+	int mode = (m_numa_node >= 0) ? MPOL_PREFERRED : MPOL_DEFAULT;
+	unsigned long max_node = (m_numa_node >= 0) ? sizeof(mask) * 8 : 0;
+	if (syscall(SYS_mbind, m_map_base, m_map_size, mode, m_numa_node >= 0 ? &mask : NULL,
+				max_node, MPOL_MF_MOVE) < 0)
+		DEB_WARNING() << "Cannot bind frame memory to NUMA node " << m_numa_node
+					  << ": " << strerror(errno);
+}
+
+void FramePool::_unmap()
+{
+	if (m_map_base)
+		munmap(m_map_base, m_map_size);
+	m_map_base = m_base = NULL;
+	m_map_size = m_size = 0;
+	m_prefaulted = 0;
+}
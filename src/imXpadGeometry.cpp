@@ -0,0 +1,228 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <stdint.h>
+#include <sys/time.h>
+#include "imXpadGeometry.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- kernel
+//---------------------------
+
+template <class T>
+static void remapKernel(const T *__restrict raw, T *__restrict frame,
+						const int *__restrict src, const float *__restrict weight,
+						int begin, int end)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		int s = src[i];
+		T value = (s >= 0) ? raw[s] : 0;
+		float w = weight[i];
+		frame[i] = (w == 1.f) ? value : T(float(value) * w + 0.5f);
+	}
+}
+
+class Geometry::RemapTask: public WorkerPool::Task
+{
+public:
+	RemapTask(const Geometry& geom, const void *raw, void *frame, int depth) :
+	m_geom(geom), m_raw(raw), m_frame(frame), m_depth(depth) {}
+
+	virtual void process(int begin, int end)
+	{
+		int width = m_geom.m_corrected_size.getWidth();
+		int height = m_geom.m_corrected_size.getHeight();
+		int first = begin * m_geom.m_block_lines * width;
+		int last = end * m_geom.m_block_lines;
+		last = ((last < height) ? last : height) * width;
+
+		if (m_depth == 2)
+			remapKernel((const uint16_t *) m_raw, (uint16_t *) m_frame,
+						&m_geom.m_src[0], &m_geom.m_weight[0], first, last);
+		else
+			remapKernel((const uint32_t *) m_raw, (uint32_t *) m_frame,
+						&m_geom.m_src[0], &m_geom.m_weight[0], first, last);
+	}
+
+private:
+	const Geometry&	m_geom;
+	const void		*m_raw;
+	void			*m_frame;
+	int				m_depth;
+} ;
+
+//---------------------------
+//- Geometry
+//---------------------------
+
+Geometry::Geometry(WorkerPool& pool, int chip_lines, int chip_columns) :
+m_pool(pool), m_chip_lines(chip_lines), m_chip_columns(chip_columns),
+m_chip_gap(3), m_module_gap(0), m_block_lines(16),
+m_nb_modules(0), m_nb_chips(0), m_remap_time(0)
+{
+	DEB_CONSTRUCTOR();
+}
+
+Geometry::~Geometry()
+{
+	DEB_DESTRUCTOR();
+}
+
+void Geometry::setGaps(int chip_gap, int module_gap)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(chip_gap, module_gap);
+
+	if (chip_gap < 0 || module_gap < 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid gaps " << DEB_VAR2(chip_gap, module_gap);
+
+	m_chip_gap = chip_gap;
+	m_module_gap = module_gap;
+	// force the next build
+	m_nb_modules = m_nb_chips = 0;
+}
+
+void Geometry::getGaps(int& chip_gap, int& module_gap) const
+{
+	chip_gap = m_chip_gap;
+	module_gap = m_module_gap;
+}
+
+void Geometry::setBlockLines(int block_lines)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(block_lines);
+
+	if (block_lines <= 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid block size " << block_lines;
+	m_block_lines = block_lines;
+}
+
+int Geometry::getBlockLines() const
+{
+	return m_block_lines;
+}
+
+void Geometry::build(int nb_modules, int nb_chips)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(nb_modules, nb_chips);
+
+	if (nb_modules <= 0 || nb_chips <= 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid layout " << DEB_VAR2(nb_modules, nb_chips);
+	if (nb_modules == m_nb_modules && nb_chips == m_nb_chips)
+		return;
+
+	int raw_width = nb_chips * m_chip_columns;
+	int width = raw_width + (nb_chips - 1) * m_chip_gap;
+	int height = nb_modules * m_chip_lines + (nb_modules - 1) * m_module_gap;
+
+	m_raw_size = Size(raw_width, nb_modules * m_chip_lines);
+	m_corrected_size = Size(width, height);
+	m_src.assign(width * height, -1);
+	m_weight.assign(width * height, 1.f);
+
+	// left side of a gap goes to the wide pixel before it, right side to the one after
+	int left_gap = (m_chip_gap + 1) / 2;
+	int right_gap = m_chip_gap / 2;
+
+	for (int module = 0; module < nb_modules; ++module)
+	{
+		for (int line = 0; line < m_chip_lines; ++line)
+		{
+			int src_line = module * m_chip_lines + line;
+			int dst_line = module * (m_chip_lines + m_module_gap) + line;
+
+			for (int chip = 0; chip < nb_chips; ++chip)
+			{
+				int src_col = chip * m_chip_columns;
+				int dst_col = chip * (m_chip_columns + m_chip_gap);
+
+				for (int col = 0; col < m_chip_columns; ++col)
+				{
+					int src = src_line * raw_width + src_col + col;
+					if (col == 0 && chip > 0 && right_gap > 0)
+						_spread(dst_line, dst_col, src, right_gap + 1, -1);
+					else if (col == m_chip_columns - 1 && chip < nb_chips - 1 && left_gap > 0)
+						_spread(dst_line, dst_col + col, src, left_gap + 1, 1);
+					else
+						m_src[dst_line * width + dst_col + col] = src;
+				}
+			}
+		}
+	}
+
+	m_nb_modules = nb_modules;
+	m_nb_chips = nb_chips;
+
+	DEB_TRACE() << "Remap table " << m_raw_size.getWidth() << "x" << m_raw_size.getHeight()
+				<< " -> " << width << "x" << height;
+}
+
+void Geometry::_spread(int dst_line, int dst_col, int src, int nb, int step)
+{
+	int width = m_corrected_size.getWidth();
+	float weight = 1.f / nb;
+	for (int i = 0; i < nb; ++i)
+	{
+		int dst = dst_line * width + dst_col + i * step;
+		m_src[dst] = src;
+		m_weight[dst] = weight;
+	}
+}
+
+const Size& Geometry::getRawSize() const
+{
+	return m_raw_size;
+}
+
+const Size& Geometry::getCorrectedSize() const
+{
+	return m_corrected_size;
+}
+
+void Geometry::apply(const void *raw, void *frame, int depth)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (m_src.empty())
+		THROW_HW_ERROR(Error) << "Remap table not built";
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	int nb_blocks = (m_corrected_size.getHeight() + m_block_lines - 1) / m_block_lines;
+	RemapTask task(*this, raw, frame, depth);
+	m_pool.run(task, nb_blocks);
+
+	gettimeofday(&end, NULL);
+	m_remap_time = (end.tv_sec - start.tv_sec) + 1e-6 * (end.tv_usec - start.tv_usec);
+}
+
+double Geometry::getRemapTime() const
+{
+	return m_remap_time;
+}
@@ -0,0 +1,338 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <sys/time.h>
+#include "imXpadModuleReadout.h"
+#include "imXpadClient.h"
+#include "imXpadCommandBuilder.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+//---------------------------
+//- module thread
+//---------------------------
+
+class ModuleReadout::ModuleThread: public Thread
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "ModuleReadout", "ModuleThread");
+public:
+	ModuleThread(ModuleReadout& readout, XpadClient *client, int module, int band);
+	virtual ~ModuleThread();
+
+	XpadClient *getClient() { return m_client; }
+	int getModule() const { return m_module; }
+
+protected:
+	virtual void threadFunction();
+
+private:
+	ModuleReadout&	m_readout;
+	XpadClient		*m_client;
+	int				m_module;
+	int				m_band;
+	int				m_generation;
+	int				m_affinity_generation;
+} ;
+
+ModuleReadout::ModuleThread::ModuleThread(ModuleReadout& readout, XpadClient *client,
+										  int module, int band) :
+m_readout(readout), m_client(client), m_module(module), m_band(band),
+m_generation(readout.m_generation), m_affinity_generation(0)
+{
+}
+
+ModuleReadout::ModuleThread::~ModuleThread()
+{
+}
+
+void ModuleReadout::ModuleThread::threadFunction()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_readout.m_cond.mutex());
+
+	while (1)
+	{
+		while (!m_readout.m_quit && m_generation == m_readout.m_generation)
+			m_readout.m_cond.wait();
+		if (m_readout.m_quit)
+			break;
+
+		m_generation = m_readout.m_generation;
+		size_t band_bytes = m_readout.m_band_bytes;
+		char *band = m_readout.m_frame + m_band * band_bytes;
+		int format = (m_readout.m_depth == 2) ? 0 : 1;
+		bool new_affinity = (m_affinity_generation != m_readout.m_affinity_generation);
+		CpuAffinity affinity = m_readout.m_affinity;
+		m_affinity_generation = m_readout.m_affinity_generation;
+		aLock.unlock();
+
+		if (new_affinity)
+			affinity.applyToCurrentThread();
+
+		int ret;
+		try
+		{
+			ret = m_client->getDataExpose(band, format, band_bytes);
+		}
+		catch (Exception& e)
+		{
+			DEB_ERROR() << "Module " << m_module << " readout failed: " << e.getErrMsg();
+			ret = -1;
+		}
+		double arrival = now();
+
+		aLock.lock();
+		if (ret != 0)
+			++m_readout.m_failed;
+		// a module stream has no end marker, an aborted one is reopened
+		if (m_client->isResyncPending())
+			m_readout.m_reconnect = true;
+		if (m_readout.m_first_band == 0 || arrival < m_readout.m_first_band)
+			m_readout.m_first_band = arrival;
+		if (arrival > m_readout.m_last_band)
+			m_readout.m_last_band = arrival;
+		if (--m_readout.m_pending == 0)
+			m_readout.m_cond.broadcast();
+	}
+
+	--m_readout.m_running;
+	m_readout.m_cond.broadcast();
+}
+
+//---------------------------
+//- ModuleReadout
+//---------------------------
+
+ModuleReadout::ModuleReadout() :
+m_frame(NULL), m_frame_nb(-1), m_band_bytes(0), m_depth(4),
+m_generation(0), m_pending(0), m_running(0), m_failed(0), m_first_band(0), m_last_band(0), m_quit(false),
+m_affinity_generation(0), m_port(0), m_module_mask(0), m_codec(NULL), m_abort(NULL), m_reconnect(false)
+{
+	DEB_CONSTRUCTOR();
+}
+
+ModuleReadout::~ModuleReadout()
+{
+	DEB_DESTRUCTOR();
+	disconnect();
+}
+
+void ModuleReadout::connect(const std::string& hostname, int port, unsigned int module_mask)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR3(hostname, port, module_mask);
+
+	disconnect();
+
+	AutoMutex aLock(m_cond.mutex());
+	m_quit = false;
+	m_frame_nb = -1;
+	m_hostname = hostname;
+	m_port = port;
+	m_module_mask = module_mask;
+	m_reconnect = false;
+	aLock.unlock();
+
+	int band = 0;
+	for (int module = 0; module < int(sizeof(module_mask) * 8); ++module)
+	{
+		if (!(module_mask & (1u << module)))
+			continue;
+
+		XpadClient *client = new XpadClient();
+		client->setFrameCodec(m_codec);
+		client->setAbortEvent(m_abort);
+		if (client->connectToServer(hostname, port) < 0)
+		{
+			std::string msg = client->getErrorMessage();
+			delete client;
+			disconnect();
+			THROW_HW_ERROR(Error) << "Module " << module << " stream: [ " << msg << " ]";
+		}
+
+		int ret;
+		CommandBuilder cmd("OpenModuleDataStream ");
+		cmd << module;
+		try
+		{
+			client->sendWait(cmd, ret);
+		}
+		catch (Exception& e)
+		{
+			ret = -1;
+		}
+		if (ret != 0)
+		{
+			client->disconnectFromServer();
+			delete client;
+			disconnect();
+			THROW_HW_ERROR(Error) << "Server refused data stream for module " << module;
+		}
+
+		ModuleThread *thread = new ModuleThread(*this, client, module, band++);
+		aLock.lock();
+		++m_running;
+		aLock.unlock();
+		thread->start();
+		m_modules.push_back(thread);
+	}
+
+	if (m_modules.empty())
+		THROW_HW_ERROR(InvalidValue) << "No module enabled in mask " << module_mask;
+
+	DEB_TRACE() << "Opened " << m_modules.size() << " module data streams";
+}
+
+void ModuleReadout::disconnect()
+{
+	DEB_MEMBER_FUNCT();
+
+	if (m_modules.empty())
+		return;
+
+	AutoMutex aLock(m_cond.mutex());
+	m_quit = true;
+	m_cond.broadcast();
+	aLock.unlock();
+
+	// wake up the threads blocked in a read, the sockets are closed once they left
+	std::vector<ModuleThread*>::iterator i;
+	for (i = m_modules.begin(); i != m_modules.end(); ++i)
+		(*i)->getClient()->shutdown();
+
+	aLock.lock();
+	while (m_running > 0)
+		m_cond.wait();
+	aLock.unlock();
+
+	for (i = m_modules.begin(); i != m_modules.end(); ++i)
+	{
+		XpadClient *client = (*i)->getClient();
+		delete *i;
+		client->disconnectFromServer();
+		delete client;
+	}
+	m_modules.clear();
+}
+
+bool ModuleReadout::isConnected() const
+{
+	return !m_modules.empty();
+}
+
+int ModuleReadout::getNbModules() const
+{
+	return m_modules.size();
+}
+
+void ModuleReadout::setFrameCodec(FrameCodec* codec)
+{
+	DEB_MEMBER_FUNCT();
+
+	m_codec = codec;
+	std::vector<ModuleThread*>::iterator i;
+	for (i = m_modules.begin(); i != m_modules.end(); ++i)
+		(*i)->getClient()->setFrameCodec(codec);
+}
+
+void ModuleReadout::setAbortEvent(AbortEvent* abort)
+{
+	DEB_MEMBER_FUNCT();
+
+	m_abort = abort;
+	std::vector<ModuleThread*>::iterator i;
+	for (i = m_modules.begin(); i != m_modules.end(); ++i)
+		(*i)->getClient()->setAbortEvent(abort);
+}
+
+void ModuleReadout::prepare(const Size& frame_size, int depth)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(frame_size, depth);
+
+	AutoMutex aLock(m_cond.mutex());
+	bool reconnect = m_reconnect;
+	aLock.unlock();
+	if (reconnect)
+	{
+		DEB_TRACE() << "Reopening the module data streams after an abort";
+		connect(m_hostname, m_port, m_module_mask);
+	}
+
+	int nb_modules = m_modules.size();
+	if (!nb_modules)
+		THROW_HW_ERROR(Error) << "Module data streams not opened";
+	if (frame_size.getHeight() % nb_modules)
+		THROW_HW_ERROR(Error) << "Frame height " << frame_size.getHeight()
+							  << " is not a multiple of " << nb_modules << " modules";
+
+	aLock.lock();
+	m_depth = depth;
+	m_band_bytes = frame_size.getWidth() * (frame_size.getHeight() / nb_modules) * depth;
+}
+
+int ModuleReadout::readFrame(void *bptr, int frame_nb)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	if (m_modules.empty())
+		THROW_HW_ERROR(Error) << "Module data streams not opened";
+
+	m_frame = (char *) bptr;
+	m_frame_nb = frame_nb;
+	++m_generation;
+	m_pending = m_modules.size();
+	m_failed = 0;
+	m_first_band = m_last_band = 0;
+	m_cond.broadcast();
+
+	while (m_pending > 0)
+		m_cond.wait();
+
+	DEB_TRACE() << "frame " << frame_nb << " complete, band skew " << m_last_band - m_first_band;
+	return m_failed ? -1 : 0;
+}
+
+double ModuleReadout::getLastFrameSkew() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_last_band - m_first_band;
+}
+
+void ModuleReadout::setCpuAffinity(const CpuAffinity& affinity)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	m_affinity = affinity;
+	++m_affinity_generation;
+}
@@ -0,0 +1,118 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "imXpadModuleRoi.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+ModuleRoi::ModuleRoi() :
+m_x(0), m_y(0), m_width(0), m_height(0), m_module_mask(0), m_first_line(0), m_nb_lines(0)
+{
+}
+
+void ModuleRoi::setRegion(int x, int y, int width, int height)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR4(x, y, width, height);
+
+	if (x < 0 || y < 0 || width < 0 || height < 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid region " << width << "x" << height << " at " << x << "," << y;
+
+	if (width == 0 || height == 0)
+		x = y = width = height = 0;
+	m_x = x;
+	m_y = y;
+	m_width = width;
+	m_height = height;
+}
+
+void ModuleRoi::getRegion(int& x, int& y, int& width, int& height) const
+{
+	x = m_x;
+	y = m_y;
+	width = m_width;
+	height = m_height;
+}
+
+bool ModuleRoi::isEmpty() const
+{
+	return m_width == 0;
+}
+
+int ModuleRoi::getNbModules(unsigned int module_mask)
+{
+	int nb_modules = 0;
+	for (; module_mask; module_mask >>= 1)
+		nb_modules += module_mask & 1;
+	return nb_modules;
+}
+
+unsigned int ModuleRoi::map(unsigned int detector_mask, const Size& full_size)
+{
+	DEB_MEMBER_FUNCT();
+
+	int nb_modules = getNbModules(detector_mask);
+	int full_lines = full_size.getHeight();
+	if (nb_modules == 0 || full_lines == 0)
+		THROW_HW_ERROR(Error) << "No module in the detector mask " << detector_mask;
+
+	if (isEmpty())
+	{
+		m_module_mask = detector_mask;
+		m_first_line = 0;
+		m_nb_lines = full_lines;
+		return m_module_mask;
+	}
+
+	if (m_x + m_width > full_size.getWidth() || m_y + m_height > full_lines)
+		THROW_HW_ERROR(InvalidValue) << "Region " << m_width << "x" << m_height << " at " << m_x << "," << m_y
+									 << " outside the " << full_size.getWidth() << "x" << full_lines << " detector";
+
+	// bands of the first and the last line of the region
+	int first = (long long) m_y * nb_modules / full_lines;
+	int last = (long long) (m_y + m_height - 1) * nb_modules / full_lines;
+
+	m_module_mask = 0;
+	int band = 0;
+	for (unsigned int bit = 1; bit; bit <<= 1)
+	{
+		if (!(detector_mask & bit))
+			continue;
+		if (band >= first && band <= last)
+			m_module_mask |= bit;
+		++band;
+	}
+	// a band starts at the first line mapped to it
+	m_first_line = ((long long) first * full_lines + nb_modules - 1) / nb_modules;
+	m_nb_lines = ((long long) (last + 1) * full_lines + nb_modules - 1) / nb_modules - m_first_line;
+
+	DEB_RETURN() << DEB_VAR3(m_module_mask, m_first_line, m_nb_lines);
+	return m_module_mask;
+}
+
+void ModuleRoi::getReadout(unsigned int& module_mask, int& first_line, int& nb_lines) const
+{
+	module_mask = m_module_mask;
+	first_line = m_first_line;
+	nb_lines = m_nb_lines;
+}
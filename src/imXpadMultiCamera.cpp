@@ -0,0 +1,400 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "imXpadMultiCamera.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- camera link
+//---------------------------
+
+// receives the frames and the size changes of one detector
+class MultiCamera::CameraLink : public HwFrameCallback, public HwMaxImageSizeCallback
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "MultiCamera", "CameraLink");
+public:
+	CameraLink(MultiCamera& multi, int index) : m_multi(multi), m_index(index) {}
+
+protected:
+	// called by the receiving thread of the detector, which copies its tile
+	virtual bool newFrameReady(const HwFrameInfoType& frame_info)
+	{
+		return m_multi.m_assembler.placeTile(m_index, frame_info.acq_frame_nb, frame_info.frame_ptr,
+											 frame_info.frame_timestamp);
+	}
+
+	virtual void maxImageSizeChanged(const Size& size, ImageType image_type)
+	{
+		m_multi._cameraSizeChanged(m_index, size);
+	}
+
+private:
+	MultiCamera&	m_multi;
+	int				m_index;
+} ;
+
+//---------------------------
+//- multi camera
+//---------------------------
+
+MultiCamera::MultiCamera() :
+m_nb_camera_buffers(16)
+{
+	DEB_CONSTRUCTOR();
+}
+
+MultiCamera::~MultiCamera()
+{
+	DEB_DESTRUCTOR();
+
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+	{
+		m_cameras[i]->getBufferCtrlObj()->unregisterFrameCallback(*m_links[i]);
+		m_cameras[i]->unregisterMaxImageSizeCallback(*m_links[i]);
+		delete m_links[i];
+	}
+}
+
+void MultiCamera::addCamera(Camera& cam, int x, int y)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(x, y);
+
+	Size size;
+	cam.getImageSize(size);
+
+	m_cameras.push_back(&cam);
+	m_offsets.push_back(Point(x, y));
+	m_sizes.push_back(size);
+	try
+	{
+		_buildLayout();
+	}
+	catch (Exception& e)
+	{
+		m_cameras.pop_back();
+		m_offsets.pop_back();
+		m_sizes.pop_back();
+		_buildLayout();
+		throw;
+	}
+
+	CameraLink *link = new CameraLink(*this, m_cameras.size() - 1);
+	m_links.push_back(link);
+	cam.getBufferCtrlObj()->registerFrameCallback(*link);
+	cam.registerMaxImageSizeCallback(*link);
+}
+
+int MultiCamera::getNbCameras() const
+{
+	return m_cameras.size();
+}
+
+Camera& MultiCamera::getCamera(int index)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (index < 0 || index >= int(m_cameras.size()))
+		THROW_HW_ERROR(InvalidValue) << "No camera " << index << ", " << m_cameras.size() << " in the layout";
+	return *m_cameras[index];
+}
+
+void MultiCamera::getCameraLayout(int index, int& x, int& y, int& width, int& height)
+{
+	DEB_MEMBER_FUNCT();
+
+	getCamera(index);
+	x = m_offsets[index].x;
+	y = m_offsets[index].y;
+	width = m_sizes[index].getWidth();
+	height = m_sizes[index].getHeight();
+}
+
+void MultiCamera::_cameraSizeChanged(int index, const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+
+	m_sizes[index] = size;
+	try
+	{
+		_buildLayout();
+	}
+	catch (Exception& e)
+	{
+		DEB_ERROR() << "Camera " << index << " no longer fits in the layout: " << e.getErrMsg();
+	}
+}
+
+void MultiCamera::_buildLayout()
+{
+	DEB_MEMBER_FUNCT();
+
+	Size previous = m_assembler.getFrameSize();
+	m_assembler.clearTiles();
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_assembler.addTile(m_offsets[i].x, m_offsets[i].y, m_sizes[i].getWidth(), m_sizes[i].getHeight());
+
+	Size size = m_assembler.getFrameSize();
+	if (!m_cameras.empty() && (size.getWidth() != previous.getWidth() || size.getHeight() != previous.getHeight()))
+	{
+		ImageType image_type;
+		getImageType(image_type);
+		maxImageSizeChanged(size, image_type);
+	}
+}
+
+int MultiCamera::prepareAcq()
+{
+	DEB_MEMBER_FUNCT();
+
+	// the module masks or the geometry may have changed behind our back
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_cameras[i]->getImageSize(m_sizes[i]);
+	_buildLayout();
+
+	ImageType image_type;
+	getImageType(image_type);
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+	{
+		ImageType cam_type;
+		m_cameras[i]->getImageType(cam_type);
+		if (cam_type != image_type)
+			THROW_HW_ERROR(InvalidValue) << "Camera " << i << " has another pixel depth than camera 0";
+
+		HwBufferCtrlObj *buffer = m_cameras[i]->getBufferCtrlObj();
+		buffer->setFrameDim(FrameDim(m_sizes[i], image_type));
+		buffer->setNbBuffers(m_nb_camera_buffers);
+	}
+
+	int nb_buffers;
+	m_buffer_ctrl_obj.getNbBuffers(nb_buffers);
+	m_assembler.prepare(this, FrameDim::getImageTypeDepth(image_type), nb_buffers);
+
+	int ret = 0;
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		if (m_cameras[i]->prepareAcq() != 0)
+			ret = -1;
+	return ret;
+}
+
+void MultiCamera::startAcq()
+{
+	DEB_MEMBER_FUNCT();
+
+	m_buffer_ctrl_obj.getBuffer().setStartTimestamp(Timestamp::now());
+	try
+	{
+		for (unsigned int i = 0; i < m_cameras.size(); ++i)
+			m_cameras[i]->startAcq();
+	}
+	catch (Exception& e)
+	{
+		abortCurrentProcess();
+		waitAcqEnd();
+		throw;
+	}
+}
+
+void MultiCamera::abortCurrentProcess()
+{
+	DEB_MEMBER_FUNCT();
+
+	// a detector waiting for the others must not hold its thread
+	m_assembler.stop();
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_cameras[i]->abortCurrentProcess();
+}
+
+void MultiCamera::waitAcqEnd()
+{
+	DEB_MEMBER_FUNCT();
+
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_cameras[i]->waitAcqEnd();
+}
+
+void *MultiCamera::getFrameBuffer(int frame_nb)
+{
+	return m_buffer_ctrl_obj.getBuffer().getFrameBufferPtr(frame_nb);
+}
+
+bool MultiCamera::frameAssembled(int frame_nb, const Timestamp& timestamp)
+{
+	DEB_MEMBER_FUNCT();
+
+	HwFrameInfoType frame_info;
+	frame_info.acq_frame_nb = frame_nb;
+	frame_info.frame_timestamp = timestamp;
+	return m_buffer_ctrl_obj.getBuffer().newFrameReady(frame_info);
+}
+
+void MultiCamera::getImageSize(Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	size = m_assembler.getFrameSize();
+}
+
+void MultiCamera::getImageType(ImageType& type)
+{
+	DEB_MEMBER_FUNCT();
+	getCamera(0).getImageType(type);
+}
+
+void MultiCamera::setImageType(ImageType type)
+{
+	DEB_MEMBER_FUNCT();
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_cameras[i]->setImageType(type);
+}
+
+void MultiCamera::getPixelSize(double& size_x, double& size_y)
+{
+	DEB_MEMBER_FUNCT();
+	getCamera(0).getPixelSize(size_x, size_y);
+}
+
+void MultiCamera::getDetectorType(std::string& type)
+{
+	DEB_MEMBER_FUNCT();
+	getCamera(0).getDetectorType(type);
+}
+
+void MultiCamera::getDetectorModel(std::string& model)
+{
+	DEB_MEMBER_FUNCT();
+
+	model.clear();
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+	{
+		std::string cam_model;
+		m_cameras[i]->getDetectorModel(cam_model);
+		if (i > 0)
+			model += "+";
+		model += cam_model;
+	}
+}
+
+HwBufferCtrlObj* MultiCamera::getBufferCtrlObj()
+{
+	return &m_buffer_ctrl_obj;
+}
+
+int MultiCamera::getNbHwAcquiredFrames()
+{
+	DEB_MEMBER_FUNCT();
+	return m_assembler.getNbAssembledFrames();
+}
+
+void MultiCamera::setNbCameraBuffers(int nb_buffers)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(nb_buffers);
+
+	if (nb_buffers < 1)
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_buffers);
+	m_nb_camera_buffers = nb_buffers;
+}
+
+int MultiCamera::getNbCameraBuffers()
+{
+	return m_nb_camera_buffers;
+}
+
+void MultiCamera::setTrigMode(TrigMode mode)
+{
+	DEB_MEMBER_FUNCT();
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_cameras[i]->setTrigMode(mode);
+}
+
+void MultiCamera::getTrigMode(TrigMode& mode)
+{
+	DEB_MEMBER_FUNCT();
+	getCamera(0).getTrigMode(mode);
+}
+
+void MultiCamera::setExpTime(double exp_time)
+{
+	DEB_MEMBER_FUNCT();
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_cameras[i]->setExpTime(exp_time);
+}
+
+void MultiCamera::getExpTime(double& exp_time)
+{
+	DEB_MEMBER_FUNCT();
+	getCamera(0).getExpTime(exp_time);
+}
+
+void MultiCamera::setLatTime(double lat_time)
+{
+	DEB_MEMBER_FUNCT();
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_cameras[i]->setLatTime(lat_time);
+}
+
+void MultiCamera::getLatTime(double& lat_time)
+{
+	DEB_MEMBER_FUNCT();
+	getCamera(0).getLatTime(lat_time);
+}
+
+void MultiCamera::setNbFrames(int nb_frames)
+{
+	DEB_MEMBER_FUNCT();
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+		m_cameras[i]->setNbFrames(nb_frames);
+}
+
+void MultiCamera::getNbFrames(int& nb_frames)
+{
+	DEB_MEMBER_FUNCT();
+	getCamera(0).getNbFrames(nb_frames);
+}
+
+void MultiCamera::getStatus(Camera::XpadStatus& status)
+{
+	DEB_MEMBER_FUNCT();
+
+	status.state = Camera::XpadStatus::Idle;
+	for (unsigned int i = 0; i < m_cameras.size(); ++i)
+	{
+		Camera::XpadStatus cam_status;
+		m_cameras[i]->getStatus(cam_status);
+		if (cam_status.state != Camera::XpadStatus::Idle)
+		{
+			status.state = cam_status.state;
+			break;
+		}
+	}
+	status.completed_frames = m_assembler.getNbAssembledFrames();
+	status.frame_num = status.completed_frames;
+}
+
+void MultiCamera::getAssemblyStatistics(double& max_skew, int& nb_waits)
+{
+	DEB_MEMBER_FUNCT();
+	max_skew = m_assembler.getMaxTileSkew();
+	nb_waits = m_assembler.getNbTileWaits();
+}
@@ -0,0 +1,261 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "imXpadMultiInterface.h"
+#include "imXpadMultiCamera.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- detector info
+//---------------------------
+
+MultiDetInfoCtrlObj::MultiDetInfoCtrlObj(MultiCamera& cam) :
+    m_cam(cam) {
+    DEB_CONSTRUCTOR();
+}
+
+MultiDetInfoCtrlObj::~MultiDetInfoCtrlObj() {
+    DEB_DESTRUCTOR();
+}
+
+void MultiDetInfoCtrlObj::getMaxImageSize(Size& size) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getImageSize(size);
+}
+
+void MultiDetInfoCtrlObj::getDetectorImageSize(Size& size) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getImageSize(size);
+}
+
+void MultiDetInfoCtrlObj::getDefImageType(ImageType& image_type) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getImageType(image_type);
+}
+
+void MultiDetInfoCtrlObj::getCurrImageType(ImageType& image_type) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getImageType(image_type);
+}
+
+void MultiDetInfoCtrlObj::setCurrImageType(ImageType image_type) {
+    DEB_MEMBER_FUNCT();
+    m_cam.setImageType(image_type);
+}
+
+void MultiDetInfoCtrlObj::getPixelSize(double& xsize, double& ysize) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getPixelSize(xsize, ysize);
+}
+
+void MultiDetInfoCtrlObj::getDetectorType(std::string& type) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getDetectorType(type);
+}
+
+void MultiDetInfoCtrlObj::getDetectorModel(std::string& model) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getDetectorModel(model);
+}
+
+void MultiDetInfoCtrlObj::registerMaxImageSizeCallback(HwMaxImageSizeCallback& cb) {
+    DEB_MEMBER_FUNCT();
+    m_cam.registerMaxImageSizeCallback(cb);
+}
+
+void MultiDetInfoCtrlObj::unregisterMaxImageSizeCallback(HwMaxImageSizeCallback& cb) {
+    DEB_MEMBER_FUNCT();
+    m_cam.unregisterMaxImageSizeCallback(cb);
+}
+
+//---------------------------
+//- synchronization
+//---------------------------
+
+MultiSyncCtrlObj::MultiSyncCtrlObj(MultiCamera& cam) :
+    HwSyncCtrlObj(), m_cam(cam) {
+    DEB_CONSTRUCTOR();
+}
+
+MultiSyncCtrlObj::~MultiSyncCtrlObj() {
+    DEB_DESTRUCTOR();
+}
+
+bool MultiSyncCtrlObj::checkTrigMode(TrigMode trig_mode) {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(trig_mode);
+
+    bool valid;
+    switch (trig_mode) {
+    case IntTrig:
+    case ExtTrigSingle:
+    case ExtGate:
+    case ExtTrigMult:
+        valid = true;
+        break;
+
+    default:
+        valid = false;
+    }
+    DEB_RETURN() << DEB_VAR1(valid);
+    return valid;
+}
+
+void MultiSyncCtrlObj::setTrigMode(TrigMode trig_mode) {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(trig_mode);
+
+    if (!checkTrigMode(trig_mode)) {
+        THROW_HW_ERROR(InvalidValue) << "Invalid "
+                                     << DEB_VAR1(trig_mode);
+    }
+    m_cam.setTrigMode(trig_mode);
+}
+
+void MultiSyncCtrlObj::getTrigMode(TrigMode& trig_mode) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getTrigMode(trig_mode);
+}
+
+void MultiSyncCtrlObj::setExpTime(double exp_time) {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(exp_time);
+    m_cam.setExpTime(exp_time);
+}
+
+void MultiSyncCtrlObj::getExpTime(double& exp_time) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getExpTime(exp_time);
+}
+
+void MultiSyncCtrlObj::setLatTime(double lat_time) {
+    DEB_MEMBER_FUNCT();
+    m_cam.setLatTime(lat_time);
+}
+
+void MultiSyncCtrlObj::getLatTime(double& lat_time) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getLatTime(lat_time);
+}
+
+void MultiSyncCtrlObj::setNbHwFrames(int nb_frames) {
+    DEB_MEMBER_FUNCT();
+    m_cam.setNbFrames(nb_frames);
+}
+
+void MultiSyncCtrlObj::getNbHwFrames(int& nb_frames) {
+    DEB_MEMBER_FUNCT();
+    m_cam.getNbFrames(nb_frames);
+}
+
+void MultiSyncCtrlObj::getValidRanges(ValidRangesType& valid_ranges) {
+    DEB_MEMBER_FUNCT();
+    valid_ranges.min_exp_time = 1e-6;
+    valid_ranges.max_exp_time = 4.2e3;
+    valid_ranges.min_lat_time = 1e-6;
+    valid_ranges.max_lat_time = 4.2e3;
+}
+
+//---------------------------
+//- interface
+//---------------------------
+
+MultiInterface::MultiInterface(MultiCamera& cam) :
+    m_cam(cam), m_det_info(cam), m_sync(cam)
+{
+    DEB_CONSTRUCTOR();
+
+    HwDetInfoCtrlObj *det_info = &m_det_info;
+    m_cap_list.push_back(det_info);
+
+    HwBufferCtrlObj *buffer = m_cam.getBufferCtrlObj();
+    m_cap_list.push_back(buffer);
+
+    HwSyncCtrlObj *sync = &m_sync;
+    m_cap_list.push_back(sync);
+}
+
+MultiInterface::~MultiInterface() {
+    DEB_DESTRUCTOR();
+}
+
+void MultiInterface::getCapList(CapList &cap_list) const {
+    DEB_MEMBER_FUNCT();
+    cap_list = m_cap_list;
+}
+
+void MultiInterface::reset(ResetLevel reset_level) {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(reset_level);
+
+    for (int i = 0; i < m_cam.getNbCameras(); ++i)
+        m_cam.getCamera(i).reset();
+}
+
+void MultiInterface::prepareAcq() {
+    DEB_MEMBER_FUNCT();
+    m_cam.prepareAcq();
+}
+
+void MultiInterface::startAcq() {
+    DEB_MEMBER_FUNCT();
+    m_cam.startAcq();
+}
+
+void MultiInterface::stopAcq() {
+    DEB_MEMBER_FUNCT();
+    m_cam.abortCurrentProcess();
+    m_cam.waitAcqEnd();
+}
+
+void MultiInterface::getStatus(StatusType& status) {
+    DEB_MEMBER_FUNCT();
+    Camera::XpadStatus xpadStatus;
+
+    m_cam.getStatus(xpadStatus);
+    switch (xpadStatus.state) {
+    case Camera::XpadStatus::Idle:
+        status.acq = AcqReady;
+        status.det = DetIdle;
+        break;
+    case Camera::XpadStatus::CalibrationManipulation:
+        status.det = DetReadout;
+        status.acq = AcqConfig;
+        break;
+    case Camera::XpadStatus::Calibrating:
+        status.det = DetExposure;
+        status.acq = AcqConfig;
+        break;
+    case Camera::XpadStatus::Acquiring:
+    case Camera::XpadStatus::DigitalTest:
+    case Camera::XpadStatus::Resetting:
+        status.det = DetExposure;
+        status.acq = AcqRunning;
+        break;
+    }
+}
+
+int MultiInterface::getNbHwAcquiredFrames() {
+    DEB_MEMBER_FUNCT();
+    return m_cam.getNbHwAcquiredFrames();
+}
@@ -0,0 +1,207 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include "imXpadPixelStatistics.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- kernel
+//---------------------------
+
+template <class T>
+static void accumulateKernel(const T *__restrict frame, double *__restrict mean, double *__restrict m2,
+							 uint32_t *__restrict min, uint32_t *__restrict max,
+							 uint32_t *__restrict zero_count, int begin, int end, double inv_n)
+{
+	// plain loop without branches so that the compiler vectorizes it
+	for (int i = begin; i < end; ++i)
+	{
+		uint32_t value = frame[i];
+		double x = value;
+		double delta = x - mean[i];
+		mean[i] += delta * inv_n;
+		m2[i] += delta * (x - mean[i]);
+		min[i] = value < min[i] ? value : min[i];
+		max[i] = value > max[i] ? value : max[i];
+		zero_count[i] += (value == 0);
+	}
+}
+
+//---------------------------
+//- task
+//---------------------------
+
+class PixelStatistics::AccumulateTask: public WorkerPool::Task
+{
+public:
+	AccumulateTask(const void *frame, int depth, PixelStatistics& stats) :
+	m_frame(frame), m_depth(depth), m_stats(stats) {}
+
+	virtual void process(int begin, int end)
+	{
+		int width = m_stats.m_size.getWidth();
+		begin *= width;
+		end *= width;
+		double inv_n = 1. / m_stats.m_nb_frames;
+		if (m_depth == 2)
+			accumulateKernel((const uint16_t *) m_frame, &m_stats.m_mean[0], &m_stats.m_m2[0],
+							 &m_stats.m_min[0], &m_stats.m_max[0], &m_stats.m_zero_count[0],
+							 begin, end, inv_n);
+		else
+			accumulateKernel((const uint32_t *) m_frame, &m_stats.m_mean[0], &m_stats.m_m2[0],
+							 &m_stats.m_min[0], &m_stats.m_max[0], &m_stats.m_zero_count[0],
+							 begin, end, inv_n);
+	}
+
+private:
+	const void			*m_frame;
+	int					m_depth;
+	PixelStatistics&	m_stats;
+} ;
+
+//---------------------------
+//- PixelStatistics
+//---------------------------
+
+PixelStatistics::Thresholds::Thresholds() :
+dead_zero_fraction(1), dead_mean_ratio(0.01), noisy_mean_ratio(10), noisy_dispersion(10)
+{
+}
+
+PixelStatistics::PixelStatistics(WorkerPool& pool) :
+m_pool(pool), m_nb_frames(0)
+{
+	DEB_CONSTRUCTOR();
+}
+
+void PixelStatistics::prepare(const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(size.getWidth(), size.getHeight());
+
+	if (size.isEmpty())
+		THROW_HW_ERROR(InvalidValue) << "Invalid pixel statistics size";
+
+	int nb_pixels = size.getWidth() * size.getHeight();
+	m_size = size;
+	m_nb_frames = 0;
+	m_mean.assign(nb_pixels, 0);
+	m_m2.assign(nb_pixels, 0);
+	m_min.assign(nb_pixels, 0xffffffff);
+	m_max.assign(nb_pixels, 0);
+	m_zero_count.assign(nb_pixels, 0);
+}
+
+void PixelStatistics::accumulate(const void *frame, int depth)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (m_mean.empty())
+		return;
+	++m_nb_frames;
+	AccumulateTask task(frame, depth, *this);
+	m_pool.run(task, m_size.getHeight());
+}
+
+int PixelStatistics::getNbFrames() const
+{
+	return m_nb_frames;
+}
+
+const Size& PixelStatistics::getSize() const
+{
+	return m_size;
+}
+
+const std::vector<double>& PixelStatistics::getMean() const
+{
+	return m_mean;
+}
+
+void PixelStatistics::getVariance(std::vector<double>& variance) const
+{
+	variance.assign(m_m2.size(), 0);
+	if (m_nb_frames < 2)
+		return;
+	double inv = 1. / (m_nb_frames - 1);
+	for (size_t i = 0; i < m_m2.size(); ++i)
+		variance[i] = m_m2[i] * inv;
+}
+
+const std::vector<uint32_t>& PixelStatistics::getMin() const
+{
+	return m_min;
+}
+
+const std::vector<uint32_t>& PixelStatistics::getMax() const
+{
+	return m_max;
+}
+
+const std::vector<uint32_t>& PixelStatistics::getZeroCount() const
+{
+	return m_zero_count;
+}
+
+void PixelStatistics::createMasks(const Thresholds& thresholds, std::vector<unsigned char>& dead,
+								  std::vector<unsigned char>& noisy) const
+{
+	DEB_MEMBER_FUNCT();
+
+	if (m_nb_frames < 2)
+		THROW_HW_ERROR(Error) << "Pixel statistics need at least 2 frames, got " << m_nb_frames;
+
+	// the median mean stands for a working pixel, whatever the share of bad ones
+	std::vector<double> means(m_mean);
+	std::nth_element(means.begin(), means.begin() + means.size() / 2, means.end());
+	double median = means[means.size() / 2];
+
+	size_t nb_pixels = m_mean.size();
+	double zero_frames = thresholds.dead_zero_fraction * m_nb_frames;
+	double dead_mean = thresholds.dead_mean_ratio * median;
+	double noisy_mean = thresholds.noisy_mean_ratio * median;
+	double inv = 1. / (m_nb_frames - 1);
+	int nb_dead = 0, nb_noisy = 0;
+
+	dead.assign(nb_pixels, 0);
+	noisy.assign(nb_pixels, 0);
+	for (size_t i = 0; i < nb_pixels; ++i)
+	{
+		double mean = m_mean[i];
+		if (m_zero_count[i] >= zero_frames || mean < dead_mean)
+		{
+			dead[i] = 1;
+			++nb_dead;
+			continue;
+		}
+		double variance = m_m2[i] * inv;
+		if ((median > 0 && mean > noisy_mean) || variance > thresholds.noisy_dispersion * std::max(mean, 1.))
+		{
+			noisy[i] = 1;
+			++nb_noisy;
+		}
+	}
+	DEB_TRACE() << DEB_VAR3(median, nb_dead, nb_noisy);
+}
@@ -0,0 +1,204 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cstdlib>
+#include <cmath>
+#include "imXpadServerLine.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+static inline bool isEol(char c)
+{
+	return c == '\r' || c == '\n';
+}
+
+// first end of line in [p, end), or end
+static inline const char *findEol(const char *p, const char *end)
+{
+	while (p < end && !isEol(*p))
+		++p;
+	return p;
+}
+
+// past the leading character and the space after it
+static inline const char *skipLead(const char *p, const char *end)
+{
+	++p;
+	if (p < end && *p == ' ')
+		++p;
+	return p;
+}
+
+// reads an optionally signed decimal integer the way atoi does
+static const char *readInt(const char *p, const char *end, int& value)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = (*p++ == '-');
+	long v = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+		v = 10 * v + (*p++ - '0');
+	value = int(negative ? -v : v);
+	return p;
+}
+
+const ServerLine::Rule ServerLine::s_rules[] =
+{
+	{'>', Prompt,		&ServerLine::_scanPrompt},
+	{'!', ErrorMessage,	&ServerLine::_scanMessage},
+	{'#', DebugMessage,	&ServerLine::_scanMessage},
+	{'@', TimeBar,		&ServerLine::_scanTimeBar},
+	{'*', Return,		&ServerLine::_scanReturn},
+	{0,   Unknown,		&ServerLine::_scanUnknown}
+};
+
+ServerLine::ServerLine() :
+m_type(Unknown), m_text(NULL), m_len(0), m_done(0), m_outoff(0)
+{
+}
+
+size_t ServerLine::parse(const char *buf, size_t len)
+{
+	const char *p = buf;
+	const char *end = buf + len;
+
+	// we are either at the beginning of a line or right at the end of the previous one
+	while (p < end && isEol(*p))
+		++p;
+	if (p == end)
+		return 0;
+
+	const Rule *rule = s_rules;
+	while (rule->lead != 0 && rule->lead != *p)
+		++rule;
+	m_type = rule->type;
+	m_text = NULL;
+	m_len = 0;
+
+	const char *line_end = (this->*rule->scan)(p, end);
+	return line_end ? line_end - buf : 0;
+}
+
+// '>' and the space after it, there is no end of line
+const char *ServerLine::_scanPrompt(const char *p, const char *end)
+{
+	return (end - p >= 2) ? p + 2 : NULL;
+}
+
+const char *ServerLine::_scanMessage(const char *p, const char *end)
+{
+	p = skipLead(p, end);
+	const char *eol = findEol(p, end);
+	if (eol == end)
+		return NULL;
+	m_text = p;
+	m_len = eol - p;
+	return eol + 1;
+}
+
+const char *ServerLine::_scanTimeBar(const char *p, const char *end)
+{
+	p = skipLead(p, end);
+	const char *eol = findEol(p, end);
+	if (eol == end)
+		return NULL;
+
+	const char *q = readInt(p, eol, m_done);
+	readInt(q, eol, m_outoff);
+	// the message follows the first quote, without its closing one
+	while (p < eol && *p != '\'' && *p != '"')
+		++p;
+	if (p < eol)
+	{
+		m_text = p + 1;
+		m_len = eol - m_text;
+		if (m_len > 0 && (m_text[m_len - 1] == '\'' || m_text[m_len - 1] == '"'))
+			--m_len;
+	}
+	else
+	{
+		m_text = eol;
+	}
+	return eol + 1;
+}
+
+const char *ServerLine::_scanReturn(const char *p, const char *end)
+{
+	p = skipLead(p, end);
+	if (p == end)
+		return NULL;
+
+	if (*p == '(')						// (null)
+	{
+		const char *q = p;
+		while (q < end && *q != ')' && !isEol(*q))
+			++q;
+		if (q == end)
+			return NULL;
+		m_type = StringReturn;
+		m_text = p;
+		return q + 1;
+	}
+	if (*p == '"')						// string, may span lines
+	{
+		const char *q = p + 1;
+		while (q < end && *q != '"')
+			++q;
+		if (q == end)
+			return NULL;
+		m_type = StringReturn;
+		m_text = p + 1;
+		m_len = q - m_text;
+		return q + 1;
+	}
+	const char *eol = findEol(p, end);	// integer or double
+	if (eol == end)
+		return NULL;
+	m_text = p;
+	m_len = eol - p;
+	return eol + 1;
+}
+
+const char *ServerLine::_scanUnknown(const char *p, const char *end)
+{
+	const char *eol = findEol(p, end);
+	if (eol == end)
+		return NULL;
+	m_text = p;
+	m_len = eol - p;
+	return eol + 1;
+}
+
+int ServerLine::toInt() const
+{
+	int value;
+	readInt(m_text, m_text + m_len, value);
+	return value;
+}
+
+double ServerLine::toDouble() const
+{
+	// the end of line following the text stops strtod
+	return m_len > 0 ? strtod(m_text, NULL) : 0.0;
+}
@@ -0,0 +1,216 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "imXpadSparse.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- kernels
+//---------------------------
+
+template <class T>
+static int countKernel(const T *__restrict line, int width)
+{
+	// branch-free so that the compiler vectorizes the scan
+	int nb = 0;
+	for (int i = 0; i < width; ++i)
+		nb += (line[i] != 0);
+	return nb;
+}
+
+template <class T>
+static void fillKernel(const T *line, int width, uint32_t first,
+					   uint32_t *indices, uint32_t *values)
+{
+	for (int i = 0; i < width; ++i)
+	{
+		if (line[i])
+		{
+			*indices++ = first + i;
+			*values++ = line[i];
+		}
+	}
+}
+
+class SparseEncoder::CountTask: public WorkerPool::Task
+{
+public:
+	CountTask(const void *frame, int depth, int width, int *count) :
+	m_frame(frame), m_depth(depth), m_width(width), m_count(count) {}
+
+	virtual void process(int begin, int end)
+	{
+		for (int line = begin; line < end; ++line)
+		{
+			if (m_depth == 2)
+				m_count[line] = countKernel((const uint16_t *) m_frame + line * m_width, m_width);
+			else
+				m_count[line] = countKernel((const uint32_t *) m_frame + line * m_width, m_width);
+		}
+	}
+
+private:
+	const void	*m_frame;
+	int			m_depth;
+	int			m_width;
+	int			*m_count;
+} ;
+
+class SparseEncoder::FillTask: public WorkerPool::Task
+{
+public:
+	FillTask(const void *frame, int depth, int width, const int *offset, SparseFrame& sparse) :
+	m_frame(frame), m_depth(depth), m_width(width), m_offset(offset), m_sparse(sparse) {}
+
+	virtual void process(int begin, int end)
+	{
+		for (int line = begin; line < end; ++line)
+		{
+			uint32_t *indices = &m_sparse.indices[0] + m_offset[line];
+			uint32_t *values = &m_sparse.values[0] + m_offset[line];
+			uint32_t first = line * m_width;
+			if (m_depth == 2)
+				fillKernel((const uint16_t *) m_frame + first, m_width, first, indices, values);
+			else
+				fillKernel((const uint32_t *) m_frame + first, m_width, first, indices, values);
+		}
+	}
+
+private:
+	const void		*m_frame;
+	int				m_depth;
+	int				m_width;
+	const int		*m_offset;
+	SparseFrame&	m_sparse;
+} ;
+
+//---------------------------
+//- SparseFrame
+//---------------------------
+
+SparseFrame::SparseFrame() :
+acq_frame_nb(-1), dense(true), frame(NULL), depth(4)
+{
+}
+
+double SparseFrame::getOccupancy() const
+{
+	int nb_pixels = size.getWidth() * size.getHeight();
+	if (!nb_pixels)
+		return 0;
+	return dense ? 1. : double(indices.size()) / nb_pixels;
+}
+
+void SparseFrame::write(std::ostream& os) const
+{
+	uint32_t header[5];
+	header[0] = acq_frame_nb;
+	header[1] = size.getWidth();
+	header[2] = size.getHeight();
+	header[3] = dense ? depth : 0;
+	header[4] = dense ? 0 : indices.size();
+	os.write((const char *) header, sizeof(header));
+
+	if (dense)
+	{
+		os.write((const char *) frame, std::streamsize(size.getWidth()) * size.getHeight() * depth);
+	}
+	else if (!indices.empty())
+	{
+		os.write((const char *) &indices[0], indices.size() * sizeof(uint32_t));
+		os.write((const char *) &values[0], values.size() * sizeof(uint32_t));
+	}
+}
+
+//---------------------------
+//- SparseEncoder
+//---------------------------
+
+SparseEncoder::SparseEncoder(WorkerPool& pool) :
+m_pool(pool), m_threshold(0.1)
+{
+	DEB_CONSTRUCTOR();
+}
+
+SparseEncoder::~SparseEncoder()
+{
+	DEB_DESTRUCTOR();
+}
+
+void SparseEncoder::setThreshold(double occupancy)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(occupancy);
+
+	if (occupancy < 0 || occupancy > 1)
+		THROW_HW_ERROR(InvalidValue) << "Occupancy threshold must be in [0, 1]";
+	m_threshold = occupancy;
+}
+
+double SparseEncoder::getThreshold() const
+{
+	return m_threshold;
+}
+
+bool SparseEncoder::encode(const void *frame, int depth, const Size& size, SparseFrame& sparse)
+{
+	DEB_MEMBER_FUNCT();
+
+	int width = size.getWidth();
+	int height = size.getHeight();
+
+	sparse.size = size;
+	sparse.frame = frame;
+	sparse.depth = depth;
+
+	m_slice_count.resize(height + 1);
+	CountTask count(frame, depth, width, &m_slice_count[0]);
+	m_pool.run(count, height);
+
+	// prefix sum turns line counts into line offsets
+	int total = 0;
+	for (int line = 0; line < height; ++line)
+	{
+		int nb = m_slice_count[line];
+		m_slice_count[line] = total;
+		total += nb;
+	}
+
+	sparse.dense = (total > m_threshold * width * height);
+	if (sparse.dense)
+	{
+		sparse.indices.clear();
+		sparse.values.clear();
+		return false;
+	}
+
+	sparse.indices.resize(total);
+	sparse.values.resize(total);
+	if (total)
+	{
+		FillTask fill(frame, depth, width, &m_slice_count[0], sparse);
+		m_pool.run(fill, height);
+	}
+	return true;
+}
@@ -0,0 +1,206 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+#include "imXpadThresholdScan.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+// pixels fitted together, their levels and crossings stay in L1
+static const int FIT_BLOCK = 512;
+
+//---------------------------
+//- tasks
+//---------------------------
+
+class ThresholdScan::FitTask: public WorkerPool::Task
+{
+public:
+	FitTask(ThresholdScan& scan, int nb_steps) :
+	m_scan(scan), m_nb_steps(nb_steps) {}
+
+	virtual void process(int begin, int end)
+	{
+		int nb_pixels = m_scan.m_size.getWidth() * m_scan.m_size.getHeight();
+		for (int block = begin; block < end; ++block)
+		{
+			int first = block * FIT_BLOCK;
+			_fit(first, std::min(first + FIT_BLOCK, nb_pixels) - first, nb_pixels);
+		}
+	}
+
+private:
+	void _fit(int first, int nb, int nb_pixels)
+	{
+		// plateaus from the first and last two steps
+		const uint32_t *cube = &m_scan.m_cube[first];
+		const uint32_t *last = cube + size_t(m_nb_steps - 2) * nb_pixels;
+		float start[FIT_BLOCK], amplitude[FIT_BLOCK];
+		for (int p = 0; p < nb; ++p)
+		{
+			start[p] = 0.5f * (float(cube[p]) + float(cube[p + nb_pixels]));
+			float end = 0.5f * (float(last[p]) + float(last[p + nb_pixels]));
+			amplitude[p] = end - start[p];
+		}
+
+		// step position where the counts cross each level, the last crossing wins
+		float cross[NB_LEVELS][FIT_BLOCK];
+		for (int l = 0; l < NB_LEVELS; ++l)
+			for (int p = 0; p < nb; ++p)
+				cross[l][p] = -1;
+
+		const uint32_t *frame = cube;
+		for (int s = 0; s + 1 < m_nb_steps; ++s, frame += nb_pixels)
+		{
+			const uint32_t *next = frame + nb_pixels;
+			for (int l = 0; l < NB_LEVELS; ++l)
+			{
+				float *c = cross[l];
+				for (int p = 0; p < nb; ++p)
+				{
+					float level = start[p] + LEVELS[l] * amplitude[p];
+					float a = float(frame[p]) - level;
+					float b = float(next[p]) - level;
+					bool crossing = (a * b <= 0) && (a != b);
+					c[p] = crossing ? s + a / (a - b) : c[p];
+				}
+			}
+		}
+
+		float *threshold = &m_scan.m_threshold[first];
+		float *noise = &m_scan.m_noise[first];
+		int direction = m_scan.m_direction;
+		for (int p = 0; p < nb; ++p)
+		{
+			bool valid = (amplitude[p] != 0) && (cross[0][p] >= 0) && (cross[1][p] >= 0) && (cross[2][p] >= 0);
+			threshold[p] = valid ? m_scan.m_first_ithl + cross[1][p] * direction : -1;
+			noise[p] = valid ? 0.5f * std::fabs(cross[2][p] - cross[0][p]) : -1;
+		}
+	}
+
+	static const int NB_LEVELS = 3;
+	static const float LEVELS[NB_LEVELS];
+
+	ThresholdScan&	m_scan;
+	int				m_nb_steps;
+} ;
+
+// one sigma before, at and one sigma after the middle of an erfc
+const float ThresholdScan::FitTask::LEVELS[NB_LEVELS] = {0.1587f, 0.5f, 0.8413f};
+
+//---------------------------
+//- ThresholdScan
+//---------------------------
+
+ThresholdScan::ThresholdScan(WorkerPool& pool) :
+m_pool(pool), m_first_ithl(0), m_direction(1), m_nb_steps(0)
+{
+	DEB_CONSTRUCTOR();
+}
+
+ThresholdScan::~ThresholdScan()
+{
+	DEB_DESTRUCTOR();
+}
+
+void ThresholdScan::prepare(int first_ithl, int last_ithl, const Size& size)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR3(first_ithl, last_ithl, size);
+
+	int nb_pixels = size.getWidth() * size.getHeight();
+	if (nb_pixels <= 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid scan frame size " << size;
+
+	m_first_ithl = first_ithl;
+	m_direction = (last_ithl < first_ithl) ? -1 : 1;
+	m_nb_steps = std::abs(last_ithl - first_ithl) + 1;
+	m_size = size;
+	m_cube.resize(size_t(m_nb_steps) * nb_pixels);
+	m_threshold.assign(nb_pixels, -1);
+	m_noise.assign(nb_pixels, -1);
+}
+
+int ThresholdScan::getNbSteps() const
+{
+	return m_nb_steps;
+}
+
+int ThresholdScan::getStepIthl(int step) const
+{
+	return m_first_ithl + step * m_direction;
+}
+
+Size ThresholdScan::getSize() const
+{
+	return m_size;
+}
+
+uint32_t *ThresholdScan::getStepFrame(int step)
+{
+	return &m_cube[size_t(step) * m_size.getWidth() * m_size.getHeight()];
+}
+
+void ThresholdScan::fit(int nb_steps)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(nb_steps);
+
+	if (nb_steps < 2)
+		THROW_HW_ERROR(Error) << "A threshold scan needs 2 steps at least, " << nb_steps << " acquired";
+
+	int nb_pixels = m_size.getWidth() * m_size.getHeight();
+	FitTask task(*this, std::min(nb_steps, m_nb_steps));
+	m_pool.run(task, (nb_pixels + FIT_BLOCK - 1) / FIT_BLOCK);
+}
+
+const std::vector<float>& ThresholdScan::getThresholdMap() const
+{
+	return m_threshold;
+}
+
+const std::vector<float>& ThresholdScan::getNoiseMap() const
+{
+	return m_noise;
+}
+
+void ThresholdScan::saveMaps(const char *threshold_path, const char *noise_path) const
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(threshold_path, noise_path);
+
+	const char *paths[2] = {threshold_path, noise_path};
+	const std::vector<float> *maps[2] = {&m_threshold, &m_noise};
+	for (int i = 0; i < 2; ++i)
+	{
+		std::ofstream file(paths[i], std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			THROW_HW_ERROR(Error) << "Cannot open " << paths[i];
+		file.write((const char *) &(*maps[i])[0], maps[i]->size() * sizeof(float));
+		if (!file)
+			THROW_HW_ERROR(Error) << "Cannot write " << paths[i];
+	}
+}
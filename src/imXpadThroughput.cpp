@@ -0,0 +1,101 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include "imXpadThroughput.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+const double ThroughputModel::DEFAULT_LINK_BANDWIDTH = 117e6;
+const double ThroughputModel::DEFAULT_CLIENT_BANDWIDTH = 1e9;
+
+ThroughputModel::ThroughputModel() :
+m_default_link_bandwidth(DEFAULT_LINK_BANDWIDTH), m_link_bytes(0), m_link_time(0),
+m_client_bytes(0), m_client_time(0), m_raw_bytes(0), m_compressed_bytes(0)
+{
+	DEB_CONSTRUCTOR();
+}
+
+void ThroughputModel::setLinkBandwidth(double bandwidth)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(bandwidth);
+
+	if (bandwidth <= 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid link bandwidth " << bandwidth;
+
+	AutoMutex aLock(m_lock);
+	m_default_link_bandwidth = bandwidth;
+	m_link_bytes = 0;
+	m_link_time = 0;
+}
+
+double ThroughputModel::getLinkBandwidth() const
+{
+	AutoMutex aLock(m_lock);
+	return (m_link_time > 0) ? m_link_bytes / m_link_time : m_default_link_bandwidth;
+}
+
+double ThroughputModel::getClientBandwidth() const
+{
+	AutoMutex aLock(m_lock);
+	return (m_client_time > 0) ? m_client_bytes / m_client_time : DEFAULT_CLIENT_BANDWIDTH;
+}
+
+double ThroughputModel::getCompressionRatio() const
+{
+	AutoMutex aLock(m_lock);
+	return (m_raw_bytes > 0) ? m_compressed_bytes / m_raw_bytes : 1;
+}
+
+void ThroughputModel::frameMeasured(uint32_t nb_pixels, uint32_t wire_bytes, bool compressed, double transfer_time,
+									int depth, double processing_time)
+{
+	AutoMutex aLock(m_lock);
+	if (transfer_time > 0)
+	{
+		m_link_bytes += wire_bytes;
+		m_link_time += transfer_time;
+	}
+	if (processing_time > 0)
+	{
+		m_client_bytes += double(nb_pixels) * depth;
+		m_client_time += processing_time;
+	}
+	if (compressed)
+	{
+		m_raw_bytes += double(nb_pixels) * sizeof(uint32_t);
+		m_compressed_bytes += wire_bytes;
+	}
+}
+
+double ThroughputModel::getMinFramePeriod(uint32_t nb_pixels, int depth, bool compressed) const
+{
+	double wire_bytes = double(nb_pixels) * sizeof(uint32_t);
+	if (compressed)
+		wire_bytes *= getCompressionRatio();
+
+	double link_time = wire_bytes / getLinkBandwidth();
+	double client_time = double(nb_pixels) * depth / getClientBandwidth();
+	return std::max(link_time, client_time);
+}
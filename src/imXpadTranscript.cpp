@@ -0,0 +1,414 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <cstring>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "imXpadTranscript.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+static const size_t RECORD_HEADER = 16;
+
+static void putLE(unsigned char *p, uint64_t value, int size)
+{
+	for (int i = 0; i < size; i++)
+		p[i] = (unsigned char) (value >> (8 * i));
+}
+
+static uint64_t getLE(const unsigned char *p, int size)
+{
+	uint64_t value = 0;
+	for (int i = size - 1; i >= 0; i--)
+		value = (value << 8) | p[i];
+	return value;
+}
+
+static double seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+//---------------------------
+//- TranscriptWriter
+//---------------------------
+
+TranscriptWriter::TranscriptWriter() :
+m_file(NULL), m_start(0), m_nb_bytes(0)
+{
+	DEB_CONSTRUCTOR();
+}
+
+TranscriptWriter::~TranscriptWriter()
+{
+	DEB_DESTRUCTOR();
+	close();
+}
+
+uint64_t TranscriptWriter::_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void TranscriptWriter::open(const std::string& path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(path);
+
+	AutoMutex aLock(m_lock);
+	if (m_file)
+		fclose(m_file);
+	m_file = fopen(path.c_str(), "wb");
+	if (!m_file)
+		THROW_HW_ERROR(Error) << "Cannot create transcript " << path << ": " << strerror(errno);
+	// frames make large records, let stdio write them in big blocks
+	setvbuf(m_file, NULL, _IOFBF, 1 << 20);
+	fwrite(TRANSCRIPT_MAGIC, 1, sizeof(TRANSCRIPT_MAGIC) - 1, m_file);
+	m_start = _now();
+	m_nb_bytes = 0;
+}
+
+void TranscriptWriter::close()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_lock);
+	if (!m_file)
+		return;
+	if (fclose(m_file) != 0)
+		DEB_ERROR() << "Transcript not completely written: " << strerror(errno);
+	m_file = NULL;
+}
+
+bool TranscriptWriter::isOpen() const
+{
+	AutoMutex aLock(m_lock);
+	return m_file != NULL;
+}
+
+void TranscriptWriter::record(TranscriptDirection direction, const void *buf, size_t len)
+{
+	struct iovec iov;
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	record(direction, &iov, 1);
+}
+
+void TranscriptWriter::record(TranscriptDirection direction, const struct iovec *iov, int iovcnt)
+{
+	DEB_MEMBER_FUNCT();
+
+	uint64_t now = _now();
+	size_t len = 0;
+	for (int i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	AutoMutex aLock(m_lock);
+	if (!m_file || len == 0)
+		return;
+
+	unsigned char header[RECORD_HEADER];
+	memset(header, 0, sizeof(header));
+	putLE(header, now - m_start, 8);
+	putLE(header + 8, len, 4);
+	header[12] = direction;
+	bool ok = fwrite(header, 1, sizeof(header), m_file) == sizeof(header);
+	for (int i = 0; i < iovcnt; i++)
+		ok = ok && fwrite(iov[i].iov_base, 1, iov[i].iov_len, m_file) == iov[i].iov_len;
+	if (!ok)
+	{
+		// a full disk must not stop the acquisition, the capture ends there
+		DEB_ERROR() << "Transcript write failed, capture stopped: " << strerror(errno);
+		fclose(m_file);
+		m_file = NULL;
+		return;
+	}
+	m_nb_bytes += len;
+}
+
+long long TranscriptWriter::getNbBytes() const
+{
+	AutoMutex aLock(m_lock);
+	return m_nb_bytes;
+}
+
+//---------------------------
+//- TranscriptReader
+//---------------------------
+
+TranscriptReader::TranscriptReader() :
+m_file(NULL)
+{
+	DEB_CONSTRUCTOR();
+}
+
+TranscriptReader::~TranscriptReader()
+{
+	DEB_DESTRUCTOR();
+	close();
+}
+
+void TranscriptReader::open(const std::string& path)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(path);
+
+	close();
+	m_file = fopen(path.c_str(), "rb");
+	if (!m_file)
+		THROW_HW_ERROR(Error) << "Cannot open transcript " << path << ": " << strerror(errno);
+	m_path = path;
+
+	char magic[sizeof(TRANSCRIPT_MAGIC) - 1];
+	if (fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) ||
+		memcmp(magic, TRANSCRIPT_MAGIC, sizeof(magic)) != 0)
+	{
+		close();
+		THROW_HW_ERROR(Error) << path << " is not a transcript";
+	}
+}
+
+void TranscriptReader::close()
+{
+	if (m_file)
+		fclose(m_file);
+	m_file = NULL;
+}
+
+bool TranscriptReader::next(TranscriptRecord& record)
+{
+	DEB_MEMBER_FUNCT();
+
+	if (!m_file)
+		THROW_HW_ERROR(Error) << "No transcript open";
+
+	unsigned char header[RECORD_HEADER];
+	size_t n = fread(header, 1, sizeof(header), m_file);
+	if (n == 0 && feof(m_file))
+		return false;
+	if (n != sizeof(header))
+		THROW_HW_ERROR(Error) << m_path << ": truncated record header";
+
+	record.time_ns = getLE(header, 8);
+	record.data.resize(getLE(header + 8, 4));
+	if (header[12] > FromServer)
+		THROW_HW_ERROR(Error) << m_path << ": bad record direction " << int(header[12]);
+	record.direction = TranscriptDirection(header[12]);
+	if (!record.data.empty() &&
+		fread(&record.data[0], 1, record.data.size(), m_file) != record.data.size())
+		THROW_HW_ERROR(Error) << m_path << ": truncated record";
+	return true;
+}
+
+//---------------------------
+//- TranscriptReplayer
+//---------------------------
+
+TranscriptReplayer::TranscriptReplayer(const std::string& path, bool keep_pace, int port) :
+m_path(path), m_keep_pace(keep_pace), m_listener(-1), m_port(port), m_skt(-1),
+m_done(false), m_nb_mismatches(0), m_nb_bytes(0), m_replay_time(0)
+{
+	DEB_CONSTRUCTOR();
+
+	// fail now on an unreadable transcript rather than in the thread
+	TranscriptReader reader;
+	reader.open(path);
+
+	m_listener = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (bind(m_listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(m_listener, 1) < 0)
+	{
+		::close(m_listener);
+		THROW_HW_ERROR(Error) << "Cannot listen on port " << port << ": " << strerror(errno);
+	}
+	socklen_t len = sizeof(addr);
+	getsockname(m_listener, (struct sockaddr *) &addr, &len);
+	m_port = ntohs(addr.sin_port);
+}
+
+TranscriptReplayer::~TranscriptReplayer()
+{
+	DEB_DESTRUCTOR();
+	abort();
+	AutoMutex aLock(m_cond.mutex());
+	while (hasStarted() && !m_done)
+		m_cond.wait();
+	aLock.unlock();
+	::close(m_listener);
+}
+
+int TranscriptReplayer::getPort() const
+{
+	return m_port;
+}
+
+void TranscriptReplayer::abort()
+{
+	AutoMutex aLock(m_cond.mutex());
+	shutdown(m_listener, SHUT_RDWR);
+	if (m_skt >= 0)
+		shutdown(m_skt, SHUT_RDWR);
+}
+
+void TranscriptReplayer::threadFunction()
+{
+	DEB_MEMBER_FUNCT();
+
+	int skt = accept(m_listener, NULL, NULL);
+	if (skt >= 0)
+	{
+		int one = 1;
+		setsockopt(skt, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		AutoMutex aLock(m_cond.mutex());
+		m_skt = skt;
+		aLock.unlock();
+
+		double start = seconds();
+		try
+		{
+			_replay(skt);
+		}
+		catch (Exception& e)
+		{
+			AutoMutex aLock(m_cond.mutex());
+			m_error = e.getErrMsg();
+		}
+		aLock.lock();
+		m_replay_time = seconds() - start;
+		m_skt = -1;
+		aLock.unlock();
+		::close(skt);
+	}
+
+	AutoMutex aLock(m_cond.mutex());
+	if (skt < 0)
+		m_error = "No client connected";
+	m_done = true;
+	m_cond.broadcast();
+}
+
+void TranscriptReplayer::_replay(int skt)
+{
+	DEB_MEMBER_FUNCT();
+
+	TranscriptReader reader;
+	reader.open(m_path);
+	TranscriptRecord record;
+	std::vector<char> received;
+
+	// server data keeps its recorded delay after the last client data
+	double base = seconds();
+	uint64_t base_ns = 0;
+
+	while (reader.next(record))
+	{
+		size_t len = record.data.size();
+		if (record.direction == ToServer)
+		{
+			received.resize(len);
+			size_t done = 0;
+			while (done < len)
+			{
+				ssize_t n = read(skt, &received[done], len - done);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					THROW_HW_ERROR(Error) << "Client closed the connection";
+				done += n;
+			}
+			if (memcmp(&received[0], &record.data[0], len) != 0)
+			{
+				AutoMutex aLock(m_cond.mutex());
+				m_nb_mismatches++;
+			}
+			base = seconds();
+			base_ns = record.time_ns;
+			continue;
+		}
+
+		if (m_keep_pace && record.time_ns > base_ns)
+		{
+			double wait = base + 1e-9 * (record.time_ns - base_ns) - seconds();
+			if (wait > 0)
+				usleep(useconds_t(wait * 1e6));
+		}
+		const char *p = &record.data[0];
+		while (len > 0)
+		{
+			ssize_t n = write(skt, p, len);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				THROW_HW_ERROR(Error) << "Client closed the connection";
+			p += n;
+			len -= n;
+		}
+		AutoMutex aLock(m_cond.mutex());
+		m_nb_bytes += record.data.size();
+	}
+}
+
+bool TranscriptReplayer::isDone() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_done;
+}
+
+std::string TranscriptReplayer::getErrorMessage() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_error;
+}
+
+int TranscriptReplayer::getNbMismatches() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_nb_mismatches;
+}
+
+long long TranscriptReplayer::getNbBytesReplayed() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_nb_bytes;
+}
+
+double TranscriptReplayer::getReplayTime() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_replay_time;
+}
@@ -0,0 +1,253 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "imXpadWorkerPool.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::imXpad;
+
+//---------------------------
+//- worker thread
+//---------------------------
+
+class WorkerPool::WorkerThread: public Thread
+{
+	DEB_CLASS_NAMESPC(DebModCamera, "WorkerPool", "WorkerThread");
+public:
+	WorkerThread(WorkerPool& pool, int index);
+	virtual ~WorkerThread();
+
+	int getNbMigrations() const { return m_migrations.getNbMigrations(); }
+	void resetMigrations() { m_migrations.reset(); }
+
+protected:
+	virtual void threadFunction();
+
+private:
+	WorkerPool&	m_pool;
+	int			m_index;
+	int			m_generation;
+	int			m_affinity_generation;
+	MigrationCounter m_migrations;
+} ;
+
+WorkerPool::WorkerThread::WorkerThread(WorkerPool& pool, int index) :
+m_pool(pool), m_index(index), m_generation(pool.m_generation), m_affinity_generation(0)
+{
+}
+
+WorkerPool::WorkerThread::~WorkerThread()
+{
+}
+
+void WorkerPool::WorkerThread::threadFunction()
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_pool.m_cond.mutex());
+
+	while (1)
+	{
+		while (!m_pool.m_quit && m_generation == m_pool.m_generation)
+			m_pool.m_cond.wait();
+		if (m_pool.m_quit)
+			break;
+
+		m_generation = m_pool.m_generation;
+		Task *task = m_pool.m_task;
+		int begin, end;
+		m_pool._slice(m_index + 1, begin, end);
+		bool new_affinity = (m_affinity_generation != m_pool.m_affinity_generation);
+		CpuAffinity affinity = m_pool.m_affinity;
+		m_affinity_generation = m_pool.m_affinity_generation;
+		aLock.unlock();
+
+		if (new_affinity)
+			affinity.applyToCurrentThread();
+
+		try
+		{
+			if (begin < end)
+				task->process(begin, end);
+		}
+		catch (...)
+		{
+			DEB_ERROR() << "Processing task failed on worker " << m_index;
+		}
+
+		aLock.lock();
+		if (new_affinity)
+			m_migrations.reset();
+		m_migrations.sample();
+		if (--m_pool.m_pending == 0)
+			m_pool.m_cond.broadcast();
+	}
+
+	--m_pool.m_running;
+	m_pool.m_cond.broadcast();
+}
+
+//---------------------------
+//- WorkerPool
+//---------------------------
+
+WorkerPool::WorkerPool(int nb_workers) :
+m_task(NULL), m_nb_items(0), m_generation(0), m_pending(0), m_running(0), m_quit(false),
+m_affinity_generation(0)
+{
+	DEB_CONSTRUCTOR();
+	_startWorkers(nb_workers);
+}
+
+WorkerPool::~WorkerPool()
+{
+	DEB_DESTRUCTOR();
+	_stopWorkers();
+}
+
+void WorkerPool::setNbWorkers(int nb_workers)
+{
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(nb_workers);
+
+	if (nb_workers < 0)
+		THROW_HW_ERROR(InvalidValue) << "Invalid number of workers " << nb_workers;
+	if (nb_workers == int(m_workers.size()))
+		return;
+
+	// not under a running task
+	AutoMutex runLock(m_run_lock);
+	_stopWorkers();
+	_startWorkers(nb_workers);
+}
+
+int WorkerPool::getNbWorkers() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	return m_workers.size();
+}
+
+void WorkerPool::run(Task& task, int nb_items)
+{
+	DEB_MEMBER_FUNCT();
+
+	// one task at a time, the workers hold a single task and slicing
+	AutoMutex runLock(m_run_lock);
+
+	AutoMutex aLock(m_cond.mutex());
+	m_task = &task;
+	m_nb_items = nb_items;
+	m_pending = m_workers.size();
+	++m_generation;
+	m_cond.broadcast();
+
+	int begin, end;
+	_slice(0, begin, end);
+	aLock.unlock();
+
+	try
+	{
+		if (begin < end)
+			task.process(begin, end);
+	}
+	catch (...)
+	{
+		// the workers still use task, it must outlive their slices
+		aLock.lock();
+		_waitTask();
+		throw;
+	}
+
+	aLock.lock();
+	_waitTask();
+}
+
+void WorkerPool::setCpuAffinity(const CpuAffinity& affinity)
+{
+	DEB_MEMBER_FUNCT();
+
+	AutoMutex aLock(m_cond.mutex());
+	m_affinity = affinity;
+	++m_affinity_generation;
+}
+
+int WorkerPool::getNbMigrations() const
+{
+	AutoMutex aLock(m_cond.mutex());
+	int nb_migrations = 0;
+	std::vector<WorkerThread*>::const_iterator i;
+	for (i = m_workers.begin(); i != m_workers.end(); ++i)
+		nb_migrations += (*i)->getNbMigrations();
+	return nb_migrations;
+}
+
+void WorkerPool::resetMigrations()
+{
+	AutoMutex aLock(m_cond.mutex());
+	std::vector<WorkerThread*>::iterator i;
+	for (i = m_workers.begin(); i != m_workers.end(); ++i)
+		(*i)->resetMigrations();
+}
+
+void WorkerPool::_startWorkers(int nb_workers)
+{
+	AutoMutex aLock(m_cond.mutex());
+	m_quit = false;
+	m_running = nb_workers;
+	aLock.unlock();
+
+	for (int i = 0; i < nb_workers; ++i)
+	{
+		WorkerThread *worker = new WorkerThread(*this, i);
+		worker->start();
+		m_workers.push_back(worker);
+	}
+}
+
+void WorkerPool::_stopWorkers()
+{
+	AutoMutex aLock(m_cond.mutex());
+	m_quit = true;
+	m_cond.broadcast();
+	while (m_running > 0)
+		m_cond.wait();
+	aLock.unlock();
+
+	std::vector<WorkerThread*>::iterator i;
+	for (i = m_workers.begin(); i != m_workers.end(); ++i)
+		delete *i;
+	m_workers.clear();
+}
+
+void WorkerPool::_waitTask()
+{
+	while (m_pending > 0)
+		m_cond.wait();
+	m_task = NULL;
+}
+
+void WorkerPool::_slice(int index, int& begin, int& end) const
+{
+	long nb_slices = m_workers.size() + 1;
+	begin = (long(m_nb_items) * index) / nb_slices;
+	end = (long(m_nb_items) * (index + 1)) / nb_slices;
+}
@@ -0,0 +1,178 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Helpers shared by the tests talking to a stand-in server over loopback.
+//###########################################################################
+#ifndef IMXPADTESTUTILS_H_
+#define IMXPADTESTUTILS_H_
+
+#include <string>
+#include <cstring>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "lima/ThreadUtils.h"
+#include "../include/imXpadClient.h"
+
+namespace lima
+{
+namespace imXpad
+{
+namespace Test
+{
+
+inline double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+//! Listen on loopback, port 0 picks a free one and returns it in port
+inline int listenLocal(int& port, int backlog = 1)
+{
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	bind(listener, (struct sockaddr *) &addr, sizeof(addr));
+	socklen_t len = sizeof(addr);
+	getsockname(listener, (struct sockaddr *) &addr, &len);
+	listen(listener, backlog);
+	port = ntohs(addr.sin_port);
+	return listener;
+}
+
+//! Accept one connection with TCP_NODELAY, as the server sets it
+inline int acceptLocal(int listener)
+{
+	int skt = accept(listener, NULL, NULL);
+	if (skt >= 0)
+	{
+		int one = 1;
+		setsockopt(skt, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	return skt;
+}
+
+//! Two connected sockets, for tests driving a raw socket
+inline void connectPair(int& client, int& server)
+{
+	int port = 0;
+	int listener = listenLocal(port);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	client = socket(AF_INET, SOCK_STREAM, 0);
+	connect(client, (struct sockaddr *) &addr, sizeof(addr));
+	server = acceptLocal(listener);
+	close(listener);
+
+	// as XpadClient::connectToServer does on the command socket
+	int one = 1;
+	setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+//! Connect client to a local listener, returns the server side socket or -1
+inline int connectClient(XpadClient& client)
+{
+	int port = 0;
+	int listener = listenLocal(port);
+	int server = -1;
+	if (client.connectToServer("127.0.0.1", port) >= 0)
+		server = acceptLocal(listener);
+	close(listener);
+	return server;
+}
+
+inline void sendAll(int skt, const void *buf, size_t len)
+{
+	const char *p = (const char *) buf;
+	while (len > 0)
+	{
+		ssize_t n = write(skt, p, len);
+		if (n <= 0)
+			return;
+		p += n;
+		len -= n;
+	}
+}
+
+inline void sendText(int skt, const char *text)
+{
+	sendAll(skt, text, strlen(text));
+}
+
+//! The '\n' the client sends back after each frame
+inline bool readAck(int skt)
+{
+	char ack;
+	return read(skt, &ack, 1) == 1;
+}
+
+//! One command line without its '\n', false when the client went away
+inline bool readLine(int skt, std::string& line)
+{
+	line.clear();
+	char c;
+	while (read(skt, &c, 1) == 1)
+	{
+		if (c == '\n')
+			return true;
+		line += c;
+	}
+	return false;
+}
+
+/*******************************************************************
+ * \class StandInServer
+ * \brief thread playing the server side of one connection
+ *******************************************************************/
+class StandInServer: public Thread
+{
+public:
+	StandInServer(int skt = -1) : m_skt(skt) {}
+
+protected:
+	void _send(const void *buf, size_t len) { sendAll(m_skt, buf, len); }
+	void _send(const char *text) { sendText(m_skt, text); }
+	bool _readAck() { return readAck(m_skt); }
+	bool _readLine(std::string& line) { return readLine(m_skt, line); }
+
+	int m_skt;
+} ;
+
+} // namespace Test
+} // namespace imXpad
+} // namespace lima
+
+#endif /* IMXPADTESTUTILS_H_ */
@@ -0,0 +1,265 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Stop latency of an acquisition blocked on the server.
+//
+// A stand-in server plays a long exposure on a localhost connection and,
+// like the detector server, only honours an abort once the exposure in
+// progress is over: it then completes the frame in flight, sends the end
+// of stream header, the return value of the exposure and its prompt.
+//
+// The stop latency is the time from the abort to the reading thread being
+// idle, with and without the abort event. With it, the stream is drained
+// by the next command, whose time is reported as the resync time.
+//
+// usage: test_imXpad_abort [nb_stops] [exposure_ms]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadClient.h"
+#include "../include/imXpadAbortEvent.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 560;
+static const int HEIGHT = 120;
+static const int BURST_NUMBER = 42;
+
+// where the acquisition is when the stop comes
+enum StopPoint
+{
+	BetweenFrames,		// waiting for the next frame header
+	InFrame,			// half of the frame payload received
+	BeforeReturn		// frames done, waiting for the exposure return value
+} ;
+
+static const char *stopPointName(StopPoint point)
+{
+	switch (point)
+	{
+		case BetweenFrames: return "between frames";
+		case InFrame: return "inside a frame";
+		default: return "before return";
+	}
+}
+
+class StopServer: public StandInServer
+{
+public:
+	StopServer(int skt, StopPoint point, double exposure) :
+	StandInServer(skt), m_point(point), m_exposure(exposure), m_abort(false) {}
+
+	void abort()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		m_abort = true;
+		m_cond.broadcast();
+	}
+
+protected:
+	virtual void threadFunction()
+	{
+		vector<uint32_t> frame(WIDTH * HEIGHT, 1);
+		const char *data = (const char *) &frame[0];
+		size_t size = frame.size() * sizeof(uint32_t);
+		uint32_t header[3] = {uint32_t(size), HEIGHT, WIDTH};
+
+		if (m_point != BeforeReturn)
+		{
+			_send(header, sizeof(header));
+			_send(data, size);
+			_readAck();
+			if (m_point == InFrame)
+			{
+				_send(header, sizeof(header));
+				_send(data, size / 2);
+			}
+		}
+		if (m_point == BeforeReturn)
+		{
+			_send("* end of acq", 12);
+			_readAck();
+		}
+
+		// the abort is only seen at the end of the exposure
+		double start = now();
+		AutoMutex aLock(m_cond.mutex());
+		while (!m_abort)
+			m_cond.wait();
+		aLock.unlock();
+		double left = start + m_exposure - now();
+		if (left > 0)
+			usleep(useconds_t(left * 1e6));
+
+		if (m_point == InFrame)
+		{
+			_send(data + size / 2, size - size / 2);
+			_readAck();
+		}
+		if (m_point != BeforeReturn)
+		{
+			_send("* end of acq", 12);
+			_readAck();
+		}
+		_send("* 1\n> ", 6);
+
+		// then serve the command that resynchronizes the stream
+		string line;
+		if (_readLine(line) && line == "GetBurstNumber")
+		{
+			char reply[32];
+			int len = snprintf(reply, sizeof(reply), "* %d\n> ", BURST_NUMBER);
+			_send(reply, len);
+		}
+	}
+
+private:
+	StopPoint m_point;
+	double m_exposure;
+	Cond m_cond;
+	bool m_abort;
+} ;
+
+// the receiving part of the acquisition thread
+class Reader: public Thread
+{
+public:
+	Reader(XpadClient& client) : m_client(client), m_nb_frames(0), m_ret(0) {}
+
+	int getNbFrames() const { return m_nb_frames; }
+	int getReturn() const { return m_ret; }
+
+protected:
+	virtual void threadFunction()
+	{
+		vector<uint32_t> frame(WIDTH * HEIGHT);
+		while (m_client.getDataExpose(&frame[0], 1, frame.size() * sizeof(uint32_t)) == 0)
+			++m_nb_frames;
+		m_client.getExposeCommandReturn(m_ret);
+	}
+
+private:
+	XpadClient& m_client;
+	int m_nb_frames;
+	int m_ret;
+} ;
+
+// returns the stop latency, resync_time is the time of the next command
+static double stop(StopPoint point, double exposure, bool use_event, double& resync_time, bool& ok)
+{
+	AbortEvent event;
+	XpadClient client;
+	int server_skt = connectClient(client);
+	if (server_skt < 0)
+	{
+		cout << "cannot connect: " << client.getErrorMessage() << endl;
+		ok = false;
+		return 0;
+	}
+	if (use_event)
+		client.setAbortEvent(&event);
+
+	StopServer server(server_skt, point, exposure);
+	Reader reader(client);
+	server.start();
+	reader.start();
+	usleep(20000);					// well inside the exposure
+
+	double start = now();
+	if (use_event)
+		event.trigger();
+	server.abort();					// AbortCurrentProcess on the other connection
+	while (!reader.hasFinished())
+		usleep(100);
+	double latency = now() - start;
+
+	event.clear();
+	start = now();
+	try
+	{
+		int burst;
+		client.sendWait("GetBurstNumber", burst);
+		ok = ok && burst == BURST_NUMBER;
+	}
+	catch (Exception& e)
+	{
+		cout << "command after stop failed: " << e.getErrMsg() << endl;
+		ok = false;
+	}
+	resync_time = now() - start;
+
+	int expected_frames = (point == BeforeReturn) ? 0 : (point == InFrame && !use_event) ? 2 : 1;
+	ok = ok && reader.getNbFrames() == expected_frames;
+	ok = ok && reader.getReturn() == (use_event ? -1 : 1);
+
+	while (!server.hasFinished())
+		usleep(1000);
+	client.disconnectFromServer();
+	close(server_skt);
+	return latency;
+}
+
+static double median(vector<double> v)
+{
+	sort(v.begin(), v.end());
+	return v[v.size() / 2];
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_stops = (argc > 1) ? atoi(argv[1]) : 5;
+	double exposure = ((argc > 2) ? atof(argv[2]) : 200) * 1e-3;
+	bool ok = true;
+
+	cout << "exposure " << exposure * 1e3 << " ms" << endl;
+	for (int p = BetweenFrames; p <= BeforeReturn; ++p)
+	{
+		StopPoint point = StopPoint(p);
+		vector<double> blocking, event, resync;
+		for (int i = 0; i < nb_stops; ++i)
+		{
+			double resync_time;
+			blocking.push_back(stop(point, exposure, false, resync_time, ok));
+			event.push_back(stop(point, exposure, true, resync_time, ok));
+			resync.push_back(resync_time);
+		}
+		cout << "stop " << stopPointName(point) << ": blocking read " << median(blocking) * 1e3
+			 << " ms, abort event " << median(event) * 1e3 << " ms (max "
+			 << *max_element(event.begin(), event.end()) * 1e3 << " ms), resync on next command "
+			 << median(resync) * 1e3 << " ms" << endl;
+	}
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
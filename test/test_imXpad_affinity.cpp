@@ -0,0 +1,130 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// CPU list parsing and migration counting.
+//
+// Lists in the kernel syntax must read back in their shortest form, and
+// malformed ones must be refused without changing the set in place. A
+// thread pinned on the CPU it runs on must see no migration.
+//
+// usage: test_imXpad_affinity
+//###########################################################################
+#include <iostream>
+#include <sstream>
+#include <sched.h>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadCpuAffinity.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+// cpu list given and its expected read back
+static const char *VALID[][2] = {
+	{"8-15", "8-15"},
+	{"0-3,8", "0-3,8"},
+	{"0,1,2,5", "0-2,5"},
+	{" 2 , 4-5", "2,4-5"},
+	{"7", "7"},
+	{"", ""},
+};
+
+static const char *INVALID[] = {"3-1", "-1", "a", "0-", "4-", "2x", "1-2-3", "0-100000", "1;2"};
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	bool ok = true;
+	CpuAffinity affinity;
+
+	for (size_t i = 0; i < sizeof(VALID) / sizeof(VALID[0]); ++i)
+	{
+		try
+		{
+			affinity.setCpus(VALID[i][0]);
+			if (affinity.getCpus() != VALID[i][1] || affinity.isPinned() != (*VALID[i][1] != 0))
+			{
+				cout << "'" << VALID[i][0] << "' reads back as '" << affinity.getCpus() << "'" << endl;
+				ok = false;
+			}
+		}
+		catch (Exception& e)
+		{
+			cout << "'" << VALID[i][0] << "' refused: " << e.getErrMsg() << endl;
+			ok = false;
+		}
+	}
+
+	affinity.setCpus("8-15");
+	for (size_t i = 0; i < sizeof(INVALID) / sizeof(INVALID[0]); ++i)
+	{
+		bool refused = false;
+		try
+		{
+			affinity.setCpus(INVALID[i]);
+		}
+		catch (Exception& e)
+		{
+			refused = true;
+		}
+		if (!refused || affinity.getCpus() != "8-15")
+		{
+			cout << "'" << INVALID[i] << "' " << (refused ? "changed the set" : "NOT refused") << endl;
+			ok = false;
+		}
+	}
+
+	bool refused = false;
+	try
+	{
+		affinity.setRealtimePriority(-1);
+	}
+	catch (Exception& e)
+	{
+		refused = true;
+	}
+	ok = ok && refused && affinity.getRealtimePriority() == 0;
+
+	// pinned where it runs, the thread stays there
+	int cpu = sched_getcpu();
+	stringstream here;
+	here << cpu;
+	affinity.setCpus(here.str());
+	affinity.applyToCurrentThread();
+	MigrationCounter migrations;
+	for (int i = 0; i < 100; ++i)
+		migrations.sample();
+	if (migrations.getNbMigrations() != 0 || migrations.getLastCpu() != cpu)
+	{
+		cout << "pinned on " << cpu << ": " << migrations.getNbMigrations() << " migrations, last on "
+			 << migrations.getLastCpu() << endl;
+		ok = false;
+	}
+	migrations.reset();
+	ok = ok && migrations.getNbMigrations() == 0 && migrations.getLastCpu() == -1;
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Assembly of the frames of several detectors into one frame.
+//
+// One thread per detector hands its tiles to the assembler, as the
+// receiving threads of the detectors do, the tiles being placed side by
+// side with a gap between them. Every assembled frame must come in order
+// with each tile in place and the gaps at zero, also when one detector
+// lags behind the others. The assembled throughput is reported for one
+// detector and more: the copies being made by the detector threads, it
+// should grow with their number.
+//
+// usage: test_imXpad_assembly [nb_frames] [max_detectors]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <time.h>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadFrameAssembler.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 560;
+static const int HEIGHT = 960;			// 8 modules
+static const int GAP = 16;
+static const int NB_SLOTS = 32;
+static const int NB_IMAGES = 4;			// distinct tile images per detector
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint16_t pixelValue(int tile, int frame_nb)
+{
+	return uint16_t(1 + tile * NB_IMAGES + frame_nb % NB_IMAGES);
+}
+
+class RingSink: public FrameAssembler::Sink
+{
+public:
+	RingSink(const Size& size) :
+	m_width(size.getWidth()), m_frame_pixels(size.getWidth() * size.getHeight()),
+	m_ring(m_frame_pixels * NB_SLOTS, 0xffff), m_nb_frames(0), m_ok(true) {}
+
+	virtual void *getFrameBuffer(int frame_nb)
+	{
+		return &m_ring[(frame_nb % NB_SLOTS) * m_frame_pixels];
+	}
+
+	virtual bool frameAssembled(int frame_nb, const Timestamp& timestamp)
+	{
+		const uint16_t *frame = (const uint16_t *) getFrameBuffer(frame_nb);
+		bool ok = (frame_nb == m_nb_frames);
+		int nb_tiles = (m_width + GAP) / (WIDTH + GAP);
+		for (int t = 0; t < nb_tiles; ++t)
+		{
+			const uint16_t *tile = frame + t * (WIDTH + GAP);
+			ok = ok && tile[0] == pixelValue(t, frame_nb);
+			ok = ok && tile[(HEIGHT - 1) * m_width + WIDTH - 1] == pixelValue(t, frame_nb);
+			if (t > 0)
+				ok = ok && tile[-1] == 0 && tile[HEIGHT / 2 * m_width - GAP] == 0;
+		}
+		if (!ok)
+			m_ok = false;
+		++m_nb_frames;
+		return true;
+	}
+
+	int getNbFrames() const { return m_nb_frames; }
+	bool isOk() const { return m_ok; }
+
+private:
+	int					m_width;
+	int					m_frame_pixels;
+	vector<uint16_t>	m_ring;
+	int					m_nb_frames;
+	bool				m_ok;
+} ;
+
+// the receiving thread of one detector, its frames already in memory
+class Detector: public Thread
+{
+public:
+	Detector(FrameAssembler& assembler, int tile, int nb_frames, int nb_placed, int lag_us) :
+	m_assembler(assembler), m_tile(tile), m_nb_frames(nb_frames), m_nb_placed(nb_placed),
+	m_lag_us(lag_us), m_images(NB_IMAGES * WIDTH * HEIGHT)
+	{
+		for (int i = 0; i < NB_IMAGES; ++i)
+			for (int p = 0; p < WIDTH * HEIGHT; ++p)
+				m_images[i * WIDTH * HEIGHT + p] = pixelValue(tile, i);
+	}
+
+	int getNbPlaced() const { return m_nb_placed; }
+
+protected:
+	virtual void threadFunction()
+	{
+		for (m_nb_placed = 0; m_nb_placed < m_nb_frames; ++m_nb_placed)
+		{
+			if (m_lag_us && m_nb_placed % 8 == 0)
+				usleep(m_lag_us);
+			const uint16_t *image = &m_images[(m_nb_placed % NB_IMAGES) * WIDTH * HEIGHT];
+			if (!m_assembler.placeTile(m_tile, m_nb_placed, image, Timestamp(now())))
+				break;
+		}
+	}
+
+private:
+	FrameAssembler&		m_assembler;
+	int					m_tile;
+	int					m_nb_frames;
+	int					m_nb_placed;
+	int					m_lag_us;
+	vector<uint16_t>	m_images;
+} ;
+
+static void waitFinished(vector<Detector*>& detectors)
+{
+	for (unsigned int d = 0; d < detectors.size(); ++d)
+		while (!detectors[d]->hasFinished())
+			usleep(100);
+}
+
+// returns the assembled frames per second
+static double assemble(int nb_detectors, int nb_frames, int lag_us, bool& ok)
+{
+	FrameAssembler assembler;
+	for (int d = 0; d < nb_detectors; ++d)
+		assembler.addTile(d * (WIDTH + GAP), 0, WIDTH, HEIGHT);
+	RingSink sink(assembler.getFrameSize());
+	assembler.prepare(&sink, sizeof(uint16_t), NB_SLOTS);
+
+	vector<Detector*> detectors;
+	for (int d = 0; d < nb_detectors; ++d)
+		detectors.push_back(new Detector(assembler, d, nb_frames, 0, (d == nb_detectors - 1) ? lag_us : 0));
+
+	double start = now();
+	for (int d = 0; d < nb_detectors; ++d)
+		detectors[d]->start();
+	waitFinished(detectors);
+	double elapsed = now() - start;
+
+	ok = ok && sink.isOk() && sink.getNbFrames() == nb_frames;
+	ok = ok && assembler.getNbAssembledFrames() == nb_frames;
+	if (lag_us)
+		cout << "lagging detector: " << assembler.getNbTileWaits() << " tile waits, max tile skew "
+			 << assembler.getMaxTileSkew() * 1e3 << " ms, " << (sink.isOk() ? "frames in place" : "WRONG") << endl;
+
+	for (int d = 0; d < nb_detectors; ++d)
+		delete detectors[d];
+	return nb_frames / elapsed;
+}
+
+// a detector that stops sending must not leave the others blocked
+static void stopStalled(bool& ok)
+{
+	FrameAssembler assembler;
+	assembler.addTile(0, 0, WIDTH, HEIGHT);
+	assembler.addTile(WIDTH + GAP, 0, WIDTH, HEIGHT);
+	RingSink sink(assembler.getFrameSize());
+	assembler.prepare(&sink, sizeof(uint16_t), NB_SLOTS);
+
+	vector<Detector*> detectors;
+	detectors.push_back(new Detector(assembler, 0, 10 * NB_SLOTS, 0, 0));
+	detectors.push_back(new Detector(assembler, 1, 5, 0, 0));
+	detectors[0]->start();
+	detectors[1]->start();
+	usleep(100000);
+
+	bool blocked = !detectors[0]->hasFinished() && detectors[0]->getNbPlaced() == 5 + NB_SLOTS;
+	assembler.stop();
+	waitFinished(detectors);
+
+	cout << "stalled detector: " << (blocked ? "others wait" : "WRONG") << ", released by stop, "
+		 << assembler.getNbAssembledFrames() << " frames assembled" << endl;
+	ok = ok && blocked && assembler.getNbAssembledFrames() == 5 && sink.isOk();
+
+	bool overlap_rejected = false;
+	try
+	{
+		assembler.addTile(WIDTH, 0, WIDTH, HEIGHT);
+	}
+	catch (Exception& e)
+	{
+		overlap_rejected = true;
+	}
+	ok = ok && overlap_rejected;
+
+	delete detectors[0];
+	delete detectors[1];
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 2000;
+	int max_detectors = (argc > 2) ? atoi(argv[2]) : 4;
+	bool ok = true;
+
+	double tile_mbytes = WIDTH * HEIGHT * sizeof(uint16_t) / 1e6;
+	for (int n = 1; n <= max_detectors; n *= 2)
+	{
+		double rate = assemble(n, nb_frames, 0, ok);
+		cout << n << " detector(s): " << rate << " frames/s, " << rate * n * tile_mbytes << " MB/s" << endl;
+	}
+	assemble(max_detectors, nb_frames / 4, 2000, ok);
+	stopStalled(ok);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
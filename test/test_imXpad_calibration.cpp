@@ -0,0 +1,250 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Round trip and speed of the binary calibration.
+//
+// The global and local configurations shipped in test/Calibration are
+// written into one binary calibration, read back and written out as text
+// again: every value must survive. A flipped byte and a newer version must
+// be refused. The time to parse the texts and to load the binary
+// calibration is reported with the size of both.
+//
+// For the delta upload, a two module local configuration with one pixel
+// changed must report that chip only and keep the other module out of the
+// text to send.
+//
+// usage: test_imXpad_calibration [calibration_dir] [nb_loads]
+//###########################################################################
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadCalibrationFile.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+static const char *BINARY_PATH = "/tmp/test_imXpad_calibration.xcal";
+static const char *GLOBAL_PATH = "/tmp/test_imXpad_calibration.cfg";
+static const char *LOCAL_PATH = "/tmp/test_imXpad_calibration.cfl";
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static long fileSize(const string& path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+static bool sameSections(const CalibrationFile& a, const CalibrationFile& b)
+{
+	const vector<CalibrationFile::Section>& sa = a.getSections();
+	const vector<CalibrationFile::Section>& sb = b.getSections();
+	if (sa.size() != sb.size())
+		return false;
+	for (size_t i = 0; i < sa.size(); ++i)
+		if (sa[i].type != sb[i].type || sa[i].module != sb[i].module || sa[i].rows != sb[i].rows
+			|| sa[i].columns != sb[i].columns || sa[i].values != sb[i].values)
+			return false;
+	return true;
+}
+
+// local text of the values, one line of columns values per row
+static string localText(const vector<uint16_t>& values, size_t columns)
+{
+	string text;
+	char number[16];
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		snprintf(number, sizeof(number), "%d ", values[i]);
+		text += number;
+		if ((i + 1) % columns == 0)
+			text += '\n';
+	}
+	return text;
+}
+
+static bool checkChangedChips(const CalibrationFile& reference)
+{
+	const CalibrationFile::Section *local = NULL;
+	for (size_t i = 0; i < reference.getSections().size(); ++i)
+		if (reference.getSections()[i].type == CalibrationFile::Local)
+			local = &reference.getSections()[i];
+	if (!local)
+		return false;
+
+	// the same module twice, then one pixel of chip 3 of the second one changed
+	vector<uint16_t> values(local->values);
+	values.insert(values.end(), local->values.begin(), local->values.end());
+	string text = localText(values, local->columns);
+	CalibrationFile uploaded;
+	uploaded.parseText(CalibrationFile::Local, text.data(), text.size());
+
+	size_t pixel = (CalibrationFile::MODULE_LINES + 5) * local->columns + 3 * CalibrationFile::CHIP_COLUMNS + 17;
+	values[pixel] ^= 1;
+	text = localText(values, local->columns);
+	CalibrationFile next;
+	next.parseText(CalibrationFile::Local, text.data(), text.size());
+
+	vector<uint32_t> masks;
+	next.getChangedChips(uploaded, masks);
+	bool ok = masks.size() == 2 && masks[0] == 0 && masks[1] == (1 << 3);
+
+	uploaded.getChangedChips(uploaded, masks);
+	ok = ok && masks.size() == 2 && masks[0] == 0 && masks[1] == 0;
+
+	next.getChangedChips(CalibrationFile(), masks);
+	ok = ok && masks.size() == 2 && masks[0] == 0x7f && masks[1] == 0x7f;
+
+	vector<bool> modules(2, false);
+	modules[1] = true;
+	string delta;
+	next.formatLocalText(modules, delta);
+	CalibrationFile sent;
+	sent.parseText(CalibrationFile::Local, delta.data(), delta.size());
+	ok = ok && sent.getSections().size() == 1
+		 && sent.getSections()[0].values == vector<uint16_t>(values.begin() + local->values.size(), values.end());
+
+	// the same detector given as one map, as the Python arrays are
+	CalibrationFile array;
+	array.setLocal(&values[0], 2 * CalibrationFile::MODULE_LINES, local->columns);
+	next.getChangedChips(array, masks);
+	ok = ok && masks.size() == 2 && masks[0] == 0 && masks[1] == 0;
+
+	cout << "changed chips " << (ok ? "found" : "WRONG") << ", delta text " << delta.size() << " of "
+		 << text.size() << " bytes" << endl;
+	return ok;
+}
+
+// true if loading the binary calibration once patched is refused
+static bool refused(long offset, char value)
+{
+	string tmp = string(BINARY_PATH) + ".bad";
+	{
+		ifstream in(BINARY_PATH, ios::binary);
+		ofstream out(tmp.c_str(), ios::binary | ios::trunc);
+		out << in.rdbuf();
+	}
+	fstream file(tmp.c_str(), ios::in | ios::out | ios::binary);
+	file.seekp(offset);
+	file.put(value);
+	file.close();
+
+	bool ok = false;
+	try
+	{
+		CalibrationFile calibration;
+		calibration.load(tmp.c_str());
+	}
+	catch (Exception& e)
+	{
+		cout << "refused: " << e.getErrMsg() << endl;
+		ok = true;
+	}
+	remove(tmp.c_str());
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	string dir = __FILE__;
+	dir = dir.substr(0, dir.find_last_of('/') + 1) + "Calibration";
+	if (argc > 1)
+		dir = argv[1];
+	int nb_loads = (argc > 2) ? atoi(argv[2]) : 20;
+	string global_path = dir + "/ConfigGlobalFast.cfg";
+	string local_path = dir + "/ConfigLocalFast.cfl";
+	bool ok = true;
+
+	try
+	{
+		CalibrationFile text;
+		double start = now();
+		for (int i = 0; i < nb_loads; ++i)
+		{
+			text.loadText(CalibrationFile::Global, global_path.c_str());
+			text.loadText(CalibrationFile::Local, local_path.c_str());
+		}
+		double text_time = (now() - start) / nb_loads;
+		text.save(BINARY_PATH);
+
+		CalibrationFile binary;
+		start = now();
+		for (int i = 0; i < nb_loads; ++i)
+			binary.load(BINARY_PATH);
+		double binary_time = (now() - start) / nb_loads;
+		ok = ok && sameSections(text, binary);
+
+		long text_size = fileSize(global_path) + fileSize(local_path);
+		cout << "text " << text_size << " bytes parsed in " << text_time * 1e3 << " ms, binary "
+			 << fileSize(BINARY_PATH) << " bytes loaded in " << binary_time * 1e3 << " ms" << endl;
+
+		const vector<CalibrationFile::Section>& sections = binary.getSections();
+		int nb_local = 0;
+		for (size_t i = 0; i < sections.size(); ++i)
+			if (sections[i].type == CalibrationFile::Local)
+			{
+				nb_local++;
+				ok = ok && sections[i].rows == CalibrationFile::MODULE_LINES;
+			}
+		ok = ok && nb_local == 1 && binary.hasSections(CalibrationFile::Global);
+
+		// back to text, then parsed again
+		binary.saveText(CalibrationFile::Global, GLOBAL_PATH);
+		binary.saveText(CalibrationFile::Local, LOCAL_PATH);
+		CalibrationFile again;
+		again.loadText(CalibrationFile::Global, GLOBAL_PATH);
+		again.loadText(CalibrationFile::Local, LOCAL_PATH);
+		ok = ok && sameSections(binary, again);
+		cout << "text round trip " << (sameSections(binary, again) ? "identical" : "DIFFERENT") << endl;
+
+		ok = checkChangedChips(binary) && ok;
+
+		ok = ok && refused(fileSize(BINARY_PATH) - 1, 0x7f);
+		ok = ok && refused(4, 2);
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+	remove(BINARY_PATH);
+	remove(GLOBAL_PATH);
+	remove(LOCAL_PATH);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
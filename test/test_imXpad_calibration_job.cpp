@@ -0,0 +1,202 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Progress, remaining time and cancellation of a calibration job.
+//
+// A stand-in server runs a calibration of NB_STEPS steps of a fixed time,
+// sending a time bar after each one as the detector server does, and
+// returns 1 instead of 0 once aborted. The job must follow the time bars,
+// its remaining time at half of the calibration must be close to the time
+// it really took, and a cancel must end the job at the next step.
+//
+// usage: test_imXpad_calibration_job [step_ms]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadCalibrationJob.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+static const int NB_STEPS = 10;
+
+class CalibrationServer: public StandInServer
+{
+public:
+	CalibrationServer(int listener, double step) :
+	m_listener(listener), m_step(step), m_abort(false), m_nb_session(0) {}
+
+	// AbortCurrentProcess, received on the other connection
+	void abort()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		m_abort = true;
+	}
+
+	int getNbSessionCommands() const { return m_nb_session; }
+
+protected:
+	virtual void threadFunction()
+	{
+		m_skt = acceptLocal(m_listener);
+		_send("> ");
+		string line;
+		while (_readLine(line))
+		{
+			if (line == "Exit")
+				break;
+			if (line.compare(0, 11, "Calibration") == 0)
+				_calibrate();
+			else
+			{
+				m_nb_session++;
+				_send("* 0\n> ");
+			}
+		}
+		close(m_skt);
+	}
+
+private:
+	void _calibrate()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		m_abort = false;
+		aLock.unlock();
+
+		for (int step = 1; step <= NB_STEPS; ++step)
+		{
+			usleep(useconds_t(m_step * 1e6));
+			aLock.lock();
+			bool aborted = m_abort;
+			aLock.unlock();
+			if (aborted)
+			{
+				_send("* 1\n> ");
+				return;
+			}
+			char bar[64];
+			snprintf(bar, sizeof(bar), "@ %d %d 'step %d'\n", step, NB_STEPS, step);
+			_send(bar);
+		}
+		_send("* 0\n> ");
+	}
+
+	int m_listener;
+	double m_step;
+	Cond m_cond;
+	bool m_abort;
+	int m_nb_session;
+} ;
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	double step = ((argc > 1) ? atof(argv[1]) : 30) * 1e-3;
+	bool ok = true;
+
+	int port = 0;
+	int listener = listenLocal(port);
+
+	CalibrationServer server(listener, step);
+	server.start();
+
+	try
+	{
+		CalibrationJob job;
+		vector<string> session;
+		session.push_back("Init");
+		session.push_back("SetModuleMask 1");
+		job.connect("127.0.0.1", port, session);
+		ok = ok && server.getNbSessionCommands() == 2;
+
+		// a whole calibration, followed from here
+		double start = now();
+		job.start("CalibrationOTN 2");
+		double last_progress = -1, half_eta = -1, half_time = 0;
+		bool monotonic = true;
+		while (job.isRunning())
+		{
+			double progress = job.getProgress();
+			monotonic = monotonic && progress >= last_progress;
+			last_progress = progress;
+			if (half_eta < 0 && progress >= 0.5)
+			{
+				half_eta = job.getRemainingTime();
+				half_time = now();
+			}
+			usleep(2000);
+		}
+		double left = now() - half_time;
+		double total = now() - start;
+		ok = ok && monotonic && job.getState() == CalibrationJob::Succeeded && job.getProgress() == 1;
+		ok = ok && half_eta >= 0 && fabs(half_eta - left) < 0.25 * total;
+		cout << "calibration " << total * 1e3 << " ms, remaining time at half " << half_eta * 1e3
+			 << " ms for " << left * 1e3 << " ms, last message '" << job.getMessage() << "'" << endl;
+
+		// a second one is cancelled on the way
+		job.start("CalibrationBEAM 1000 50 2");
+		try
+		{
+			job.start("CalibrationOTN 2");
+			ok = false;
+		}
+		catch (Exception& e)
+		{
+		}
+		while (job.getProgress() < 0.3)
+			usleep(1000);
+		double cancel = now();
+		job.cancel();
+		server.abort();
+		job.wait();
+		double stop = now() - cancel;
+		ok = ok && job.getState() == CalibrationJob::Aborted && job.getProgress() < 1;
+		ok = ok && stop < 2 * step + 0.05;
+		cout << "cancelled at " << job.getProgress() * 100 << " %, ended " << stop * 1e3 << " ms later" << endl;
+
+		job.disconnect();
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	while (!server.hasFinished())
+		usleep(1000);
+	close(listener);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,317 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Round trip and throughput of the compressed frame transfer.
+//
+// A stand-in server thread sends frames over a localhost socket with the
+// same 12 bytes header as the detector server, raw or compressed, and
+// optionally paced to emulate a slower link (bandwidth in Mbit/s).
+// Several threads also decode on the same pool at once, as the module
+// streams of the per-module readout do.
+//
+// usage: test_imXpad_codec [nb_frames] [link_mbits ...]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadClient.h"
+#include "../include/imXpadCodec.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 560;		// 7 chips of 80 columns
+static const int HEIGHT = 1200;		// 10 modules of 120 lines
+
+// mostly empty frame with a few low count spots, as seen in diffraction
+static void makeFrame(vector<uint32_t>& frame, int seed)
+{
+	srand(seed);
+	frame.assign(WIDTH * HEIGHT, 0);
+	for (size_t i = 0; i < frame.size(); ++i)
+	{
+		int r = rand() % 100;
+		if (r < 20)
+			frame[i] = rand() % 8;
+		else if (r == 99)
+			frame[i] = rand() % 5000;
+	}
+}
+
+class FrameServer: public StandInServer
+{
+public:
+	FrameServer(int skt, const vector<unsigned char>& payload, int nb_frames, double mbits) :
+	StandInServer(skt), m_payload(payload), m_nb_frames(nb_frames), m_mbits(mbits) {}
+
+protected:
+	virtual void threadFunction()
+	{
+		unsigned char header[3 * sizeof(uint32_t)];
+		uint32_t words[3] = {uint32_t(m_payload.size()), HEIGHT, WIDTH};
+		memcpy(header, words, sizeof(header));
+
+		for (int i = 0; i < m_nb_frames; ++i)
+		{
+			double start = now();
+			_send(header, sizeof(header));
+			const size_t chunk = 64 * 1024;
+			for (size_t pos = 0; pos < m_payload.size(); pos += chunk)
+			{
+				size_t len = min(chunk, m_payload.size() - pos);
+				_send(&m_payload[pos], len);
+				if (m_mbits > 0)
+				{
+					double due = start + (pos + len) * 8. / (m_mbits * 1e6);
+					double wait = due - now();
+					if (wait > 0)
+						usleep(useconds_t(wait * 1e6));
+				}
+			}
+			if (!_readAck())
+				break;
+		}
+	}
+
+private:
+	const vector<unsigned char>& m_payload;
+	int m_nb_frames;
+	double m_mbits;
+} ;
+
+// returns frames per second received through XpadClient::getDataExpose
+static double transfer(const vector<unsigned char>& payload, FrameCodec *codec,
+					   const vector<uint32_t>& ref, int nb_frames, double mbits, bool& ok)
+{
+	int client_skt, server_skt;
+	connectPair(client_skt, server_skt);
+
+	FrameServer server(server_skt, payload, nb_frames, mbits);
+	XpadClient client;
+	client.m_skt = client_skt;
+	client.setFrameCodec(codec);
+
+	vector<uint32_t> frame(WIDTH * HEIGHT);
+	double start = now();
+	server.start();
+	for (int i = 0; i < nb_frames; ++i)
+	{
+		client.getDataExpose(&frame[0], 1, frame.size() * sizeof(uint32_t));
+		ok = ok && (frame == ref);
+	}
+	double elapsed = now() - start;
+
+	while (!server.hasFinished())
+		usleep(1000);
+	close(client_skt);
+	close(server_skt);
+	return nb_frames / elapsed;
+}
+
+static uint32_t getWord(const vector<unsigned char>& payload, size_t pos)
+{
+	return payload[pos] | payload[pos + 1] << 8 | payload[pos + 2] << 16 | uint32_t(payload[pos + 3]) << 24;
+}
+
+static void setWord(vector<unsigned char>& payload, size_t pos, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		payload[pos + i] = (value >> (8 * i)) & 0xff;
+}
+
+// one module stream decoding its bands
+class DecodeThread: public Thread
+{
+public:
+	DecodeThread(FrameCodec& codec, const vector<unsigned char>& packed, const vector<uint32_t>& ref, int nb_frames) :
+	m_codec(codec), m_packed(packed), m_ref(ref), m_nb_frames(nb_frames), m_nb_bad(0) {}
+
+	int getNbBadFrames() const { return m_nb_bad; }
+
+protected:
+	virtual void threadFunction()
+	{
+		vector<uint32_t> out(m_ref.size());
+		for (int i = 0; i < m_nb_frames; ++i)
+		{
+			out.assign(out.size(), 0);
+			try
+			{
+				m_codec.decode(&m_packed[0], m_packed.size(), &out[0], m_ref.size(), 4);
+			}
+			catch (Exception& e)
+			{
+			}
+			if (out != m_ref)
+				++m_nb_bad;
+		}
+	}
+
+private:
+	FrameCodec&						m_codec;
+	const vector<unsigned char>&	m_packed;
+	const vector<uint32_t>&			m_ref;
+	int								m_nb_frames;
+	int								m_nb_bad;
+} ;
+
+static bool concurrentDecode(const vector<unsigned char>& packed, const vector<uint32_t>& ref,
+							 int nb_threads, int nb_frames)
+{
+	// workers even on a single CPU, their slices are what the callers share
+	WorkerPool pool(3);
+	FrameCodec codec(pool);
+	vector<DecodeThread*> threads;
+	for (int i = 0; i < nb_threads; ++i)
+	{
+		threads.push_back(new DecodeThread(codec, packed, ref, nb_frames));
+		threads.back()->start();
+	}
+	int nb_bad = 0;
+	for (int i = 0; i < nb_threads; ++i)
+	{
+		while (!threads[i]->hasFinished())
+			usleep(1000);
+		nb_bad += threads[i]->getNbBadFrames();
+		delete threads[i];
+	}
+	if (nb_bad)
+		cout << nb_bad << " frames wrongly decoded by " << nb_threads << " concurrent threads" << endl;
+	return nb_bad == 0;
+}
+
+static bool rejected(FrameCodec& codec, const vector<unsigned char>& payload, uint32_t nb_pixels, const char *what)
+{
+	vector<uint32_t> frame(nb_pixels);
+	bool ok = false;
+	try
+	{
+		codec.decode(&payload[0], payload.size(), &frame[0], nb_pixels, 4);
+	}
+	catch (Exception& e)
+	{
+		ok = true;
+	}
+	if (!ok)
+		cout << what << " NOT rejected" << endl;
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 20;
+	vector<double> links;
+	for (int i = 2; i < argc; ++i)
+		links.push_back(atof(argv[i]));
+	if (links.empty())
+	{
+		links.push_back(0);			// localhost, unthrottled
+		links.push_back(1000);
+	}
+
+	long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	WorkerPool pool(nb_cpus > 1 ? nb_cpus - 1 : 0);
+	FrameCodec codec(pool);
+	bool ok = true;
+
+	vector<uint32_t> ref;
+	makeFrame(ref, 1);
+
+	// round trip, 32 and 16 bits
+	vector<unsigned char> packed;
+	double start = now();
+	for (int i = 0; i < nb_frames; ++i)
+		codec.encode(&ref[0], ref.size(), packed);
+	double encode_time = (now() - start) / nb_frames;
+
+	vector<uint32_t> out32(ref.size());
+	start = now();
+	for (int i = 0; i < nb_frames; ++i)
+		codec.decode(&packed[0], packed.size(), &out32[0], ref.size(), 4);
+	double decode_time = (now() - start) / nb_frames;
+	ok = ok && (out32 == ref);
+
+	vector<uint16_t> out16(ref.size());
+	codec.decode(&packed[0], packed.size(), &out16[0], ref.size(), 2);
+	for (size_t i = 0; ok && i < ref.size(); ++i)
+		ok = (out16[i] == ref[i]);
+
+	ok = concurrentDecode(packed, ref, 4, nb_frames) && ok;
+
+	// a truncated or corrupted payload must be rejected, not decoded
+	vector<unsigned char> broken(packed.begin(), packed.begin() + packed.size() / 2);
+	ok = rejected(codec, broken, ref.size(), "truncated payload") && ok;
+
+	uint32_t table_end = FrameCodec::HEADER_SIZE + (getWord(packed, 12) + 1) * sizeof(uint32_t);
+	broken = packed;
+	setWord(broken, 12, 0x3fffffff);		// (nb_blocks + 1) * 4 wraps to 0 on 32 bits
+	ok = rejected(codec, broken, ref.size(), "wrapping block count") && ok;
+
+	broken = packed;
+	setWord(broken, 16 + 2 * 4, getWord(packed, 16 + 4) - 1);
+	ok = rejected(codec, broken, ref.size(), "decreasing offsets") && ok;
+
+	broken = packed;
+	setWord(broken, 16 + 4, packed.size());
+	ok = rejected(codec, broken, ref.size(), "offset past the blocks") && ok;
+
+	broken = packed;
+	broken[table_end + getWord(packed, 16)] = 200;
+	ok = rejected(codec, broken, ref.size(), "bit width over 32") && ok;
+
+	broken = packed;
+	broken[table_end + getWord(packed, 16)] = 32;
+	ok = rejected(codec, broken, ref.size(), "block overrunning the next one") && ok;
+
+	double raw_size = ref.size() * sizeof(uint32_t);
+	cout << "frame " << WIDTH << "x" << HEIGHT << ", " << pool.getNbWorkers() << " workers" << endl;
+	cout << "compression ratio " << raw_size / packed.size() << endl;
+	cout << "encode " << raw_size / encode_time / 1e6 << " MB/s, decode "
+		 << raw_size / decode_time / 1e6 << " MB/s" << endl;
+
+	vector<unsigned char> raw(raw_size);
+	memcpy(&raw[0], &ref[0], raw.size());
+
+	for (size_t i = 0; i < links.size(); ++i)
+	{
+		double raw_fps = transfer(raw, NULL, ref, nb_frames, links[i], ok);
+		double packed_fps = transfer(packed, &codec, ref, nb_frames, links[i], ok);
+		cout << "link ";
+		if (links[i] > 0)
+			cout << links[i] << " Mbit/s";
+		else
+			cout << "localhost";
+		cout << ": raw " << raw_fps << " fps, compressed " << packed_fps << " fps" << endl;
+	}
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Heap allocations and time per server command.
+//
+// The same exposure parameters command is formatted with a stringstream,
+// as the camera used to, and with a CommandBuilder, then sent to a
+// stand-in server answering every command at once. Allocations are counted
+// by replacing the global operator new. Doubles must keep their '.'
+// under a locale with a decimal comma, when one is installed.
+//
+// usage: test_imXpad_command [nb_commands]
+//###########################################################################
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <clocale>
+#include <new>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadClient.h"
+#include "../include/imXpadCommandBuilder.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+// allocations of the main thread only, the stand-in server has its own
+static __thread long nb_allocs = 0;
+
+void *operator new(size_t size)
+{
+	++nb_allocs;
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) throw()
+{
+	free(p);
+}
+
+// exposure parameters of a fast scan point
+static const unsigned NB_FRAMES = 1;
+static const unsigned EXP_TIME = 1000;
+static const unsigned LAT_TIME = 5000;
+static const unsigned OVERFLOW_TIME = 4000;
+static const unsigned short TRIGGER = 0, OUTPUT = 0, GEOM = 0, FLAT = 0;
+static const unsigned short TRANSFER = 1, FORMAT = 1, MODE = 0, STACK = 1;
+
+static void format(stringstream& cmd)
+{
+	cmd << "SetExposureParameters " << NB_FRAMES << " " << EXP_TIME << " " << LAT_TIME << " "
+		<< OVERFLOW_TIME << " " << TRIGGER << " " << OUTPUT << " " << GEOM << " " << FLAT << " "
+		<< TRANSFER << " " << FORMAT << " " << MODE << " " << STACK << " "
+		<< "/opt/imXPAD/tmp_corrected/";
+}
+
+static void format(CommandBuilder& cmd)
+{
+	cmd << "SetExposureParameters " << NB_FRAMES << " " << EXP_TIME << " " << LAT_TIME << " "
+		<< OVERFLOW_TIME << " " << TRIGGER << " " << OUTPUT << " " << GEOM << " " << FLAT << " "
+		<< TRANSFER << " " << FORMAT << " " << MODE << " " << STACK << " "
+		<< "/opt/imXPAD/tmp_corrected/";
+}
+
+// answers every line with a zero return value and the next prompt
+class CommandServer: public StandInServer
+{
+public:
+	CommandServer(int skt) : StandInServer(skt), m_nb_commands(0) {}
+
+	int getNbCommands() const { return m_nb_commands; }
+	const string& getLastCommand() const { return m_last; }
+
+protected:
+	virtual void threadFunction()
+	{
+		static const char reply[] = "* 0\n> ";
+		write(m_skt, "> ", 2);
+		char buf[4096];
+		string line;
+		ssize_t n;
+		while ((n = read(m_skt, buf, sizeof(buf))) > 0)
+		{
+			for (ssize_t i = 0; i < n; ++i)
+			{
+				if (buf[i] != '\n')
+				{
+					line += buf[i];
+					continue;
+				}
+				m_last = line;
+				line.clear();
+				++m_nb_commands;
+				write(m_skt, reply, sizeof(reply) - 1);
+			}
+		}
+	}
+
+private:
+	int m_nb_commands;
+	string m_last;
+} ;
+
+// doubles as a stream in the classic locale writes them
+static bool checkDoubles(const char *locale)
+{
+	static const double values[] = {0.5, -2.25, 1e-7, 123456789.0, 1.0 / 3};
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+	{
+		stringstream ref;
+		ref.imbue(std::locale::classic());
+		ref << values[i];
+		CommandBuilder cmd;
+		cmd << values[i];
+		if (cmd.str() != ref.str())
+		{
+			cout << "locale " << locale << ": " << ref.str() << " written " << cmd.str() << endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_commands = (argc > 1) ? atoi(argv[1]) : 20000;
+	bool ok = true;
+
+	// formatting alone
+	stringstream ref;
+	format(ref);
+	CommandBuilder check;
+	format(check);
+	ok = ok && check.str() == ref.str();
+
+	ok = checkDoubles("C") && ok;
+	const char *comma_locales[] = {"de_DE.UTF-8", "fr_FR.UTF-8", "de_DE", "fr_FR"};
+	const char *comma = NULL;
+	for (size_t i = 0; !comma && i < sizeof(comma_locales) / sizeof(comma_locales[0]); ++i)
+		if (setlocale(LC_NUMERIC, comma_locales[i]))
+			comma = comma_locales[i];
+	if (comma)
+	{
+		ok = checkDoubles(comma) && ok;
+		setlocale(LC_NUMERIC, "C");
+	}
+	else
+		cout << "no locale with a decimal comma installed, not checked" << endl;
+
+	long allocs = nb_allocs;
+	double start = now();
+	for (int i = 0; i < nb_commands; ++i)
+	{
+		stringstream cmd;
+		format(cmd);
+		string s = cmd.str();
+	}
+	double stream_time = (now() - start) / nb_commands;
+	double stream_allocs = double(nb_allocs - allocs) / nb_commands;
+
+	allocs = nb_allocs;
+	start = now();
+	for (int i = 0; i < nb_commands; ++i)
+	{
+		CommandBuilder cmd;
+		format(cmd);
+	}
+	double builder_time = (now() - start) / nb_commands;
+	double builder_allocs = double(nb_allocs - allocs) / nb_commands;
+
+	cout << "formatting: stringstream " << stream_allocs << " allocations, " << stream_time * 1e9
+		 << " ns; CommandBuilder " << builder_allocs << " allocations, " << builder_time * 1e9 << " ns" << endl;
+	ok = ok && builder_allocs == 0;
+
+	// full command round trip
+	XpadClient client;
+	int server_skt = connectClient(client);
+	if (server_skt < 0)
+	{
+		cout << "cannot connect: " << client.getErrorMessage() << endl;
+		return 1;
+	}
+	CommandServer server(server_skt);
+	server.start();
+
+	int ret;
+	{
+		CommandBuilder cmd;
+		format(cmd);
+		client.sendWait(cmd, ret);			// warm up
+	}
+
+	allocs = nb_allocs;
+	start = now();
+	for (int i = 0; i < nb_commands; ++i)
+	{
+		stringstream cmd;
+		format(cmd);
+		client.sendWait(cmd.str(), ret);
+	}
+	stream_time = (now() - start) / nb_commands;
+	stream_allocs = double(nb_allocs - allocs) / nb_commands;
+
+	allocs = nb_allocs;
+	start = now();
+	for (int i = 0; i < nb_commands; ++i)
+	{
+		CommandBuilder cmd;
+		format(cmd);
+		client.sendWait(cmd, ret);
+	}
+	builder_time = (now() - start) / nb_commands;
+	builder_allocs = double(nb_allocs - allocs) / nb_commands;
+
+	cout << "round trip: stringstream " << stream_allocs << " allocations, " << stream_time * 1e6
+		 << " us; CommandBuilder " << builder_allocs << " allocations, " << builder_time * 1e6 << " us" << endl;
+	ok = ok && builder_allocs == 0;
+	ok = ok && server.getNbCommands() == 2 * nb_commands + 1 && server.getLastCommand() == ref.str();
+
+	client.disconnectFromServer();
+	while (!server.hasFinished())
+		usleep(1000);
+	close(server_skt);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Worker pool and client-side flat field / bad pixel correction.
+//
+// The pool must hand every item to exactly one slice, and a task failing
+// in the caller's own slice must not return before the workers are done
+// with it. The corrections are checked on a small frame against values
+// computed by hand: a known flat field, clamping at the 16 bits maximum,
+// masked pixels set to zero or to the mean of their valid neighbours,
+// and a white image loaded from a file.
+//
+// usage: test_imXpad_correction [nb_workers]
+//###########################################################################
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadCorrection.h"
+#include "../include/imXpadWorkerPool.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 4;
+static const int HEIGHT = 3;
+
+class CountTask: public WorkerPool::Task
+{
+public:
+	CountTask(int nb_items) : m_hits(nb_items, 0) {}
+
+	virtual void process(int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+			++m_hits[i];
+	}
+
+	bool allOnce() const
+	{
+		for (size_t i = 0; i < m_hits.size(); ++i)
+			if (m_hits[i] != 1)
+				return false;
+		return true;
+	}
+
+private:
+	vector<int> m_hits;
+} ;
+
+// the caller's slice starts at 0 and fails, worker slices finish late
+class FailingTask: public WorkerPool::Task
+{
+public:
+	FailingTask() : m_nb_done(0) {}
+
+	virtual void process(int begin, int end)
+	{
+		if (begin == 0)
+			THROW_HW_ERROR(Error) << "caller slice failed";
+		usleep(50000);
+		AutoMutex aLock(m_lock);
+		++m_nb_done;
+	}
+
+	int getNbDone()
+	{
+		AutoMutex aLock(m_lock);
+		return m_nb_done;
+	}
+
+private:
+	Mutex	m_lock;
+	int		m_nb_done;
+} ;
+
+static bool testPool(int nb_workers)
+{
+	WorkerPool pool(nb_workers);
+	bool ok = true;
+
+	int nb_items[] = {0, 1, 3, 7, 1000};
+	for (size_t n = 0; n < sizeof(nb_items) / sizeof(nb_items[0]); ++n)
+	{
+		CountTask task(nb_items[n]);
+		pool.run(task, nb_items[n]);
+		if (!task.allOnce())
+		{
+			cout << nb_items[n] << " items not processed once each" << endl;
+			ok = false;
+		}
+	}
+
+	FailingTask failing;
+	bool thrown = false;
+	try
+	{
+		pool.run(failing, (nb_workers + 1) * 10);
+	}
+	catch (Exception& e)
+	{
+		thrown = true;
+	}
+	if (!thrown || failing.getNbDone() != nb_workers)
+	{
+		cout << "failing task: " << (thrown ? "" : "not ") << "thrown, "
+			 << failing.getNbDone() << " of " << nb_workers << " worker slices done" << endl;
+		ok = false;
+	}
+	return ok;
+}
+
+template <class T>
+static bool check(const vector<T>& frame, const T *expected, const char *what)
+{
+	for (size_t i = 0; i < frame.size(); ++i)
+		if (frame[i] != expected[i])
+		{
+			cout << what << ": pixel " << i << " is " << frame[i] << ", expected " << expected[i] << endl;
+			return false;
+		}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_workers = (argc > 1) ? atoi(argv[1]) : 3;
+	bool ok = true;
+
+	ok = testPool(0) && ok;
+	ok = testPool(nb_workers) && ok;
+
+	WorkerPool pool(nb_workers);
+	Size size(WIDTH, HEIGHT);
+	try
+	{
+		// flat field, rounded to the nearest count
+		Correction corr(pool);
+		float coeffs[WIDTH * HEIGHT] = {1, 2, 0.5, 1.5, 1, 1, 1, 1, 0, 3, 1, 1};
+		corr.setFlatField(coeffs, size);
+		corr.prepare(size);
+		uint32_t raw32[WIDTH * HEIGHT] = {10, 10, 11, 10, 1, 2, 3, 4, 9, 7, 0, 5};
+		uint32_t flat32[WIDTH * HEIGHT] = {10, 20, 6, 15, 1, 2, 3, 4, 0, 21, 0, 5};
+		vector<uint32_t> frame32(raw32, raw32 + WIDTH * HEIGHT);
+		corr.apply(&frame32[0], 4);
+		ok = check(frame32, flat32, "flat field 32 bits") && ok;
+
+		uint16_t raw16[WIDTH * HEIGHT] = {60000, 10, 11, 10, 1, 2, 3, 4, 9, 30000, 0, 5};
+		uint16_t flat16[WIDTH * HEIGHT] = {60000, 20, 6, 15, 1, 2, 3, 4, 0, 65535, 0, 5};
+		vector<uint16_t> frame16(raw16, raw16 + WIDTH * HEIGHT);
+		corr.apply(&frame16[0], 2);
+		ok = check(frame16, flat16, "flat field 16 bits") && ok;
+
+		// pixels 5 (dead) and 6 (noisy) are neighbours, 5 has one valid neighbour left
+		corr.clearFlatField();
+		unsigned char dead[WIDTH * HEIGHT] = {0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0};
+		unsigned char noisy[WIDTH * HEIGHT] = {0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0};
+		corr.setDeadPixelMask(dead, size);
+		corr.setNoisyPixelMask(noisy, size);
+		uint32_t raw[WIDTH * HEIGHT] = {10, 20, 30, 40, 99, 99, 99, 50, 60, 99, 70, 80};
+		uint32_t zeroed[WIDTH * HEIGHT] = {10, 20, 30, 40, 0, 0, 0, 50, 60, 0, 70, 80};
+		// 4: (10 + 60) / 2, 5: (20) / 1, 6: (30 + 50 + 70) / 3, 9: (60 + 70) / 2
+		uint32_t interpolated[WIDTH * HEIGHT] = {10, 20, 30, 40, 35, 20, 50, 50, 60, 65, 70, 80};
+
+		corr.setBadPixelMode(Correction::Zero);
+		frame32.assign(raw, raw + WIDTH * HEIGHT);
+		corr.apply(&frame32[0], 4);
+		ok = check(frame32, zeroed, "bad pixels zeroed") && ok;
+
+		corr.setBadPixelMode(Correction::Interpolate);
+		frame32.assign(raw, raw + WIDTH * HEIGHT);
+		corr.apply(&frame32[0], 4);
+		ok = check(frame32, interpolated, "bad pixels interpolated") && ok;
+
+		// masks of another size are refused, so are frames of another size
+		bool refused = false;
+		try
+		{
+			corr.setDeadPixelMask(dead, Size(HEIGHT, WIDTH));
+		}
+		catch (Exception& e)
+		{
+			refused = true;
+		}
+		try
+		{
+			corr.prepare(Size(WIDTH, HEIGHT + 1));
+			refused = false;
+		}
+		catch (Exception& e)
+		{
+		}
+		ok = ok && refused;
+
+		corr.clearPixelMasks();
+		ok = ok && !corr.isActive();
+
+		// a white image gives mean / white, pixels which never counted stay at 0
+		const char *path = "/tmp/test_imXpad_correction.white";
+		uint32_t white[WIDTH * HEIGHT] = {100, 200, 50, 100, 100, 100, 100, 100, 100, 100, 0, 100};
+		{
+			ofstream file(path, ios::out | ios::binary);
+			file.write((const char *) white, sizeof(white));
+		}
+		corr.loadFlatField(path, size);
+		unlink(path);
+		uint32_t counts[WIDTH * HEIGHT] = {100, 200, 50, 100, 100, 100, 100, 100, 100, 100, 100, 100};
+		// mean of the 11 counting pixels is 1150 / 11
+		uint32_t flat[WIDTH * HEIGHT] = {105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 0, 105};
+		frame32.assign(counts, counts + WIDTH * HEIGHT);
+		corr.apply(&frame32[0], 4);
+		ok = check(frame32, flat, "loaded white image") && ok;
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
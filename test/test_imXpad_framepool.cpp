@@ -0,0 +1,160 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Allocation, prefault and reuse of the frame pool.
+//
+// Buffers of a frame which is not a whole number of pages must come page
+// aligned and must not overlap. A second acquisition with fewer buffers
+// reuses the mapping without touching a page again, a larger one grows
+// it and only prefaults then. The mapping is kept on release and only
+// given back once no buffer is in use; with transparent hugepages the
+// buffers start on a hugepage boundary.
+//
+// usage: test_imXpad_framepool [nb_buffers]
+//###########################################################################
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadFramePool.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+// 560 x 121 x 4 bytes is not a multiple of the page size
+static const FrameDim FRAME_DIM(Size(560, 121), Bpp32);
+
+static bool checkBuffers(FramePool& pool, int nb_buffers, const char *what)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t mem_size = FRAME_DIM.getMemSize();
+	int nb;
+	pool.getNbBuffers(nb);
+	if (nb != nb_buffers || pool.getBufferPtr(nb_buffers) != NULL || pool.getBufferPtr(-1) != NULL)
+	{
+		cout << what << ": " << nb << " buffers for " << nb_buffers << endl;
+		return false;
+	}
+
+	// every buffer holds its own frame number
+	for (int i = 0; i < nb_buffers; ++i)
+	{
+		char *ptr = (char *) pool.getBufferPtr(i);
+		if (!ptr || (uintptr_t) ptr % page)
+		{
+			cout << what << ": buffer " << i << " not page aligned" << endl;
+			return false;
+		}
+		memset(ptr, i + 1, mem_size);
+	}
+	for (int i = 0; i < nb_buffers; ++i)
+	{
+		char *ptr = (char *) pool.getBufferPtr(i);
+		if (ptr[0] != i + 1 || ptr[mem_size - 1] != i + 1)
+		{
+			cout << what << ": buffer " << i << " overwritten" << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_buffers = (argc > 1) ? atoi(argv[1]) : 8;
+	bool ok = true;
+
+	try
+	{
+		FramePool pool;
+		ok = pool.getMaxNbBuffers(FRAME_DIM) > nb_buffers;
+
+		pool.allocBuffers(nb_buffers, FRAME_DIM);
+		pool.prefault();
+		size_t mapped = pool.getMappedSize();
+		void *base = pool.getBufferPtr(0);
+		ok = checkBuffers(pool, nb_buffers, "first acquisition") && ok;
+
+		// fewer buffers: same mapping, nothing left to touch
+		pool.releaseBuffers();
+		pool.allocBuffers(nb_buffers / 2, FRAME_DIM);
+		pool.prefault();
+		if (pool.getMappedSize() != mapped || pool.getBufferPtr(0) != base || pool.getPrefaultTime() != 0)
+		{
+			cout << "smaller acquisition did not reuse the mapping" << endl;
+			ok = false;
+		}
+		ok = checkBuffers(pool, nb_buffers / 2, "smaller acquisition") && ok;
+
+		// more buffers: the mapping grows and is touched again
+		pool.releaseBuffers();
+		pool.allocBuffers(2 * nb_buffers, FRAME_DIM);
+		pool.prefault();
+		if (pool.getMappedSize() <= mapped || pool.getPrefaultTime() == 0)
+		{
+			cout << "larger acquisition did not grow the mapping" << endl;
+			ok = false;
+		}
+		ok = checkBuffers(pool, 2 * nb_buffers, "larger acquisition") && ok;
+
+		// the mapping outlives the buffers, not their use
+		bool refused = false;
+		try
+		{
+			pool.freeMemory();
+		}
+		catch (Exception& e)
+		{
+			refused = true;
+		}
+		pool.releaseBuffers();
+		ok = ok && refused && pool.getMappedSize() > 0;
+		pool.freeMemory();
+		ok = ok && pool.getMappedSize() == 0;
+
+		pool.setHugePageMode(FramePool::TransparentHugePage);
+		pool.allocBuffers(nb_buffers, FRAME_DIM);
+		pool.prefault();
+		if ((uintptr_t) pool.getBufferPtr(0) % (2 * 1024 * 1024))
+		{
+			cout << "hugepage buffers not hugepage aligned" << endl;
+			ok = false;
+		}
+		ok = checkBuffers(pool, nb_buffers, "hugepage acquisition") && ok;
+		pool.releaseBuffers();
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
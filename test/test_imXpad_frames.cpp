@@ -0,0 +1,199 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Frame accounting of a streamed acquisition.
+//
+// A stand-in server streams frames at a fixed period and, on the way,
+// delays one frame, announces one with the wrong size, sends one shorter
+// than its header says, then ends the stream with an empty header instead
+// of the end of stream one. The reading side checks each header the way
+// the acquisition thread does; the accounting must count each anomaly
+// once and every frame read.
+//
+// Frames are sent on a fixed schedule. The delay from the modelled
+// exposure start is reported for the header arrival time, and for the
+// time the frame is ready, which the buffer manager would stamp.
+//
+// usage: test_imXpad_frames [nb_frames] [period_ms]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadClient.h"
+#include "../include/imXpadFrameAccounting.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+static const uint32_t WIDTH = 560;
+static const uint32_t HEIGHT = 120;
+
+class FrameServer: public StandInServer
+{
+public:
+	FrameServer(int skt, int nb_frames, double period) :
+	StandInServer(skt), m_nb_frames(nb_frames), m_period(period) {}
+
+	// frames the server spoils
+	int lateFrame() const { return m_nb_frames / 4; }
+	int resizedFrame() const { return m_nb_frames / 2; }
+	int shortFrame() const { return 3 * m_nb_frames / 4; }
+
+protected:
+	virtual void threadFunction()
+	{
+		vector<uint32_t> frame(WIDTH * HEIGHT, 1);
+		const char *data = (const char *) &frame[0];
+		double start = FrameAccounting::now();
+
+		for (int i = 0; i < m_nb_frames; ++i)
+		{
+			uint32_t lines = (i == resizedFrame()) ? HEIGHT - 1 : HEIGHT;
+			uint32_t size = lines * WIDTH * sizeof(uint32_t);
+			uint32_t sent = (i == shortFrame()) ? size / 2 : size;
+			uint32_t header[3] = {sent, lines, WIDTH};
+
+			double left = start + (i + ((i == lateFrame()) ? 3 : 1)) * m_period - FrameAccounting::now();
+			if (left > 0)
+				usleep(useconds_t(left * 1e6));
+			_send(header, sizeof(header));
+			_send(data, sent);
+			_readAck();
+		}
+
+		uint32_t empty[3] = {0, HEIGHT, WIDTH};
+		_send(empty, sizeof(empty));
+		_readAck();
+		_send("* 0\n> ", 6);
+	}
+
+private:
+	int m_nb_frames;
+	double m_period;
+} ;
+
+// the header checks of the acquisition thread
+static void account(XpadClient& client, FrameAccounting& accounting, FrameAccounting& ready)
+{
+	const FrameHeader& header = client.getLastFrameHeader();
+	if (header.kind == FrameHeader::Empty)
+		accounting.headerAnomaly();
+	if (header.kind != FrameHeader::Frame)
+		return;
+
+	if (header.lines != HEIGHT || header.columns != WIDTH)
+		accounting.headerAnomaly();
+	if (!header.compressed && header.data_size < header.lines * header.columns * sizeof(uint32_t))
+		accounting.shortRead();
+	accounting.frameReceived(header.receive_time);
+	ready.frameReceived(FrameAccounting::now());
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 40;
+	double period = ((argc > 2) ? atof(argv[2]) : 5) * 1e-3;
+	bool ok = true;
+
+	XpadClient client;
+	int server_skt = connectClient(client);
+	if (server_skt < 0)
+	{
+		cout << "cannot connect: " << client.getErrorMessage() << endl;
+		return 1;
+	}
+
+	FrameServer server(server_skt, nb_frames, period);
+	FrameAccounting accounting, ready;
+	vector<uint32_t> frame(WIDTH * HEIGHT);
+	int ret = -1;
+
+	// the server streams one more frame than asked, only the empty header stops it
+	double start = FrameAccounting::now();
+	accounting.start(nb_frames + 1, period, true, start);
+	ready.start(nb_frames + 1, period, true, start);
+	server.start();
+	try
+	{
+		while (client.getDataExpose(&frame[0], 1, frame.size() * sizeof(uint32_t)) == 0)
+			account(client, accounting, ready);
+		account(client, accounting, ready);
+		client.getExposeCommandReturn(ret);
+	}
+	catch (Exception& e)
+	{
+		cout << "stream failed: " << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	cout << "expected " << accounting.getNbExpected() << ", received " << accounting.getNbReceived()
+		 << ", short reads " << accounting.getNbShortReads() << ", header anomalies "
+		 << accounting.getNbHeaderAnomalies() << ", late " << accounting.getNbLateFrames()
+		 << ", max gap " << accounting.getMaxGap() * 1e3 << " ms" << endl;
+
+	double mean, jitter, max;
+	accounting.getDelayStatistics(mean, jitter, max);
+	cout << "delay at header arrival: mean " << mean * 1e3 << " ms, jitter " << jitter * 1e6
+		 << " us, max " << max * 1e3 << " ms" << endl;
+	double ready_mean, ready_jitter, ready_max;
+	ready.getDelayStatistics(ready_mean, ready_jitter, ready_max);
+	cout << "delay at frame ready: mean " << ready_mean * 1e3 << " ms, jitter " << ready_jitter * 1e6
+		 << " us, max " << ready_max * 1e3 << " ms" << endl;
+
+	ok = ok && ret == 0;
+	ok = ok && accounting.getNbExpected() == nb_frames + 1;
+	ok = ok && accounting.getNbReceived() == nb_frames;
+	ok = ok && accounting.getNbShortReads() == 1;
+	ok = ok && accounting.getNbHeaderAnomalies() == 2;
+	ok = ok && accounting.getNbLateFrames() >= 1;
+	ok = ok && accounting.getMaxGap() >= 2.5 * period;
+	ok = ok && max >= 2 * period && mean <= ready_mean;
+
+	// frames come in order, each after the modelled start of its exposure
+	double last = 0;
+	for (int i = 0; i < nb_frames; ++i)
+	{
+		double receive_time, exposure_start;
+		ok = ok && accounting.getFrameTiming(i, receive_time, exposure_start);
+		ok = ok && receive_time > last && receive_time >= exposure_start;
+		last = receive_time;
+	}
+	double receive_time, exposure_start;
+	ok = ok && !accounting.getFrameTiming(nb_frames, receive_time, exposure_start);
+
+	while (!server.hasFinished())
+		usleep(1000);
+	client.disconnectFromServer();
+	close(server_skt);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
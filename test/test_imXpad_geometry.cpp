@@ -0,0 +1,146 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Positions given by the geometrical correction remap table.
+//
+// Chips of 2x4 pixels are laid out with a chip gap of 3 columns, so that
+// the wide pixel before a gap is spread over 3 columns and the one after
+// it over 2. A single module of 3 chips checks both sides of a middle
+// chip, 3 modules of 2 chips with a module gap check the gap lines. Every
+// corrected pixel is compared with its source pixel divided by its share,
+// at 16 and 32 bits, with one line per work item so that all the workers
+// write a part of the frame.
+//
+// usage: test_imXpad_geometry [nb_workers]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadGeometry.h"
+#include "../include/imXpadWorkerPool.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+static const int CHIP_LINES = 2;
+static const int CHIP_COLUMNS = 4;
+static const int CHIP_GAP = 3;
+static const int MODULE_GAP = 1;
+
+// source column and share of each corrected column
+static const int ROW_3_CHIPS[][2] = {
+	{0, 1}, {1, 1}, {2, 1}, {3, 3}, {3, 3}, {3, 3},
+	{4, 2}, {4, 2}, {5, 1}, {6, 1}, {7, 3}, {7, 3}, {7, 3},
+	{8, 2}, {8, 2}, {9, 1}, {10, 1}, {11, 1}
+};
+static const int ROW_2_CHIPS[][2] = {
+	{0, 1}, {1, 1}, {2, 1}, {3, 3}, {3, 3}, {3, 3},
+	{4, 2}, {4, 2}, {5, 1}, {6, 1}, {7, 1}
+};
+
+// counts divide exactly by 2 and 3
+static uint32_t rawValue(int line, int col)
+{
+	return 6000 * line + 60 * (col + 1);
+}
+
+template <class T>
+static bool checkLayout(Geometry& geom, int nb_modules, int nb_chips, const int row[][2], int row_size)
+{
+	geom.build(nb_modules, nb_chips);
+	const Size& raw_size = geom.getRawSize();
+	const Size& size = geom.getCorrectedSize();
+
+	int height = nb_modules * CHIP_LINES + (nb_modules - 1) * MODULE_GAP;
+	if (raw_size != Size(nb_chips * CHIP_COLUMNS, nb_modules * CHIP_LINES) || size != Size(row_size, height))
+	{
+		cout << nb_modules << "x" << nb_chips << ": sizes " << raw_size << " -> " << size << endl;
+		return false;
+	}
+
+	vector<T> raw(raw_size.getWidth() * raw_size.getHeight());
+	for (int line = 0; line < raw_size.getHeight(); ++line)
+		for (int col = 0; col < raw_size.getWidth(); ++col)
+			raw[line * raw_size.getWidth() + col] = T(rawValue(line, col));
+
+	vector<T> frame(size.getWidth() * size.getHeight(), T(1));
+	geom.apply(&raw[0], &frame[0], sizeof(T));
+
+	for (int line = 0; line < height; ++line)
+	{
+		int module = line / (CHIP_LINES + MODULE_GAP);
+		int module_line = line % (CHIP_LINES + MODULE_GAP);
+		bool gap = (module_line >= CHIP_LINES);
+		int src_line = module * CHIP_LINES + module_line;
+
+		for (int col = 0; col < row_size; ++col)
+		{
+			T expected = gap ? 0 : T(rawValue(src_line, row[col][0]) / row[col][1]);
+			T value = frame[line * size.getWidth() + col];
+			if (value != expected)
+			{
+				cout << nb_modules << "x" << nb_chips << " at " << sizeof(T) * 8 << " bits: pixel ("
+					 << line << ", " << col << ") is " << value << ", expected " << expected << endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_workers = (argc > 1) ? atoi(argv[1]) : 3;
+	bool ok = true;
+
+	WorkerPool pool(nb_workers);
+	Geometry geom(pool, CHIP_LINES, CHIP_COLUMNS);
+	try
+	{
+		geom.setGaps(CHIP_GAP, MODULE_GAP);
+		geom.setBlockLines(1);
+
+		int nb_3 = sizeof(ROW_3_CHIPS) / sizeof(ROW_3_CHIPS[0]);
+		int nb_2 = sizeof(ROW_2_CHIPS) / sizeof(ROW_2_CHIPS[0]);
+		ok = checkLayout<uint32_t>(geom, 1, 3, ROW_3_CHIPS, nb_3) && ok;
+		ok = checkLayout<uint16_t>(geom, 1, 3, ROW_3_CHIPS, nb_3) && ok;
+		ok = checkLayout<uint32_t>(geom, 3, 2, ROW_2_CHIPS, nb_2) && ok;
+		ok = checkLayout<uint16_t>(geom, 3, 2, ROW_2_CHIPS, nb_2) && ok;
+
+		// back to the first layout, the table follows it
+		ok = checkLayout<uint32_t>(geom, 1, 3, ROW_3_CHIPS, nb_3) && ok;
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
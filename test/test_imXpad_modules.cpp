@@ -0,0 +1,240 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Per-module readout of raw frames.
+//
+// A stand-in server accepts one data stream per enabled module of a mask
+// with a hole in it, then sends the band of every module for each frame,
+// filled with values telling the module and the frame apart. The frames
+// are read at 32 bits, at 16 bits and compressed, the module threads then
+// decoding on the same pool at once. A frame height made of whole modules
+// plus gap lines, as the server geometrical correction gives, is refused.
+//
+// usage: test_imXpad_modules [nb_frames]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadModuleReadout.h"
+#include "../include/imXpadCodec.h"
+#include "../include/imXpadWorkerPool.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+static const unsigned int MODULE_MASK = 0xb;	// modules 0, 1 and 3
+static const int NB_MODULES = 3;
+static const int WIDTH = 16;
+static const int MODULE_LINES = 4;
+
+static uint32_t pixelValue(int module, int frame_nb, int pixel)
+{
+	return 1000 * (module + 1) + 10 * frame_nb + pixel % 7;
+}
+
+class ModuleServer: public StandInServer
+{
+public:
+	ModuleServer(int listener, FrameCodec& codec, int nb_raw, int nb_packed) :
+	m_listener(listener), m_codec(codec), m_nb_raw(nb_raw), m_nb_packed(nb_packed), m_streaming(false) {}
+
+	//! modules in the order their stream was opened
+	vector<int> getModules()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		return m_modules;
+	}
+
+	//! start sending the frames, as the acquisition would
+	void stream()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		m_streaming = true;
+		m_cond.broadcast();
+	}
+
+protected:
+	virtual void threadFunction()
+	{
+		vector<int> skts;
+		for (int i = 0; i < NB_MODULES; ++i)
+		{
+			int skt = acceptLocal(m_listener);
+			sendText(skt, "> ");
+			string line;
+			int module = -1;
+			if (readLine(skt, line))
+				sscanf(line.c_str(), "OpenModuleDataStream %d", &module);
+			AutoMutex aLock(m_cond.mutex());
+			m_modules.push_back(module);
+			aLock.unlock();
+			sendText(skt, "* 0\n> ");
+			skts.push_back(skt);
+		}
+
+		AutoMutex aLock(m_cond.mutex());
+		while (!m_streaming)
+			m_cond.wait();
+		vector<int> modules = m_modules;
+		aLock.unlock();
+
+		vector<uint32_t> band(WIDTH * MODULE_LINES);
+		vector<unsigned char> packed;
+		for (int f = 0; f < m_nb_raw + m_nb_packed; ++f)
+		{
+			for (int i = 0; i < NB_MODULES; ++i)
+			{
+				for (size_t p = 0; p < band.size(); ++p)
+					band[p] = pixelValue(modules[i], f, p);
+				const void *data = &band[0];
+				uint32_t size = band.size() * sizeof(uint32_t);
+				if (f >= m_nb_raw)
+				{
+					m_codec.encode(&band[0], band.size(), packed);
+					data = &packed[0];
+					size = packed.size();
+				}
+				uint32_t header[3] = {size, uint32_t(MODULE_LINES), uint32_t(WIDTH)};
+				sendAll(skts[i], header, sizeof(header));
+				sendAll(skts[i], data, size);
+			}
+			for (int i = 0; i < NB_MODULES; ++i)
+				readAck(skts[i]);
+		}
+
+		for (int i = 0; i < NB_MODULES; ++i)
+			close(skts[i]);
+	}
+
+private:
+	int			m_listener;
+	FrameCodec&	m_codec;
+	int			m_nb_raw;
+	int			m_nb_packed;
+	Cond		m_cond;
+	bool		m_streaming;
+	vector<int>	m_modules;
+} ;
+
+// the k-th enabled module fills the k-th band
+template <class T>
+static bool checkFrame(const vector<T>& frame, const vector<int>& modules, int frame_nb, const char *what)
+{
+	int band_pixels = WIDTH * MODULE_LINES;
+	for (size_t p = 0; p < frame.size(); ++p)
+	{
+		T expected = T(pixelValue(modules[p / band_pixels], frame_nb, p % band_pixels));
+		if (frame[p] != expected)
+		{
+			cout << what << " frame " << frame_nb << ": pixel " << p << " is " << frame[p]
+				 << ", expected " << expected << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+template <class T>
+static bool readFrames(ModuleReadout& readout, const vector<int>& modules, int first, int nb_frames,
+					   const char *what)
+{
+	Size size(WIDTH, NB_MODULES * MODULE_LINES);
+	readout.prepare(size, sizeof(T));
+	vector<T> frame(WIDTH * NB_MODULES * MODULE_LINES);
+	bool ok = true;
+	for (int f = first; ok && f < first + nb_frames; ++f)
+	{
+		frame.assign(frame.size(), 0);
+		if (readout.readFrame(&frame[0], f) != 0)
+		{
+			cout << what << " frame " << f << " not complete" << endl;
+			return false;
+		}
+		ok = checkFrame(frame, modules, f, what);
+	}
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 5;
+	bool ok = true;
+
+	WorkerPool pool(2);
+	FrameCodec codec(pool);
+
+	int port = 0;
+	int listener = listenLocal(port, NB_MODULES);
+	ModuleServer server(listener, codec, 2 * nb_frames, nb_frames);
+	server.start();
+
+	ModuleReadout readout;
+	try
+	{
+		readout.connect("127.0.0.1", port, MODULE_MASK);
+		int modules[] = {0, 1, 3};
+		ok = readout.getNbModules() == NB_MODULES && server.getModules() == vector<int>(modules, modules + 3);
+
+		// whole modules only, gap lines would shift the bands
+		bool refused = false;
+		try
+		{
+			readout.prepare(Size(WIDTH, NB_MODULES * MODULE_LINES + 2), 4);
+		}
+		catch (Exception& e)
+		{
+			refused = true;
+		}
+		if (!refused)
+			cout << "frame with gap lines NOT refused" << endl;
+		ok = ok && refused;
+
+		vector<int> order = server.getModules();
+		server.stream();
+		ok = readFrames<uint32_t>(readout, order, 0, nb_frames, "32 bits") && ok;
+		ok = readFrames<uint16_t>(readout, order, nb_frames, nb_frames, "16 bits") && ok;
+		readout.setFrameCodec(&codec);
+		ok = readFrames<uint32_t>(readout, order, 2 * nb_frames, nb_frames, "compressed") && ok;
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	while (!server.hasFinished())
+		usleep(1000);
+	readout.disconnect();
+	close(listener);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Parsing throughput of the server command protocol.
+//
+// The replies of the command sequences of test/mesures.txt (status, exposure
+// parameters, image size, exposure with its messages) are parsed as they
+// come from the socket, in chunks of at most RD_BUFF bytes, by ServerLine
+// and by the former character by character parser, kept here as reference.
+// Both must read the same lines. Allocations are counted by replacing the
+// global operator new.
+//
+// usage: test_imXpad_parser [nb_passes] [server_output_file]
+//###########################################################################
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <time.h>
+
+#include "../include/imXpadClient.h"
+#include "../include/imXpadServerLine.h"
+
+using namespace std;
+using namespace lima::imXpad;
+
+static long nb_allocs = 0;
+
+void *operator new(size_t size)
+{
+	++nb_allocs;
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) throw()
+{
+	free(p);
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// what the server sends for one of the sessions of mesures.txt
+static string session()
+{
+	stringstream out;
+	out << "> * \"Idle.\"\n";
+	out << "> # Time to set exposure conditions [s]: 0.0104361\n* 0\n";
+	out << "> * \"120x560\"\n";
+	out << "> # Time to call asynchronous acquisition [s]: 7.29561e-05\n"
+		<< "# LibXpadUSB :    Start expose\n";
+	for (int i = 1; i <= 10; ++i)
+		out << "@ " << i << " 10 'Acquiring'\n";
+	out << "# LibXpadUSB : exposeWriteFileAs()        Expose finish !!!!\n"
+		<< "# Mean time to get one image from disk [s]: 0.00158787\n"
+		<< "# Mean time to process and transfer one image [s]: 0.0039711\n"
+		<< "# Total time to process and transfer all images [s]: 1.07395\n"
+		<< "# Total time for command StartExposure [s]: 1.08447\n"
+		<< "* 0\n";
+	out << "> * 42\n> * 1.5e-3\n> * (null)\n> ! Module 3 not responding\n* -1\n* \"USB error\"\n";
+	return out.str();
+}
+
+// one parsed line, for the comparison of both parsers
+struct Parsed
+{
+	int type;
+	int ivalue;
+	string text;
+	bool operator==(const Parsed& o) const
+	{
+		return type == o.type && ivalue == o.ivalue && text == o.text;
+	}
+} ;
+
+// the parser the client used before ServerLine, reading from memory
+class ReferenceParser
+{
+public:
+	ReferenceParser(const string& data) : m_data(data), m_pos(0) {}
+
+	bool atEnd()
+	{
+		while (m_pos < m_data.size() && (m_data[m_pos] == '\r' || m_data[m_pos] == '\n'))
+			++m_pos;
+		return m_pos >= m_data.size();
+	}
+
+	int getChar()
+	{
+		return m_pos < m_data.size() ? m_data[m_pos++] : -1;
+	}
+
+	// returns the line type with the numbering of ServerLine::Type
+	int nextLine(string& text, int& ivalue)
+	{
+		char buff[1024 + 2];
+		char *bptr = buff;
+		int r;
+		do {
+			r = getChar();
+		} while (r == '\r' || r == '\n');
+
+		switch (r) {
+		case '>':
+			getChar();
+			return ServerLine::Prompt;
+		case '!':
+		case '#': {
+			int lead = r;
+			getChar();
+			while ((r = getChar()) != -1 && r != '\r' && r != '\n')
+				*bptr++ = r;
+			*bptr = '\0';
+			text = buff;
+			return lead == '!' ? ServerLine::ErrorMessage : ServerLine::DebugMessage;
+		}
+		case '@': {
+			char timestr[80], *tp = timestr;
+			getChar();
+			for (;;) {
+				r = getChar();
+				if (r == '\'' || r == '"' || r == '\r' || r == '\n' || r == -1)
+					break;
+				*tp++ = r;
+			}
+			*tp = '\0';
+			int done, outoff;
+			sscanf(timestr, "%d %d", &done, &outoff);
+			ivalue = done;
+			if (r == '\'' || r == '"')
+				while ((r = getChar()) != -1 && r != '\r' && r != '\n')
+					*bptr++ = r;
+			*bptr = '\0';
+			size_t len = strlen(buff);
+			if (len > 0 && (buff[len - 1] == '\'' || buff[len - 1] == '"'))
+				buff[len - 1] = 0;
+			text = buff;
+			return ServerLine::TimeBar;
+		}
+		case '*':
+			getChar();
+			r = getChar();
+			if (r == '(') {
+				while ((r = getChar()) != -1 && r != ')' && r != '\r' && r != '\n')
+					;
+				text = "";
+				return ServerLine::StringReturn;
+			} else if (r == '"') {
+				while ((r = getChar()) != -1 && r != '"')
+					*bptr++ = r;
+				*bptr = '\0';
+				text = buff;
+				return ServerLine::StringReturn;
+			} else {
+				char buffer[80], *p = buffer;
+				buffer[0] = r;
+				p = &buffer[1];
+				while ((r = getChar()) != -1 && r != '\r' && r != '\n')
+					*p++ = r;
+				*p = '\0';
+				ivalue = atoi(buffer);
+				text = buffer;
+				return ServerLine::Return;
+			}
+		default:
+			while ((r = getChar()) != -1 && r != '\r' && r != '\n')
+				*bptr++ = r;
+			*bptr = '\0';
+			text = buff;
+			return ServerLine::Unknown;
+		}
+	}
+
+private:
+	const string& m_data;
+	size_t m_pos;
+} ;
+
+// parses data the way XpadClient does: in place, refilling by RD_BUFF chunks
+class ChunkedReader
+{
+public:
+	ChunkedReader(const string& data) : m_data(data), m_next(0), m_buff(2 * RD_BUFF), m_num_read(0), m_cur_pos(0) {}
+
+	bool nextLine(ServerLine& line)
+	{
+		for (;;) {
+			size_t len = line.parse(&m_buff[m_cur_pos], m_num_read - m_cur_pos);
+			if (len > 0) {
+				m_cur_pos += len;
+				return true;
+			}
+			if (m_next == m_data.size())
+				return false;
+			memmove(&m_buff[0], &m_buff[m_cur_pos], m_num_read - m_cur_pos);
+			m_num_read -= m_cur_pos;
+			m_cur_pos = 0;
+			if (m_buff.size() - m_num_read < size_t(RD_BUFF))
+				m_buff.resize(m_num_read + RD_BUFF);
+			size_t n = min(size_t(RD_BUFF), m_data.size() - m_next);
+			memcpy(&m_buff[m_num_read], m_data.data() + m_next, n);
+			m_next += n;
+			m_num_read += n;
+		}
+	}
+
+private:
+	const string& m_data;
+	size_t m_next;
+	vector<char> m_buff;
+	size_t m_num_read;
+	size_t m_cur_pos;
+} ;
+
+int main(int argc, char *argv[])
+{
+	int nb_passes = (argc > 1) ? atoi(argv[1]) : 200;
+	bool ok = true;
+
+	string data;
+	if (argc > 2)
+	{
+		ifstream file(argv[2], ios::in | ios::binary);
+		if (!file)
+		{
+			cout << "cannot read " << argv[2] << endl;
+			return 1;
+		}
+		stringstream content;
+		content << file.rdbuf();
+		data = content.str();
+	}
+	else
+	{
+		string one = session();
+		for (int i = 0; i < 100; ++i)
+			data += one;
+	}
+
+	// both parsers read the same lines
+	vector<Parsed> reference;
+	{
+		ReferenceParser parser(data);
+		while (!parser.atEnd())
+		{
+			Parsed p;
+			p.ivalue = 0;
+			p.type = parser.nextLine(p.text, p.ivalue);
+			if (p.type == ServerLine::Prompt)
+				p.text.clear();
+			reference.push_back(p);
+		}
+	}
+	{
+		ChunkedReader reader(data);
+		ServerLine line;
+		size_t i = 0;
+		while (reader.nextLine(line))
+		{
+			Parsed p;
+			p.type = line.getType();
+			p.text = line.str();
+			p.ivalue = (p.type == ServerLine::Return) ? line.toInt()
+					 : (p.type == ServerLine::TimeBar) ? line.getDone() : 0;
+			if (i >= reference.size() || !(p == reference[i]))
+			{
+				cout << "line " << i << " differs: type " << p.type << " \"" << p.text << "\"" << endl;
+				ok = false;
+			}
+			++i;
+		}
+		ok = ok && i == reference.size();
+	}
+	size_t nb_lines = reference.size();
+
+	long allocs = nb_allocs;
+	double start = now();
+	long sum = 0;
+	for (int pass = 0; pass < nb_passes; ++pass)
+	{
+		ReferenceParser parser(data);
+		string text;
+		while (!parser.atEnd())
+		{
+			int ivalue = 0;
+			if (parser.nextLine(text, ivalue) == ServerLine::Return)
+				sum += ivalue;
+		}
+	}
+	double ref_time = now() - start;
+	double ref_allocs = double(nb_allocs - allocs) / nb_passes / nb_lines;
+
+	allocs = nb_allocs;
+	start = now();
+	long check = 0;
+	for (int pass = 0; pass < nb_passes; ++pass)
+	{
+		ChunkedReader reader(data);
+		ServerLine line;
+		while (reader.nextLine(line))
+			if (line.getType() == ServerLine::Return)
+				check += line.toInt();
+	}
+	double line_time = now() - start;
+	// the reader buffer is allocated once per pass
+	double line_allocs = double(nb_allocs - allocs - nb_passes) / nb_passes / nb_lines;
+	ok = ok && check == sum && line_allocs == 0;
+
+	double mbytes = double(data.size()) * nb_passes / 1e6;
+	cout << data.size() << " bytes, " << nb_lines << " lines" << endl;
+	cout << "character parser: " << mbytes / ref_time << " MB/s, " << ref_time / nb_passes / nb_lines * 1e9
+		 << " ns/line, " << ref_allocs << " allocations/line" << endl;
+	cout << "ServerLine: " << mbytes / line_time << " MB/s, " << line_time / nb_passes / nb_lines * 1e9
+		 << " ns/line, " << line_allocs << " allocations/line" << endl;
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
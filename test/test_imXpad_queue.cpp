@@ -0,0 +1,247 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Order, results and failures of the queued server commands.
+//
+// A stand-in server answers integer, double and string commands with the
+// value they carry, refuses one with an error message, and leaves one
+// unanswered. Commands must reach the server in submission order, their
+// futures must hold the values, a refused command must fail its future
+// and its callback without stopping the queue, and the commands still
+// queued behind the unanswered one must all fail, callbacks included,
+// once the queue is disconnected.
+//
+// usage: test_imXpad_queue [nb_commands]
+//###########################################################################
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadCommandQueue.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+// "Value <x>" returns x, "String <s>" returns "s", "Fail" is refused,
+// "Hold" is never answered
+class QueueServer: public StandInServer
+{
+public:
+	QueueServer(int listener) : m_listener(listener) {}
+
+	vector<string> getCommands()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		return m_commands;
+	}
+
+protected:
+	virtual void threadFunction()
+	{
+		m_skt = acceptLocal(m_listener);
+		_send("> ");
+		string line;
+		while (_readLine(line))
+		{
+			AutoMutex aLock(m_cond.mutex());
+			m_commands.push_back(line);
+			aLock.unlock();
+			if (line == "Exit")
+				break;
+			else if (line == "Hold")
+				continue;
+			else if (line == "Fail")
+				_send("! unknown command\n> ");
+			else if (line.compare(0, 7, "String ") == 0)
+				_send(("* \"" + line.substr(7) + "\"\n> ").c_str());
+			else
+				_send(("* " + line.substr(6) + "\n> ").c_str());
+		}
+		close(m_skt);
+	}
+
+private:
+	int				m_listener;
+	Cond			m_cond;
+	vector<string>	m_commands;
+} ;
+
+// commands in the order their callback came, with their outcome
+class Recorder: public CommandCallback
+{
+public:
+	virtual void commandDone(const CommandFuture& result)
+	{
+		AutoMutex aLock(m_lock);
+		m_commands.push_back(result.getCommand());
+		m_errors.push_back(result.hasError());
+	}
+
+	vector<string> getCommands()
+	{
+		AutoMutex aLock(m_lock);
+		return m_commands;
+	}
+
+	vector<bool> getErrors()
+	{
+		AutoMutex aLock(m_lock);
+		return m_errors;
+	}
+
+private:
+	Mutex			m_lock;
+	vector<string>	m_commands;
+	vector<bool>	m_errors;
+} ;
+
+static string valueCommand(int i)
+{
+	stringstream cmd;
+	cmd << "Value " << i;
+	return cmd.str();
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_commands = (argc > 1) ? atoi(argv[1]) : 20;
+	bool ok = true;
+
+	int port = 0;
+	int listener = listenLocal(port);
+	QueueServer server(listener);
+	server.start();
+
+	Recorder recorder;
+	CommandQueue queue;
+	try
+	{
+		queue.connect("127.0.0.1", port);
+
+		// results in submission order, a refused command in the middle
+		vector<CommandFuture> futures;
+		vector<string> sent;
+		for (int i = 0; i < nb_commands; ++i)
+		{
+			string cmd = (i == nb_commands / 2) ? "Fail" : valueCommand(i);
+			futures.push_back(queue.submit(cmd, CommandQueue::IntReturn, &recorder));
+			sent.push_back(cmd);
+		}
+		CommandFuture dvalue = queue.submit("Value 2.5", CommandQueue::DoubleReturn, &recorder);
+		CommandFuture svalue = queue.submit("String two words", CommandQueue::StringReturn, &recorder);
+		sent.push_back("Value 2.5");
+		sent.push_back("String two words");
+
+		for (int i = 0; i < nb_commands; ++i)
+		{
+			if (i == nb_commands / 2)
+			{
+				bool thrown = false;
+				try
+				{
+					futures[i].getInt();
+				}
+				catch (Exception& e)
+				{
+					thrown = true;
+				}
+				ok = ok && thrown && futures[i].hasError();
+			}
+			else if (futures[i].hasError() || futures[i].getInt() != i)
+			{
+				cout << "command " << i << " returned " << (futures[i].hasError() ? -1 : futures[i].getInt()) << endl;
+				ok = false;
+			}
+		}
+		ok = ok && dvalue.getDouble() == 2.5 && svalue.getString() == "two words";
+		// a future is ready just before its callback is called
+		double start = now();
+		while (recorder.getCommands().size() < sent.size() && now() - start < 5)
+			usleep(1000);
+		ok = ok && server.getCommands() == sent && recorder.getCommands() == sent;
+		vector<bool> errors = recorder.getErrors();
+		for (size_t i = 0; i < errors.size(); ++i)
+			ok = ok && errors[i] == (sent[i] == "Fail");
+		if (!ok)
+			cout << "commands out of order or wrong outcome" << endl;
+
+		// the server never answers Hold, the commands behind it stay queued
+		CommandFuture held = queue.submit("Hold", CommandQueue::NoReturn, &recorder);
+		vector<CommandFuture> queued;
+		for (int i = 0; i < 3; ++i)
+			queued.push_back(queue.submit(valueCommand(i), CommandQueue::IntReturn, &recorder));
+		start = now();
+		while (server.getCommands().back() != "Hold" && now() - start < 5)
+			usleep(1000);
+		ok = ok && queue.getNbPending() == 4 && !held.isReady();
+
+		queue.disconnect();
+		ok = ok && !queue.isConnected() && held.hasError();
+		for (size_t i = 0; i < queued.size(); ++i)
+			ok = ok && queued[i].isReady() && queued[i].hasError();
+
+		// every callback came, the failed ones too
+		errors = recorder.getErrors();
+		int nb_failed = 0;
+		for (size_t i = sent.size(); i < errors.size(); ++i)
+			nb_failed += errors[i] ? 1 : 0;
+		if (errors.size() != sent.size() + 4 || nb_failed != 4)
+		{
+			cout << errors.size() - sent.size() << " callbacks after the disconnection, "
+				 << nb_failed << " failed, for 4 commands" << endl;
+			ok = false;
+		}
+
+		bool refused = false;
+		try
+		{
+			queue.submit("Value 1", CommandQueue::IntReturn);
+		}
+		catch (Exception& e)
+		{
+			refused = true;
+		}
+		ok = ok && refused;
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	queue.disconnect();
+	while (!server.hasFinished())
+		usleep(1000);
+	close(listener);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Recovery time of a scan when the server restarts.
+//
+// A stand-in server answers the commands of a scan on a fixed localhost
+// port. Mid-scan it drops the connection and stays down for a while, as
+// a restarted server does. The client reconnects by itself and replays the
+// session configuration, in one write, before the next scan point.
+//
+// Reported: time from the drop to the next successful scan point, time
+// spent in the reconnection itself, and whether the new server session
+// got the configuration back before the first scan command.
+//
+// usage: test_imXpad_reconnect [nb_restarts] [downtime_ms]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadClient.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+static const char MODULE_MASK[] = "SetModuleMask 255";
+static const char EXPOSURE[] = "SetExposureParameters 1 1000 5000 4000 0 0 0 0 1 1 0 1 /opt/imXPAD/tmp_corrected/";
+static const char SCAN_POINT[] = "GetBurstNumber";
+static const int BURST_NUMBER = 42;
+
+class RestartingServer: public StandInServer
+{
+public:
+	RestartingServer() : m_port(0), m_down(false), m_up_time(0), m_quit(false)
+	{
+		m_listener = listenLocal(m_port, 4);
+	}
+
+	int getPort() const { return m_port; }
+
+	//! drop the connection and refuse new ones for downtime seconds
+	void restart(double downtime)
+	{
+		AutoMutex aLock(m_cond.mutex());
+		m_down = true;
+		m_up_time = now() + downtime;
+		shutdown(m_skt, SHUT_RDWR);
+		m_cond.broadcast();
+	}
+
+	void quit()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		m_quit = true;
+		shutdown(m_skt, SHUT_RDWR);
+		shutdown(m_listener, SHUT_RDWR);
+		m_cond.broadcast();
+	}
+
+	//! commands received on the current connection
+	vector<string> getSession()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		return m_session;
+	}
+
+protected:
+	virtual void threadFunction()
+	{
+		AutoMutex aLock(m_cond.mutex());
+		while (!m_quit)
+		{
+			if (m_down)
+			{
+				// the port is closed while the server is down
+				close(m_listener);
+				m_listener = -1;
+				double left;
+				while (!m_quit && (left = m_up_time - now()) > 0)
+					m_cond.wait(left);
+				if (m_quit)
+					break;
+				m_down = false;
+				m_listener = listenLocal(m_port, 4);
+			}
+			int listener = m_listener;
+			aLock.unlock();
+			int skt = acceptLocal(listener);
+			aLock.lock();
+			if (skt < 0)
+				continue;
+			m_skt = skt;
+			m_session.clear();
+			aLock.unlock();
+			_serve();
+			aLock.lock();
+			m_skt = -1;
+			close(skt);
+		}
+		if (m_listener >= 0)
+			close(m_listener);
+	}
+
+private:
+	void _serve()
+	{
+		_send("> ");
+		string line;
+		while (_readLine(line))
+		{
+			AutoMutex aLock(m_cond.mutex());
+			m_session.push_back(line);
+			aLock.unlock();
+			char reply[32];
+			snprintf(reply, sizeof(reply), "* %d\n> ", line == SCAN_POINT ? BURST_NUMBER : 0);
+			_send(reply);
+		}
+	}
+
+	int m_port;
+	int m_listener;
+	Cond m_cond;
+	bool m_down;
+	double m_up_time;
+	bool m_quit;
+	vector<string> m_session;
+} ;
+
+// replays the scan configuration the way the camera restores its session
+class ScanRestore: public ConnectionCallback
+{
+public:
+	virtual void connectionRestored(XpadClient& client)
+	{
+		vector<string> cmds;
+		cmds.push_back("Init");
+		cmds.push_back(MODULE_MASK);
+		cmds.push_back(EXPOSURE);
+		vector<int> values;
+		client.sendBatch(cmds, values);
+	}
+} ;
+
+static double median(vector<double> v)
+{
+	sort(v.begin(), v.end());
+	return v[v.size() / 2];
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_restarts = (argc > 1) ? atoi(argv[1]) : 5;
+	double downtime = ((argc > 2) ? atof(argv[2]) : 100) * 1e-3;
+	bool ok = true;
+
+	RestartingServer server;
+	server.start();
+
+	ScanRestore restore;
+	XpadClient client;
+	client.setConnectionCallback(&restore);
+	client.setAutoReconnect(8);
+	if (client.connectToServer("127.0.0.1", server.getPort()) < 0)
+	{
+		cout << "cannot connect: " << client.getErrorMessage() << endl;
+		return 1;
+	}
+	client.sendWait(MODULE_MASK);
+	client.sendWait(EXPOSURE);
+
+	vector<double> recovery, reconnect;
+	int nb_failed = 0;
+	for (int i = 0; i < nb_restarts; ++i)
+	{
+		int burst;
+		client.sendWait(SCAN_POINT, burst);
+
+		double start = now();
+		server.restart(downtime);
+
+		// the scan goes on, the first point after the drop reconnects
+		bool done = false;
+		while (!done && now() - start < 10)
+		{
+			try
+			{
+				client.sendWait(SCAN_POINT, burst);
+				done = (burst == BURST_NUMBER);
+			}
+			catch (Exception& e)
+			{
+				++nb_failed;
+			}
+		}
+		ok = ok && done;
+		recovery.push_back(now() - start);
+		reconnect.push_back(client.getLastReconnectTime());
+
+		vector<string> session = server.getSession();
+		ok = ok && session.size() == 4 && session[0] == "Init" && session[1] == MODULE_MASK
+			 && session[2] == EXPOSURE && session[3] == SCAN_POINT;
+	}
+	ok = ok && client.getNbReconnects() == nb_restarts && nb_failed == 0;
+
+	cout << "server down " << downtime * 1e3 << " ms, " << nb_restarts << " restarts" << endl;
+	cout << "scan point after the drop: " << median(recovery) * 1e3 << " ms (max "
+		 << *max_element(recovery.begin(), recovery.end()) * 1e3 << " ms), reconnection and restore "
+		 << median(reconnect) * 1e3 << " ms, failed scan points " << nb_failed << endl;
+
+	client.disconnectFromServer();
+	server.quit();
+	while (!server.hasFinished())
+		usleep(1000);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Capture of a server connection and its replay.
+//
+// Without argument: a session (one command, then an exposure streaming
+// frames at a fixed period) is run against a stand-in server and captured.
+// The transcript is then replayed to a new client, at the original pace
+// and as fast as possible; the client must read the same values and
+// frames, and send what the transcript recorded.
+//
+// With a transcript: serves it on a local port (printed) for one client,
+// e.g. a camera pointed to localhost, then prints the replay statistics.
+//
+// usage: test_imXpad_replay [transcript [fast] [port]]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadClient.h"
+#include "../include/imXpadTranscript.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 560;
+static const int HEIGHT = 120;
+static const int NB_FRAMES = 50;
+static const int FRAME_PERIOD_US = 4000;
+static const int BURST_NUMBER = 42;
+
+class SessionServer: public StandInServer
+{
+public:
+	SessionServer(int skt) : StandInServer(skt) {}
+
+protected:
+	virtual void threadFunction()
+	{
+		_send("> ");
+		string line;
+		while (_readLine(line))
+		{
+			if (line == "GetBurstNumber")
+			{
+				char reply[32];
+				int len = snprintf(reply, sizeof(reply), "* %d\n> ", BURST_NUMBER);
+				_send(reply, len);
+			}
+			else if (line == "StartExposure")
+			{
+				_expose();
+				_send("* 0\n> ");
+			}
+		}
+	}
+
+private:
+	void _expose()
+	{
+		vector<uint32_t> frame(WIDTH * HEIGHT);
+		uint32_t header[3] = {uint32_t(frame.size() * sizeof(uint32_t)), HEIGHT, WIDTH};
+		for (int i = 0; i < NB_FRAMES; ++i)
+		{
+			usleep(FRAME_PERIOD_US);
+			for (size_t j = 0; j < frame.size(); ++j)
+				frame[j] = i + j;
+			_send(header, sizeof(header));
+			_send(&frame[0], header[0]);
+			_readAck();
+		}
+		_send("* end of acq", 12);
+		_readAck();
+	}
+
+	int m_skt;
+} ;
+
+struct SessionResult
+{
+	int burst;
+	int nb_frames;
+	unsigned long long checksum;
+	int ret;
+	double time;
+} ;
+
+// what the camera does for a snap
+static SessionResult runSession(XpadClient& client)
+{
+	SessionResult result;
+	double start = now();
+	client.sendWait("GetBurstNumber", result.burst);
+	client.sendExposeCommand();
+	vector<uint32_t> frame(WIDTH * HEIGHT);
+	result.nb_frames = 0;
+	result.checksum = 0;
+	while (client.getDataExpose(&frame[0], 1, frame.size() * sizeof(uint32_t)) == 0)
+	{
+		++result.nb_frames;
+		for (size_t j = 0; j < frame.size(); j += 97)
+			result.checksum = 31 * result.checksum + frame[j];
+	}
+	client.getExposeCommandReturn(result.ret);
+	result.time = now() - start;
+	return result;
+}
+
+static bool replay(const string& path, bool keep_pace, const SessionResult& ref)
+{
+	TranscriptReplayer replayer(path, keep_pace);
+	replayer.start();
+
+	XpadClient client;
+	if (client.connectToServer("127.0.0.1", replayer.getPort()) < 0)
+	{
+		cout << "cannot connect to the replay: " << client.getErrorMessage() << endl;
+		return false;
+	}
+	SessionResult result = runSession(client);
+	client.disconnectFromServer();
+	while (!replayer.isDone())
+		usleep(1000);
+
+	double mbytes = replayer.getNbBytesReplayed() / 1e6;
+	cout << (keep_pace ? "replay at original pace: " : "replay as fast as possible: ")
+		 << result.time * 1e3 << " ms, " << mbytes / result.time << " MB/s, "
+		 << replayer.getNbMismatches() << " client records differing" << endl;
+
+	return result.burst == ref.burst && result.nb_frames == ref.nb_frames
+		&& result.checksum == ref.checksum && result.ret == ref.ret
+		&& replayer.getNbMismatches() == 0 && replayer.getErrorMessage().empty();
+}
+
+static int serve(const string& path, bool keep_pace, int port)
+{
+	TranscriptReplayer replayer(path, keep_pace, port);
+	cout << "serving " << path << " on port " << replayer.getPort() << endl;
+	replayer.start();
+	while (!replayer.isDone())
+		usleep(10000);
+	cout << replayer.getNbBytesReplayed() << " bytes replayed in " << replayer.getReplayTime() << " s, "
+		 << replayer.getNbMismatches() << " client records differing" << endl;
+	if (!replayer.getErrorMessage().empty())
+		cout << replayer.getErrorMessage() << endl;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	if (argc > 1)
+	{
+		bool fast = argc > 2 && string(argv[2]) == "fast";
+		int port = (argc > 3) ? atoi(argv[3]) : 0;
+		return serve(argv[1], !fast, port);
+	}
+
+	char path[] = "/tmp/test_imXpad_replayXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0)
+	{
+		cout << "cannot create the transcript file" << endl;
+		return 1;
+	}
+	close(fd);
+
+	// capture
+	int port = 0;
+	int listener = listenLocal(port);
+	TranscriptWriter transcript;
+	transcript.open(path);
+	XpadClient client;
+	client.setTranscript(&transcript);
+	if (client.connectToServer("127.0.0.1", port) < 0)
+	{
+		cout << "cannot connect: " << client.getErrorMessage() << endl;
+		return 1;
+	}
+	int server_skt = acceptLocal(listener);
+	close(listener);
+	SessionServer server(server_skt);
+	server.start();
+
+	SessionResult ref = runSession(client);
+	client.disconnectFromServer();
+	transcript.close();
+	while (!server.hasFinished())
+		usleep(1000);
+	close(server_skt);
+
+	bool ok = ref.burst == BURST_NUMBER && ref.nb_frames == NB_FRAMES && ref.ret == 0;
+	cout << "capture: " << ref.nb_frames << " frames in " << ref.time * 1e3 << " ms, "
+		 << transcript.getNbBytes() << " bytes recorded" << endl;
+
+	ok = replay(path, true, ref) && ok;
+	ok = replay(path, false, ref) && ok;
+	unlink(path);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Mapping of a readout region to the modules holding it.
+//
+// Regions of a whole detector frame, with and without the gap lines of
+// the geometrical corrections and with modules left out of the detector
+// mask, must select the fewest modules holding them, and report the lines
+// of the whole frame those modules cover. Regions outside the detector
+// must be refused. The frame memory read out is reported for a small
+// region against the whole detector.
+//
+// usage: test_imXpad_roi
+//###########################################################################
+#include <iostream>
+#include <cstdlib>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadModuleRoi.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 560;
+static const int MODULE_LINES = 120;
+
+static bool check(const char *name, unsigned int detector_mask, const Size& full_size,
+				  int x, int y, int width, int height,
+				  unsigned int expected_mask, int expected_first, int expected_lines)
+{
+	ModuleRoi roi;
+	roi.setRegion(x, y, width, height);
+	unsigned int mask = roi.map(detector_mask, full_size);
+
+	unsigned int module_mask;
+	int first_line, nb_lines;
+	roi.getReadout(module_mask, first_line, nb_lines);
+	bool ok = mask == expected_mask && module_mask == mask && first_line == expected_first && nb_lines == expected_lines;
+
+	// the region must lie in the lines read out
+	if (!roi.isEmpty())
+		ok = ok && first_line <= y && y + height <= first_line + nb_lines;
+
+	cout << name << ": modules 0x" << hex << mask << dec << ", lines " << first_line << " to "
+		 << first_line + nb_lines - 1 << (ok ? "" : "  WRONG") << endl;
+	return ok;
+}
+
+static bool refused(unsigned int detector_mask, const Size& full_size, int x, int y, int width, int height)
+{
+	try
+	{
+		ModuleRoi roi;
+		roi.setRegion(x, y, width, height);
+		roi.map(detector_mask, full_size);
+	}
+	catch (Exception& e)
+	{
+		return true;
+	}
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	bool ok = true;
+	Size raw(WIDTH, 8 * MODULE_LINES);
+	// 8 modules and 7 gap lines of 30 between them
+	Size corrected(WIDTH + 6 * 3, 8 * MODULE_LINES + 7 * 30);
+
+	ok = check("whole detector", 0xff, raw, 0, 0, 0, 0, 0xff, 0, 960) && ok;
+	ok = check("inside module 0", 0xff, raw, 10, 10, 100, 100, 0x01, 0, 120) && ok;
+	ok = check("module 1 exactly", 0xff, raw, 0, 120, WIDTH, 120, 0x02, 120, 120) && ok;
+	ok = check("across modules 1 and 2", 0xff, raw, 200, 230, 50, 20, 0x06, 120, 240) && ok;
+	ok = check("last line", 0xff, raw, 0, 959, 1, 1, 0x80, 840, 120) && ok;
+	ok = check("with gaps, module 3", 0xff, corrected, 0, 460, 100, 100, 0x08, 439, 146) && ok;
+	ok = check("with gaps, modules 6 and 7", 0xff, corrected, 0, 1000, 10, 69, 0xc0, 878, 292) && ok;
+	ok = check("modules left out", 0x36, Size(WIDTH, 4 * MODULE_LINES), 0, 200, 10, 100, 0x14, 120, 240) && ok;
+
+	ok = refused(0xff, raw, 0, 900, 10, 100) && ok;
+	ok = refused(0xff, raw, 550, 0, 20, 10) && ok;
+	ok = refused(0xff, raw, -1, 0, 10, 10) && ok;
+	ok = refused(0, raw, 0, 0, 10, 10) && ok;
+
+	ModuleRoi roi;
+	roi.setRegion(100, 500, 64, 64);
+	roi.map(0xff, raw);
+	unsigned int module_mask;
+	int first_line, nb_lines;
+	roi.getReadout(module_mask, first_line, nb_lines);
+	cout << "64x64 region: " << ModuleRoi::getNbModules(module_mask) << " module(s), "
+		 << nb_lines * WIDTH * 4 / 1024 << " kB per 32 bits frame instead of "
+		 << raw.getHeight() * WIDTH * 4 / 1024 << " kB" << endl;
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
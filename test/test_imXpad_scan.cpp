@@ -0,0 +1,143 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Accuracy and speed of the threshold scan fit.
+//
+// A cube of S-curves is synthesized for a full detector: each pixel has
+// its own threshold and noise, its counts follow the matching erfc with
+// a poissonian counting noise. The fit must find both within a fraction of
+// an ITHL step; its time is reported for the whole detector.
+//
+// usage: test_imXpad_scan [nb_modules] [nb_workers]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <time.h>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadThresholdScan.h"
+#include "../include/imXpadWorkerPool.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 560;
+static const int MODULE_LINES = 120;
+static const int FIRST_ITHL = 10;
+static const int LAST_ITHL = 60;
+static const double COUNTS = 10000;
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// Box-Muller, good enough for a counting noise
+static double gaussian()
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_modules = (argc > 1) ? atoi(argv[1]) : 8;
+	int nb_workers = (argc > 2) ? atoi(argv[2]) : 3;
+	bool ok = true;
+
+	Size size(WIDTH, nb_modules * MODULE_LINES);
+	int nb_pixels = size.getWidth() * size.getHeight();
+	WorkerPool pool(nb_workers);
+	ThresholdScan scan(pool);
+	scan.prepare(FIRST_ITHL, LAST_ITHL, size);
+
+	// thresholds spread over the middle of the scan, a few dead pixels
+	vector<float> threshold(nb_pixels), noise(nb_pixels);
+	srand(1);
+	for (int p = 0; p < nb_pixels; ++p)
+	{
+		bool dead = (p % 997 == 0);
+		threshold[p] = dead ? -1 : 25 + 20.f * rand() / RAND_MAX;
+		noise[p] = dead ? -1 : 1 + 2.f * rand() / RAND_MAX;
+	}
+	for (int s = 0; s < scan.getNbSteps(); ++s)
+	{
+		uint32_t *frame = scan.getStepFrame(s);
+		int ithl = scan.getStepIthl(s);
+		for (int p = 0; p < nb_pixels; ++p)
+		{
+			if (threshold[p] < 0)
+			{
+				frame[p] = 0;
+				continue;
+			}
+			double counts = COUNTS / 2 * erfc((ithl - threshold[p]) / (M_SQRT2 * noise[p]));
+			counts += sqrt(counts) * gaussian();
+			frame[p] = (counts > 0) ? uint32_t(counts + 0.5) : 0;
+		}
+	}
+
+	double start = now();
+	scan.fit(scan.getNbSteps());
+	double fit_time = now() - start;
+
+	const vector<float>& fitted_threshold = scan.getThresholdMap();
+	const vector<float>& fitted_noise = scan.getNoiseMap();
+	double threshold_sum = 0, noise_sum = 0;
+	int nb_fitted = 0, nb_outliers = 0;
+	for (int p = 0; p < nb_pixels; ++p)
+	{
+		if (threshold[p] < 0)
+		{
+			ok = ok && fitted_threshold[p] == -1 && fitted_noise[p] == -1;
+			continue;
+		}
+		double threshold_error = fitted_threshold[p] - threshold[p];
+		double noise_error = fitted_noise[p] - noise[p];
+		threshold_sum += threshold_error * threshold_error;
+		noise_sum += noise_error * noise_error;
+		if (fabs(threshold_error) > 0.5 || fabs(noise_error) > 0.5)
+			++nb_outliers;
+		++nb_fitted;
+	}
+	double threshold_rms = sqrt(threshold_sum / nb_fitted);
+	double noise_rms = sqrt(noise_sum / nb_fitted);
+
+	cout << scan.getNbSteps() << " steps of " << size.getWidth() << "x" << size.getHeight() << ": fit "
+		 << fit_time * 1e3 << " ms with " << nb_workers << " workers" << endl;
+	cout << "rms error: threshold " << threshold_rms << ", noise " << noise_rms << " ITHL, "
+		 << nb_outliers << " pixels off by more than 0.5" << endl;
+
+	ok = ok && threshold_rms < 0.1 && noise_rms < 0.2 && nb_outliers < nb_fitted / 1000;
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
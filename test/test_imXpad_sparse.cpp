@@ -0,0 +1,174 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Round trip of the sparse frame encoder and of its file records.
+//
+// Frames with a given number of random non-zero pixels are encoded at
+// 16 and 32 bits: an empty frame, low occupancy ones and one above the
+// threshold that must stay dense. Indices must come sorted with their
+// values, and the records written for all the frames are read back by
+// the documented layout and expanded into the original frames.
+//
+// usage: test_imXpad_sparse [nb_workers]
+//###########################################################################
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadSparse.h"
+#include "../include/imXpadWorkerPool.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 80;
+static const int HEIGHT = 120;
+static const double THRESHOLD = 0.05;
+
+template <class T>
+static vector<T> makeFrame(int nb_hits)
+{
+	vector<T> frame(WIDTH * HEIGHT, 0);
+	for (int n = 0; n < nb_hits; )
+	{
+		int i = rand() % frame.size();
+		if (!frame[i])
+			frame[i] = T(1 + rand() % 60000), ++n;
+	}
+	return frame;
+}
+
+template <class T>
+static bool checkSparse(const SparseFrame& sparse, const vector<T>& frame)
+{
+	vector<T> out(frame.size(), 0);
+	for (size_t k = 0; k < sparse.indices.size(); ++k)
+	{
+		if (k > 0 && sparse.indices[k] <= sparse.indices[k - 1])
+			return false;
+		out[sparse.indices[k]] = T(sparse.values[k]);
+	}
+	return out == frame;
+}
+
+// reads one record back into a frame of the given depth
+template <class T>
+static bool readRecord(istream& is, int frame_nb, vector<T>& frame)
+{
+	uint32_t header[5];
+	if (!is.read((char *) header, sizeof(header)))
+		return false;
+	if (header[0] != uint32_t(frame_nb) || header[1] != uint32_t(WIDTH) || header[2] != uint32_t(HEIGHT))
+		return false;
+
+	frame.assign(WIDTH * HEIGHT, 0);
+	if (header[3])
+	{
+		if (header[3] != sizeof(T) || header[4])
+			return false;
+		return bool(is.read((char *) &frame[0], frame.size() * sizeof(T)));
+	}
+
+	vector<uint32_t> indices(header[4]), values(header[4]);
+	if (header[4])
+	{
+		is.read((char *) &indices[0], indices.size() * sizeof(uint32_t));
+		is.read((char *) &values[0], values.size() * sizeof(uint32_t));
+	}
+	for (size_t k = 0; k < indices.size(); ++k)
+	{
+		if (indices[k] >= frame.size())
+			return false;
+		frame[indices[k]] = T(values[k]);
+	}
+	return bool(is);
+}
+
+template <class T>
+static bool roundTrip(SparseEncoder& encoder)
+{
+	bool ok = true;
+	int nb_pixels = WIDTH * HEIGHT;
+	int nb_hits[] = {0, 1, nb_pixels / 100, int(THRESHOLD * nb_pixels), nb_pixels / 4};
+	int nb_frames = sizeof(nb_hits) / sizeof(nb_hits[0]);
+
+	vector<vector<T> > frames;
+	stringstream file;
+	for (int f = 0; f < nb_frames; ++f)
+	{
+		frames.push_back(makeFrame<T>(nb_hits[f]));
+		SparseFrame sparse;
+		sparse.acq_frame_nb = f;
+		bool encoded = encoder.encode(&frames[f][0], sizeof(T), Size(WIDTH, HEIGHT), sparse);
+		bool expected = (nb_hits[f] <= THRESHOLD * nb_pixels);
+		if (encoded != expected || sparse.dense == encoded ||
+			(encoded && (int(sparse.indices.size()) != nb_hits[f] || !checkSparse(sparse, frames[f]))))
+		{
+			cout << sizeof(T) * 8 << " bits, " << nb_hits[f] << " hits: wrong " << (encoded ? "sparse" : "dense")
+				 << " frame" << endl;
+			ok = false;
+		}
+		sparse.write(file);
+	}
+
+	for (int f = 0; f < nb_frames; ++f)
+	{
+		vector<T> frame;
+		if (!readRecord(file, f, frame) || frame != frames[f])
+		{
+			cout << sizeof(T) * 8 << " bits: record " << f << " does not read back" << endl;
+			ok = false;
+			break;
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_workers = (argc > 1) ? atoi(argv[1]) : 3;
+	bool ok = true;
+
+	srand(3);
+	WorkerPool pool(nb_workers);
+	SparseEncoder encoder(pool);
+	try
+	{
+		encoder.setThreshold(THRESHOLD);
+		ok = roundTrip<uint32_t>(encoder) && ok;
+		ok = roundTrip<uint16_t>(encoder) && ok;
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Accuracy and speed of the running per-pixel statistics.
+//
+// Frames of a full detector are synthesized with a gaussian counting noise
+// around a flat level, with a few dead pixels (always zero), hot ones
+// (a much higher level) and noisy ones (a much wider noise). The running
+// mean and variance must match a two pass computation over the kept
+// frames, and the masks must hold exactly the planted pixels. The time
+// to fold one frame in is reported.
+//
+// usage: test_imXpad_statistics [nb_frames] [nb_modules] [nb_workers]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <time.h>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadPixelStatistics.h"
+#include "../include/imXpadWorkerPool.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+
+DEB_GLOBAL(DebModTest);
+
+static const int WIDTH = 560;
+static const int MODULE_LINES = 120;
+static const double LEVEL = 1000;
+static const int NB_BAD = 50;		// of each kind
+
+enum PixelKind
+{
+	Good,
+	Dead,
+	Hot,
+	Noisy
+} ;
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static double gaussian()
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 50;
+	int nb_modules = (argc > 2) ? atoi(argv[2]) : 8;
+	int nb_workers = (argc > 3) ? atoi(argv[3]) : 3;
+	bool ok = true;
+
+	Size size(WIDTH, nb_modules * MODULE_LINES);
+	int nb_pixels = size.getWidth() * size.getHeight();
+	WorkerPool pool(nb_workers);
+	PixelStatistics stats(pool);
+
+	srand(7);
+	vector<int> kind(nb_pixels, Good);
+	for (int k = Dead; k <= Noisy; ++k)
+		for (int n = 0; n < NB_BAD; )
+		{
+			int i = rand() % nb_pixels;
+			if (kind[i] == Good)
+				kind[i] = k, ++n;
+		}
+
+	// frames are kept for the two pass reference only
+	vector<vector<uint32_t> > frames(nb_frames, vector<uint32_t>(nb_pixels));
+	for (int f = 0; f < nb_frames; ++f)
+		for (int i = 0; i < nb_pixels; ++i)
+		{
+			double value = 0;
+			switch (kind[i])
+			{
+				case Good: value = LEVEL + sqrt(LEVEL) * gaussian(); break;
+				case Dead: value = 0; break;
+				case Hot: value = 20 * LEVEL + sqrt(20 * LEVEL) * gaussian(); break;
+				case Noisy: value = LEVEL + 30 * sqrt(LEVEL) * gaussian(); break;
+			}
+			frames[f][i] = value > 0 ? uint32_t(value + 0.5) : 0;
+		}
+
+	try
+	{
+		stats.prepare(size);
+		double start = now();
+		for (int f = 0; f < nb_frames; ++f)
+			stats.accumulate(&frames[f][0], 4);
+		double frame_time = (now() - start) / nb_frames;
+
+		vector<double> variance;
+		stats.getVariance(variance);
+		const vector<double>& mean = stats.getMean();
+		double max_mean_error = 0, max_variance_error = 0;
+		bool extrema = true;
+		for (int i = 0; i < nb_pixels; ++i)
+		{
+			double sum = 0, sum2 = 0;
+			uint32_t lo = 0xffffffff, hi = 0, zeros = 0;
+			for (int f = 0; f < nb_frames; ++f)
+			{
+				uint32_t v = frames[f][i];
+				sum += v;
+				lo = min(lo, v);
+				hi = max(hi, v);
+				zeros += (v == 0);
+			}
+			double m = sum / nb_frames;
+			for (int f = 0; f < nb_frames; ++f)
+				sum2 += (frames[f][i] - m) * (frames[f][i] - m);
+			double var = sum2 / (nb_frames - 1);
+			max_mean_error = max(max_mean_error, fabs(mean[i] - m) / max(m, 1.));
+			max_variance_error = max(max_variance_error, fabs(variance[i] - var) / max(var, 1.));
+			extrema = extrema && stats.getMin()[i] == lo && stats.getMax()[i] == hi
+					  && stats.getZeroCount()[i] == zeros;
+		}
+		ok = ok && max_mean_error < 1e-9 && max_variance_error < 1e-9 && extrema;
+
+		vector<unsigned char> dead, noisy;
+		stats.createMasks(PixelStatistics::Thresholds(), dead, noisy);
+		int wrong = 0, nb_dead = 0, nb_noisy = 0;
+		for (int i = 0; i < nb_pixels; ++i)
+		{
+			nb_dead += dead[i];
+			nb_noisy += noisy[i];
+			if (bool(dead[i]) != (kind[i] == Dead) || bool(noisy[i]) != (kind[i] == Hot || kind[i] == Noisy))
+				++wrong;
+		}
+		ok = ok && wrong == 0;
+
+		cout << nb_frames << " frames of " << size.getWidth() << "x" << size.getHeight() << ": "
+			 << frame_time * 1e3 << " ms per frame, relative error mean " << max_mean_error
+			 << " variance " << max_variance_error << endl;
+		cout << nb_dead << " dead and " << nb_noisy << " noisy pixels found, " << wrong << " wrong" << endl;
+	}
+	catch (Exception& e)
+	{
+		cout << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
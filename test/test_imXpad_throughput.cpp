@@ -0,0 +1,152 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2017
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+// Frame rate predicted by the throughput model, against the one observed.
+//
+// A stand-in server streams large frames back to back, waiting only for
+// the acknowledge of each. The reading side feeds the model the way the
+// acquisition thread does. The model assumes transfer and conversion
+// overlap while the client here reads a frame before the server sends
+// the next one, so the observed rate stays close to or below the model.
+// The comparison needs the server on a CPU of its own: sharing one with
+// the reader, it is preempted in the frames the link is measured on.
+//
+// usage: test_imXpad_throughput [nb_frames] [nb_modules]
+//###########################################################################
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include "lima/Exceptions.h"
+#include "../include/imXpadClient.h"
+#include "../include/imXpadFrameAccounting.h"
+#include "../include/imXpadThroughput.h"
+#include "imXpadTestUtils.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::imXpad;
+using namespace lima::imXpad::Test;
+
+DEB_GLOBAL(DebModTest);
+
+static const uint32_t WIDTH = 560;
+static const uint32_t MODULE_LINES = 120;
+
+class FrameServer: public StandInServer
+{
+public:
+	FrameServer(int skt, int nb_frames, uint32_t lines) :
+	StandInServer(skt), m_nb_frames(nb_frames), m_lines(lines) {}
+
+protected:
+	virtual void threadFunction()
+	{
+		vector<uint32_t> frame(WIDTH * m_lines, 7);
+		uint32_t size = frame.size() * sizeof(uint32_t);
+		uint32_t header[3] = {size, m_lines, WIDTH};
+
+		for (int i = 0; i < m_nb_frames; ++i)
+		{
+			_send(header, sizeof(header));
+			_send(&frame[0], size);
+			char ack;
+			read(m_skt, &ack, 1);
+		}
+		_send("* end of acq", 12);
+		char ack;
+		read(m_skt, &ack, 1);
+		_send("* 0\n> ", 6);
+	}
+
+private:
+	int m_nb_frames;
+	uint32_t m_lines;
+} ;
+
+int main(int argc, char *argv[])
+{
+	DEB_GLOBAL_FUNCT();
+
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 200;
+	int nb_modules = (argc > 2) ? atoi(argv[2]) : 8;
+	uint32_t lines = nb_modules * MODULE_LINES;
+	bool ok = true;
+
+	XpadClient client;
+	int server_skt = connectClient(client);
+	if (server_skt < 0)
+	{
+		cout << "cannot connect: " << client.getErrorMessage() << endl;
+		return 1;
+	}
+
+	FrameServer server(server_skt, nb_frames, lines);
+	ThroughputModel model;
+	vector<uint32_t> frame(WIDTH * lines);
+	int nb_received = 0, ret = -1;
+	double first = 0, last = 0;
+
+	server.start();
+	try
+	{
+		while (client.getDataExpose(&frame[0], 1, frame.size() * sizeof(uint32_t)) == 0)
+		{
+			// as Camera::accountFrame does
+			const FrameHeader& header = client.getLastFrameHeader();
+			double transfer_time = (header.nb_reads > 1) ? header.payload_time - header.receive_time : 0;
+			model.frameMeasured(header.lines * header.columns, header.data_size, header.compressed,
+								transfer_time, 4, FrameAccounting::now() - header.payload_time);
+			if (nb_received++ == 0)
+				first = header.receive_time;
+			last = header.receive_time;
+		}
+		client.getExposeCommandReturn(ret);
+	}
+	catch (Exception& e)
+	{
+		cout << "stream failed: " << e.getErrMsg() << endl;
+		ok = false;
+	}
+
+	double observed = (nb_received > 1) ? (nb_received - 1) / (last - first) : 0;
+	double predicted = 1 / model.getMinFramePeriod(WIDTH * lines, 4, false);
+	cout << nb_received << " frames of " << WIDTH << "x" << lines << ": link " << model.getLinkBandwidth() / 1e6
+		 << " MB/s, client " << model.getClientBandwidth() / 1e6 << " MB/s" << endl;
+	cout << "frame rate: model " << predicted << " Hz, observed " << observed << " Hz" << endl;
+
+	ok = ok && ret == 0 && nb_received == nb_frames;
+	ok = ok && model.getLinkBandwidth() != ThroughputModel::DEFAULT_LINK_BANDWIDTH;
+	ok = ok && model.getClientBandwidth() != ThroughputModel::DEFAULT_CLIENT_BANDWIDTH;
+	if (sysconf(_SC_NPROCESSORS_ONLN) > 1)
+		ok = ok && observed <= 1.2 * predicted && observed >= 0.25 * predicted;
+	else
+		cout << "single CPU, the observed rate is not compared with the model" << endl;
+
+	while (!server.hasFinished())
+		usleep(1000);
+	client.disconnectFromServer();
+	close(server_skt);
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}